@@ -0,0 +1,440 @@
+// Benchmark.cpp
+#include "Benchmark.h"
+#include "Painter.h"
+#include "RecordingRenderDevice.h"
+#include "StrokeStore.h"
+#include "Globals.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+    const char* const StyleNames[] = { "freehand", "cube", "points", "sphere", "tube" }; // DrawStyle order
+
+    struct Config {
+        size_t strokes = 2000;
+        size_t points = 200;   // Per stroke
+        float mix[5] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f }; // Relative share of each style
+        size_t frames = 60;    // Prepared frames per render mode
+        size_t soakCycles = 20;
+        size_t soakStrokes = 500; // Drawn per soak cycle
+        unsigned int seed = 1;
+        std::string out;       // JSON file; stdout if empty
+    };
+
+    struct Stage {
+        std::string name;
+        std::vector<double> samples; // Milliseconds per operation
+        double seconds = 0.0;
+        bool recorded = false;       // Draw stages: device counters over all samples
+        RecordingRenderDevice::Stats device;
+
+        double percentile(double q) const {
+            if (samples.empty()) return 0.0;
+            std::vector<double> sorted(samples);
+            std::sort(sorted.begin(), sorted.end());
+            size_t rank = static_cast<size_t>(q * (sorted.size() - 1) + 0.5); // Nearest rank
+            return sorted[rank];
+        }
+    };
+
+    class Timer {
+    public:
+        Timer() : start(std::chrono::steady_clock::now()) {}
+        double ms() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); }
+    private:
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // Times body() once and records it as one operation of 'stage'
+    template <typename Body>
+    void measure(Stage& stage, const Body& body) {
+        Timer timer;
+        body();
+        double ms = timer.ms();
+        stage.samples.push_back(ms);
+        stage.seconds += ms / 1000.0;
+    }
+
+    size_t peakResidentBytes() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);        // Bytes
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024; // Kilobytes
+#endif
+#endif
+    }
+
+    // The stroke layout before StrokeStore: one struct per stroke owning its arrays, material
+    // inline. Bounds and transform added so a walk reads the same fields from both layouts.
+    struct LegacyStroke {
+        std::vector<glm::vec3> points;
+        std::vector<StrokeVertex> generatedVertices;
+        std::vector<unsigned int> generatedIndices;
+        glm::vec4 ambientColor;
+        glm::vec4 diffuseColor;
+        glm::vec4 specularColor;
+        float shininess;
+        float size;
+        int style;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        glm::mat4 transform;
+    };
+
+    // Culling-style pass: padded stroke bounds against a query box
+    inline bool overlaps(const glm::vec3& min, const glm::vec3& max, float size, const glm::vec3& queryMin, const glm::vec3& queryMax) {
+        glm::vec3 pad(size * 0.1f);
+        glm::vec3 lo = min - pad, hi = max + pad;
+        return lo.x <= queryMax.x && lo.y <= queryMax.y && lo.z <= queryMax.z &&
+            hi.x >= queryMin.x && hi.y >= queryMin.y && hi.z >= queryMin.z;
+    }
+
+    // Arena use over the soak: high-water marks while cycling, and what is still held after the last clear
+    struct SoakResult {
+        size_t peakBytesUsed = 0;
+        size_t peakBytesReserved = 0;
+        size_t firstCyclePeakReserved = 0; // Growth from first to last cycle means the arena fragments
+        size_t lastCyclePeakReserved = 0;
+        StrokeArena::Stats retained;
+    };
+
+    void printUsage() {
+        std::fprintf(stderr,
+            "Headless benchmark options:\n"
+            "  --strokes N     strokes to draw (default 2000)\n"
+            "  --points N      points per stroke (default 200)\n"
+            "  --mix F,C,P,S,T relative share of freehand, cube, points, sphere, tube strokes (default 1,1,1,1,1)\n"
+            "  --frames N      frames prepared per render mode (default 60)\n"
+            "  --soak-cycles N add/undo/clear cycles in the arena soak (default 20)\n"
+            "  --soak-strokes N strokes drawn per soak cycle (default 500)\n"
+            "  --seed N        random seed (default 1)\n"
+            "  --out FILE      write the JSON here instead of stdout\n");
+    }
+
+    bool parseArgs(int argc, char** argv, Config& config) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") return false;
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "--strokes") config.strokes = std::strtoul(value, nullptr, 10);
+            else if (arg == "--points") config.points = std::max<size_t>(std::strtoul(value, nullptr, 10), 1);
+            else if (arg == "--frames") config.frames = std::strtoul(value, nullptr, 10);
+            else if (arg == "--soak-cycles") config.soakCycles = std::strtoul(value, nullptr, 10);
+            else if (arg == "--soak-strokes") config.soakStrokes = std::strtoul(value, nullptr, 10);
+            else if (arg == "--seed") config.seed = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--out") config.out = value;
+            else if (arg == "--mix") {
+                float total = 0.0f;
+                char* cursor = const_cast<char*>(value);
+                for (int style = 0; style < 5; ++style) {
+                    config.mix[style] = std::max(0.0f, std::strtof(cursor, &cursor));
+                    total += config.mix[style];
+                    if (*cursor == ',') cursor++;
+                }
+                if (total <= 0.0f) {
+                    std::fprintf(stderr, "--mix needs at least one non-zero share\n");
+                    return false;
+                }
+            }
+            else {
+                std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Smooth random walk inside a 40 unit box, like a hand sweeping the brush around
+    void makeStroke(std::mt19937& random, size_t count, std::vector<glm::vec3>& points) {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        glm::vec3 position(unit(random) * 20.0f, unit(random) * 20.0f, unit(random) * 20.0f);
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+        points.resize(count);
+        for (size_t p = 0; p < count; ++p) {
+            points[p] = position;
+            direction = glm::normalize(direction + glm::vec3(unit(random), unit(random), unit(random)) * 0.2f);
+            position += direction * 0.05f;
+        }
+    }
+
+    void writeJson(FILE* file, const Config& config, const std::vector<Stage>& stages, const Painter& painter,
+        const RecordingRenderDevice& device, const SoakResult& soak, double totalSeconds) {
+        std::fprintf(file, "{\n  \"benchmark\": \"3d-paint-headless\",\n");
+        std::fprintf(file, "  \"config\": {\"strokes\": %zu, \"points_per_stroke\": %zu, \"frames\": %zu, \"seed\": %u, \"mix\": {",
+            config.strokes, config.points, config.frames, config.seed);
+        for (int style = 0; style < 5; ++style) {
+            std::fprintf(file, "%s\"%s\": %g", style ? ", " : "", StyleNames[style], config.mix[style]);
+        }
+        std::fprintf(file, "}},\n  \"stages\": [\n");
+        for (size_t i = 0; i < stages.size(); ++i) {
+            const Stage& stage = stages[i];
+            double opsPerSecond = stage.seconds > 0.0 ? stage.samples.size() / stage.seconds : 0.0;
+            std::fprintf(file, "    {\"name\": \"%s\", \"ops\": %zu, \"seconds\": %.6f, \"ops_per_second\": %.1f, "
+                "\"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f",
+                stage.name.c_str(), stage.samples.size(), stage.seconds, opsPerSecond,
+                stage.percentile(0.5), stage.percentile(0.99), stage.percentile(1.0));
+            if (stage.recorded && !stage.samples.empty()) {
+                // Averages per frame
+                const RecordingRenderDevice::Stats& d = stage.device;
+                double frames = static_cast<double>(stage.samples.size());
+                std::fprintf(file, ", \"per_frame\": {\"commands\": %.1f, \"draw_calls\": %.1f, \"instances\": %.1f, \"triangles\": %.1f, "
+                    "\"binds\": %.1f, \"redundant_binds\": %.1f, \"uniform_sets\": %.1f, \"uniform_lookups\": %.1f, "
+                    "\"state_changes\": %.1f, \"uploads\": %.1f, \"upload_bytes\": %.1f}",
+                    d.commands / frames, d.drawCalls / frames, d.instances / frames, d.triangles / frames,
+                    d.binds / frames, d.redundantBinds / frames, d.uniformSets / frames, d.uniformLookups / frames,
+                    d.stateChanges / frames, d.uploads / frames, d.uploadBytes / frames);
+            }
+            std::fprintf(file, "}%s\n", i + 1 < stages.size() ? "," : "");
+        }
+        StrokeArena::Stats memory = painter.getMemoryStats();
+        StrokeHistory::Stats history = painter.getHistoryStats();
+        std::fprintf(file, "  ],\n  \"scene\": {\"strokes\": %d, \"arena_bytes_used\": %zu, \"arena_bytes_reserved\": %zu, \"history_bytes\": %zu},\n",
+            painter.getStrokeCount(), memory.bytesUsed, memory.bytesReserved, history.bytesUsed);
+        std::fprintf(file, "  \"arena_soak\": {\"cycles\": %zu, \"strokes_per_cycle\": %zu, \"peak_bytes_used\": %zu, \"peak_bytes_reserved\": %zu, "
+            "\"first_cycle_peak_reserved\": %zu, \"last_cycle_peak_reserved\": %zu, \"retained_bytes_reserved\": %zu, "
+            "\"retained_bytes_used\": %zu, \"retained_chunks\": %zu, \"retained_live_allocations\": %zu},\n",
+            config.soakCycles, config.soakStrokes, soak.peakBytesUsed, soak.peakBytesReserved, soak.firstCyclePeakReserved,
+            soak.lastCyclePeakReserved, soak.retained.bytesReserved, soak.retained.bytesUsed, soak.retained.chunkCount,
+            soak.retained.liveAllocations);
+        std::fprintf(file, "  \"device\": {\"buffers\": %zu, \"buffer_bytes\": %zu, \"vertex_arrays\": %zu, \"textures\": %zu},\n",
+            device.getBufferCount(), device.getBufferBytes(), device.getVertexArrayCount(), device.getTextureCount());
+        std::fprintf(file, "  \"peak_rss_bytes\": %zu,\n  \"total_seconds\": %.3f\n}\n", peakResidentBytes(), totalSeconds);
+    }
+}
+
+int runBenchmark(int argc, char** argv) {
+    Config config;
+    if (!parseArgs(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+    LogSinkScope logToStderr(logger, stderr); // No window drains the log: stdout is the JSON, log lines go to stderr
+    Timer total;
+    // Commands are counted, not executed: draw() runs its full submission path without a GPU
+    RecordingRenderDevice device;
+    Painter painter(device);
+    std::mt19937 random(config.seed);
+    std::discrete_distribution<int> pickStyle(config.mix, config.mix + 5);
+    std::uniform_int_distribution<int> pickColor(0, 7);
+    std::vector<Stage> stages;
+
+    // --- Drawing: addPoint for every point, then endStroke ---
+    Stage drawing;
+    drawing.name = "stroke";
+    std::vector<glm::vec3> points;
+    for (size_t s = 0; s < config.strokes; ++s) {
+        makeStroke(random, config.points, points);
+        int color = pickColor(random);
+        painter.setBrushDiffuseColor(glm::vec4(color & 1, (color >> 1) & 1, (color >> 2) & 1, 1.0f));
+        painter.setDrawStyle(static_cast<Painter::DrawStyle>(pickStyle(random)));
+        measure(drawing, [&]() {
+            for (const glm::vec3& point : points) painter.addPoint(point);
+            painter.endStroke();
+        });
+    }
+    stages.push_back(drawing);
+
+    // --- Frame preparation: chunked (the first frame bakes every chunk at once), then per-stroke culling ---
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    auto eyeAt = [](size_t frame) {
+        float angle = frame * 0.05f;
+        return glm::vec3(std::sin(angle) * 45.0f, 10.0f, std::cos(angle) * 45.0f);
+    };
+    auto viewAt = [&eyeAt](size_t frame) {
+        return glm::lookAt(eyeAt(frame), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    };
+    auto viewProjection = [&](size_t frame) { return projection * viewAt(frame); };
+    Stage bake, chunked, culled;
+    bake.name = "prepare_frame_chunk_bake";
+    chunked.name = "prepare_frame_chunked";
+    culled.name = "prepare_frame_culled";
+    painter.setChunkedRendering(true);
+    measure(bake, [&]() {
+        painter.prepareFrame(viewProjection(0));
+        painter.flushChunks();
+    });
+    for (size_t f = 0; f < config.frames; ++f) {
+        measure(chunked, [&]() { painter.prepareFrame(viewProjection(f)); });
+    }
+    painter.setChunkedRendering(false);
+    for (size_t f = 0; f < config.frames; ++f) {
+        measure(culled, [&]() { painter.prepareFrame(viewProjection(f)); });
+    }
+    stages.push_back(bake);
+    stages.push_back(chunked);
+    stages.push_back(culled);
+
+    // --- Submission: whole draw() calls into the recording device. An untimed first frame
+    // uploads the meshes, so the counters show what an unchanged scene costs per frame ---
+    Stage drawChunked, drawCulled;
+    drawChunked.name = "draw_chunked";
+    drawCulled.name = "draw_culled";
+    Stage* drawStages[2] = { &drawChunked, &drawCulled };
+    for (int mode = 0; mode < 2; ++mode) {
+        Stage& stage = *drawStages[mode];
+        painter.setChunkedRendering(mode == 0);
+        painter.flushChunks(); // Steady state: every chunk baked
+        painter.draw(viewAt(0), projection, eyeAt(0));
+        device.resetStats();
+        for (size_t f = 0; f < config.frames; ++f) {
+            measure(stage, [&]() { painter.draw(viewAt(f), projection, eyeAt(f)); });
+        }
+        stage.recorded = true;
+        stage.device = device.getStats();
+        stages.push_back(stage);
+    }
+
+    // --- History: undo everything, then redo it ---
+    Stage undo, redo;
+    undo.name = "undo";
+    redo.name = "redo";
+    for (size_t s = 0; s < config.strokes; ++s) measure(undo, [&]() { painter.undoStroke(); });
+    for (size_t s = 0; s < config.strokes; ++s) measure(redo, [&]() { painter.redoStroke(); });
+    stages.push_back(undo);
+    stages.push_back(redo);
+
+    // --- Merge everything into one stroke, then undo the merge ---
+    Stage merge, undoMerge;
+    merge.name = "merge";
+    undoMerge.name = "undo_merge";
+    painter.setDrawStyle(Painter::FREEHAND);
+    measure(merge, [&]() { painter.mergeAllStrokes(); });
+    measure(undoMerge, [&]() { painter.undoStroke(); });
+    stages.push_back(merge);
+    stages.push_back(undoMerge);
+
+    // --- Store iteration: the same strokes in StrokeStore's packed header arrays and in the old
+    // array of stroke structs, walked by a bounds test like the culling pass ---
+    Stage walkSoa, walkAos;
+    walkSoa.name = "store_walk_soa";
+    walkAos.name = "store_walk_aos";
+    {
+        StrokeArena walkArena;
+        StrokeStore store;
+        std::vector<LegacyStroke> legacy(config.strokes);
+        store.reserve(config.strokes);
+        for (size_t s = 0; s < config.strokes; ++s) {
+            makeStroke(random, config.points, points);
+            StrokePayloadBuilder builder(walkArena, points.size(), 0, 0);
+            std::copy(points.begin(), points.end(), builder.points());
+            StrokeRef payload = builder.finish();
+            StrokeMaterial material = { glm::vec4(0.2f), glm::vec4(1.0f), glm::vec4(0.5f), 32.0f };
+            int style = pickStyle(random);
+            store.add(payload, material, 1.0f, static_cast<uint8_t>(style));
+            LegacyStroke& stroke = legacy[s];
+            stroke.points = points;
+            stroke.ambientColor = material.ambientColor;
+            stroke.diffuseColor = material.diffuseColor;
+            stroke.specularColor = material.specularColor;
+            stroke.shininess = material.shininess;
+            stroke.size = 1.0f;
+            stroke.style = style;
+            stroke.boundsMin = payload->boundsMin;
+            stroke.boundsMax = payload->boundsMax;
+            stroke.transform = glm::mat4(1.0f);
+        }
+        size_t hitsSoa = 0, hitsAos = 0;
+        for (size_t f = 0; f < config.frames; ++f) {
+            // A slab sweeping through the scene, so about half the strokes pass
+            float x = std::sin(f * 0.1f) * 20.0f;
+            glm::vec3 queryMin(x - 20.0f, -100.0f, -100.0f), queryMax(x + 20.0f, 100.0f, 100.0f);
+            measure(walkSoa, [&]() {
+                const std::vector<glm::vec3>& boundsMin = store.getBoundsMin();
+                const std::vector<glm::vec3>& boundsMax = store.getBoundsMax();
+                const std::vector<float>& sizes = store.getSizes();
+                for (size_t i = 0; i < store.size(); ++i) {
+                    if (overlaps(boundsMin[i], boundsMax[i], sizes[i], queryMin, queryMax)) hitsSoa++;
+                }
+            });
+            measure(walkAos, [&]() {
+                for (const LegacyStroke& stroke : legacy) {
+                    if (overlaps(stroke.boundsMin, stroke.boundsMax, stroke.size, queryMin, queryMax)) hitsAos++;
+                }
+            });
+        }
+        if (hitsSoa != hitsAos) std::fprintf(stderr, "Store walks disagree: %zu vs %zu\n", hitsSoa, hitsAos);
+    }
+    stages.push_back(walkSoa);
+    stages.push_back(walkAos);
+
+    // --- Arena soak: cycles of drawing, undoing half, drawing over the undone strokes and
+    // clearing, on a painter of its own so the scene above is left as it is ---
+    Stage soakCycle;
+    soakCycle.name = "arena_soak_cycle";
+    SoakResult soak;
+    {
+        Painter soakPainter(false);
+        auto sample = [&](size_t& cyclePeak) {
+            StrokeArena::Stats stats = soakPainter.getMemoryStats();
+            soak.peakBytesUsed = std::max(soak.peakBytesUsed, stats.bytesUsed);
+            soak.peakBytesReserved = std::max(soak.peakBytesReserved, stats.bytesReserved);
+            cyclePeak = std::max(cyclePeak, stats.bytesReserved);
+        };
+        auto drawStrokes = [&](size_t count) {
+            for (size_t s = 0; s < count; ++s) {
+                makeStroke(random, config.points, points);
+                soakPainter.setDrawStyle(static_cast<Painter::DrawStyle>(pickStyle(random)));
+                for (const glm::vec3& point : points) soakPainter.addPoint(point);
+                soakPainter.endStroke();
+            }
+        };
+        for (size_t cycle = 0; cycle < config.soakCycles; ++cycle) {
+            size_t cyclePeak = 0;
+            measure(soakCycle, [&]() {
+                drawStrokes(config.soakStrokes);
+                sample(cyclePeak);
+                for (size_t s = 0; s < config.soakStrokes / 2; ++s) soakPainter.undoStroke();
+                drawStrokes(config.soakStrokes / 4); // Drops the undone strokes
+                sample(cyclePeak);
+                soakPainter.clear();
+            });
+            if (cycle == 0) soak.firstCyclePeakReserved = cyclePeak;
+            soak.lastCyclePeakReserved = cyclePeak;
+        }
+        soak.retained = soakPainter.getMemoryStats();
+    }
+    stages.push_back(soakCycle);
+
+    FILE* file = config.out.empty() ? stdout : std::fopen(config.out.c_str(), "w");
+    if (!file) {
+        std::fprintf(stderr, "Cannot write %s\n", config.out.c_str());
+        return 1;
+    }
+    writeJson(file, config, stages, painter, device, soak, total.ms() / 1000.0);
+    if (file != stdout) std::fclose(file);
+    return 0;
+}
+
+#ifdef P3D_BENCHMARK_MAIN
+// Standalone headless build (see README.md)
+int main(int argc, char** argv) {
+    return runBenchmark(argc, argv);
+}
+#endif
@@ -0,0 +1,10 @@
+// Benchmark.h
+#pragma once
+
+// Headless scene-scale benchmark: drives a Painter through synthetic strokes and prints
+// per-stage timings as JSON. GPU commands go to a RecordingRenderDevice, so draw() is timed and
+// its commands, binds and uploads counted, with no window or GL context.
+//   3D Paint.exe --benchmark [options]
+// or, on Linux, the standalone build described in README.md. Run with --help for the options.
+// Returns the process exit code.
+int runBenchmark(int argc, char** argv);
@@ -0,0 +1,185 @@
+// FrameTimeStats.cpp
+#include "FrameTimeStats.h"
+#include "Globals.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// The ring median behind the hitch threshold is refreshed this often, and only once there
+// are enough frames for it to mean something
+static const uint64_t MedianInterval = 64;
+static const size_t MedianMinFrames = 32;
+static const int GraphFrames = 240;
+
+FrameTimeStats::FrameTimeStats() :
+    recentMs(RecentFrames, 0.0f),
+    recentHitch(RecentFrames, 0),
+    hitchFactor(2.0f)
+{
+    std::strcpy(csvPath, "frametimes.csv");
+    reset();
+}
+
+void FrameTimeStats::reset() {
+    std::memset(histogram, 0, sizeof(histogram));
+    frameCount = 0;
+    totalMs = 0.0;
+    maxMs = 0.0;
+    hitches = 0;
+    std::fill(recentMs.begin(), recentMs.end(), 0.0f);
+    std::fill(recentHitch.begin(), recentHitch.end(), 0);
+    head = 0;
+    medianMs = 0.0f;
+}
+
+int FrameTimeStats::binOf(double ms) {
+    if (ms <= 0.0) return 0;
+    int bin = static_cast<int>(std::floor((std::log2(ms) - MinOctave) * BinsPerOctave));
+    return std::min(std::max(bin, 0), BinCount - 1);
+}
+
+double FrameTimeStats::binLowerMs(int bin) {
+    return std::exp2(MinOctave + static_cast<double>(bin) / BinsPerOctave);
+}
+
+void FrameTimeStats::addFrame(double seconds) {
+    double ms = seconds * 1000.0;
+    histogram[binOf(ms)]++;
+    frameCount++;
+    totalMs += ms;
+    maxMs = std::max(maxMs, ms);
+
+    bool hitch = medianMs > 0.0f && ms > medianMs * hitchFactor;
+    if (hitch) hitches++;
+    recentMs[head] = static_cast<float>(ms);
+    recentHitch[head] = hitch ? 1 : 0;
+    head = (head + 1) % RecentFrames;
+
+    size_t filled = static_cast<size_t>(std::min<uint64_t>(frameCount, RecentFrames));
+    if (filled >= MedianMinFrames && frameCount % MedianInterval == 0) {
+        std::vector<float> sorted(recentMs.begin(), recentMs.begin() + filled);
+        std::nth_element(sorted.begin(), sorted.begin() + filled / 2, sorted.end());
+        medianMs = sorted[filled / 2];
+    }
+}
+
+
+// --- Percentiles ---
+
+// Geometric middle of the bin the q-th frame falls in
+double FrameTimeStats::percentileFromHistogram(double q) const {
+    if (frameCount == 0) return 0.0;
+    uint64_t rank = static_cast<uint64_t>(q * (frameCount - 1)); // Frames below it
+    uint64_t seen = 0;
+    for (int bin = 0; bin < BinCount; ++bin) {
+        seen += histogram[bin];
+        if (seen > rank) return std::min(std::sqrt(binLowerMs(bin) * binLowerMs(bin + 1)), maxMs);
+    }
+    return maxMs;
+}
+
+FrameTimeStats::Summary FrameTimeStats::getSession() const {
+    Summary summary;
+    summary.frames = frameCount;
+    if (frameCount == 0) return summary;
+    summary.meanMs = totalMs / frameCount;
+    summary.p50 = percentileFromHistogram(0.50);
+    summary.p95 = percentileFromHistogram(0.95);
+    summary.p99 = percentileFromHistogram(0.99);
+    summary.maxMs = maxMs;
+    return summary;
+}
+
+FrameTimeStats::Summary FrameTimeStats::getRecent() const {
+    Summary summary;
+    size_t filled = static_cast<size_t>(std::min<uint64_t>(frameCount, RecentFrames));
+    summary.frames = filled;
+    if (filled == 0) return summary;
+    std::vector<float> sorted(recentMs.begin(), recentMs.begin() + filled);
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&sorted](double q) { return static_cast<double>(sorted[static_cast<size_t>(q * (sorted.size() - 1) + 0.5)]); };
+    double sum = 0.0;
+    for (float ms : sorted) sum += ms;
+    summary.meanMs = sum / filled;
+    summary.p50 = at(0.50);
+    summary.p95 = at(0.95);
+    summary.p99 = at(0.99);
+    summary.maxMs = sorted.back();
+    return summary;
+}
+
+
+// --- CSV ---
+
+bool FrameTimeStats::writeCsv(const std::string& path, std::string* error) const {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    std::string histogramPath = hasExtension ? path.substr(0, dot) + "_histogram" + path.substr(dot) : path + "_histogram.csv";
+
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        if (error) *error = "Cannot open " + path + " for writing";
+        return false;
+    }
+    // Oldest first; frame numbers count from the session start, so runs line up
+    size_t filled = static_cast<size_t>(std::min<uint64_t>(frameCount, RecentFrames));
+    size_t first = (head + RecentFrames - filled) % RecentFrames;
+    std::fprintf(file, "frame,frame_ms,hitch\n");
+    for (size_t i = 0; i < filled; ++i) {
+        size_t slot = (first + i) % RecentFrames;
+        std::fprintf(file, "%llu,%.4f,%d\n", static_cast<unsigned long long>(frameCount - filled + i), recentMs[slot], recentHitch[slot]);
+    }
+    bool ok = std::fclose(file) == 0;
+
+    file = std::fopen(histogramPath.c_str(), "w");
+    if (!file) {
+        if (error) *error = "Cannot open " + histogramPath + " for writing";
+        return false;
+    }
+    std::fprintf(file, "lower_ms,upper_ms,frames\n");
+    for (int bin = 0; bin < BinCount; ++bin) {
+        if (histogram[bin]) std::fprintf(file, "%.4f,%.4f,%llu\n", binLowerMs(bin), binLowerMs(bin + 1), static_cast<unsigned long long>(histogram[bin]));
+    }
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok && error) *error = "Failed writing " + path;
+    return ok;
+}
+
+
+// --- UI ---
+
+void FrameTimeStats::draw() {
+    if (!ImGui::CollapsingHeader("Frame Times")) return;
+
+    Summary recent = getRecent();
+    Summary session = getSession();
+    ImGui::Text("Last %llu: p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms", static_cast<unsigned long long>(recent.frames),
+        recent.p50, recent.p95, recent.p99, recent.maxMs);
+    ImGui::Text("Session %llu: p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms", static_cast<unsigned long long>(session.frames),
+        session.p50, session.p95, session.p99, session.maxMs);
+    ImGui::Text("Hitches: %llu (frames over %.2f ms)", static_cast<unsigned long long>(hitches), medianMs * hitchFactor);
+    ImGui::SliderFloat("Hitch x Median", &hitchFactor, 1.25f, 5.0f, "%.2f");
+
+    // Newest frames, oldest on the left
+    float graph[GraphFrames];
+    size_t shown = static_cast<size_t>(std::min<uint64_t>(frameCount, GraphFrames));
+    for (size_t i = 0; i < GraphFrames; ++i) {
+        graph[i] = i < GraphFrames - shown ? 0.0f : recentMs[(head + RecentFrames - GraphFrames + i) % RecentFrames];
+    }
+    char overlay[32];
+    std::snprintf(overlay, sizeof(overlay), "%.2f ms", recent.frames ? recentMs[(head + RecentFrames - 1) % RecentFrames] : 0.0f);
+    ImGui::PlotLines("##FrameTimes", graph, GraphFrames, 0, overlay, 0.0f, std::max(recent.p99 * 1.5, 1.0), ImVec2(-1.0f, 60.0f));
+
+    ImGui::InputText("##FrameTimesCsv", csvPath, sizeof(csvPath));
+    ImGui::SameLine();
+    if (ImGui::Button("Dump CSV")) {
+        std::string error;
+        if (writeCsv(csvPath, &error)) logger.addLog(std::string("Frame times written to ") + csvPath);
+        else logger.addLog("[ERROR] Frame time CSV failed: " + error);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset##FrameTimes")) reset();
+}
@@ -0,0 +1,66 @@
+// FrameTimeStats.h
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Distribution of frame times over a session, for the stutters an average hides. Every frame
+// goes into a log-spaced histogram (16 bins per octave from 1/16 ms to 2 s, so session
+// percentiles are within ~2%) that never grows, and into a ring of the most recent frames for
+// exact recent percentiles and the graph. A hitch is a frame longer than hitchFactor times the
+// recent median, so the threshold follows the refresh rate instead of a fixed budget.
+class FrameTimeStats {
+public:
+    static const size_t RecentFrames = 4096;
+    static const int BinsPerOctave = 16;
+    static const int MinOctave = -4; // 1/16 ms
+    static const int Octaves = 15;   // Up to 2048 ms
+    static const int BinCount = BinsPerOctave * Octaves;
+
+    struct Summary {
+        uint64_t frames = 0;
+        double meanMs = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double maxMs = 0.0;
+    };
+
+    FrameTimeStats();
+
+    void addFrame(double seconds);
+    void reset();
+
+    Summary getSession() const; // From the histogram, since the last reset
+    Summary getRecent() const;  // Exact, over the ring
+    uint64_t getHitchCount() const { return hitches; }
+
+    // Recent frames as "frame,frame_ms,hitch" rows to 'path', and the session histogram as
+    // "lower_ms,upper_ms,frames" rows next to it (name_histogram.csv)
+    bool writeCsv(const std::string& path, std::string* error = nullptr) const;
+
+    void draw(); // Inside the current ImGui window
+
+private:
+    static int binOf(double ms);
+    static double binLowerMs(int bin);
+
+    double percentileFromHistogram(double q) const;
+
+    // Session
+    uint64_t histogram[BinCount];
+    uint64_t frameCount;
+    double totalMs;
+    double maxMs;
+    uint64_t hitches;
+
+    // Recent frames
+    std::vector<float> recentMs;
+    std::vector<uint8_t> recentHitch;
+    size_t head;          // Next slot
+    float medianMs;       // Of the ring, refreshed every few frames
+    float hitchFactor;
+
+    char csvPath[256];
+};
@@ -0,0 +1,352 @@
+// GltfExport.cpp
+#include "GltfExport.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdarg>
+#include <cmath>
+#include <chrono>
+#include <map>
+#include <algorithm>
+
+using namespace GltfExport;
+
+namespace {
+    enum ComponentType { Byte = 5120, UnsignedByte = 5121, Short = 5122, UnsignedShort = 5123, UnsignedInt = 5125, Float = 5126 };
+    enum Target { NoTarget = 0, ArrayBuffer = 34962, ElementArrayBuffer = 34963 };
+    enum Mode { ModePoints = 0, ModeLines = 1, ModeLineStrip = 3, ModeTriangles = 4 };
+
+    void appendf(std::string& out, const char* format, ...) {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        int length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length > 0) out.append(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+    }
+
+    // Comma-separated JSON array body plus its element count
+    struct JsonArray {
+        std::string body;
+        uint32_t count = 0;
+        std::string& next() {
+            if (count++ > 0) body += ",";
+            return body;
+        }
+    };
+
+    // Binary chunk, buffer views and accessors
+    struct Buffers {
+        std::vector<uint8_t> binary;
+        JsonArray views;
+        JsonArray accessors;
+
+        uint32_t addView(const void* data, size_t bytes, uint32_t stride, Target target) {
+            binary.resize((binary.size() + 3) & ~size_t(3), 0); // Every view starts 4-byte aligned
+            size_t offset = binary.size();
+            binary.insert(binary.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + bytes);
+            std::string& out = views.next();
+            appendf(out, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu", offset, bytes);
+            if (stride) appendf(out, ",\"byteStride\":%u", stride);
+            if (target) appendf(out, ",\"target\":%d", target);
+            out += "}";
+            return views.count - 1;
+        }
+
+        uint32_t addAccessor(uint32_t view, ComponentType component, size_t count, const char* type, bool normalized = false,
+            const float* minValues = nullptr, const float* maxValues = nullptr, int components = 0) {
+            std::string& out = accessors.next();
+            appendf(out, "{\"bufferView\":%u,\"componentType\":%d,\"count\":%zu,\"type\":\"%s\"", view, component, count, type);
+            if (normalized) out += ",\"normalized\":true";
+            if (minValues && maxValues) {
+                for (int pass = 0; pass < 2; ++pass) {
+                    const float* values = pass == 0 ? minValues : maxValues;
+                    out += pass == 0 ? ",\"min\":[" : ",\"max\":[";
+                    for (int c = 0; c < components; ++c) appendf(out, c ? ",%.9g" : "%.9g", values[c]);
+                    out += "]";
+                }
+            }
+            out += "}";
+            return accessors.count - 1;
+        }
+
+        uint32_t addPositions(const glm::vec3* positions, size_t count) {
+            glm::vec3 lo(INFINITY), hi(-INFINITY);
+            for (size_t i = 0; i < count; ++i) {
+                lo = glm::min(lo, positions[i]);
+                hi = glm::max(hi, positions[i]);
+            }
+            uint32_t view = addView(positions, count * sizeof(glm::vec3), 0, ArrayBuffer);
+            return addAccessor(view, Float, count, "VEC3", false, &lo.x, &hi.x, 3);
+        }
+
+        uint32_t addIndices(const unsigned int* indices, size_t count, size_t vertexCount) {
+            if (vertexCount <= 0xFFFF) {
+                std::vector<uint16_t> shorts(indices, indices + count);
+                uint32_t view = addView(shorts.data(), shorts.size() * sizeof(uint16_t), 0, ElementArrayBuffer);
+                return addAccessor(view, UnsignedShort, count, "SCALAR");
+            }
+            uint32_t view = addView(indices, count * sizeof(unsigned int), 0, ElementArrayBuffer);
+            return addAccessor(view, UnsignedInt, count, "SCALAR");
+        }
+    };
+
+    // Splits an affine matrix into translation, rotation (x, y, z, w) and per-axis scale.
+    // Stroke and dab transforms are rotations and scales along the mesh axes, never sheared.
+    void decompose(const glm::mat4& matrix, glm::vec3& translation, glm::vec4& rotation, glm::vec3& scale) {
+        translation = glm::vec3(matrix[3]);
+        glm::vec3 columns[3];
+        for (int c = 0; c < 3; ++c) {
+            columns[c] = glm::vec3(matrix[c]);
+            scale[c] = glm::length(columns[c]);
+            columns[c] = scale[c] > 0.0f ? columns[c] / scale[c] : glm::vec3(c == 0, c == 1, c == 2);
+        }
+        if (glm::dot(glm::cross(columns[0], columns[1]), columns[2]) < 0.0f) {
+            // Mirrored: fold the reflection into the scale so the rotation stays proper
+            scale.x = -scale.x;
+            columns[0] = -columns[0];
+        }
+        // m(row, column) = columns[column][row]
+        float m00 = columns[0].x, m11 = columns[1].y, m22 = columns[2].z;
+        float m01 = columns[1].x, m02 = columns[2].x, m10 = columns[0].y;
+        float m12 = columns[2].y, m20 = columns[0].z, m21 = columns[1].z;
+        float trace = m00 + m11 + m22;
+        if (trace > 0.0f) {
+            float s = 0.5f / std::sqrt(trace + 1.0f);
+            rotation = glm::vec4((m21 - m12) * s, (m02 - m20) * s, (m10 - m01) * s, 0.25f / s);
+        }
+        else if (m00 > m11 && m00 > m22) {
+            float s = 2.0f * std::sqrt(1.0f + m00 - m11 - m22);
+            rotation = glm::vec4(0.25f * s, (m01 + m10) / s, (m02 + m20) / s, (m21 - m12) / s);
+        }
+        else if (m11 > m22) {
+            float s = 2.0f * std::sqrt(1.0f + m11 - m00 - m22);
+            rotation = glm::vec4((m01 + m10) / s, 0.25f * s, (m12 + m21) / s, (m02 - m20) / s);
+        }
+        else {
+            float s = 2.0f * std::sqrt(1.0f + m22 - m00 - m11);
+            rotation = glm::vec4((m02 + m20) / s, (m12 + m21) / s, 0.25f * s, (m10 - m01) / s);
+        }
+    }
+
+    std::string primitive(uint32_t position, int normal, int indices, uint32_t material, Mode mode) {
+        std::string out;
+        appendf(out, "{\"attributes\":{\"POSITION\":%u", position);
+        if (normal >= 0) appendf(out, ",\"NORMAL\":%d", normal);
+        out += "}";
+        if (indices >= 0) appendf(out, ",\"indices\":%d", indices);
+        appendf(out, ",\"material\":%u,\"mode\":%d}", material, mode);
+        return out;
+    }
+}
+
+bool GltfExport::write(const std::string& path, const Scene& scene, Stats* stats, std::string* error) {
+    auto start = std::chrono::steady_clock::now();
+    Buffers buffers;
+    JsonArray meshes, nodes;
+    size_t instances = 0;
+    bool quantized = false, instanced = false;
+
+    auto addMesh = [&meshes](const std::string& primitives) {
+        appendf(meshes.next(), "{\"primitives\":[%s]}", primitives.c_str());
+        return meshes.count - 1;
+    };
+    // One node for a single transform, otherwise one node instancing the mesh
+    auto addNode = [&](uint32_t mesh, const std::vector<glm::mat4>& transforms) {
+        std::string& out = nodes.next();
+        appendf(out, "{\"mesh\":%u", mesh);
+        if (transforms.size() == 1) {
+            out += ",\"matrix\":[";
+            const float* values = &transforms[0][0][0];
+            for (int i = 0; i < 16; ++i) appendf(out, i ? ",%.9g" : "%.9g", values[i]);
+            out += "]}";
+            return;
+        }
+        std::vector<glm::vec3> translations(transforms.size()), scales(transforms.size());
+        std::vector<glm::vec4> rotations(transforms.size());
+        for (size_t i = 0; i < transforms.size(); ++i) {
+            decompose(transforms[i], translations[i], rotations[i], scales[i]);
+        }
+        uint32_t t = buffers.addAccessor(buffers.addView(translations.data(), translations.size() * sizeof(glm::vec3), 0, NoTarget), Float, transforms.size(), "VEC3");
+        uint32_t r = buffers.addAccessor(buffers.addView(rotations.data(), rotations.size() * sizeof(glm::vec4), 0, NoTarget), Float, transforms.size(), "VEC4");
+        uint32_t s = buffers.addAccessor(buffers.addView(scales.data(), scales.size() * sizeof(glm::vec3), 0, NoTarget), Float, transforms.size(), "VEC3");
+        appendf(out, ",\"extensions\":{\"EXT_mesh_gpu_instancing\":{\"attributes\":{\"TRANSLATION\":%u,\"ROTATION\":%u,\"SCALE\":%u}}}}", t, r, s);
+        instances += transforms.size();
+        instanced = true;
+    };
+
+    // --- Dabs: base meshes written once, one instanced node per primitive and material ---
+    int baseAccessors[2][3] = { { -1, -1, -1 }, { -1, -1, -1 } }; // position, normal, indices
+    for (const Scene::DabGroup& group : scene.dabs) {
+        if (group.transforms.empty()) continue;
+        const BaseMesh& base = group.base == Scene::Cube ? scene.cube : scene.sphere;
+        int* accessors = baseAccessors[group.base];
+        if (accessors[0] < 0) {
+            std::vector<glm::vec3> positions(base.vertexCount), normals(base.vertexCount);
+            for (size_t v = 0; v < base.vertexCount; ++v) {
+                positions[v] = base.vertices[v].position;
+                normals[v] = base.vertices[v].normal;
+            }
+            accessors[0] = static_cast<int>(buffers.addPositions(positions.data(), positions.size()));
+            accessors[1] = static_cast<int>(buffers.addAccessor(buffers.addView(normals.data(), normals.size() * sizeof(glm::vec3), 0, ArrayBuffer), Float, normals.size(), "VEC3"));
+            if (base.indices) accessors[2] = static_cast<int>(buffers.addIndices(base.indices, base.indexCount, base.vertexCount));
+        }
+        uint32_t mesh = addMesh(primitive(accessors[0], accessors[1], accessors[2], group.material, ModeTriangles));
+        addNode(mesh, group.transforms);
+    }
+
+    // --- Payloads: one mesh each, placed by every stroke that draws it ---
+    for (const Scene::PayloadGroup& group : scene.payloads) {
+        const StrokePayload& payload = *group.payload;
+        if (group.transforms.empty()) continue;
+
+        if (group.kind == Scene::Triangles) {
+            if (payload.vertexCount == 0 || payload.indexCount == 0) continue;
+            // 16-bit positions over the mesh bounds, 8-bit normals, both padded to 4 bytes
+            glm::vec3 lo(INFINITY), hi(-INFINITY);
+            for (uint32_t v = 0; v < payload.vertexCount; ++v) {
+                lo = glm::min(lo, payload.vertices[v].position);
+                hi = glm::max(hi, payload.vertices[v].position);
+            }
+            glm::vec3 center = (lo + hi) * 0.5f;
+            glm::vec3 extent = glm::max((hi - lo) * 0.5f, glm::vec3(1e-6f));
+            std::vector<int16_t> positions(payload.vertexCount * 4, 0);
+            std::vector<int8_t> normals(payload.vertexCount * 4, 0);
+            float qMin[3] = { 32767, 32767, 32767 }, qMax[3] = { -32767, -32767, -32767 };
+            for (uint32_t v = 0; v < payload.vertexCount; ++v) {
+                glm::vec3 p = (payload.vertices[v].position - center) / extent;
+                const glm::vec3& n = payload.vertices[v].normal;
+                for (int axis = 0; axis < 3; ++axis) {
+                    int16_t q = static_cast<int16_t>(std::lround(glm::clamp(p[axis], -1.0f, 1.0f) * 32767.0f));
+                    positions[v * 4 + axis] = q;
+                    qMin[axis] = std::min(qMin[axis], float(q));
+                    qMax[axis] = std::max(qMax[axis], float(q));
+                    normals[v * 4 + axis] = static_cast<int8_t>(std::lround(glm::clamp(n[axis], -1.0f, 1.0f) * 127.0f));
+                }
+            }
+            uint32_t position = buffers.addAccessor(buffers.addView(positions.data(), positions.size() * sizeof(int16_t), 8, ArrayBuffer),
+                Short, payload.vertexCount, "VEC3", true, qMin, qMax, 3);
+            uint32_t normal = buffers.addAccessor(buffers.addView(normals.data(), normals.size(), 4, ArrayBuffer),
+                Byte, payload.vertexCount, "VEC3", true);
+            uint32_t indices = buffers.addIndices(payload.indices, payload.indexCount, payload.vertexCount);
+            uint32_t mesh = addMesh(primitive(position, normal, indices, group.material, ModeTriangles));
+
+            // Fold the dequantization into every placement
+            glm::mat4 dequantize(1.0f);
+            for (int axis = 0; axis < 3; ++axis) dequantize[axis][axis] = extent[axis];
+            dequantize[3] = glm::vec4(center, 1.0f);
+            std::vector<glm::mat4> transforms(group.transforms.size());
+            for (size_t i = 0; i < transforms.size(); ++i) transforms[i] = group.transforms[i] * dequantize;
+            addNode(mesh, transforms);
+            quantized = true;
+        }
+        else if (group.kind == Scene::LineStrip || group.kind == Scene::Points) {
+            if (payload.pointCount < (group.kind == Scene::LineStrip ? 2u : 1u)) continue;
+            uint32_t position = buffers.addPositions(payload.points, payload.pointCount);
+            uint32_t mesh = addMesh(primitive(position, -1, -1, group.material, group.kind == Scene::LineStrip ? ModeLineStrip : ModePoints));
+            addNode(mesh, group.transforms);
+        }
+        else {
+            // Batch: shared vertices, one primitive per range and material
+            if (payload.vertexCount == 0) continue;
+            std::vector<glm::vec3> positions(payload.vertexCount), normals(payload.vertexCount);
+            for (uint32_t v = 0; v < payload.vertexCount; ++v) {
+                positions[v] = payload.vertices[v].position;
+                normals[v] = payload.vertices[v].normal;
+            }
+            uint32_t position = buffers.addPositions(positions.data(), positions.size());
+            uint32_t normal = buffers.addAccessor(buffers.addView(normals.data(), normals.size() * sizeof(glm::vec3), 0, ArrayBuffer), Float, normals.size(), "VEC3");
+            std::string primitives;
+            for (uint32_t r = 0; r < payload.rangeCount; ++r) {
+                const StrokeBatchRange& range = payload.ranges[r];
+                uint32_t step = range.primitive == StrokeBatchRange::Triangles ? 3 : range.primitive == StrokeBatchRange::Lines ? 2 : 1;
+                Mode mode = range.primitive == StrokeBatchRange::Triangles ? ModeTriangles : range.primitive == StrokeBatchRange::Lines ? ModeLines : ModePoints;
+                std::map<uint32_t, std::vector<unsigned int>> byMaterial;
+                const unsigned int* indices = payload.indices + range.firstIndex;
+                for (uint32_t i = 0; i + step <= range.indexCount; i += step) {
+                    std::vector<unsigned int>& target = byMaterial[payload.materialIds[indices[i]]];
+                    target.insert(target.end(), indices + i, indices + i + step);
+                }
+                for (const auto& part : byMaterial) {
+                    uint32_t accessor = buffers.addIndices(part.second.data(), part.second.size(), payload.vertexCount);
+                    if (!primitives.empty()) primitives += ",";
+                    primitives += primitive(position, mode == ModeTriangles ? static_cast<int>(normal) : -1, accessor, group.material + part.first, mode);
+                }
+            }
+            if (primitives.empty()) continue;
+            addNode(addMesh(primitives), group.transforms);
+        }
+    }
+
+    // --- Materials ---
+    JsonArray materials;
+    for (const StrokeMaterial& material : scene.materials) {
+        // Blinn-Phong shininess to roughness, the usual sqrt(2 / (n + 2)) mapping
+        float roughness = std::sqrt(2.0f / (std::max(material.shininess, 0.0f) + 2.0f));
+        const glm::vec4& color = material.diffuseColor;
+        appendf(materials.next(), "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[%.6g,%.6g,%.6g,%.6g],\"metallicFactor\":0,\"roughnessFactor\":%.6g},\"doubleSided\":true%s}",
+            color.x, color.y, color.z, color.w, roughness, color.w < 1.0f ? ",\"alphaMode\":\"BLEND\"" : "");
+    }
+
+    // --- JSON ---
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"3D Paint\"}";
+    if (instanced || quantized) {
+        json += ",\"extensionsUsed\":[";
+        if (instanced) json += "\"EXT_mesh_gpu_instancing\"";
+        if (quantized) json += instanced ? ",\"KHR_mesh_quantization\"" : "\"KHR_mesh_quantization\"";
+        json += "]";
+        if (quantized) json += ",\"extensionsRequired\":[\"KHR_mesh_quantization\"]";
+    }
+    json += ",\"scene\":0,\"scenes\":[{";
+    if (nodes.count > 0) {
+        json += "\"nodes\":[";
+        for (uint32_t n = 0; n < nodes.count; ++n) appendf(json, n ? ",%u" : "%u", n);
+        json += "]";
+    }
+    json += "}]";
+    // glTF forbids empty arrays
+    if (nodes.count) json += ",\"nodes\":[" + nodes.body + "]";
+    if (meshes.count) json += ",\"meshes\":[" + meshes.body + "]";
+    if (materials.count) json += ",\"materials\":[" + materials.body + "]";
+    if (buffers.accessors.count) json += ",\"accessors\":[" + buffers.accessors.body + "]";
+    if (buffers.views.count) json += ",\"bufferViews\":[" + buffers.views.body + "]";
+    if (!buffers.binary.empty()) appendf(json, ",\"buffers\":[{\"byteLength\":%zu}]", buffers.binary.size());
+    json += "}";
+
+    // --- GLB container: header, JSON chunk (space padded), BIN chunk (zero padded) ---
+    while (json.size() % 4) json += ' ';
+    buffers.binary.resize((buffers.binary.size() + 3) & ~size_t(3), 0);
+    uint32_t jsonLength = static_cast<uint32_t>(json.size());
+    uint32_t binLength = static_cast<uint32_t>(buffers.binary.size());
+    uint32_t totalLength = 12 + 8 + jsonLength + (binLength ? 8 + binLength : 0);
+    const uint32_t header[3] = { 0x46546C67, 2, totalLength }; // "glTF", version 2
+    const uint32_t jsonChunk[2] = { jsonLength, 0x4E4F534A };  // "JSON"
+    const uint32_t binChunk[2] = { binLength, 0x004E4942 };    // "BIN\0"
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        if (error) *error = "Cannot write " + path;
+        return false;
+    }
+    std::fwrite(header, sizeof(header), 1, file);
+    std::fwrite(jsonChunk, sizeof(jsonChunk), 1, file);
+    std::fwrite(json.data(), 1, json.size(), file);
+    if (binLength) {
+        std::fwrite(binChunk, sizeof(binChunk), 1, file);
+        std::fwrite(buffers.binary.data(), 1, buffers.binary.size(), file);
+    }
+    bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    if (!ok) {
+        if (error) *error = "Write failed: " + path;
+        return false;
+    }
+
+    if (stats) {
+        stats->meshes = meshes.count;
+        stats->nodes = nodes.count;
+        stats->instances = instances;
+        stats->bytes = totalLength;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return true;
+}
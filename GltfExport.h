@@ -0,0 +1,60 @@
+// GltfExport.h
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "StrokePayload.h"
+
+// Binary glTF 2.0 (.glb) export.
+//
+// Geometry is written once per payload and placed by nodes, so duplicated strokes and dabs
+// cost one transform each instead of a copy of their mesh:
+//  - Cube/sphere dabs share one base mesh per primitive; every dab becomes an instance of it
+//    through EXT_mesh_gpu_instancing (one node per primitive and material).
+//  - Tubes are indexed meshes with positions quantized to 16 bits over the payload bounds and
+//    normals to 8 bits (KHR_mesh_quantization); the node transform undoes the quantization.
+//  - Freehand lines and points use glTF's native line strip / point primitives.
+//  - Baked batches keep their ranges, one primitive per range and material.
+// Viewers without EXT_mesh_gpu_instancing still load the file and show one instance per node.
+namespace GltfExport {
+    struct BaseMesh {
+        const StrokeVertex* vertices = nullptr;
+        size_t vertexCount = 0;
+        const unsigned int* indices = nullptr; // Null: non-indexed triangles
+        size_t indexCount = 0;
+    };
+
+    struct Scene {
+        enum Base { Cube, Sphere };
+        enum Kind { Triangles, LineStrip, Points, Batch };
+
+        // All dabs of one primitive and material
+        struct DabGroup {
+            Base base;
+            uint32_t material;
+            std::vector<glm::mat4> transforms; // One per dab, base mesh space to world
+        };
+        // Every stroke drawing 'payload' with one material
+        struct PayloadGroup {
+            const StrokePayload* payload;
+            Kind kind;
+            uint32_t material;    // Batches: offset of their table in 'materials'
+            std::vector<glm::mat4> transforms;
+        };
+
+        std::vector<StrokeMaterial> materials;
+        BaseMesh cube, sphere;
+        std::vector<DabGroup> dabs;
+        std::vector<PayloadGroup> payloads;
+    };
+
+    struct Stats {
+        size_t meshes = 0;
+        size_t nodes = 0;
+        size_t instances = 0; // Dabs and strokes placed through EXT_mesh_gpu_instancing
+        uint64_t bytes = 0;
+        double seconds = 0.0;
+    };
+
+    bool write(const std::string& path, const Scene& scene, Stats* stats = nullptr, std::string* error = nullptr);
+}
@@ -0,0 +1,102 @@
+// GpuCounterPanel.cpp
+#include "GpuCounterPanel.h"
+#include "imgui.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* const MetricNames[] = { "Draws", "Instanced", "Triangles", "Upload KB", "Program", "VAO", "Buffer", "Uniforms" };
+
+GpuCounterPanel::GpuCounterPanel() :
+    head(0),
+    graphMetric(DrawCalls)
+{
+    std::memset(history, 0, sizeof(history));
+}
+
+size_t GpuCounterPanel::metricValue(const RecordingRenderDevice::Stats& stats, int metric) {
+    switch (metric) {
+    case DrawCalls: return stats.drawCalls;
+    case InstancedDraws: return stats.instancedDraws;
+    case Triangles: return stats.triangles;
+    case UploadBytes: return stats.uploadBytes;
+    case ProgramBinds: return stats.programBinds;
+    case ArrayBinds: return stats.vertexArrayBinds;
+    case BufferBinds: return stats.bufferBinds;
+    case UniformSets: return stats.uniformSets;
+    }
+    return 0;
+}
+
+void GpuCounterPanel::addFrame(const RecordingRenderDevice& device) {
+    for (int row = 0; row < PassRows; ++row) {
+        last[row] = row < PassRows - 1 ? device.getPassStats(static_cast<RenderPass>(row)) : device.getStats();
+        for (int metric = 0; metric < MetricCount; ++metric) {
+            float value = static_cast<float>(metricValue(last[row], metric));
+            history[row][metric][head] = metric == UploadBytes ? value / 1024.0f : value;
+        }
+    }
+    head = (head + 1) % HistoryFrames;
+}
+
+RecordingRenderDevice::Stats GpuCounterPanel::countImGuiDrawData(const ImDrawData* data) {
+    RecordingRenderDevice::Stats stats;
+    if (!data || data->CmdListsCount == 0) return stats;
+    // Setup: program + 2 uniforms, vertex array, array/element buffers; restore: program, texture, vertex array, buffer
+    stats.programBinds = 2;
+    stats.vertexArrayBinds = 2;
+    stats.bufferBinds = 3;
+    stats.textureBinds = 1;
+    stats.uniformSets = 2;
+    for (int l = 0; l < data->CmdListsCount; ++l) {
+        const ImDrawList* list = data->CmdLists[l];
+        stats.uploads += 2;
+        stats.uploadBytes += list->VtxBuffer.Size * sizeof(ImDrawVert) + list->IdxBuffer.Size * sizeof(ImDrawIdx);
+        for (const ImDrawCmd& command : list->CmdBuffer) {
+            if (command.UserCallback) continue;
+            stats.textureBinds++;
+            stats.drawCalls++;
+            stats.instances++;
+            stats.elements += command.ElemCount;
+            stats.triangles += command.ElemCount / 3;
+        }
+    }
+    stats.binds = stats.programBinds + stats.vertexArrayBinds + stats.bufferBinds + stats.textureBinds;
+    stats.commands = stats.binds + stats.uniformSets + stats.uploads + stats.drawCalls;
+    return stats;
+}
+
+void GpuCounterPanel::draw() {
+    if (!ImGui::CollapsingHeader("GPU Counters")) return;
+
+    // --- Last frame, per pass ---
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+    if (ImGui::BeginTable("##GpuCounters", MetricCount + 1, flags)) {
+        ImGui::TableSetupColumn("Pass");
+        for (int metric = 0; metric < MetricCount; ++metric) ImGui::TableSetupColumn(MetricNames[metric]);
+        ImGui::TableHeadersRow();
+        for (int row = 0; row < PassRows; ++row) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(row < PassRows - 1 ? RecordingRenderDevice::passName(static_cast<RenderPass>(row)) : "Total");
+            for (int metric = 0; metric < MetricCount; ++metric) {
+                ImGui::TableNextColumn();
+                size_t value = metricValue(last[row], metric);
+                if (metric == UploadBytes) ImGui::Text("%.1f", value / 1024.0);
+                else ImGui::Text("%zu", value);
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    // --- Rolling graphs of one metric ---
+    ImGui::Combo("Graph##GpuCounters", &graphMetric, MetricNames, MetricCount);
+    int newest = (head + HistoryFrames - 1) % HistoryFrames;
+    for (int row = 1; row < PassRows; ++row) { // "Other" is setup work, rarely interesting per frame
+        const char* name = row < PassRows - 1 ? RecordingRenderDevice::passName(static_cast<RenderPass>(row)) : "Total";
+        char overlay[48];
+        std::snprintf(overlay, sizeof(overlay), "%s: %.0f", name, history[row][graphMetric][newest]);
+        ImGui::PushID(row);
+        ImGui::PlotLines("##Graph", history[row][graphMetric], HistoryFrames, head, overlay, 0.0f, FLT_MAX, ImVec2(-1.0f, 36.0f));
+        ImGui::PopID();
+    }
+}
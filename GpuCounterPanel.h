@@ -0,0 +1,32 @@
+// GpuCounterPanel.h
+#pragma once
+#include "RecordingRenderDevice.h"
+
+struct ImDrawData;
+
+// Per-pass GPU workload of recent frames (draw calls, triangles, uploads, binds, uniforms),
+// as a table for the last frame plus short rolling graphs. Fed from the RecordingRenderDevice
+// that wraps the app's GL device, once per frame after the last pass.
+class GpuCounterPanel {
+public:
+    GpuCounterPanel();
+
+    void addFrame(const RecordingRenderDevice& device);
+    void draw(); // Inside the current ImGui window
+
+    // What imgui_impl_opengl3 issues to render 'data' (it calls GL directly, so the device never
+    // sees it): one program/array setup, a vertex and index upload per list, a draw per command
+    static RecordingRenderDevice::Stats countImGuiDrawData(const ImDrawData* data);
+
+private:
+    enum Metric { DrawCalls, InstancedDraws, Triangles, UploadBytes, ProgramBinds, ArrayBinds, BufferBinds, UniformSets, MetricCount };
+    static const int HistoryFrames = 120;
+    static const int PassRows = static_cast<int>(RenderPass::Count) + 1; // Every pass, then the frame total
+
+    static size_t metricValue(const RecordingRenderDevice::Stats& stats, int metric);
+
+    RecordingRenderDevice::Stats last[PassRows];
+    float history[PassRows][MetricCount][HistoryFrames];
+    int head;        // Next history slot
+    int graphMetric; // Metric shown in the graphs
+};
@@ -0,0 +1,150 @@
+// GpuPassTimer.cpp
+#include "GpuPassTimer.h"
+#include "Profiler.h"
+#include <algorithm>
+
+// Re-reads the GL clock against the CPU one this often, in frames, for drift
+static const uint64_t CalibrateInterval = 600;
+
+GpuPassTimer::GpuPassTimer() :
+    available(false),
+    recording(false),
+    frameCount(0),
+    skippedFrames(0),
+    cpuMinusGpuNs(0)
+{
+}
+
+GpuPassTimer::~GpuPassTimer() {
+    shutdown();
+}
+
+bool GpuPassTimer::init() {
+    if (available) return true;
+    if (!GLAD_GL_VERSION_3_3) return false;
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    if (bits == 0) return false; // Timer queries exist but the clock doesn't count
+    for (Slot& slot : slots) {
+        glGenQueries(MaxMarks, slot.queries);
+    }
+    available = true;
+    calibrate();
+    return true;
+}
+
+void GpuPassTimer::shutdown() {
+    if (!available) return;
+    for (Slot& slot : slots) {
+        glDeleteQueries(MaxMarks, slot.queries);
+        slot = Slot();
+    }
+    available = false;
+    recording = false;
+}
+
+// GL_TIMESTAMP read directly is the GPU clock now, without waiting for queued work
+void GpuPassTimer::calibrate() {
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    cpuMinusGpuNs = static_cast<int64_t>(Profiler::now()) - gpuNow;
+}
+
+
+// --- Recording ---
+
+void GpuPassTimer::beginFrame() {
+    if (!available) return;
+    collect(false);
+    frameCount++;
+    if (frameCount % CalibrateInterval == 0) calibrate();
+    Slot& slot = slots[frameCount % FrameLatency];
+    if (slot.pending) {
+        // The GPU is FrameLatency frames behind: skip timing this one rather than wait
+        recording = false;
+        skippedFrames++;
+        return;
+    }
+    slot.marks = 0;
+    slot.frame = frameCount;
+    slot.cpuMinusGpuNs = cpuMinusGpuNs;
+    recording = true;
+    markPass(RenderPass::Other);
+}
+
+void GpuPassTimer::markPass(RenderPass pass) {
+    if (!recording) return;
+    Slot& slot = slots[frameCount % FrameLatency];
+    if (slot.marks > 0 && slot.passes[slot.marks - 1] == pass) return; // Still the same pass
+    if (slot.marks >= MaxMarks - 1) return; // Keep the last one for endFrame
+    glQueryCounter(slot.queries[slot.marks], GL_TIMESTAMP);
+    slot.passes[slot.marks++] = pass;
+}
+
+void GpuPassTimer::endFrame() {
+    if (!recording) return;
+    Slot& slot = slots[frameCount % FrameLatency];
+    glQueryCounter(slot.queries[slot.marks], GL_TIMESTAMP);
+    slot.passes[slot.marks++] = RenderPass::Other;
+    slot.pending = true;
+    recording = false;
+}
+
+
+// --- Reading back ---
+
+void GpuPassTimer::collect(bool wait) {
+    if (!available) return;
+    // Oldest first, and stop at the first unfinished frame: the GPU finishes them in order
+    Slot* order[FrameLatency];
+    int count = 0;
+    for (Slot& slot : slots) {
+        if (slot.pending) order[count++] = &slot;
+    }
+    for (int i = 1; i < count; ++i) {
+        // Insertion sort: at most FrameLatency slots
+        for (int j = i; j > 0 && order[j - 1]->frame > order[j]->frame; --j) std::swap(order[j - 1], order[j]);
+    }
+    for (int i = 0; i < count; ++i) {
+        if (!readSlot(*order[i], wait)) break;
+    }
+}
+
+bool GpuPassTimer::readSlot(Slot& slot, bool wait) {
+    if (!wait) {
+        // Timestamps complete in order, so the last one being ready means all are
+        GLint ready = 0;
+        glGetQueryObjectiv(slot.queries[slot.marks - 1], GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) return false;
+    }
+    GLuint64 stamps[MaxMarks];
+    for (int i = 0; i < slot.marks; ++i) {
+        glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &stamps[i]);
+    }
+
+    Result result;
+    result.frame = slot.frame;
+    for (int i = 0; i + 1 < slot.marks; ++i) {
+        uint64_t start = stamps[i];
+        uint64_t end = std::max(stamps[i + 1], start);
+        int pass = static_cast<int>(slot.passes[i]);
+        result.passMs[pass] += (end - start) / 1e6;
+        result.passMask |= 1u << pass;
+        Interval interval;
+        interval.pass = slot.passes[i];
+        interval.startNs = static_cast<uint64_t>(std::max<int64_t>(static_cast<int64_t>(start) + slot.cpuMinusGpuNs, 0));
+        interval.endNs = static_cast<uint64_t>(std::max<int64_t>(static_cast<int64_t>(end) + slot.cpuMinusGpuNs, 0));
+        result.intervals.push_back(interval);
+    }
+    result.frameMs = slot.marks > 1 ? (std::max(stamps[slot.marks - 1], stamps[0]) - stamps[0]) / 1e6 : 0.0;
+    history.push_back(result);
+    while (history.size() > HistoryFrames) history.pop_front();
+    slot.pending = false;
+    return true;
+}
+
+bool GpuPassTimer::getLatest(Result& out) const {
+    if (history.empty()) return false;
+    out = history.back();
+    return true;
+}
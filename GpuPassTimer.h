@@ -0,0 +1,80 @@
+// GpuPassTimer.h
+#pragma once
+#include "RenderDevice.h"
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// GPU time per render pass. A GL timestamp query is written at the start of every frame, at
+// every pass change (GLRenderDevice::beginPass) and at the end of the frame; a pass's time is
+// the gap to the next timestamp. Timestamps rather than GL_TIME_ELAPSED, so passes can follow
+// each other without begin/end pairs and the timestamps also place them on the CPU timeline.
+//
+// Each frame writes into one of FrameLatency query sets and is read back only once its last
+// query reports ready, so the CPU never waits on the GPU. If a set is still in flight when its
+// turn comes round again, that frame goes untimed instead. Needs GL 3.3 (ARB_timer_query),
+// which software rasterizers like llvmpipe provide too; otherwise init() fails and every call
+// does nothing.
+class GpuPassTimer {
+public:
+    static const int FrameLatency = 4;  // Frames in flight before a query set is reused
+    static const int MaxMarks = 16;     // Timestamps per frame, the end one included
+    static const size_t HistoryFrames = 120;
+    static const int PassCount = static_cast<int>(RenderPass::Count);
+
+    struct Interval {
+        RenderPass pass;
+        uint64_t startNs; // On the profiler clock (Profiler::now)
+        uint64_t endNs;
+    };
+
+    struct Result {
+        uint64_t frame = 0;        // beginFrame() count, from 1
+        double passMs[PassCount] = {};
+        uint32_t passMask = 0;     // Bit per pass that was marked this frame
+        double frameMs = 0.0;      // First timestamp to last
+        std::vector<Interval> intervals;
+
+        bool hasPass(RenderPass pass) const { return (passMask >> static_cast<int>(pass)) & 1u; }
+    };
+
+    GpuPassTimer();
+    ~GpuPassTimer(); // Calls shutdown()
+
+    bool init();     // After GL is loaded; false when the context has no timer queries
+    void shutdown(); // Deletes the queries; while the context is still current
+    bool isAvailable() const { return available; }
+
+    void beginFrame();
+    void markPass(RenderPass pass); // The GPU work that follows belongs to 'pass'
+    void endFrame();
+    // Reads back every finished frame, oldest first. 'wait' blocks until all of them are done;
+    // only for tools that have synced with the GPU anyway (offscreen rendering)
+    void collect(bool wait = false);
+
+    bool getLatest(Result& out) const;
+    const std::deque<Result>& getHistory() const { return history; } // Oldest first
+    uint64_t getSkippedFrames() const { return skippedFrames; }
+
+private:
+    struct Slot {
+        GLuint queries[MaxMarks] = {};
+        RenderPass passes[MaxMarks] = {};
+        int marks = 0;
+        bool pending = false; // Written, not read back yet
+        uint64_t frame = 0;
+        int64_t cpuMinusGpuNs = 0; // Clock offset when the frame began
+    };
+
+    void calibrate();
+    bool readSlot(Slot& slot, bool wait);
+
+    bool available;
+    bool recording; // Inside a frame that has a free slot
+    uint64_t frameCount;
+    uint64_t skippedFrames;
+    int64_t cpuMinusGpuNs; // Profiler clock minus GL timestamp clock
+    Slot slots[FrameLatency];
+    std::deque<Result> history;
+};
@@ -0,0 +1,151 @@
+// LogFileSink.cpp
+#include "LogFileSink.h"
+#include "Profiler.h"
+#include <chrono>
+#include <ctime>
+
+static const int BatchIntervalMs = 50;
+static const size_t BatchBytes = 256 * 1024; // Written out early once a batch gets this big
+
+LogFileSink::LogFileSink() :
+    queue(QueueCapacity),
+    opened(false),
+    maxBytes(0),
+    keepFiles(1),
+    file(nullptr),
+    ownsFile(true),
+    fileBytes(0),
+    stopping(false)
+{
+}
+
+LogFileSink::~LogFileSink() {
+    close();
+}
+
+bool LogFileSink::open(const std::string& newPath, size_t newMaxBytes, int newKeepFiles, std::string* error) {
+    close();
+    path = newPath;
+    maxBytes = newMaxBytes;
+    keepFiles = newKeepFiles < 1 ? 1 : newKeepFiles;
+    ownsFile = true;
+    if (!rotate()) {
+        if (error) *error = "Cannot open log file " + path;
+        return false;
+    }
+
+    // Wall clock once, so the monotonic times in the file can be placed
+    char openedAt[64] = "?";
+    std::time_t now = std::time(nullptr);
+    if (std::tm* local = std::localtime(&now)) std::strftime(openedAt, sizeof(openedAt), "%Y-%m-%d %H:%M:%S", local);
+    std::string header = std::string("--- Log opened ") + openedAt + "; times are seconds since startup ---\n";
+    std::fwrite(header.data(), 1, header.size(), file);
+    fileBytes += header.size();
+    startWriter();
+    return true;
+}
+
+bool LogFileSink::openStream(FILE* stream) {
+    close();
+    if (!stream) return false;
+    path.clear();
+    maxBytes = 0; // Never rotated
+    keepFiles = 1;
+    file = stream;
+    ownsFile = false;
+    fileBytes = 0;
+    startWriter();
+    return true;
+}
+
+void LogFileSink::startWriter() {
+    LogQueue::Entry stale;
+    while (queue.pop(stale)) {} // Pushed after an earlier close()
+    stopping = false;
+    opened.store(true, std::memory_order_release);
+    writer = std::thread(&LogFileSink::run, this);
+}
+
+void LogFileSink::close() {
+    if (!opened.load(std::memory_order_acquire)) return;
+    opened.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    if (file && ownsFile) std::fclose(file);
+    file = nullptr;
+}
+
+
+// --- Writer thread ---
+
+void LogFileSink::run() {
+    Profiler::setThreadName("Log writer");
+    LogQueue::Entry entry;
+    std::string line;
+    std::string batch;
+    uint64_t droppedWritten = 0;
+    bool stop = false;
+    while (!stop) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(BatchIntervalMs), [this]() { return stopping; });
+            stop = stopping; // Still drains below: close() flushes everything pushed before it
+        }
+        char prefix[32];
+        while (queue.pop(entry)) {
+            std::snprintf(prefix, sizeof(prefix), "%12.6f %-8s ", entry.timeNs / 1e9, logLevelName(entry.level));
+            line = prefix;
+            // Continuation lines (shader info logs) indented under the text
+            size_t start = 0;
+            for (size_t end; (end = entry.text.find('\n', start)) != std::string::npos; start = end + 1) {
+                line.append(entry.text, start, end + 1 - start);
+                line.append(22, ' ');
+            }
+            line.append(entry.text, start, std::string::npos);
+            line += '\n';
+            // Fill the file up to maxBytes before this line rotates it
+            if (maxBytes > 0 && fileBytes + batch.size() + line.size() > maxBytes) writeBatch(batch);
+            batch += line;
+            if (batch.size() >= BatchBytes) writeBatch(batch);
+        }
+        uint64_t dropped = queue.getDroppedCount();
+        if (dropped != droppedWritten) {
+            batch += "--- " + std::to_string(dropped - droppedWritten) + " lines dropped: logging outran the writer ---\n";
+            droppedWritten = dropped;
+        }
+        writeBatch(batch);
+    }
+}
+
+void LogFileSink::writeBatch(std::string& batch) {
+    if (batch.empty()) return;
+    PROFILE_SCOPE("Log write");
+    if (maxBytes > 0 && fileBytes > 0 && fileBytes + batch.size() > maxBytes) rotate();
+    if (file) {
+        std::fwrite(batch.data(), 1, batch.size(), file);
+        std::fflush(file);
+        fileBytes += batch.size();
+    }
+    batch.clear();
+}
+
+// Closes the current file, shifts path -> path.1 -> ... and starts a new empty one ("wb"
+// truncates, so with keepFiles 1 the old contents just go)
+bool LogFileSink::rotate() {
+    if (file) std::fclose(file);
+    file = nullptr;
+    fileBytes = 0;
+    if (keepFiles > 1) {
+        std::remove((path + "." + std::to_string(keepFiles - 1)).c_str());
+        for (int i = keepFiles - 2; i >= 0; --i) {
+            std::string from = i == 0 ? path : path + "." + std::to_string(i);
+            std::rename(from.c_str(), (path + "." + std::to_string(i + 1)).c_str());
+        }
+    }
+    file = std::fopen(path.c_str(), "wb");
+    return file != nullptr;
+}
@@ -0,0 +1,59 @@
+// LogFileSink.h
+#pragma once
+#include "LogQueue.h"
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Log lines on disk, written by a background thread so the logging thread only pays for a
+// lock-free push. The writer wakes every 50 ms, formats whatever has queued up into one batch
+// ("   12.345678 Error    text", seconds on the monotonic log clock) and writes it with a
+// single fwrite + fflush, so a crash loses at most the last 50 ms. When the file would exceed
+// maxBytes it is rotated: path -> path.1 -> ... -> path.<keepFiles - 1>, the oldest deleted.
+// open() rotates too, so the previous session's log survives as path.1.
+// openStream() runs the same writer into a stream the caller owns (stderr for headless runs).
+class LogFileSink {
+public:
+    static const size_t QueueCapacity = 8192; // Lines between two wakes before some are dropped
+
+    LogFileSink();
+    ~LogFileSink(); // Calls close()
+    LogFileSink(const LogFileSink&) = delete;
+    LogFileSink& operator=(const LogFileSink&) = delete;
+
+    bool open(const std::string& path, size_t maxBytes, int keepFiles, std::string* error = nullptr);
+    // No header and no rotation; close() flushes the stream but leaves it open
+    bool openStream(FILE* stream);
+    // Writes everything queued so far, then stops the writer
+    void close();
+    bool isOpen() const { return opened.load(std::memory_order_acquire); }
+
+    void push(LogLevel level, uint64_t timeNs, std::string&& text) { queue.push(level, timeNs, std::move(text)); }
+
+private:
+    void startWriter();
+    void run();
+    void writeBatch(std::string& batch);
+    bool rotate();
+
+    LogQueue queue;
+    std::atomic<bool> opened;
+    std::string path;
+    size_t maxBytes;
+    int keepFiles;
+
+    // Writer thread only, while open
+    FILE* file;
+    bool ownsFile; // False for openStream()
+    size_t fileBytes;
+
+    std::thread writer;
+    std::mutex mutex; // Only for waking the writer
+    std::condition_variable wake;
+    bool stopping;
+};
@@ -0,0 +1,63 @@
+// LogQueue.cpp
+#include "LogQueue.h"
+#include <utility>
+
+const char* logLevelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::Info: return "Info";
+    case LogLevel::Warning: return "Warning";
+    case LogLevel::Error: return "Error";
+    case LogLevel::Critical: return "Critical";
+    default: return "?";
+    }
+}
+
+LogQueue::LogQueue(size_t capacity) :
+    slots(new Slot[capacity]),
+    mask(capacity - 1),
+    enqueuePos(0),
+    dequeuePos(0),
+    dropped(0)
+{
+    for (size_t i = 0; i < capacity; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// A slot is free for position 'pos' when its sequence equals pos, and holds the line pushed
+// at 'pos' when it equals pos + 1
+bool LogQueue::push(LogLevel level, uint64_t timeNs, std::string&& text) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots[pos & mask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if (diff < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed); // Full
+            return false;
+        }
+        else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->entry.level = level;
+    slot->entry.timeNs = timeNs;
+    slot->entry.text = std::move(text);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogQueue::pop(Entry& out) {
+    Slot& slot = slots[dequeuePos & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1) return false;
+    out.level = slot.entry.level;
+    out.timeNs = slot.entry.timeNs;
+    out.text.swap(slot.entry.text);
+    slot.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+    dequeuePos++;
+    return true;
+}
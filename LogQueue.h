@@ -0,0 +1,45 @@
+// LogQueue.h
+#pragma once
+#include <string>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+enum class LogLevel : uint8_t { Info, Warning, Error, Critical, Count };
+const char* logLevelName(LogLevel level);
+
+// Bounded lock-free queue of log lines (Vyukov's array queue). Any number of threads push, one
+// thread at a time pops. A full queue makes push() drop the line and count it instead of
+// waiting. A pusher stalled between claiming a slot and filling it holds up the lines behind
+// it until it finishes, but never blocks other pushers.
+class LogQueue {
+public:
+    struct Entry {
+        LogLevel level = LogLevel::Info;
+        uint64_t timeNs = 0; // Monotonic, see Logger
+        std::string text;
+    };
+
+    explicit LogQueue(size_t capacity); // Power of two
+    LogQueue(const LogQueue&) = delete;
+    LogQueue& operator=(const LogQueue&) = delete;
+
+    bool push(LogLevel level, uint64_t timeNs, std::string&& text);
+    // Swaps the text into out.text, so the popping side reuses its buffers
+    bool pop(Entry& out);
+
+    uint64_t getDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Entry entry;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) size_t dequeuePos;
+    std::atomic<uint64_t> dropped;
+};
@@ -1,16 +1,137 @@
 // Logger.cpp
 #include "Logger.h"
-#include "imgui.h"
+#include <algorithm>
+
+static const ImVec4 LevelColors[] = {
+    ImVec4(1.0f, 1.0f, 1.0f, 1.0f),  // Info (unused, plain text)
+    ImVec4(1.0f, 0.8f, 0.3f, 1.0f),  // Warning
+    ImVec4(1.0f, 0.4f, 0.4f, 1.0f),  // Error
+    ImVec4(1.0f, 0.3f, 0.9f, 1.0f),  // Critical
+};
+
+Logger::Logger() :
+    startTime(std::chrono::steady_clock::now()),
+    queue(QueueCapacity),
+    headless(false),
+    lines(Capacity),
+    lineCount(0),
+    firstLine(0),
+    filterDirty(true)
+{
+    std::fill(std::begin(shown), std::end(shown), true);
+}
+
+bool Logger::openFile(const std::string& path, size_t maxBytes, int keepFiles, std::string* error) {
+    return fileSink.open(path, maxBytes, keepFiles, error);
+}
+
+bool Logger::openStream(FILE* stream) {
+    if (!fileSink.openStream(stream)) return false;
+    headless.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+
+// --- Producers (any thread) ---
+
 void Logger::addLog(const std::string& log) {
-    logs.push_back(log);
+    LogLevel level = LogLevel::Info;
+    if (log.compare(0, 7, "[ERROR]") == 0) level = LogLevel::Error;
+    else if (log.compare(0, 10, "[CRITICAL]") == 0) level = LogLevel::Critical;
+    else if (log.compare(0, 9, "[WARNING]") == 0) level = LogLevel::Warning;
+    addLog(level, log);
+}
+
+// The copies are made before taking a queue slot
+void Logger::addLog(LogLevel level, const std::string& log) {
+    uint64_t timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    if (fileSink.isOpen()) fileSink.push(level, timeNs, std::string(log));
+    if (!headless.load(std::memory_order_relaxed)) queue.push(level, timeNs, std::string(log));
 }
+
+
+// --- Consumer (main thread) ---
+
+// Multi-line messages (shader info logs) become one line each, so every line has the same
+// height for the clipper
+void Logger::drain() {
+    while (queue.pop(popped)) {
+        const std::string& text = popped.text;
+        size_t start = 0;
+        do {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos) end = text.size();
+            if (end > start || start == 0) {
+                Line& line = lines[lineCount % Capacity];
+                line.level = popped.level;
+                line.text.assign(text, start, end - start); // Reuses the old line's buffer
+                lineCount++;
+            }
+            start = end + 1;
+        } while (start < text.size());
+        filterDirty = true;
+    }
+    if (lineCount - firstLine > Capacity) firstLine = lineCount - Capacity;
+}
+
+void Logger::clear() {
+    firstLine = lineCount;
+    filterDirty = true;
+}
+
+void Logger::rebuildFiltered() {
+    filtered.clear();
+    for (uint64_t i = firstLine; i < lineCount; ++i) {
+        const Line& line = lineAt(i);
+        if (!shown[static_cast<int>(line.level)]) continue;
+        if (!filter.PassFilter(line.text.c_str())) continue;
+        filtered.push_back(i);
+    }
+    filterDirty = false;
+}
+
 void Logger::draw(const std::string& title) {
+    drain();
     ImGui::Begin(title.c_str());
-    for (auto& log : logs) {
-        ImGui::TextUnformatted(log.c_str());
+
+    for (int i = 0; i < static_cast<int>(LogLevel::Count); ++i) {
+        if (ImGui::Checkbox(logLevelName(static_cast<LogLevel>(i)), &shown[i])) filterDirty = true;
+        ImGui::SameLine();
     }
+    if (filter.Draw("Filter##Log", 160.0f)) filterDirty = true;
+    ImGui::SameLine();
+    if (ImGui::Button("Clear##Log")) clear();
+    uint64_t droppedLines = getDroppedCount();
+    if (droppedLines > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(%llu dropped)", static_cast<unsigned long long>(droppedLines));
+    }
+    ImGui::Separator();
+
+    ImGui::BeginChild("##LogLines", ImVec2(0.0f, 0.0f), ImGuiChildFlags_None, ImGuiWindowFlags_HorizontalScrollbar);
+    // Without a filter the ring is shown as is and the index list isn't needed
+    bool filtering = filter.IsActive() || std::find(std::begin(shown), std::end(shown), false) != std::end(shown);
+    if (filtering && filterDirty) rebuildFiltered();
+    int count = static_cast<int>(filtering ? filtered.size() : lineCount - firstLine);
+
+    ImGuiListClipper clipper;
+    clipper.Begin(count);
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const Line& line = lineAt(filtering ? filtered[i] : firstLine + i);
+            bool colored = line.level != LogLevel::Info;
+            if (colored) ImGui::PushStyleColor(ImGuiCol_Text, LevelColors[static_cast<int>(line.level)]);
+            ImGui::TextUnformatted(line.text.data(), line.text.data() + line.text.size());
+            if (colored) ImGui::PopStyleColor();
+        }
+    }
+    clipper.End();
+
+    // Follow new lines while scrolled to the bottom
+    if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY()) ImGui::SetScrollHereY(1.0f);
+    ImGui::EndChild();
     ImGui::End();
 }
 
 // made by Piotrixek / Veni
-// https://github.com/Piotrixek
\ No newline at end of file
+// https://github.com/Piotrixek
@@ -1,11 +1,82 @@
 // Logger.h
 #pragma once
+#include "imgui.h"
+#include "LogQueue.h"
+#include "LogFileSink.h"
 #include <string>
 #include <vector>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+
+// Application log. addLog() is safe from any thread: it puts the line on a bounded lock-free
+// queue (one CAS, no mutex) and the main thread moves queued lines into a fixed ring of the
+// last Capacity lines when it draws, so memory stays bounded however chatty a session gets.
+// If producers outrun the main thread by QueueCapacity lines, the extra lines are dropped and
+// counted. The window only draws the lines that are on screen (ImGuiListClipper).
+// With openFile() every line also goes to a LogFileSink, stamped with the monotonic time since
+// the Logger was created. Headless runs never draw the window, so they call openStream(stderr)
+// instead: the sink's writer thread then gets every line out, and the window queue is left alone.
 class Logger {
 public:
-    void addLog(const std::string& log);
-    void draw(const std::string& title);
+    static const size_t Capacity = 4096;      // Lines kept for the window
+    static const size_t QueueCapacity = 1024; // Lines in flight between addLog and draw; power of two
+
+    Logger();
+
+    void addLog(const std::string& log); // Level from a "[ERROR]" / "[CRITICAL]" / "[WARNING]" prefix
+    void addLog(LogLevel level, const std::string& log);
+    void draw(const std::string& title); // Main thread only
+
+    // Also writes every line to 'path' (see LogFileSink); the destructor closes it
+    bool openFile(const std::string& path, size_t maxBytes = 4 << 20, int keepFiles = 3, std::string* error = nullptr);
+    // Like openFile, into a stream the caller keeps open; addLog stops feeding the window queue
+    bool openStream(FILE* stream);
+    void closeFile() { fileSink.close(); }
+
+    uint64_t getDroppedCount() const { return queue.getDroppedCount(); }
+
 private:
-    std::vector<std::string> logs;
+    struct Line {
+        LogLevel level = LogLevel::Info;
+        std::string text;
+    };
+
+    void drain();
+    void clear();
+    void rebuildFiltered();
+    const Line& lineAt(uint64_t index) const { return lines[index % Capacity]; }
+
+    std::chrono::steady_clock::time_point startTime;
+    LogQueue queue; // Popped by the main thread
+    LogQueue::Entry popped; // Keeps its buffer between drains
+    LogFileSink fileSink;
+    std::atomic<bool> headless; // openStream() was called: nothing will ever drain 'queue'
+
+    // Ring, main thread only. Line i (counting from the start of the session) is at i % Capacity
+    std::vector<Line> lines;
+    uint64_t lineCount;
+    uint64_t firstLine; // Oldest line still kept (moves on when cleared or overwritten)
+
+    // Window
+    bool shown[static_cast<int>(LogLevel::Count)];
+    ImGuiTextFilter filter;
+    std::vector<uint64_t> filtered; // Line indices passing the filter
+    bool filterDirty;
+};
+
+// Closes the logger's sink (every line written) when the scope ends, rather than in the global
+// Logger's destructor, which may run after globals the writer thread uses (the profiler) are gone.
+// Headless entry points pass the stream to log to; the app opens its log file itself.
+class LogSinkScope {
+public:
+    explicit LogSinkScope(Logger& logger, FILE* stream = nullptr) : logger(logger) { if (stream) logger.openStream(stream); }
+    ~LogSinkScope() { logger.closeFile(); }
+    LogSinkScope(const LogSinkScope&) = delete;
+    LogSinkScope& operator=(const LogSinkScope&) = delete;
+
+private:
+    Logger& logger;
 };
@@ -0,0 +1,170 @@
+// MappedFile.cpp
+#include "MappedFile.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+MappedFile::MappedFile() :
+    data(nullptr),
+    size(0)
+#ifdef _WIN32
+    , fileHandle(nullptr),
+    mappingHandle(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path, std::string* error) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        if (error) *error = "Cannot open " + path;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        if (error) *error = "Empty or unreadable file " + path;
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        if (error) *error = "Cannot map " + path;
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (error) *error = "Cannot open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        if (error) *error = "Empty or unreadable file " + path;
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps its own reference
+    if (view == MAP_FAILED) {
+        if (error) *error = "Cannot map " + path;
+        return false;
+    }
+    madvise(view, static_cast<size_t>(info.st_size), MADV_WILLNEED);
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(info.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+    if (!data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+uint64_t MappedFile::contentHash() const {
+    ContentHasher hasher(size);
+    hasher.update(data, size);
+    return hasher.finish();
+}
+
+bool MappedFile::replace(const std::string& source, const std::string& target) {
+#ifdef _WIN32
+    if (MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) return true;
+    // Probably mapped: renaming it is still allowed, replacing it isn't
+    std::string aside = target + "." + std::to_string(GetCurrentProcessId()) + "." + std::to_string(GetTickCount64()) + ".old";
+    if (!MoveFileExA(target.c_str(), aside.c_str(), MOVEFILE_WRITE_THROUGH)) return false;
+    if (!MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_WRITE_THROUGH)) {
+        MoveFileExA(aside.c_str(), target.c_str(), MOVEFILE_WRITE_THROUGH);
+        return false;
+    }
+    DeleteFileA(aside.c_str()); // Pending until the mapping closes
+    return true;
+#else
+    return std::rename(source.c_str(), target.c_str()) == 0; // Mappings keep the old inode alive
+#endif
+}
+
+
+// --- ContentHasher ---
+// Four independent multiply-xorshift lanes over 32-byte blocks, folded together at the end;
+// the bytes after the last whole block go in one by one
+
+static const uint64_t HashMultiplier = 0x9E3779B97F4A7C15ull;
+
+ContentHasher::ContentHasher(uint64_t totalSize) :
+    lanes{ totalSize, totalSize ^ HashMultiplier, ~totalSize, totalSize + HashMultiplier },
+    partialSize(0)
+{
+}
+
+void ContentHasher::block(const uint8_t* data) {
+    for (int l = 0; l < 4; ++l) {
+        uint64_t word;
+        std::memcpy(&word, data + l * 8, sizeof(word));
+        lanes[l] = (lanes[l] ^ word) * HashMultiplier;
+        lanes[l] ^= lanes[l] >> 29;
+    }
+}
+
+void ContentHasher::update(const void* data, size_t bytes) {
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    if (partialSize > 0) {
+        size_t take = std::min(bytes, sizeof(partial) - partialSize);
+        std::memcpy(partial + partialSize, in, take);
+        partialSize += take;
+        in += take;
+        bytes -= take;
+        if (partialSize < sizeof(partial)) return;
+        block(partial);
+        partialSize = 0;
+    }
+    for (; bytes >= 32; in += 32, bytes -= 32) block(in);
+    std::memcpy(partial, in, bytes);
+    partialSize = bytes;
+}
+
+uint64_t ContentHasher::finish() {
+    uint64_t hash = HashMultiplier;
+    for (uint64_t lane : lanes) {
+        hash = (hash ^ lane) * HashMultiplier;
+        hash ^= hash >> 32;
+    }
+    for (size_t i = 0; i < partialSize; ++i) {
+        hash = (hash ^ partial[i]) * 0x100000001B3ull;
+    }
+    return hash ^ (hash >> 29);
+}
@@ -0,0 +1,53 @@
+// MappedFile.h
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Files are opened sharing delete access, so they can be renamed or replaced while mapped
+    bool open(const std::string& path, std::string* error = nullptr);
+    void close();
+
+    // Moves 'source' over 'target', also when 'target' is mapped right now (Windows won't replace
+    // a mapped file, so it is renamed aside and deleted once its last mapping goes away)
+    static bool replace(const std::string& source, const std::string& target);
+
+    bool isOpen() const { return data != nullptr; }
+    const uint8_t* getData() const { return data; }
+    size_t getSize() const { return size; }
+    // 64-bit hash of the whole file (not cryptographic), to tell whether a file changed.
+    // Reads every page, at about memory speed once they are cached.
+    uint64_t contentHash() const;
+
+private:
+    const uint8_t* data;
+    size_t size;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
+
+// MappedFile::contentHash() of bytes that arrive in pieces (e.g. while a file is written).
+// The total size is part of the hash, so it must be known up front.
+class ContentHasher {
+public:
+    explicit ContentHasher(uint64_t totalSize);
+    void update(const void* data, size_t bytes);
+    uint64_t finish(); // After exactly totalSize bytes
+
+private:
+    void block(const uint8_t* data);
+
+    uint64_t lanes[4];
+    uint8_t partial[32]; // Bytes of an incomplete block
+    size_t partialSize;
+};
@@ -0,0 +1,324 @@
+// MeshExport.cpp
+#include "MeshExport.h"
+#include "ParallelFor.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <memory>
+
+using namespace MeshExport;
+
+static const size_t WindowStrokes = 1024; // Strokes triangulated and formatted per round
+static const size_t WriteBufferBytes = 4u << 20;
+
+const char* MeshExport::extension(Format format) {
+    switch (format) {
+    case OBJ: return ".obj";
+    case PLY: return ".ply";
+    case STL: return ".stl";
+    }
+    return "";
+}
+
+namespace {
+    struct FileCloser {
+        void operator()(FILE* file) const { if (file) std::fclose(file); }
+    };
+    typedef std::unique_ptr<FILE, FileCloser> FilePtr;
+
+    // Closes the file and reports whether everything written to it made it out (a full disk
+    // often only shows up when the last buffer is flushed by fclose)
+    bool closeFile(FilePtr& file) {
+        FILE* raw = file.release();
+        bool ok = std::ferror(raw) == 0;
+        return std::fclose(raw) == 0 && ok;
+    }
+
+    // --- Text formatting ---
+
+    // Fixed 6-decimal floats without going through printf: the exporter's hot loop
+    char* writeFloat(char* out, float value) {
+        if (!(value == value)) value = 0.0f; // NaN
+        if (value < 0.0f) {
+            *out++ = '-';
+            value = -value;
+        }
+        if (value >= 1e9f) {
+            return out + std::sprintf(out, "%.6e", value);
+        }
+        uint64_t scaled = static_cast<uint64_t>(static_cast<double>(value) * 1000000.0 + 0.5);
+        uint64_t whole = scaled / 1000000;
+        uint32_t fraction = static_cast<uint32_t>(scaled % 1000000);
+        char digits[24];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + whole % 10);
+            whole /= 10;
+        } while (whole > 0);
+        while (count > 0) *out++ = digits[--count];
+        if (fraction != 0) {
+            *out++ = '.';
+            for (int divisor = 100000; divisor > 0 && fraction != 0; divisor /= 10) {
+                *out++ = static_cast<char>('0' + fraction / divisor);
+                fraction %= divisor;
+            }
+        }
+        return out;
+    }
+
+    char* writeUint(char* out, uint64_t value) {
+        char digits[24];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) *out++ = digits[--count];
+        return out;
+    }
+
+    void appendObj(const StrokeMesh& mesh, size_t strokeIndex, uint64_t firstVertex, std::string& out) {
+        // Worst case per vertex: 2 lines of 3 floats of ~20 chars; per triangle: 3 x 2 indices
+        out.resize(32 + mesh.positions.size() * 140 + mesh.indices.size() * 48 + mesh.parts.size() * 32);
+        char* cursor = &out[0];
+        cursor += std::sprintf(cursor, "o stroke_%zu\n", strokeIndex);
+        for (size_t v = 0; v < mesh.positions.size(); ++v) {
+            const glm::vec3& p = mesh.positions[v];
+            *cursor++ = 'v';
+            for (int axis = 0; axis < 3; ++axis) {
+                *cursor++ = ' ';
+                cursor = writeFloat(cursor, p[axis]);
+            }
+            *cursor++ = '\n';
+        }
+        for (size_t v = 0; v < mesh.normals.size(); ++v) {
+            const glm::vec3& n = mesh.normals[v];
+            *cursor++ = 'v';
+            *cursor++ = 'n';
+            for (int axis = 0; axis < 3; ++axis) {
+                *cursor++ = ' ';
+                cursor = writeFloat(cursor, n[axis]);
+            }
+            *cursor++ = '\n';
+        }
+        for (const StrokeMesh::Part& part : mesh.parts) {
+            cursor += std::sprintf(cursor, "usemtl material_%u\n", part.material);
+            for (uint32_t i = part.firstIndex; i + 2 < part.firstIndex + part.indexCount; i += 3) {
+                *cursor++ = 'f';
+                for (int corner = 0; corner < 3; ++corner) {
+                    uint64_t index = firstVertex + mesh.indices[i + corner] + 1; // OBJ counts from 1
+                    *cursor++ = ' ';
+                    cursor = writeUint(cursor, index);
+                    *cursor++ = '/';
+                    *cursor++ = '/';
+                    cursor = writeUint(cursor, index);
+                }
+                *cursor++ = '\n';
+            }
+        }
+        out.resize(cursor - out.data());
+    }
+
+    bool writeMtl(const std::string& path, const std::vector<StrokeMaterial>& materials) {
+        FilePtr file(std::fopen(path.c_str(), "wb"));
+        if (!file) return false;
+        for (size_t m = 0; m < materials.size(); ++m) {
+            const StrokeMaterial& material = materials[m];
+            std::fprintf(file.get(), "newmtl material_%zu\nKa %f %f %f\nKd %f %f %f\nKs %f %f %f\nNs %f\nd %f\n\n", m,
+                material.ambientColor.x, material.ambientColor.y, material.ambientColor.z,
+                material.diffuseColor.x, material.diffuseColor.y, material.diffuseColor.z,
+                material.specularColor.x, material.specularColor.y, material.specularColor.z,
+                material.shininess, material.diffuseColor.w);
+        }
+        return closeFile(file);
+    }
+
+    // --- Binary formatting (little-endian hosts) ---
+
+    template <typename T> uint8_t* put(uint8_t* out, const T& value) {
+        std::memcpy(out, &value, sizeof(T));
+        return out + sizeof(T);
+    }
+
+    uint8_t toByte(float value) {
+        value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<uint8_t>(value * 255.0f + 0.5f);
+    }
+
+    void appendPly(const StrokeMesh& mesh, const std::vector<StrokeMaterial>& materials, uint64_t firstVertex, std::string& out) {
+        // Vertices and faces go to separate blocks of the file, so they're formatted separately:
+        // 'out' holds the vertices followed by the faces, split by the caller
+        const size_t vertexBytes = 6 * sizeof(float) + 3;
+        const size_t faceBytes = 1 + 3 * sizeof(uint32_t);
+        out.resize(mesh.positions.size() * vertexBytes + mesh.indices.size() / 3 * faceBytes);
+        uint8_t* cursor = reinterpret_cast<uint8_t*>(&out[0]);
+
+        // Vertex color from the material of the part the vertex is first used by
+        std::vector<uint32_t> vertexMaterial(mesh.positions.size(), 0);
+        for (const StrokeMesh::Part& part : mesh.parts) {
+            for (uint32_t i = part.firstIndex; i < part.firstIndex + part.indexCount; ++i) {
+                vertexMaterial[mesh.indices[i]] = part.material;
+            }
+        }
+        for (size_t v = 0; v < mesh.positions.size(); ++v) {
+            cursor = put(cursor, mesh.positions[v]);
+            cursor = put(cursor, mesh.normals[v]);
+            const glm::vec4& color = materials.empty() ? glm::vec4(1.0f) : materials[vertexMaterial[v]].diffuseColor;
+            *cursor++ = toByte(color.x);
+            *cursor++ = toByte(color.y);
+            *cursor++ = toByte(color.z);
+        }
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            *cursor++ = 3;
+            for (int corner = 0; corner < 3; ++corner) {
+                cursor = put(cursor, static_cast<uint32_t>(firstVertex + mesh.indices[i + corner]));
+            }
+        }
+    }
+
+    void appendStl(const StrokeMesh& mesh, std::string& out) {
+        out.resize(mesh.indices.size() / 3 * 50);
+        uint8_t* cursor = reinterpret_cast<uint8_t*>(&out[0]);
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const glm::vec3& a = mesh.positions[mesh.indices[i]];
+            const glm::vec3& b = mesh.positions[mesh.indices[i + 1]];
+            const glm::vec3& c = mesh.positions[mesh.indices[i + 2]];
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+            cursor = put(cursor, normal);
+            cursor = put(cursor, a);
+            cursor = put(cursor, b);
+            cursor = put(cursor, c);
+            cursor = put(cursor, uint16_t(0));
+        }
+    }
+}
+
+bool MeshExport::write(const std::string& path, Format format, const Source& source, Stats* stats, std::string* error) {
+    auto start = std::chrono::steady_clock::now();
+    auto fail = [error](const std::string& message) {
+        if (error) *error = message;
+        return false;
+    };
+
+    // Totals up front: PLY and STL headers need them, and they size the progress stats
+    std::vector<size_t> vertexCounts(source.strokeCount), triangleCounts(source.strokeCount);
+    parallelFor(source.strokeCount, [&](size_t s) {
+        source.measure(s, vertexCounts[s], triangleCounts[s]);
+    }, 256);
+    uint64_t totalVertices = 0, totalTriangles = 0;
+    for (size_t s = 0; s < source.strokeCount; ++s) {
+        totalVertices += vertexCounts[s];
+        totalTriangles += triangleCounts[s];
+    }
+    if (format == PLY && totalVertices > 0xFFFFFFFFull) return fail("Too many vertices for PLY");
+    if (format == STL && totalTriangles > 0xFFFFFFFFull) return fail("Too many triangles for STL");
+
+    FilePtr file(std::fopen(path.c_str(), "wb"));
+    if (!file) return fail("Cannot write " + path);
+    std::vector<char> writeBuffer(WriteBufferBytes);
+    std::setvbuf(file.get(), writeBuffer.data(), _IOFBF, writeBuffer.size());
+
+    // PLY keeps vertices and faces in separate blocks: faces go to a side file and are appended
+    uint64_t bytesWritten = 0;
+    FilePtr faceFile;
+    std::string facePath = path + ".faces.tmp";
+
+    switch (format) {
+    case OBJ: {
+        std::string mtlPath = path;
+        size_t dot = mtlPath.find_last_of('.');
+        size_t slash = mtlPath.find_last_of("/\\");
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) mtlPath.erase(dot);
+        mtlPath += ".mtl";
+        if (!writeMtl(mtlPath, source.materials)) return fail("Cannot write " + mtlPath);
+        size_t nameStart = mtlPath.find_last_of("/\\");
+        bytesWritten += std::fprintf(file.get(), "# 3D Paint export: %zu strokes\nmtllib %s\n", source.strokeCount,
+            mtlPath.c_str() + (nameStart == std::string::npos ? 0 : nameStart + 1));
+        break;
+    }
+    case PLY:
+        bytesWritten += std::fprintf(file.get(),
+            "ply\nformat binary_little_endian 1.0\ncomment 3D Paint export\n"
+            "element vertex %llu\nproperty float x\nproperty float y\nproperty float z\n"
+            "property float nx\nproperty float ny\nproperty float nz\n"
+            "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+            "element face %llu\nproperty list uchar uint vertex_indices\nend_header\n",
+            (unsigned long long)totalVertices, (unsigned long long)totalTriangles);
+        faceFile.reset(std::fopen(facePath.c_str(), "w+b"));
+        if (!faceFile) return fail("Cannot write " + facePath);
+        break;
+    case STL: {
+        char header[80] = {};
+        std::strncpy(header, "3D Paint export", sizeof(header) - 1);
+        uint32_t count = static_cast<uint32_t>(totalTriangles);
+        std::fwrite(header, 1, sizeof(header), file.get());
+        std::fwrite(&count, sizeof(count), 1, file.get());
+        bytesWritten += sizeof(header) + sizeof(count);
+        break;
+    }
+    }
+
+    // Stream window by window: build + format in parallel, then write in stroke order
+    std::vector<StrokeMesh> meshes(std::min(WindowStrokes, source.strokeCount));
+    std::vector<std::string> chunks(meshes.size());
+    uint64_t firstVertex = 0;
+    for (size_t first = 0; first < source.strokeCount; first += WindowStrokes) {
+        size_t count = std::min(WindowStrokes, source.strokeCount - first);
+        std::vector<uint64_t> vertexOffsets(count);
+        for (size_t k = 0; k < count; ++k) {
+            vertexOffsets[k] = firstVertex;
+            firstVertex += vertexCounts[first + k];
+        }
+        parallelFor(count, [&](size_t k) {
+            StrokeMesh& mesh = meshes[k];
+            mesh.clear();
+            source.build(first + k, mesh);
+            switch (format) {
+            case OBJ: appendObj(mesh, first + k, vertexOffsets[k], chunks[k]); break;
+            case PLY: appendPly(mesh, source.materials, vertexOffsets[k], chunks[k]); break;
+            case STL: appendStl(mesh, chunks[k]); break;
+            }
+        });
+        for (size_t k = 0; k < count; ++k) {
+            if (format == PLY) {
+                size_t vertexBytes = meshes[k].positions.size() * (6 * sizeof(float) + 3);
+                std::fwrite(chunks[k].data(), 1, vertexBytes, file.get());
+                std::fwrite(chunks[k].data() + vertexBytes, 1, chunks[k].size() - vertexBytes, faceFile.get());
+            }
+            else {
+                std::fwrite(chunks[k].data(), 1, chunks[k].size(), file.get());
+            }
+            bytesWritten += chunks[k].size();
+        }
+    }
+
+    if (faceFile) {
+        // Every face block must have reached the side file and come back from it in full
+        bool faceOk = std::fflush(faceFile.get()) == 0 && std::ferror(faceFile.get()) == 0;
+        std::rewind(faceFile.get());
+        std::vector<char> block(WriteBufferBytes);
+        size_t read;
+        while (faceOk && (read = std::fread(block.data(), 1, block.size(), faceFile.get())) > 0) {
+            faceOk = std::fwrite(block.data(), 1, read, file.get()) == read;
+        }
+        faceOk = closeFile(faceFile) && faceOk;
+        std::remove(facePath.c_str());
+        if (!faceOk) {
+            file.reset();
+            return fail("Write failed: " + path);
+        }
+    }
+
+    if (!closeFile(file)) return fail("Write failed: " + path);
+
+    if (stats) {
+        stats->strokes = source.strokeCount;
+        stats->vertices = static_cast<size_t>(totalVertices);
+        stats->triangles = static_cast<size_t>(totalTriangles);
+        stats->bytes = bytesWritten;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return true;
+}
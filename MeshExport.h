@@ -0,0 +1,55 @@
+// MeshExport.h
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "StrokePayload.h"
+
+// Exports the scene as triangles for other tools: Wavefront OBJ (+ .mtl), binary PLY
+// (per-vertex colors) or binary STL.
+//
+// Strokes are pulled from a Source a window at a time: each window is triangulated and
+// formatted in parallel (one stroke per task), then written with one large write, so memory
+// stays bounded however big the scene is. Headers that need totals (PLY, STL) get them from
+// a cheap measuring pass first.
+namespace MeshExport {
+    enum Format { OBJ, PLY, STL };
+
+    // World-space triangles of one stroke
+    struct StrokeMesh {
+        struct Part {
+            uint32_t material;   // Into Source::materials
+            uint32_t firstIndex;
+            uint32_t indexCount;
+        };
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<uint32_t> indices; // Triangles, local to this stroke
+        std::vector<Part> parts;
+
+        void clear() { positions.clear(); normals.clear(); indices.clear(); parts.clear(); }
+    };
+
+    struct Source {
+        size_t strokeCount = 0;
+        std::vector<StrokeMaterial> materials;
+        // Counts for stroke i without building it. Called from several threads at once.
+        std::function<void(size_t stroke, size_t& vertexCount, size_t& triangleCount)> measure;
+        // Builds stroke i. Called from several threads at once.
+        std::function<void(size_t stroke, StrokeMesh& out)> build;
+    };
+
+    struct Stats {
+        size_t strokes = 0;
+        size_t vertices = 0;
+        size_t triangles = 0;
+        uint64_t bytes = 0;
+        double seconds = 0.0;
+        double megabytesPerSecond() const { return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0; }
+    };
+
+    const char* extension(Format format); // ".obj", ".ply", ".stl"
+
+    bool write(const std::string& path, Format format, const Source& source, Stats* stats = nullptr, std::string* error = nullptr);
+}
@@ -0,0 +1,481 @@
+// OffscreenRender.cpp
+#include "OffscreenRender.h"
+#include <glad/glad.h>
+#include "Painter.h"
+#include "Shader.h"
+#include "GpuPassTimer.h"
+#include "RecordingRenderDevice.h"
+#include "Globals.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <GLFW/glfw3.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+namespace {
+    struct Config {
+        std::string scene;
+        std::string cameraPath; // Script: "eye.x eye.y eye.z target.x target.y target.z" per frame
+        std::string out;        // JSON file; stdout if empty
+        std::string ppm;        // Last frame as an image, for eyeballing
+        int width = 1280;
+        int height = 720;
+        size_t frames = 120;    // Orbit length when there is no script
+        bool chunked = true;
+        std::string shaderCache = "shader_cache"; // Program binary directory; "off" compiles everything
+    };
+
+    struct Shot {
+        glm::vec3 eye;
+        glm::vec3 target;
+    };
+
+    struct FrameRecord {
+        double cpuMs;   // Submitting the frame (sky + Painter::draw)
+        double gpuMs;   // GL_TIME_ELAPSED around the same commands
+        double totalMs; // Until the pixels were read back
+        uint64_t hash;
+        double passMs[GpuPassTimer::PassCount]; // GPU timestamps at every pass change
+        bool passesTimed;
+    };
+
+    // --- GL context ---
+
+    class Context {
+    public:
+        ~Context() { destroy(); }
+
+        bool create(std::string* error) {
+#ifdef _WIN32
+            if (!glfwInit()) {
+                *error = "Failed to initialize GLFW";
+                return false;
+            }
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            window = glfwCreateWindow(16, 16, "3D Painter (offscreen)", nullptr, nullptr);
+            if (!window) {
+                *error = "Failed to create hidden GLFW window";
+                return false;
+            }
+            glfwMakeContextCurrent(window);
+            GLADloadproc loader = (GLADloadproc)glfwGetProcAddress;
+#else
+            // Surfaceless platform first: needs no X/Wayland server and no GPU
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            EGLint major = 0, minor = 0;
+            if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+                *error = "Failed to initialize EGL";
+                display = EGL_NO_DISPLAY;
+                return false;
+            }
+            if (!eglBindAPI(EGL_OPENGL_API)) {
+                *error = "EGL has no desktop OpenGL";
+                return false;
+            }
+            // Rendering goes to our own framebuffer, so any config will do (or none at all)
+            const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+            EGLConfig config = nullptr;
+            EGLint configCount = 0;
+            eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+            const EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 3,
+                EGL_CONTEXT_MINOR_VERSION, 3,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+            };
+            context = eglCreateContext(display, configCount > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttributes);
+            if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+                *error = "Failed to create a surfaceless OpenGL 3.3 core context";
+                return false;
+            }
+            GLADloadproc loader = (GLADloadproc)eglGetProcAddress;
+#endif
+            if (!gladLoadGLLoader(loader)) {
+                *error = "Failed to initialize GLAD";
+                return false;
+            }
+            return true;
+        }
+
+        void destroy() {
+#ifdef _WIN32
+            if (window) {
+                glfwDestroyWindow(window);
+                glfwTerminate();
+                window = nullptr;
+            }
+#else
+            if (display != EGL_NO_DISPLAY) {
+                eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+                eglTerminate(display);
+                display = EGL_NO_DISPLAY;
+                context = EGL_NO_CONTEXT;
+            }
+#endif
+        }
+
+    private:
+#ifdef _WIN32
+        GLFWwindow* window = nullptr;
+#else
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+#endif
+    };
+
+    // --- Helpers ---
+
+    void printUsage() {
+        std::fprintf(stderr,
+            "Offscreen render: --render SCENE.p3d [options]\n"
+            "  --size WxH     framebuffer size (default 1280x720)\n"
+            "  --frames N     frames of the default orbit (default 120)\n"
+            "  --camera FILE  camera path, one \"ex ey ez tx ty tz\" line per frame (replaces the orbit)\n"
+            "  --chunked 0|1  chunked rendering (default 1)\n"
+            "  --shader-cache DIR|off  program binary cache (default shader_cache)\n"
+            "  --ppm FILE     save the last frame\n"
+            "  --out FILE     write the JSON here instead of stdout\n");
+    }
+
+    bool parseArgs(int argc, char** argv, Config& config) {
+        if (argc < 2 || argv[1][0] == '-') return false;
+        config.scene = argv[1];
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "--size") {
+                if (std::sscanf(value, "%dx%d", &config.width, &config.height) != 2 || config.width <= 0 || config.height <= 0) return false;
+            }
+            else if (arg == "--frames") config.frames = std::strtoul(value, nullptr, 10);
+            else if (arg == "--camera") config.cameraPath = value;
+            else if (arg == "--chunked") config.chunked = std::atoi(value) != 0;
+            else if (arg == "--shader-cache") config.shaderCache = value;
+            else if (arg == "--ppm") config.ppm = value;
+            else if (arg == "--out") config.out = value;
+            else {
+                std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool loadCameraPath(const std::string& path, std::vector<Shot>& shots) {
+        FILE* file = std::fopen(path.c_str(), "r");
+        if (!file) return false;
+        char line[256];
+        while (std::fgets(line, sizeof(line), file)) {
+            Shot shot;
+            if (std::sscanf(line, "%f %f %f %f %f %f", &shot.eye.x, &shot.eye.y, &shot.eye.z,
+                    &shot.target.x, &shot.target.y, &shot.target.z) == 6) {
+                shots.push_back(shot);
+            }
+        }
+        std::fclose(file);
+        return !shots.empty();
+    }
+
+    uint64_t hashPixels(const uint8_t* data, size_t size) {
+        uint64_t hash = 14695981039346656037ull; // FNV-1a
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ data[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    double percentile(std::vector<double> values, double q) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        return values[static_cast<size_t>(q * (values.size() - 1) + 0.5)];
+    }
+
+    std::string lowercase(std::string text) {
+        for (char& c : text) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return text;
+    }
+
+    bool writePpm(const std::string& path, const std::vector<uint8_t>& rgba, int width, int height) {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+        std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+        std::vector<uint8_t> row(width * 3);
+        for (int y = height - 1; y >= 0; --y) { // GL rows start at the bottom
+            for (int x = 0; x < width; ++x) {
+                std::memcpy(&row[x * 3], &rgba[(static_cast<size_t>(y) * width + x) * 4], 3);
+            }
+            std::fwrite(row.data(), 1, row.size(), file);
+        }
+        std::fclose(file);
+        return true;
+    }
+}
+
+int runOffscreenRender(int argc, char** argv) {
+    auto launchTime = std::chrono::steady_clock::now(); // For first_frame_ms
+    Config config;
+    if (!parseArgs(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+    LogSinkScope logToStderr(logger, stderr); // The hidden window never draws the log window
+    Context context;
+    std::string error;
+    if (!context.create(&error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    setShaderCacheDirectory(config.shaderCache == "off" ? std::string() : config.shaderCache);
+
+    int exitCode = 0;
+    { // GL objects (and the painter's) must go before the context does
+        GLRenderDevice device;
+        GpuPassTimer passTimer;
+        if (passTimer.init()) device.setPassTimer(&passTimer);
+        Painter painter(device);
+        if (!painter.hasShaders()) {
+            std::fprintf(stderr, "Painter shaders failed to load (run from the directory holding shaders/)\n");
+            return 1;
+        }
+        if (!painter.loadScene(config.scene)) {
+            std::fprintf(stderr, "Cannot load scene %s\n", config.scene.c_str());
+            return 1;
+        }
+        painter.setChunkedRendering(config.chunked);
+        painter.flushChunks(); // Time a settled scene, not chunks baking in over the first frames
+
+        // Camera path: the script, or an orbit around the scene bounds
+        std::vector<Shot> shots;
+        glm::vec3 boundsMin(-1.0f), boundsMax(1.0f);
+        painter.getSceneBounds(boundsMin, boundsMax);
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radius = std::max(glm::length(boundsMax - boundsMin) * 0.5f, 1.0f);
+        if (!config.cameraPath.empty()) {
+            if (!loadCameraPath(config.cameraPath, shots)) {
+                std::fprintf(stderr, "Cannot read camera path %s\n", config.cameraPath.c_str());
+                return 1;
+            }
+        }
+        else {
+            for (size_t f = 0; f < config.frames; ++f) {
+                float angle = 2.0f * 3.14159265f * f / std::max<size_t>(config.frames, 1);
+                glm::vec3 offset(std::sin(angle), 0.35f, std::cos(angle));
+                shots.push_back({ center + offset * (radius * 2.2f), center });
+            }
+        }
+
+        // Framebuffer with the same state main.cpp sets up
+        GLuint framebuffer, color, depth;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &color);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, config.width, config.height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, config.width, config.height);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::fprintf(stderr, "Offscreen framebuffer is incomplete\n");
+            return 1;
+        }
+        glViewport(0, 0, config.width, config.height);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+
+        // Sky quad, as in main.cpp
+        const float skyVertices[] = { -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f, -1.0f };
+        GLuint skyVAO, skyVBO;
+        glGenVertexArrays(1, &skyVAO);
+        glGenBuffers(1, &skyVBO);
+        glBindVertexArray(skyVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, skyVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(skyVertices), skyVertices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        unsigned int skyShader = loadShader("shaders/sky.vert", "shaders/sky.frag");
+
+        GLuint query;
+        glGenQueries(1, &query);
+        float aspect = static_cast<float>(config.width) / config.height;
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, std::max(100.0f, radius * 6.0f));
+        std::vector<uint8_t> pixels(static_cast<size_t>(config.width) * config.height * 4);
+        std::vector<FrameRecord> records;
+        records.reserve(shots.size());
+        uint64_t runHash = 14695981039346656037ull;
+        uint64_t frameIndex = 0; // Frames begun on the pass timer
+        uint32_t passMask = 0;   // Passes seen in any frame
+
+        // Renders one shot. Also run once untimed up front, so shader compiles, first uploads and drivers
+        // that time the first query from context creation don't skew the numbers
+        auto renderShot = [&](const Shot& shot, FrameRecord& record) {
+            glm::vec3 forward = shot.target - shot.eye;
+            glm::vec3 up = std::fabs(glm::normalize(forward).y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::mat4 view = glm::lookAt(shot.eye, shot.target, up);
+            frameIndex++;
+
+            auto start = std::chrono::steady_clock::now();
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            passTimer.beginFrame();
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            device.beginPass(RenderPass::Sky);
+            if (skyShader) {
+                glDepthMask(GL_FALSE);
+                device.useProgram(skyShader);
+                device.bindVertexArray(skyVAO);
+                device.drawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                glDepthMask(GL_TRUE);
+                device.bindVertexArray(0);
+            }
+            device.beginPass(RenderPass::Other);
+            painter.draw(view, projection, shot.eye);
+            passTimer.endFrame();
+            glEndQuery(GL_TIME_ELAPSED);
+            auto submitted = std::chrono::steady_clock::now();
+            glReadPixels(0, 0, config.width, config.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            auto finished = std::chrono::steady_clock::now();
+
+            GLuint64 gpuNs = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuNs);
+            record.cpuMs = std::chrono::duration<double, std::milli>(submitted - start).count();
+            record.totalMs = std::chrono::duration<double, std::milli>(finished - start).count();
+            record.gpuMs = gpuNs / 1e6;
+            record.hash = hashPixels(pixels.data(), pixels.size());
+
+            // The read-back synced with the GPU, so this frame's timestamps are in; nothing waits
+            GpuPassTimer::Result passes;
+            passTimer.collect(true);
+            record.passesTimed = passTimer.getLatest(passes) && passes.frame == frameIndex;
+            for (int pass = 0; pass < GpuPassTimer::PassCount; ++pass) {
+                record.passMs[pass] = record.passesTimed ? passes.passMs[pass] : 0.0;
+                if (record.passesTimed && passes.hasPass(static_cast<RenderPass>(pass))) passMask |= 1u << pass;
+            }
+        };
+
+        FrameRecord warmup;
+        if (!shots.empty()) renderShot(shots[0], warmup);
+        double firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launchTime).count();
+        for (const Shot& shot : shots) {
+            FrameRecord record;
+            renderShot(shot, record);
+            for (int b = 0; b < 8; ++b) {
+                runHash = (runHash ^ ((record.hash >> (b * 8)) & 0xFF)) * 1099511628211ull;
+            }
+            records.push_back(record);
+        }
+        if (!config.ppm.empty() && !writePpm(config.ppm, pixels, config.width, config.height)) {
+            std::fprintf(stderr, "Cannot write %s\n", config.ppm.c_str());
+        }
+
+        // --- JSON ---
+        FILE* file = config.out.empty() ? stdout : std::fopen(config.out.c_str(), "w");
+        if (file) {
+            std::vector<double> cpu, gpu, total;
+            for (const FrameRecord& record : records) {
+                cpu.push_back(record.cpuMs);
+                gpu.push_back(record.gpuMs);
+                total.push_back(record.totalMs);
+            }
+            const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+            std::fprintf(file, "{\n  \"renderer\": \"%s\",\n  \"scene\": \"%s\",\n  \"strokes\": %d,\n  \"width\": %d,\n  \"height\": %d,\n  \"chunked\": %s,\n",
+                renderer ? renderer : "unknown", config.scene.c_str(), painter.getStrokeCount(), config.width, config.height,
+                config.chunked ? "true" : "false");
+            std::fprintf(file, "  \"frames\": %zu,\n  \"image_hash\": \"%016llx\",\n", records.size(), static_cast<unsigned long long>(runHash));
+            ShaderLoadStats shaderStats = getShaderLoadStats();
+            std::fprintf(file, "  \"first_frame_ms\": %.2f,\n  \"shaders\": {\"programs\": %d, \"from_cache\": %d, \"load_ms\": %.2f, \"cache\": %s},\n",
+                firstFrameMs, shaderStats.programs, shaderStats.fromCache, shaderStats.totalMs, config.shaderCache == "off" ? "false" : "true");
+            const std::vector<double>* series[3] = { &cpu, &gpu, &total };
+            const char* names[3] = { "cpu_ms", "gpu_ms", "frame_ms" };
+            for (int s = 0; s < 3; ++s) {
+                std::fprintf(file, "  \"%s\": {\"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n", names[s],
+                    percentile(*series[s], 0.5), percentile(*series[s], 0.99), percentile(*series[s], 1.0));
+            }
+            // GPU time per pass, from the pass timer's timestamps; "other" is the clear and the gaps
+            std::vector<int> timedPasses;
+            for (int pass = 0; pass < GpuPassTimer::PassCount; ++pass) {
+                if ((passMask >> pass) & 1u) timedPasses.push_back(pass);
+            }
+            if (!timedPasses.empty()) {
+                std::fprintf(file, "  \"gpu_pass_ms\": {");
+                for (size_t p = 0; p < timedPasses.size(); ++p) {
+                    std::vector<double> values;
+                    for (const FrameRecord& record : records) {
+                        if (record.passesTimed) values.push_back(record.passMs[timedPasses[p]]);
+                    }
+                    std::fprintf(file, "%s\n    \"%s\": {\"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f}", p ? "," : "",
+                        lowercase(RecordingRenderDevice::passName(static_cast<RenderPass>(timedPasses[p]))).c_str(),
+                        percentile(values, 0.5), percentile(values, 0.99), percentile(values, 1.0));
+                }
+                std::fprintf(file, "\n  },\n");
+            }
+            std::fprintf(file, "  \"per_frame\": [\n");
+            for (size_t f = 0; f < records.size(); ++f) {
+                std::fprintf(file, "    {\"cpu_ms\": %.4f, \"gpu_ms\": %.4f, \"frame_ms\": %.4f, \"hash\": \"%016llx\"",
+                    records[f].cpuMs, records[f].gpuMs, records[f].totalMs, static_cast<unsigned long long>(records[f].hash));
+                if (records[f].passesTimed && !timedPasses.empty()) {
+                    std::fprintf(file, ", \"passes\": {");
+                    for (size_t p = 0; p < timedPasses.size(); ++p) {
+                        std::fprintf(file, "%s\"%s\": %.4f", p ? ", " : "",
+                            lowercase(RecordingRenderDevice::passName(static_cast<RenderPass>(timedPasses[p]))).c_str(),
+                            records[f].passMs[timedPasses[p]]);
+                    }
+                    std::fprintf(file, "}");
+                }
+                std::fprintf(file, "}%s\n", f + 1 < records.size() ? "," : "");
+            }
+            std::fprintf(file, "  ]\n}\n");
+            if (file != stdout) std::fclose(file);
+        }
+        else {
+            std::fprintf(stderr, "Cannot write %s\n", config.out.c_str());
+            exitCode = 1;
+        }
+
+        glDeleteQueries(1, &query);
+        if (skyShader) glDeleteProgram(skyShader);
+        glDeleteVertexArrays(1, &skyVAO);
+        glDeleteBuffers(1, &skyVBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+    }
+    return exitCode;
+}
+
+#ifdef P3D_RENDER_MAIN
+// Standalone offscreen build (see README.md)
+int main(int argc, char** argv) {
+    return runOffscreenRender(argc, argv);
+}
+#endif
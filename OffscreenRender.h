@@ -0,0 +1,13 @@
+// OffscreenRender.h
+#pragma once
+
+// Renders a saved scene along a camera path without a window, through the full draw path
+// (sky + Painter::draw), and reports CPU/GPU frame times plus a hash of every frame as JSON.
+// Identical hashes mean identical pixels, so a change can be checked for unchanged output.
+//
+// Linux: surfaceless EGL context (Mesa's llvmpipe when there is no GPU, e.g. CI boxes).
+// Windows: hidden GLFW window.
+//   3D Paint.exe --render scene.p3d [options]
+// or the standalone Linux build described in README.md. Run with --help for the options.
+// Returns the process exit code.
+int runOffscreenRender(int argc, char** argv);
@@ -1,85 +1,167 @@
 // Painter.cpp
 #include "Painter.h"
-#include "Shader.h" 
 #include "Globals.h"  
 #include "Camera.h"   
+#include "SceneFile.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glfw/glfw3.h>
 #include <algorithm>
+#include <map>
 #include <vector>
 #include <cmath> 
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-// Constructor
-Painter::Painter() :
-    drawing(false),
+// Grid for packed control points in scene files; same as the undo history uses
+static const float PointGridStep = 1.0f / 1024.0f;
+// World width of one pixel of line width / point size when lines and points are exported as geometry
+static const float ExportPixelSize = 0.01f;
+// Imported point clouds are cut into strokes this long, small enough to cull and chunk well
+static const size_t ImportStrokePoints = 4096;
+// Chunk rebakes wait until the scene has been left alone this long, then share this much of each frame
+static const std::chrono::milliseconds ChunkIdleDelay(500);
+static const double ChunkRebakeBudgetMs = 4.0;
+// ...unless this many strokes are waiting to be baked: then they bake right away (within the budget)
+static const size_t ChunkUnbakedLimit = 256;
+
+static_assert(Painter::BATCH == SceneFile::BatchStyle, "scene files validate batches by this style");
+
+// Size and content hash of a file a journal record refers to. Replay only: new records get
+// theirs from the save, the stream worker or the journal writer, never from the render thread.
+static bool fileDigest(const std::string& path, uint64_t& size, uint64_t& hash) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    size = file.getSize();
+    hash = file.contentHash();
+    return true;
+}
+
+// Constructors
+Painter::Painter(bool gpu) : Painter(gpu ? new GLRenderDevice() : nullptr, true) {}
+
+Painter::Painter(RenderDevice& renderDevice) : Painter(&renderDevice, false) {}
+
+Painter::Painter(RenderDevice* renderDevice, bool ownsDevice) :
     brushAmbientColor(0.1f, 0.1f, 0.1f, 1.0f),
     brushDiffuseColor(1.0f, 1.0f, 1.0f, 1.0f),
     brushSpecularColor(0.5f, 0.5f, 0.5f, 1.0f),
     brushShininess(32.0f),
     brushSize(2.0f),
-    currentDrawStyle(FREEHAND),
     lightPos(1.0f, 5.0f, 3.0f),
     lightColor(1.0f, 1.0f, 1.0f),
+    drawing(false),
+    gpuCacheDirty(false),
+    chunkedRendering(true),
+    ownedDevice(ownsDevice ? renderDevice : nullptr),
+    device(renderDevice),
     simpleVAO(0), simpleVBO(0),
     instancedVAO(0), instancedVBO(0), instanceDataVBO(0),
     cubeEBO(0), cubeIndexCount(0),
     sphereVAO(0), sphereVBO(0), sphereEBO(0), sphereIndexCount(0),
     tubeVAO(0), tubeVBO(0), tubeEBO(0),
-    simpleShaderProgram(0), litShaderProgram(0)
+    strokeInstanceVBO(0), identityInstanceVBO(0),
+    simpleShaderProgram(0), litShaderProgram(0),
+    currentDrawStyle(FREEHAND)
 {
-    initShaders();
+    // Strokes coming back from compressed history need their mesh regenerated
+    history.setRebuildFunction([this](const glm::vec3* points, size_t count, uint8_t style, float size) {
+        return buildPayload(points, count, static_cast<DrawStyle>(style), size);
+    });
+    // A compressed stroke's GPU mesh goes at the next prune, along with the payload
+    history.setCacheReferenceFunction([this](const StrokePayload* payload) {
+        return static_cast<uint32_t>(gpuMeshes.count(payload));
+    });
+
     initCube();       // For CUBE style (instanced)
     initSphere(16, 8); // For SPHERE style (instanced)
+    if (!device) return; // Headless: the CPU copies of the dab meshes are all we need
+
+    initShaders();
     initTubeResources(); // For TUBE style
+    device->genBuffers(1, &strokeInstanceVBO); // Filled by updateInstanceBuffers
+    // Chunk batches are baked in world space: their VAOs read this single identity instance
+    glm::mat4 identity(1.0f);
+    device->genBuffers(1, &identityInstanceVBO);
+    device->bindBuffer(GL_ARRAY_BUFFER, identityInstanceVBO);
+    device->bufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4), glm::value_ptr(identity), GL_STATIC_DRAW);
+    device->bindBuffer(GL_ARRAY_BUFFER, 0);
 
     // VAO for simple line/point drawing
-    glGenVertexArrays(1, &simpleVAO);
-    glGenBuffers(1, &simpleVBO);
-    glBindVertexArray(simpleVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, simpleVBO);
+    device->genVertexArrays(1, &simpleVAO);
+    device->genBuffers(1, &simpleVBO);
+    device->bindVertexArray(simpleVAO);
+    device->bindBuffer(GL_ARRAY_BUFFER, simpleVBO);
     // Position attribute (simple)
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0); // Unbind
+    device->vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    device->enableVertexAttribArray(0);
+    device->bindVertexArray(0); // Unbind
 }
 
 // Destructor
 Painter::~Painter() {
-    glDeleteVertexArrays(1, &simpleVAO);
-    glDeleteBuffers(1, &simpleVBO);
-    glDeleteVertexArrays(1, &instancedVAO);
-    glDeleteBuffers(1, &instancedVBO); // Base mesh VBO for instancing
-    glDeleteBuffers(1, &instanceDataVBO); // Instance data VBO
-    glDeleteBuffers(1, &cubeEBO);
-    glDeleteVertexArrays(1, &sphereVAO); // Only if used for single sphere drawing
-    glDeleteBuffers(1, &sphereVBO);
-    glDeleteBuffers(1, &sphereEBO);
-    glDeleteVertexArrays(1, &tubeVAO);
-    glDeleteBuffers(1, &tubeVBO);
-    glDeleteBuffers(1, &tubeEBO);
-
-    glDeleteProgram(simpleShaderProgram);
-    glDeleteProgram(litShaderProgram);
+    if (!device) return;
+    device->deleteVertexArrays(1, &simpleVAO);
+    device->deleteBuffers(1, &simpleVBO);
+    device->deleteVertexArrays(1, &instancedVAO);
+    device->deleteBuffers(1, &instancedVBO); // Base mesh VBO for instancing
+    device->deleteBuffers(1, &instanceDataVBO); // Instance data VBO
+    device->deleteBuffers(1, &cubeEBO);
+    device->deleteVertexArrays(1, &sphereVAO); // Only if used for single sphere drawing
+    device->deleteBuffers(1, &sphereVBO);
+    device->deleteBuffers(1, &sphereEBO);
+    device->deleteVertexArrays(1, &tubeVAO);
+    device->deleteBuffers(1, &tubeVBO);
+    device->deleteBuffers(1, &tubeEBO);
+    device->deleteBuffers(1, &strokeInstanceVBO);
+    device->deleteBuffers(1, &identityInstanceVBO);
+    for (auto& entry : gpuMeshes) {
+        deleteGpuMesh(entry.second);
+    }
+    gpuMeshes.clear();
+
+    device->deleteProgram(simpleShaderProgram);
+    device->deleteProgram(litShaderProgram);
 }
 
 void Painter::initShaders() {
     // Keep the original simple shader if needed, or remove if all drawing uses lighting
-    simpleShaderProgram = loadShader("shaders/paint.vert", "shaders/paint.frag");
+    simpleShaderProgram = device->loadProgram("shaders/paint.vert", "shaders/paint.frag");
     if (!simpleShaderProgram) {
-        logger.addLog(" Failed to load simple paint shader!");
+        logger.addLog(LogLevel::Error, " Failed to load simple paint shader!");
     }
 
     // Load the new shader with lighting
-    litShaderProgram = loadShader("shaders/paint_lit.vert", "shaders/paint_lit.frag");
+    litShaderProgram = device->loadProgram("shaders/paint_lit.vert", "shaders/paint_lit.frag");
     if (!litShaderProgram) {
-        logger.addLog(" Failed to load lit paint shader!");
+        logger.addLog(LogLevel::Error, " Failed to load lit paint shader!");
+        return;
     }
+    // Locations are fixed once the program is linked: look them up here, not every frame
+    litUniforms.view = device->getUniformLocation(litShaderProgram, "view");
+    litUniforms.projection = device->getUniformLocation(litShaderProgram, "projection");
+    litUniforms.model = device->getUniformLocation(litShaderProgram, "model");
+    litUniforms.viewPos = device->getUniformLocation(litShaderProgram, "viewPos");
+    litUniforms.lightPosition = device->getUniformLocation(litShaderProgram, "light.position");
+    litUniforms.lightColor = device->getUniformLocation(litShaderProgram, "light.color");
+    litUniforms.lightAmbient = device->getUniformLocation(litShaderProgram, "light.ambient");
+    litUniforms.lightDiffuse = device->getUniformLocation(litShaderProgram, "light.diffuse");
+    litUniforms.lightSpecular = device->getUniformLocation(litShaderProgram, "light.specular");
+    litUniforms.materialAmbient = device->getUniformLocation(litShaderProgram, "material.ambient");
+    litUniforms.materialDiffuse = device->getUniformLocation(litShaderProgram, "material.diffuse");
+    litUniforms.materialSpecular = device->getUniformLocation(litShaderProgram, "material.specular");
+    litUniforms.materialShininess = device->getUniformLocation(litShaderProgram, "material.shininess");
+    litUniforms.useInstancing = device->getUniformLocation(litShaderProgram, "useInstancing");
+    litUniforms.materialTable = device->getUniformLocation(litShaderProgram, "materialTable");
+    litUniforms.useMaterialTable = device->getUniformLocation(litShaderProgram, "useMaterialTable");
 }
 
 void Painter::initCube() {
@@ -129,27 +211,37 @@ void Painter::initCube() {
         -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
     };
 
-    glGenVertexArrays(1, &instancedVAO); // Use a single VAO for all instanced meshes
-    glGenBuffers(1, &instancedVBO);      // VBO for base mesh vertices (pos + normal)
     // No EBO needed for this cube definition (using triangles directly)
     cubeIndexCount = 36; // 6 faces * 2 triangles/face * 3 vertices/triangle
+    cubeMesh.resize(cubeIndexCount);
+    for (int i = 0; i < cubeIndexCount; ++i) {
+        cubeMesh[i].position = glm::vec3(vertices[i * 6 + 0], vertices[i * 6 + 1], vertices[i * 6 + 2]);
+        cubeMesh[i].normal = glm::vec3(vertices[i * 6 + 3], vertices[i * 6 + 4], vertices[i * 6 + 5]);
+    }
+    if (!device) return;
+
+    device->genVertexArrays(1, &instancedVAO); // Use a single VAO for all instanced meshes
+    device->genBuffers(1, &instancedVBO);      // VBO for base mesh vertices (pos + normal)
 
-    glBindVertexArray(instancedVAO);
+    device->bindVertexArray(instancedVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, instancedVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    device->bindBuffer(GL_ARRAY_BUFFER, instancedVBO);
+    device->bufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     // Position attribute (location 0)
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    device->vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    device->enableVertexAttribArray(0);
     // Normal attribute (location 1)
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    device->vertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    device->enableVertexAttribArray(1);
 
-    // Setup buffer and attributes for instance data (position, scale, color)
-    setupInstancedVertexAttributes(instancedVAO, instanceDataVBO);
+    // Setup buffer and attributes for instance data (model matrix per dab)
+    device->genBuffers(1, &instanceDataVBO);
+    device->bindBuffer(GL_ARRAY_BUFFER, instanceDataVBO);
+    bindInstanceAttributes();
+    device->bindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glBindVertexArray(0); // Unbind VAO
+    device->bindVertexArray(0); // Unbind VAO
 }
 
 
@@ -198,97 +290,97 @@ void Painter::initSphere(int segments, int rings) {
         }
     }
     sphereIndexCount = indices.size();
-
-    // We already have the instancedVAO and instancedVBO. We just need to
-    // potentially store sphere data if we want to draw it non-instanced,
-    // or just remember the index count for instanced drawing.
-    // For instanced drawing, we'll load the sphere data into the *same*
-    // instancedVBO when the style switches to SPHERE.
-
-    // Optional: If you need a separate VAO for drawing a single sphere
-    glGenVertexArrays(1, &sphereVAO);
-    glGenBuffers(1, &sphereVBO);
-    glGenBuffers(1, &sphereEBO);
-
-    glBindVertexArray(sphereVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    sphereMesh = vertices;
+    sphereMeshIndices = indices;
+    if (!device) return;
+
+    // The sphere gets its own VAO (with its EBO) and shares the per-dab instance buffer
+    // with the cube, so instanced sphere strokes never touch the cube's vertex data.
+    device->genVertexArrays(1, &sphereVAO);
+    device->genBuffers(1, &sphereVBO);
+    device->genBuffers(1, &sphereEBO);
+
+    device->bindVertexArray(sphereVAO);
+    device->bindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+    device->bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    device->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+    device->bufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
     // Position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
+    device->vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+    device->enableVertexAttribArray(0);
     // Normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
+    device->vertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    device->enableVertexAttribArray(1);
     // TexCoords (Add later)
     // glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
     // glEnableVertexAttribArray(2);
 
-    glBindVertexArray(0);
+    // Instance matrices (instanceDataVBO is created by initCube)
+    device->bindBuffer(GL_ARRAY_BUFFER, instanceDataVBO);
+    bindInstanceAttributes();
+
+    device->bindVertexArray(0);
+    device->bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 
 void Painter::initTubeResources() {
-    glGenVertexArrays(1, &tubeVAO);
-    glGenBuffers(1, &tubeVBO);
-    glGenBuffers(1, &tubeEBO);
+    device->genVertexArrays(1, &tubeVAO);
+    device->genBuffers(1, &tubeVBO);
+    device->genBuffers(1, &tubeEBO);
 
-    glBindVertexArray(tubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, tubeVBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tubeEBO); // Bind EBO here
+    device->bindVertexArray(tubeVAO);
+    device->bindBuffer(GL_ARRAY_BUFFER, tubeVBO);
+    device->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, tubeEBO); // Bind EBO here
 
     // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
+    device->vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+    device->enableVertexAttribArray(0);
     // Normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
+    device->vertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    device->enableVertexAttribArray(1);
     // TexCoords attribute (Add later)
     // glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
     // glEnableVertexAttribArray(2);
 
-    glBindVertexArray(0); // Unbind
+    device->bindVertexArray(0); // Unbind
 }
 
-// Helper to setup vertex attributes for instanced data (call *after* base mesh attributes)
-void Painter::setupInstancedVertexAttributes(unsigned int VAO, unsigned int& instanceVBO) {
-    glGenBuffers(1, &instanceVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-    // Allocate buffer - size will be determined later when drawing
-    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW); // Start with zero size
-
-    glBindVertexArray(VAO); // Bind the VAO we are adding attributes to
-
+// Helper to setup vertex attributes for instanced data (call *after* base mesh attributes).
+// Uses the VAO and GL_ARRAY_BUFFER currently bound.
+void Painter::bindInstanceAttributes() {
     // Instance Matrix (mat4) - spanning attribute locations 2, 3, 4, 5
-    GLsizei vec4Size = sizeof(glm::vec4);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(1 * vec4Size));
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * vec4Size));
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * vec4Size));
+    device->enableVertexAttribArray(2);
+    device->enableVertexAttribArray(3);
+    device->enableVertexAttribArray(4);
+    device->enableVertexAttribArray(5);
+    pointInstanceAttributes(0);
 
     // Tell OpenGL this is per-instance data
-    glVertexAttribDivisor(2, 1);
-    glVertexAttribDivisor(3, 1);
-    glVertexAttribDivisor(4, 1);
-    glVertexAttribDivisor(5, 1);
+    device->vertexAttribDivisor(2, 1);
+    device->vertexAttribDivisor(3, 1);
+    device->vertexAttribDivisor(4, 1);
+    device->vertexAttribDivisor(5, 1);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+// Re-points the instance matrix of the bound VAO at 'firstInstance' in the bound GL_ARRAY_BUFFER
+// (GL 3.3 has no base instance for draws)
+void Painter::pointInstanceAttributes(size_t firstInstance) {
+    size_t offset = firstInstance * sizeof(glm::mat4);
+    size_t vec4Size = sizeof(glm::vec4);
+    device->vertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset));
+    device->vertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + 1 * vec4Size));
+    device->vertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + 2 * vec4Size));
+    device->vertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + 3 * vec4Size));
 }
 
 
 void Painter::addPoint(const glm::vec3& point) {
+    PROFILE_SCOPE("Painter::addPoint");
     if (!drawing) {
         drawing = true;
         currentStroke.points.clear();
-        currentStroke.generatedVertices.clear(); // Clear generated geometry too
-        currentStroke.generatedIndices.clear();
 
         // Store current brush settings with the stroke
         currentStroke.ambientColor = brushAmbientColor;
@@ -297,8 +389,14 @@ void Painter::addPoint(const glm::vec3& point) {
         currentStroke.shininess = brushShininess;
         currentStroke.size = brushSize;
         currentStroke.style = currentDrawStyle; // Store the style used
+        currentStroke.transform = glm::mat4(1.0f);
+        currentStroke.inverseTransform = glm::mat4(1.0f);
+        currentStroke.pointSum = glm::dvec3(0.0);
     }
-    currentStroke.points.push_back(point);
+    // Input arrives in world space; the stroke may have been moved since it started
+    glm::vec3 local = glm::vec3(currentStroke.inverseTransform * glm::vec4(point, 1.0f));
+    currentStroke.points.push_back(local);
+    currentStroke.pointSum += glm::dvec3(local);
 
     // Optimization: For tubes, you could generate segments incrementally here
     // instead of all at once in endStroke, but it's more complex.
@@ -306,47 +404,216 @@ void Painter::addPoint(const glm::vec3& point) {
 
 void Painter::endStroke() {
     if (drawing) {
+        PROFILE_SCOPE("Painter::endStroke");
         if (currentStroke.points.size() > 1) {
             // Smoothing happens on control points BEFORE geometry generation
             // smoothStroke(currentStroke); // Optional: Apply smoothing
 
-            // Generate mesh if it's a style that needs it (like TUBE)
-            if (currentStroke.style == TUBE) {
-                generateTubeMesh(currentStroke);
-            }
+            // Mesh-based styles (like TUBE) are generated straight into the stroke's payload.
             // For instanced styles (CUBE, SPHERE), geometry is generated per-instance in draw call
-
-            strokes.push_back(currentStroke);
-            undoneStrokes.clear(); // Clear redo stack
+            storeStroke(currentStroke);
+            history.recordAdd(); // Also clears the redo stack
+            journalStroke(currentStroke);
+            gpuCacheDirty = true;
         }
         drawing = false;
-        // Clear current stroke temporary data
+        // Clear current stroke temporary data (keeps capacity for the next stroke)
         currentStroke.points.clear();
-        currentStroke.generatedVertices.clear();
-        currentStroke.generatedIndices.clear();
     }
 }
 
+void Painter::storeStroke(const Stroke& stroke) {
+    StrokeMaterial material;
+    material.ambientColor = stroke.ambientColor;
+    material.diffuseColor = stroke.diffuseColor;
+    material.specularColor = stroke.specularColor;
+    material.shininess = stroke.shininess;
+    strokes.add(buildPayload(stroke.points.data(), stroke.points.size(), stroke.style, stroke.size),
+        material, stroke.size, static_cast<uint8_t>(stroke.style), stroke.transform);
+}
 
-void Painter::generateTubeMesh(Stroke& stroke, int segments) {
-    stroke.generatedVertices.clear();
-    stroke.generatedIndices.clear();
+StrokeRef Painter::buildPayload(const glm::vec3* points, size_t count, DrawStyle style, float size) {
+    PROFILE_SCOPE("Painter::buildPayload");
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    if (style == TUBE && count >= 2) {
+        vertexCount = count * TubeSegments;
+        indexCount = (count - 1) * TubeSegments * 6;
+    }
+    // Single arena allocation for points and mesh, filled in place
+    StrokePayloadBuilder builder(strokeArena, count, vertexCount, indexCount);
+    std::copy_n(points, count, builder.points());
+    if (vertexCount > 0) {
+        generateTubeMesh(points, count, size, builder.vertices(), builder.indices());
+    }
+    return builder.finish();
+}
 
-    if (stroke.points.size() < 2) return;
+// Flattens strokes into one world-space mesh. Every style ends up as indexed geometry:
+// tubes and dabs (cubes/spheres expanded per point) as triangles, freehand as line pairs and
+// points as points, each vertex tagged with its stroke's entry in the batch material table.
+// Triangles share one range; lines and points get one range per width/size.
+StrokeRef Painter::buildBatchPayload(const uint32_t* strokeIndices, size_t count) {
+    PROFILE_SCOPE("Painter::buildBatchPayload");
+    std::vector<StrokeMaterial> table;
+    std::vector<glm::vec3> points;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> materialIds;
+    std::vector<unsigned int> triangleIndices;
+    std::map<float, std::vector<unsigned int>> lineIndices;  // By line width
+    std::map<float, std::vector<unsigned int>> pointIndices; // By point size
+
+    auto tableId = [&table](const StrokeMaterial& material) {
+        for (uint32_t m = 0; m < table.size(); ++m) {
+            if (table[m] == material) return m;
+        }
+        table.push_back(material);
+        return static_cast<uint32_t>(table.size() - 1);
+    };
+    auto pushVertex = [&](const glm::mat4& model, const Vertex& v, uint32_t materialId) {
+        Vertex out;
+        out.position = glm::vec3(model * glm::vec4(v.position, 1.0f));
+        out.normal = glm::mat3(model) * v.normal; // Uniform scale only, like the shader
+        float length = glm::length(out.normal);
+        if (length > 0.0f) out.normal = out.normal / length;
+        vertices.push_back(out);
+        materialIds.push_back(materialId);
+    };
 
-    float radius = stroke.size * 0.05f; // Example: scale radius with brush size
+    for (size_t s = 0; s < count; ++s) {
+        uint32_t index = strokeIndices[s];
+        const StrokePayload& payload = *strokes.payload(index);
+        const glm::mat4& transform = strokes.transform(index);
+        float size = strokes.size(index);
+        DrawStyle style = static_cast<DrawStyle>(strokes.style(index));
+        uint32_t materialId = style == BATCH ? 0 : tableId(strokes.material(index));
+        unsigned int base = static_cast<unsigned int>(vertices.size());
+
+        for (uint32_t p = 0; p < payload.pointCount; ++p) {
+            points.push_back(glm::vec3(transform * glm::vec4(payload.points[p], 1.0f)));
+        }
 
-    for (size_t i = 0; i < stroke.points.size(); ++i) {
-        glm::vec3 p0 = stroke.points[i];
+        switch (style) {
+        case FREEHAND:
+        case POINTS: {
+            for (uint32_t p = 0; p < payload.pointCount; ++p) {
+                Vertex v;
+                v.position = payload.points[p];
+                v.normal = glm::vec3(0.0f); // Lines/points carry no normal, as when drawn unbatched
+                pushVertex(transform, v, materialId);
+            }
+            if (style == FREEHAND) {
+                std::vector<unsigned int>& lines = lineIndices[size];
+                for (uint32_t p = 1; p < payload.pointCount; ++p) {
+                    lines.push_back(base + p - 1);
+                    lines.push_back(base + p);
+                }
+            }
+            else {
+                std::vector<unsigned int>& dots = pointIndices[size];
+                for (uint32_t p = 0; p < payload.pointCount; ++p) {
+                    dots.push_back(base + p);
+                }
+            }
+            break;
+        }
+        case CUBE:
+        case SPHERE: {
+            const std::vector<Vertex>& mesh = style == CUBE ? cubeMesh : sphereMesh;
+            for (uint32_t p = 0; p < payload.pointCount; ++p) {
+                glm::mat4 model = glm::translate(transform, payload.points[p]);
+                model = glm::scale(model, glm::vec3(size * 0.1f)); // Same scale as the instanced path
+                unsigned int dabBase = static_cast<unsigned int>(vertices.size());
+                for (const Vertex& v : mesh) {
+                    pushVertex(model, v, materialId);
+                }
+                if (style == CUBE) {
+                    for (unsigned int i = 0; i < mesh.size(); ++i) triangleIndices.push_back(dabBase + i);
+                }
+                else {
+                    for (unsigned int i : sphereMeshIndices) triangleIndices.push_back(dabBase + i);
+                }
+            }
+            break;
+        }
+        case TUBE:
+            for (uint32_t v = 0; v < payload.vertexCount; ++v) {
+                pushVertex(transform, payload.vertices[v], materialId);
+            }
+            for (uint32_t i = 0; i < payload.indexCount; ++i) {
+                triangleIndices.push_back(base + payload.indices[i]);
+            }
+            break;
+        case BATCH: {
+            // Re-baking a batch: remap its material table into ours
+            std::vector<uint32_t> remap(payload.materialCount);
+            for (uint32_t m = 0; m < payload.materialCount; ++m) {
+                remap[m] = tableId(payload.materials[m]);
+            }
+            for (uint32_t v = 0; v < payload.vertexCount; ++v) {
+                pushVertex(transform, payload.vertices[v], remap[payload.materialIds[v]]);
+            }
+            for (uint32_t r = 0; r < payload.rangeCount; ++r) {
+                const StrokeBatchRange& range = payload.ranges[r];
+                std::vector<unsigned int>& target =
+                    range.primitive == StrokeBatchRange::Triangles ? triangleIndices :
+                    range.primitive == StrokeBatchRange::Lines ? lineIndices[range.size] : pointIndices[range.size];
+                for (uint32_t i = 0; i < range.indexCount; ++i) {
+                    target.push_back(base + payload.indices[range.firstIndex + i]);
+                }
+            }
+            break;
+        }
+        }
+    }
+    if (table.empty() || vertices.empty()) return StrokeRef();
+
+    // Lay out the index buffer range by range
+    std::vector<StrokeBatchRange> ranges;
+    std::vector<unsigned int> indices;
+    auto addRange = [&](StrokeBatchRange::Primitive primitive, float size, const std::vector<unsigned int>& source) {
+        if (source.empty()) return;
+        StrokeBatchRange range;
+        range.firstIndex = static_cast<uint32_t>(indices.size());
+        range.indexCount = static_cast<uint32_t>(source.size());
+        range.primitive = primitive;
+        range.size = size;
+        ranges.push_back(range);
+        indices.insert(indices.end(), source.begin(), source.end());
+    };
+    addRange(StrokeBatchRange::Triangles, 0.0f, triangleIndices);
+    for (const auto& lines : lineIndices) addRange(StrokeBatchRange::Lines, lines.first, lines.second);
+    for (const auto& dots : pointIndices) addRange(StrokeBatchRange::Points, dots.first, dots.second);
+    if (ranges.empty()) return StrokeRef(); // Only single-point lines: nothing to draw, and no way to save it as a batch
+
+    StrokePayloadBuilder builder(strokeArena, points.size(), vertices.size(), indices.size(), table.size(), ranges.size());
+    std::copy(points.begin(), points.end(), builder.points());
+    std::copy(vertices.begin(), vertices.end(), builder.vertices());
+    std::copy(indices.begin(), indices.end(), builder.indices());
+    std::copy(materialIds.begin(), materialIds.end(), builder.materialIds());
+    std::copy(table.begin(), table.end(), builder.materials());
+    std::copy(ranges.begin(), ranges.end(), builder.ranges());
+    return builder.finish();
+}
+
+
+void Painter::generateTubeMesh(const glm::vec3* points, size_t count, float size, Vertex* outVertices, unsigned int* outIndices, int segments) {
+    PROFILE_SCOPE("Painter::generateTubeMesh");
+    if (count < 2) return;
+
+    float radius = size * 0.05f; // Example: scale radius with brush size
+
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 p0 = points[i];
         glm::vec3 direction;
 
         // Calculate direction vector
-        if (i < stroke.points.size() - 1) {
-            direction = glm::normalize(stroke.points[i + 1] - p0);
+        if (i < count - 1) {
+            direction = glm::normalize(points[i + 1] - p0);
         }
         else {
             // For the last point, use the direction from the previous segment
-            direction = glm::normalize(p0 - stroke.points[i - 1]);
+            direction = glm::normalize(p0 - points[i - 1]);
         }
 
         // Find a perpendicular vector (up vector)
@@ -360,16 +627,15 @@ void Painter::generateTubeMesh(Stroke& stroke, int segments) {
             glm::vec3 normal = glm::normalize(cos(angle) * right + sin(angle) * up);
             glm::vec3 position = p0 + normal * radius;
 
-            Vertex v;
+            Vertex& v = *outVertices++;
             v.position = position;
             v.normal = normal;
-            // v.texCoords = glm::vec2((float)s / segments, (float)i / (stroke.points.size() - 1)); // Add later
-            stroke.generatedVertices.push_back(v);
+            // v.texCoords = glm::vec2((float)s / segments, (float)i / (count - 1)); // Add later
         }
     }
 
     // Generate indices to connect the rings into a tube
-    for (size_t i = 0; i < stroke.points.size() - 1; ++i) {
+    for (size_t i = 0; i < count - 1; ++i) {
         for (int s = 0; s < segments; ++s) {
             int current_ring_start = i * segments;
             int next_ring_start = (i + 1) * segments;
@@ -380,15 +646,15 @@ void Painter::generateTubeMesh(Stroke& stroke, int segments) {
             int p4 = next_ring_start + (s + 1) % segments; // Wrap around
 
             // Triangle 1
-            stroke.generatedIndices.push_back(p1);
-            stroke.generatedIndices.push_back(p3);
-            stroke.generatedIndices.push_back(p2);
+            *outIndices++ = p1;
+            *outIndices++ = p3;
+            *outIndices++ = p2;
 
 
             // Triangle 2
-            stroke.generatedIndices.push_back(p2);
-            stroke.generatedIndices.push_back(p3);
-            stroke.generatedIndices.push_back(p4);
+            *outIndices++ = p2;
+            *outIndices++ = p3;
+            *outIndices++ = p4;
 
         }
     }
@@ -396,26 +662,29 @@ void Painter::generateTubeMesh(Stroke& stroke, int segments) {
 
 
 void Painter::clear() {
+    sceneStream.cancel();
+    // Dropping the last references hands whole arena chunks back at once
     strokes.clear();
+    history.clear();
+    chunkGrid.clear();
+    unbakedStrokes.clear();
+    journal.reset(); // Nothing before a clear can matter to a replay
+    heldJournalRecords.clear();
+    pruneGpuMeshes(); // Nothing left to draw: every mesh goes
     currentStroke.points.clear();
-    currentStroke.generatedVertices.clear();
-    currentStroke.generatedIndices.clear();
-    undoneStrokes.clear();
     drawing = false;
+    // The chunks kept for reuse would otherwise stay reserved for as long as the scene stays empty
+    strokeArena.trim();
 }
 
 void Painter::undoStroke() {
-    if (!strokes.empty()) {
-        undoneStrokes.push_back(strokes.back());
-        strokes.pop_back();
-    }
+    if (history.undo(strokes)) journalAppend(StrokeJournal::Undo);
+    gpuCacheDirty = true;
 }
 
 void Painter::redoStroke() {
-    if (!undoneStrokes.empty()) {
-        strokes.push_back(undoneStrokes.back());
-        undoneStrokes.pop_back();
-    }
+    if (history.redo(strokes)) journalAppend(StrokeJournal::Redo);
+    gpuCacheDirty = true;
 }
 
 void Painter::smoothCurrentStroke() {
@@ -423,6 +692,9 @@ void Painter::smoothCurrentStroke() {
     // geometry needs regeneration afterwards if it's a mesh-based style.
     if (drawing && currentStroke.points.size() > 2) {
         smoothStroke(currentStroke); // Smooth control points
+        currentStroke.pointSum = glm::dvec3(0.0);
+        for (const auto& p : currentStroke.points)
+            currentStroke.pointSum += glm::dvec3(p);
         // If it was a tube, regenerate mesh (or wait until endStroke)
         // if (currentStroke.style == TUBE) { generateTubeMesh(currentStroke); }
     }
@@ -444,154 +716,116 @@ void Painter::smoothStroke(Stroke& stroke) {
 }
 
 
-void Painter::updateSimpleBuffer(const std::vector<glm::vec3>& points) {
-    if (points.empty()) return;
-    glBindVertexArray(simpleVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, simpleVBO);
-    glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(glm::vec3), points.data(), GL_DYNAMIC_DRAW);
+void Painter::updateSimpleBuffer(const glm::vec3* points, size_t count) {
+    if (count == 0) return;
+    device->bindVertexArray(simpleVAO);
+    device->bindBuffer(GL_ARRAY_BUFFER, simpleVBO);
+    device->bufferData(GL_ARRAY_BUFFER, count * sizeof(glm::vec3), points, GL_DYNAMIC_DRAW);
     // Vertex attrib pointer should already be set from init
-    glBindVertexArray(0);
+    device->bindVertexArray(0);
 }
 
-void Painter::updateTubeBuffers(const Stroke& stroke) {
-    if (stroke.generatedVertices.empty() || stroke.generatedIndices.empty()) return;
+void Painter::updateTubeBuffers(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+    if (vertexCount == 0 || indexCount == 0) return;
 
-    glBindVertexArray(tubeVAO);
+    device->bindVertexArray(tubeVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, tubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, stroke.generatedVertices.size() * sizeof(Vertex), stroke.generatedVertices.data(), GL_DYNAMIC_DRAW);
+    device->bindBuffer(GL_ARRAY_BUFFER, tubeVBO);
+    device->bufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_DYNAMIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tubeEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, stroke.generatedIndices.size() * sizeof(unsigned int), stroke.generatedIndices.data(), GL_DYNAMIC_DRAW);
+    device->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, tubeEBO);
+    device->bufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_DYNAMIC_DRAW);
 
     // Vertex attrib pointers should already be set from init
-    glBindVertexArray(0);
+    device->bindVertexArray(0);
 }
 
 
 void Painter::draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos) {
     if (!litShaderProgram) return; // Don't draw if shader failed to load
+    PROFILE_SCOPE("Painter::draw");
 
-    glUseProgram(litShaderProgram);
+    device->beginPass(RenderPass::Strokes);
+    device->useProgram(litShaderProgram);
 
     // --- Set Uniforms ---
     // Matrices
-    glUniformMatrix4fv(glGetUniformLocation(litShaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(litShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    device->uniformMatrix4fv(litUniforms.view, 1, GL_FALSE, glm::value_ptr(view));
+    device->uniformMatrix4fv(litUniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
 
     // Lighting
-    glUniform3fv(glGetUniformLocation(litShaderProgram, "light.position"), 1, glm::value_ptr(lightPos));
-    glUniform3fv(glGetUniformLocation(litShaderProgram, "light.color"), 1, glm::value_ptr(lightColor));
+    device->uniform3fv(litUniforms.lightPosition, 1, glm::value_ptr(lightPos));
+    device->uniform3fv(litUniforms.lightColor, 1, glm::value_ptr(lightColor));
     // Example fixed light intensities - make these adjustable later
-    glUniform3f(glGetUniformLocation(litShaderProgram, "light.ambient"), 0.2f, 0.2f, 0.2f);
-    glUniform3f(glGetUniformLocation(litShaderProgram, "light.diffuse"), 0.8f, 0.8f, 0.8f); // Stronger diffuse
-    glUniform3f(glGetUniformLocation(litShaderProgram, "light.specular"), 1.0f, 1.0f, 1.0f); // Full specular intensity
+    device->uniform3f(litUniforms.lightAmbient, 0.2f, 0.2f, 0.2f);
+    device->uniform3f(litUniforms.lightDiffuse, 0.8f, 0.8f, 0.8f); // Stronger diffuse
+    device->uniform3f(litUniforms.lightSpecular, 1.0f, 1.0f, 1.0f); // Full specular intensity
 
     // Camera Position (for specular)
-    glUniform3fv(glGetUniformLocation(litShaderProgram, "viewPos"), 1, glm::value_ptr(viewPos));
+    device->uniform3fv(litUniforms.viewPos, 1, glm::value_ptr(viewPos));
 
     // --- Draw Completed Strokes ---
-    for (const auto& stroke : strokes) {
-        // Set Material properties for this stroke
-        glUniform4fv(glGetUniformLocation(litShaderProgram, "material.ambient"), 1, glm::value_ptr(stroke.ambientColor));
-        glUniform4fv(glGetUniformLocation(litShaderProgram, "material.diffuse"), 1, glm::value_ptr(stroke.diffuseColor));
-        glUniform4fv(glGetUniformLocation(litShaderProgram, "material.specular"), 1, glm::value_ptr(stroke.specularColor));
-        glUniform1f(glGetUniformLocation(litShaderProgram, "material.shininess"), stroke.shininess);
-
-        // Determine how to draw based on the style stored *in the stroke*
-        switch (stroke.style) {
-        case FREEHAND:
-            updateSimpleBuffer(stroke.points);
-            glBindVertexArray(simpleVAO);
-            glLineWidth(stroke.size); // Line width might not work well with lit shaders depending on GPU
-            glUniformMatrix4fv(glGetUniformLocation(litShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f))); // Identity model
-            glDrawArrays(GL_LINE_STRIP, 0, stroke.points.size());
-            break;
-        case POINTS:
-            updateSimpleBuffer(stroke.points);
-            glBindVertexArray(simpleVAO);
-            glPointSize(stroke.size); // Point size might not work well with lit shaders
-            glUniformMatrix4fv(glGetUniformLocation(litShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f))); // Identity model
-            glDrawArrays(GL_POINTS, 0, stroke.points.size());
-            break;
-        case CUBE:
-            drawStrokeInstanced(stroke, instancedVAO, cubeIndexCount, view, projection, viewPos);
-            break;
-        case SPHERE:
-            // For sphere, we need to load sphere vertex data into the *instancedVBO*
-            // This is slightly inefficient, ideally we'd have separate VBOs or use geometry shaders
-            // Or better: have a dedicated sphere VAO/VBO and switch VAOs
-            // Let's stick to reusing the instanced VBO for now.
-            // If initSphere created sphereVBO/EBO:
-            glBindBuffer(GL_ARRAY_BUFFER, instancedVBO); // Bind the base mesh VBO
-            glBindVertexArray(sphereVAO); // Bind sphere VAO to get sphere vertex data
-            glBindBuffer(GL_ARRAY_BUFFER, sphereVBO); // Get sphere data source
-            GLint size; glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size); // Get sphere data size
-            glBindBuffer(GL_ARRAY_BUFFER, instancedVBO); // Bind destination
-            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW); // Allocate space in instancedVBO
-            glBindBuffer(GL_COPY_READ_BUFFER, sphereVBO);
-            glBindBuffer(GL_COPY_WRITE_BUFFER, instancedVBO);
-            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size); // Copy sphere data
-            glBindBuffer(GL_COPY_READ_BUFFER, 0); glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
-
-            // Now draw using the common instanced path
-            drawStrokeInstanced(stroke, instancedVAO, sphereIndexCount, view, projection, viewPos);
-            break;
-        case TUBE:
-            updateTubeBuffers(stroke);
-            glBindVertexArray(tubeVAO);
-            glUniformMatrix4fv(glGetUniformLocation(litShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f))); // Identity model
-            glDrawElements(GL_TRIANGLES, stroke.generatedIndices.size(), GL_UNSIGNED_INT, 0);
-            break;
-        }
+    renderStats.drawCalls = 0;
+    bool chunked = prepareFrame(projection * view);
+    if (gpuCacheDirty) pruneGpuMeshes();
+    Profiler::Scope submitZone("Submit strokes");
+    device->uniform1i(litUniforms.useInstancing, 1);
+    if (chunked) drawChunks(projection * view);
+    updateInstanceBuffers();
+    for (const StrokeGroup& group : visibleGroups) {
+        drawStrokeGroup(group);
     }
-    glBindVertexArray(0); // Unbind VAO after drawing all strokes
+    device->uniform1i(litUniforms.useInstancing, 0);
+    device->bindVertexArray(0); // Unbind VAO after drawing all strokes
+    submitZone.end();
 
 
     // --- Draw Current Stroke (Preview) ---
+    PROFILE_SCOPE("Preview");
+    device->beginPass(RenderPass::Preview);
     if (drawing && currentStroke.points.size() > 0) {
         // Set Material properties for the current brush
-        glUniform4fv(glGetUniformLocation(litShaderProgram, "material.ambient"), 1, glm::value_ptr(brushAmbientColor));
-        glUniform4fv(glGetUniformLocation(litShaderProgram, "material.diffuse"), 1, glm::value_ptr(brushDiffuseColor));
-        glUniform4fv(glGetUniformLocation(litShaderProgram, "material.specular"), 1, glm::value_ptr(brushSpecularColor));
-        glUniform1f(glGetUniformLocation(litShaderProgram, "material.shininess"), brushShininess);
+        device->uniform4fv(litUniforms.materialAmbient, 1, glm::value_ptr(brushAmbientColor));
+        device->uniform4fv(litUniforms.materialDiffuse, 1, glm::value_ptr(brushDiffuseColor));
+        device->uniform4fv(litUniforms.materialSpecular, 1, glm::value_ptr(brushSpecularColor));
+        device->uniform1f(litUniforms.materialShininess, brushShininess);
 
-        glm::mat4 identity = glm::mat4(1.0f);
-        glUniformMatrix4fv(glGetUniformLocation(litShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(identity)); // Reset model matrix for non-instanced
+        const glm::mat4& strokeModel = currentStroke.transform;
+        device->uniformMatrix4fv(litUniforms.model, 1, GL_FALSE, glm::value_ptr(strokeModel)); // Stroke transform for non-instanced
 
         switch (currentDrawStyle) {
         case FREEHAND:
             if (currentStroke.points.size() > 1) {
-                updateSimpleBuffer(currentStroke.points);
-                glBindVertexArray(simpleVAO);
-                glLineWidth(brushSize);
-                glDrawArrays(GL_LINE_STRIP, 0, currentStroke.points.size());
+                updateSimpleBuffer(currentStroke.points.data(), currentStroke.points.size());
+                device->bindVertexArray(simpleVAO);
+                device->lineWidth(brushSize);
+                device->drawArrays(GL_LINE_STRIP, 0, currentStroke.points.size());
             }
             break;
         case POINTS:
-            updateSimpleBuffer(currentStroke.points);
-            glBindVertexArray(simpleVAO);
-            glPointSize(brushSize);
-            glDrawArrays(GL_POINTS, 0, currentStroke.points.size());
+            updateSimpleBuffer(currentStroke.points.data(), currentStroke.points.size());
+            device->bindVertexArray(simpleVAO);
+            device->pointSize(brushSize);
+            device->drawArrays(GL_POINTS, 0, currentStroke.points.size());
             break;
         case CUBE:
             // Previewing instanced strokes requires drawing one instance at the last point
             if (!currentStroke.points.empty()) {
-                glm::mat4 model = glm::translate(identity, currentStroke.points.back());
+                glm::mat4 model = glm::translate(strokeModel, currentStroke.points.back());
                 model = glm::scale(model, glm::vec3(brushSize * 0.1f)); // Apply scaling
-                glUniformMatrix4fv(glGetUniformLocation(litShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-                glBindVertexArray(instancedVAO); // Use the base cube VAO
-                glDrawArrays(GL_TRIANGLES, 0, cubeIndexCount); // Draw one cube
+                device->uniformMatrix4fv(litUniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+                device->bindVertexArray(instancedVAO); // Use the base cube VAO
+                device->drawArrays(GL_TRIANGLES, 0, cubeIndexCount); // Draw one cube
             }
             break;
         case SPHERE:
             // Previewing instanced strokes requires drawing one instance at the last point
             if (!currentStroke.points.empty()) {
-                glm::mat4 model = glm::translate(identity, currentStroke.points.back());
+                glm::mat4 model = glm::translate(strokeModel, currentStroke.points.back());
                 model = glm::scale(model, glm::vec3(brushSize * 0.1f)); // Apply scaling
-                glUniformMatrix4fv(glGetUniformLocation(litShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-                glBindVertexArray(sphereVAO); // Use the base sphere VAO
-                glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0); // Draw one sphere
+                device->uniformMatrix4fv(litUniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+                device->bindVertexArray(sphereVAO); // Use the base sphere VAO
+                device->drawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0); // Draw one sphere
             }
             break;
         case TUBE:
@@ -599,10 +833,10 @@ void Painter::draw(const glm::mat4& view, const glm::mat4& projection, const glm
             // For simplicity, maybe just draw lines for preview
             if (currentStroke.points.size() > 1) {
                 // Option 1: Draw lines as preview
-                updateSimpleBuffer(currentStroke.points);
-                glBindVertexArray(simpleVAO);
-                glLineWidth(brushSize);
-                glDrawArrays(GL_LINE_STRIP, 0, currentStroke.points.size());
+                updateSimpleBuffer(currentStroke.points.data(), currentStroke.points.size());
+                device->bindVertexArray(simpleVAO);
+                device->lineWidth(brushSize);
+                device->drawArrays(GL_LINE_STRIP, 0, currentStroke.points.size());
 
                 // Option 2: Generate and draw tube preview (can be slow)
                 // Stroke previewTube = currentStroke; // Copy
@@ -612,50 +846,437 @@ void Painter::draw(const glm::mat4& view, const glm::mat4& projection, const glm
                 // glDrawElements(GL_TRIANGLES, previewTube.generatedIndices.size(), GL_UNSIGNED_INT, 0);
             }
             break;
+        case BATCH: // Not a brush style
+            break;
         }
-        glBindVertexArray(0); // Unbind after preview
+        device->bindVertexArray(0); // Unbind after preview
     }
+    device->beginPass(RenderPass::Other);
 }
 
-// Helper function for drawing instanced strokes (CUBE, SPHERE)
-void Painter::drawStrokeInstanced(const Stroke& stroke, unsigned int baseVAO, int indexCount, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos)
+bool Painter::prepareFrame(const glm::mat4& viewProjection) {
+    PROFILE_SCOPE("Painter::prepareFrame");
+    // --- Stream In Scene Strokes ---
+    if (sceneStream.isActive()) {
+        pumpSceneStream();
+    }
+
+    // Streamed strokes are drawn one by one as they arrive, and chunks bake them in a few per
+    // frame (the stream keeps the unbaked count over the limit), so the stream never ends in one big bake
+    bool chunked = chunkedRendering;
+    if (chunked) {
+        // Chunk batches draw most of the scene; what they don't cover yet goes through the normal path
+        updateChunks();
+        unbakedStrokes.clear();
+        chunkGrid.collectUnbaked(unbakedStrokes);
+    }
+    renderStats.unbakedStrokes = chunked ? unbakedStrokes.size() : 0;
+    // Cull first: this pass only touches the packed bounds/size arrays
+    collectVisibleStrokes(viewProjection, chunked ? &unbakedStrokes : nullptr);
+    // Sort so copies sharing a payload (duplicates) end up next to each other
+    PROFILE_SCOPE("Sort visible strokes");
+    std::sort(visibleStrokes.begin(), visibleStrokes.end(), [this](uint32_t a, uint32_t b) {
+        const StrokePayload* pa = strokes.payload(a).get();
+        const StrokePayload* pb = strokes.payload(b).get();
+        if (pa != pb) return pa < pb;
+        if (strokes.materialIndex(a) != strokes.materialIndex(b)) return strokes.materialIndex(a) < strokes.materialIndex(b);
+        return strokes.size(a) < strokes.size(b);
+    });
+    return chunked;
+}
+
+// Splits the sorted visible strokes into groups (copies of one payload with the same material
+// and size) and gives each its range of the instance buffers: one matrix per copy for mesh and
+// line styles, one per control point per copy for dab styles (CUBE, SPHERE). A stroke's transform
+// never changes, so the matrices are only rebuilt and uploaded when the visible strokes do.
+void Painter::updateInstanceBuffers() {
+    PROFILE_SCOPE("Painter::updateInstanceBuffers");
+    visibleGroups.clear();
+    size_t meshInstances = 0, dabInstances = 0;
+    for (size_t start = 0; start < visibleStrokes.size();) {
+        uint32_t first = visibleStrokes[start];
+        size_t end = start + 1;
+        while (end < visibleStrokes.size() &&
+            strokes.payload(visibleStrokes[end]).get() == strokes.payload(first).get() &&
+            strokes.materialIndex(visibleStrokes[end]) == strokes.materialIndex(first) &&
+            strokes.size(visibleStrokes[end]) == strokes.size(first)) {
+            ++end;
+        }
+        StrokeGroup group;
+        group.start = start;
+        group.count = end - start;
+        DrawStyle style = static_cast<DrawStyle>(strokes.style(first));
+        if (style == CUBE || style == SPHERE) {
+            group.firstInstance = dabInstances;
+            dabInstances += group.count * strokes.pointCount(first);
+        }
+        else {
+            group.firstInstance = meshInstances;
+            meshInstances += group.count;
+        }
+        visibleGroups.push_back(group);
+        start = end;
+    }
+
+    // Same strokes in the same order as the last upload: the buffers already hold their matrices
+    const std::vector<uint64_t>& serials = strokes.getSerials();
+    bool changed = instanceSerials.size() != visibleStrokes.size();
+    for (size_t i = 0; !changed && i < visibleStrokes.size(); ++i) {
+        changed = instanceSerials[i] != serials[visibleStrokes[i]];
+    }
+    if (!changed) return;
+    instanceSerials.resize(visibleStrokes.size());
+    for (size_t i = 0; i < visibleStrokes.size(); ++i) {
+        instanceSerials[i] = serials[visibleStrokes[i]];
+    }
+
+    instanceScratch.clear();
+    dabInstanceScratch.clear();
+    instanceScratch.reserve(meshInstances);
+    dabInstanceScratch.reserve(dabInstances);
+    for (const StrokeGroup& group : visibleGroups) {
+        uint32_t first = visibleStrokes[group.start];
+        DrawStyle style = static_cast<DrawStyle>(strokes.style(first));
+        if (style == CUBE || style == SPHERE) {
+            const StrokePayload& payload = *strokes.payload(first);
+            float size = strokes.size(first);
+            for (size_t m = 0; m < group.count; ++m) {
+                const glm::mat4& strokeModel = strokes.transform(visibleStrokes[group.start + m]);
+                for (uint32_t p = 0; p < payload.pointCount; ++p) {
+                    glm::mat4 model = glm::translate(strokeModel, payload.points[p]);
+                    model = glm::scale(model, glm::vec3(size * 0.1f)); // Adjust scale based on stroke size
+                    dabInstanceScratch.push_back(model);
+                }
+            }
+        }
+        else {
+            for (size_t m = 0; m < group.count; ++m) {
+                instanceScratch.push_back(strokes.transform(visibleStrokes[group.start + m]));
+            }
+        }
+    }
+    device->bindBuffer(GL_ARRAY_BUFFER, strokeInstanceVBO);
+    device->bufferData(GL_ARRAY_BUFFER, instanceScratch.size() * sizeof(glm::mat4), instanceScratch.data(), GL_DYNAMIC_DRAW);
+    device->bindBuffer(GL_ARRAY_BUFFER, instanceDataVBO);
+    device->bufferData(GL_ARRAY_BUFFER, dabInstanceScratch.size() * sizeof(glm::mat4), dabInstanceScratch.data(), GL_DYNAMIC_DRAW);
+    device->bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Draws every copy of one payload (same material and size) with a single instanced call.
+// Mesh and line styles use cached per-payload buffers; the copies' matrices are already in the
+// instance buffers (updateInstanceBuffers), so drawing only points the VAO at the group's range.
+void Painter::drawStrokeGroup(const StrokeGroup& group)
 {
-    if (stroke.points.empty()) return;
+    uint32_t first = visibleStrokes[group.start];
+    const StrokeRef& payload = strokes.payload(first);
+    DrawStyle style = static_cast<DrawStyle>(strokes.style(first));
+    float size = strokes.size(first);
+    if (payload->pointCount == 0) return;
+    if (style == TUBE && payload->indexCount == 0) return;
+
+    // Set Material properties for this group (batches read theirs from a table)
+    const StrokeMaterial& material = strokes.material(first);
+    device->uniform4fv(litUniforms.materialAmbient, 1, glm::value_ptr(material.ambientColor));
+    device->uniform4fv(litUniforms.materialDiffuse, 1, glm::value_ptr(material.diffuseColor));
+    device->uniform4fv(litUniforms.materialSpecular, 1, glm::value_ptr(material.specularColor));
+    device->uniform1f(litUniforms.materialShininess, material.shininess);
+
+    // Bind the mesh VAO (base mesh attributes AND instance attributes) and point its instance
+    // matrices at this group's range
+    bool dabs = style == CUBE || style == SPHERE;
+    GLsizei instanceCount = static_cast<GLsizei>(dabs ? group.count * payload->pointCount : group.count);
+    unsigned int vao = style == CUBE ? instancedVAO : style == SPHERE ? sphereVAO : getGpuMesh(payload, style).vao;
+    device->bindVertexArray(vao);
+    device->bindBuffer(GL_ARRAY_BUFFER, dabs ? instanceDataVBO : strokeInstanceVBO);
+    pointInstanceAttributes(group.firstInstance);
+    device->bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    switch (style) {
+    case FREEHAND:
+        device->lineWidth(size); // Line width might not work well with lit shaders depending on GPU
+        device->drawArraysInstanced(GL_LINE_STRIP, 0, payload->pointCount, instanceCount);
+        break;
+    case POINTS:
+        device->pointSize(size); // Point size might not work well with lit shaders
+        device->drawArraysInstanced(GL_POINTS, 0, payload->pointCount, instanceCount);
+        break;
+    case CUBE: // Cube uses glDrawArrays
+        device->drawArraysInstanced(GL_TRIANGLES, 0, cubeIndexCount, instanceCount);
+        break;
+    case SPHERE: // Sphere uses glDrawElements with the EBO bound in its VAO
+        device->drawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0, instanceCount);
+        break;
+    case TUBE:
+        device->drawElementsInstanced(GL_TRIANGLES, payload->indexCount, GL_UNSIGNED_INT, 0, instanceCount);
+        break;
+    case BATCH:
+        drawBatch(payload, instanceCount);
+        break;
+    }
+    if (style != BATCH) renderStats.drawCalls++;
 
-    // 1. Prepare instance data (Model matrices)
-    std::vector<glm::mat4> instanceModels;
-    instanceModels.reserve(stroke.points.size());
-    for (const auto& point : stroke.points) {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, point);
-        // Adjust scale based on stroke size and maybe style
-        float scaleFactor = (stroke.style == CUBE || stroke.style == SPHERE) ? stroke.size * 0.1f : stroke.size;
-        model = glm::scale(model, glm::vec3(scaleFactor));
-        instanceModels.push_back(model);
+    device->bindVertexArray(0);
+}
+
+// Draws a baked batch: one call per primitive range, all triangles form a single range
+void Painter::drawBatch(const StrokeRef& payload, GLsizei instanceCount) {
+    const GpuMesh& mesh = getGpuMesh(payload, BATCH);
+    device->bindVertexArray(mesh.vao);
+    device->activeTexture(GL_TEXTURE0);
+    device->bindTexture(GL_TEXTURE_BUFFER, mesh.materialTexture);
+    device->uniform1i(litUniforms.materialTable, 0);
+    device->uniform1i(litUniforms.useMaterialTable, 1);
+    for (uint32_t r = 0; r < payload->rangeCount; ++r) {
+        const StrokeBatchRange& range = payload->ranges[r];
+        const void* offset = (const void*)(range.firstIndex * sizeof(unsigned int));
+        switch (range.primitive) {
+        case StrokeBatchRange::Triangles:
+            device->drawElementsInstanced(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, offset, instanceCount);
+            break;
+        case StrokeBatchRange::Lines:
+            device->lineWidth(range.size);
+            device->drawElementsInstanced(GL_LINES, range.indexCount, GL_UNSIGNED_INT, offset, instanceCount);
+            break;
+        case StrokeBatchRange::Points:
+            device->pointSize(range.size);
+            device->drawElementsInstanced(GL_POINTS, range.indexCount, GL_UNSIGNED_INT, offset, instanceCount);
+            break;
+        }
+        renderStats.drawCalls++;
+    }
+    device->uniform1i(litUniforms.useMaterialTable, 0);
+    device->bindTexture(GL_TEXTURE_BUFFER, 0);
+    device->bindVertexArray(0);
+}
+
+// Returns the GPU buffers for a payload, uploading them on first use.
+// The cache holds a reference, so payloads stay alive (and addresses unique) while cached.
+const Painter::GpuMesh& Painter::getGpuMesh(const StrokeRef& payload, DrawStyle style) {
+    auto found = gpuMeshes.find(payload.get());
+    if (found != gpuMeshes.end()) return found->second;
+    PROFILE_SCOPE("GPU mesh upload");
+
+    GpuMesh mesh;
+    mesh.payload = payload;
+    device->genVertexArrays(1, &mesh.vao);
+    device->genBuffers(1, &mesh.vbo);
+    device->bindVertexArray(mesh.vao);
+    device->bindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    if (style == BATCH) {
+        // [vertices][material ids] in one buffer
+        size_t vertexBytes = payload->vertexCount * sizeof(Vertex);
+        size_t idBytes = payload->vertexCount * sizeof(uint32_t);
+        device->bufferData(GL_ARRAY_BUFFER, vertexBytes + idBytes, nullptr, GL_STATIC_DRAW);
+        device->bufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, payload->vertices);
+        device->bufferSubData(GL_ARRAY_BUFFER, vertexBytes, idBytes, payload->materialIds);
+        device->genBuffers(1, &mesh.ebo);
+        device->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        device->bufferData(GL_ELEMENT_ARRAY_BUFFER, payload->indexCount * sizeof(unsigned int), payload->indices, GL_STATIC_DRAW);
+        device->vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+        device->enableVertexAttribArray(0);
+        device->vertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+        device->enableVertexAttribArray(1);
+        device->vertexAttribIPointer(6, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)vertexBytes);
+        device->enableVertexAttribArray(6);
+
+        // Material table: 4 texels per material (ambient, diffuse, specular, shininess)
+        std::vector<glm::vec4> table;
+        table.reserve(payload->materialCount * 4);
+        for (uint32_t m = 0; m < payload->materialCount; ++m) {
+            const StrokeMaterial& material = payload->materials[m];
+            table.push_back(material.ambientColor);
+            table.push_back(material.diffuseColor);
+            table.push_back(material.specularColor);
+            table.push_back(glm::vec4(material.shininess, 0.0f, 0.0f, 0.0f));
+        }
+        device->genBuffers(1, &mesh.materialBuffer);
+        device->bindBuffer(GL_TEXTURE_BUFFER, mesh.materialBuffer);
+        device->bufferData(GL_TEXTURE_BUFFER, table.size() * sizeof(glm::vec4), table.data(), GL_STATIC_DRAW);
+        device->genTextures(1, &mesh.materialTexture);
+        device->bindTexture(GL_TEXTURE_BUFFER, mesh.materialTexture);
+        device->texBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mesh.materialBuffer);
+        device->bindTexture(GL_TEXTURE_BUFFER, 0);
+        device->bindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+    else if (style == TUBE) {
+        device->bufferData(GL_ARRAY_BUFFER, payload->vertexCount * sizeof(Vertex), payload->vertices, GL_STATIC_DRAW);
+        device->genBuffers(1, &mesh.ebo);
+        device->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        device->bufferData(GL_ELEMENT_ARRAY_BUFFER, payload->indexCount * sizeof(unsigned int), payload->indices, GL_STATIC_DRAW);
+        device->vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+        device->enableVertexAttribArray(0);
+        device->vertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+        device->enableVertexAttribArray(1);
+    }
+    else {
+        // Lines and points only carry positions
+        device->bufferData(GL_ARRAY_BUFFER, payload->pointCount * sizeof(glm::vec3), payload->points, GL_STATIC_DRAW);
+        device->vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        device->enableVertexAttribArray(0);
+    }
+    device->bindBuffer(GL_ARRAY_BUFFER, identityInstanceVBO); // drawStrokeGroup re-points it per group
+    bindInstanceAttributes();
+    device->bindVertexArray(0);
+    device->bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return gpuMeshes.emplace(payload.get(), std::move(mesh)).first->second;
+}
+
+// Frees the GPU buffers of payloads the scene no longer draws (undone, cleared or replaced
+// strokes, old chunk batches), even if the history still holds them: redo uploads them again.
+// With chunks, strokes a batch covers are drawn by the batch, so their own meshes go too.
+void Painter::pruneGpuMeshes() {
+    PROFILE_SCOPE("Painter::pruneGpuMeshes");
+    livePayloads.clear();
+    if (chunkedRendering) {
+        for (const StrokeChunkGrid::Chunk& chunk : chunkGrid.getChunks()) {
+            if (chunk.batch) livePayloads.insert(chunk.batch.get());
+        }
+        for (uint32_t i : unbakedStrokes) { // As of this frame's prepareFrame
+            livePayloads.insert(strokes.payload(i).get());
+        }
+    }
+    else {
+        for (uint32_t i = 0; i < strokes.size(); ++i) {
+            livePayloads.insert(strokes.payload(i).get());
+        }
     }
+    for (auto it = gpuMeshes.begin(); it != gpuMeshes.end();) {
+        if (!livePayloads.count(it->first)) {
+            deleteGpuMesh(it->second);
+            it = gpuMeshes.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    gpuCacheDirty = false;
+}
+
+void Painter::deleteGpuMesh(GpuMesh& mesh) {
+    device->deleteVertexArrays(1, &mesh.vao);
+    device->deleteBuffers(1, &mesh.vbo);
+    if (mesh.ebo) device->deleteBuffers(1, &mesh.ebo);
+    if (mesh.materialTexture) device->deleteTextures(1, &mesh.materialTexture);
+    if (mesh.materialBuffer) device->deleteBuffers(1, &mesh.materialBuffer);
+}
 
-    // 2. Upload instance data to VBO
-    glBindBuffer(GL_ARRAY_BUFFER, instanceDataVBO);
-    glBufferData(GL_ARRAY_BUFFER, instanceModels.size() * sizeof(glm::mat4), instanceModels.data(), GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    // 3. Bind base mesh VAO (already contains vertex attributes for base mesh AND instance data)
-    glBindVertexArray(baseVAO);
+// Extract the six clip planes of a view-projection matrix (Gribb/Hartmann)
+static void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+    glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+}
+
+static bool boxInFrustum(const glm::vec4 planes[6], const glm::vec3& bMin, const glm::vec3& bMax) {
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4& plane = planes[p];
+        // Test the box corner furthest along the plane normal
+        glm::vec3 corner(plane.x >= 0.0f ? bMax.x : bMin.x,
+                         plane.y >= 0.0f ? bMax.y : bMin.y,
+                         plane.z >= 0.0f ? bMax.z : bMin.z);
+        if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    // 4. Set uniforms (view, projection, light, material - already set in draw())
-    // No need to set model uniform here, it's handled by instance attributes
+// Frustum culling over the packed stroke bounds. Fills 'visibleStrokes' with stroke indices.
+void Painter::collectVisibleStrokes(const glm::mat4& viewProjection, const std::vector<uint32_t>* candidates) {
+    PROFILE_SCOPE("Painter::collectVisibleStrokes");
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+
+    const std::vector<glm::vec3>& boundsMin = strokes.getBoundsMin();
+    const std::vector<glm::vec3>& boundsMax = strokes.getBoundsMax();
+    const std::vector<float>& sizes = strokes.getSizes();
+
+    visibleStrokes.clear();
+    size_t count = candidates ? candidates->size() : strokes.size();
+    for (size_t k = 0; k < count; ++k) {
+        uint32_t i = candidates ? (*candidates)[k] : static_cast<uint32_t>(k);
+        // Pad by the largest extent any style draws around a control point (cube/sphere dabs)
+        glm::vec3 pad(sizes[i] * 0.1f);
+        if (boxInFrustum(planes, boundsMin[i] - pad, boundsMax[i] + pad)) visibleStrokes.push_back(i);
+    }
+}
 
-    // 5. Draw instanced
-    if (stroke.style == CUBE) { // Cube uses glDrawArrays
-        glDrawArraysInstanced(GL_TRIANGLES, 0, indexCount, stroke.points.size());
+// Brings the chunk grid up to date and rebakes the chunks whose strokes changed, a few per
+// frame once the scene is idle (or has piled up too many unbaked strokes). Until then their
+// new strokes are drawn one by one, so adding, undoing or redoing a stroke never waits on a bake.
+void Painter::updateChunks(bool flush) {
+    PROFILE_SCOPE("Painter::updateChunks");
+    auto now = std::chrono::steady_clock::now();
+    if (chunkGrid.sync(strokes) > 0) lastChunkEdit = now;
+
+    std::vector<StrokeChunkGrid::Chunk>& chunks = chunkGrid.getChunks();
+    std::vector<uint32_t> behind;
+    size_t unbaked = 0;
+    for (uint32_t c = 0; c < chunks.size(); ++c) {
+        if (!chunks[c].needsRebake()) continue;
+        behind.push_back(c);
+        unbaked += chunks[c].pendingCount();
     }
-    else if (stroke.style == SPHERE) { // Sphere uses glDrawElements
-        // Ensure sphere EBO is bound within its VAO setup
-        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, stroke.points.size());
+    if (behind.empty()) return;
+    bool idle = !drawing && now - lastChunkEdit >= ChunkIdleDelay;
+    bool bakeNow = flush || idle || unbaked > ChunkUnbakedLimit;
+    // Most unbaked strokes first; emptied chunks cost nothing and go first
+    std::sort(behind.begin(), behind.end(), [&chunks](uint32_t a, uint32_t b) {
+        if (chunks[a].members.empty() != chunks[b].members.empty()) return chunks[a].members.empty();
+        return chunks[a].pendingCount() > chunks[b].pendingCount();
+    });
+
+    size_t rebuilt = 0;
+    float rebuildMs = 0.0f;
+    for (uint32_t c : behind) {
+        StrokeChunkGrid::Chunk& chunk = chunks[c];
+        if (chunk.members.empty()) {
+            StrokeChunkGrid::markBaked(chunk, StrokeRef());
+            rebuilt++;
+            continue;
+        }
+        if (!bakeNow || (!flush && rebuildMs >= ChunkRebakeBudgetMs)) break;
+        PROFILE_SCOPE("Chunk rebuild");
+        auto start = std::chrono::steady_clock::now();
+        StrokeChunkGrid::markBaked(chunk, buildBatchPayload(chunk.members.data(), chunk.members.size()));
+        chunk.lastRebuildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        rebuilt++;
+        rebuildMs += chunk.lastRebuildMs;
+        renderStats.maxRebuildMs = std::max(renderStats.maxRebuildMs, chunk.lastRebuildMs);
     }
+    if (rebuilt == 0) return;
+    renderStats.chunksRebuilt = rebuilt;
+    renderStats.lastRebuildMs = rebuildMs;
+    gpuCacheDirty = true; // Replaced chunk batches leave their old meshes behind
+}
 
+void Painter::flushChunks() {
+    if (chunkedRendering) updateChunks(true);
+}
 
-    glBindVertexArray(0);
+// Draws every chunk batch inside the frustum; one batch per chunk regardless of stroke count
+void Painter::drawChunks(const glm::mat4& viewProjection) {
+    PROFILE_SCOPE("Painter::drawChunks");
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+
+    // Batch VAOs read the identity instance uploaded once in the constructor
+    renderStats.visibleChunks = 0;
+    for (const StrokeChunkGrid::Chunk& chunk : chunkGrid.getChunks()) {
+        if (!chunk.batch || chunk.stale) continue;
+        if (!boxInFrustum(planes, chunk.batch->boundsMin, chunk.batch->boundsMax)) continue;
+        renderStats.visibleChunks++;
+        drawBatch(chunk.batch, 1);
+    }
 }
 
 
@@ -673,74 +1294,145 @@ void Painter::setBrushSize(float size) {
 }
 
 int Painter::getStrokeCount() const {
-    return strokes.size(); // Don't count the current stroke being drawn
+    return static_cast<int>(strokes.size()); // Don't count the current stroke being drawn
 }
 
 void Painter::removeLastPoint() {
     if (drawing && !currentStroke.points.empty()) {
+        currentStroke.pointSum -= glm::dvec3(currentStroke.points.back());
         currentStroke.points.pop_back();
         // Need to regenerate mesh if it's TUBE style and we want accurate preview
     }
 }
 
-// Scale/Translate affect control points. Mesh needs regenerating for tubes.
+// Scale/Translate/Rotate only update the stroke transform; control points (and any mesh
+// generated from them) stay untouched until bakeCurrentStrokeTransform is called.
 void Painter::scaleCurrentStroke(float scaleFactor) {
+    applyCurrentStrokeEdit(glm::scale(glm::mat4(1.0f), glm::vec3(scaleFactor)));
+}
+
+void Painter::translateCurrentStroke(const glm::vec3& translation) {
     if (drawing && !currentStroke.points.empty()) {
-        glm::vec3 center(0.0f);
-        for (const auto& p : currentStroke.points)
-            center += p;
-        center /= currentStroke.points.size();
-        for (auto& p : currentStroke.points)
-            p = center + (p - center) * scaleFactor;
-        // Need to regenerate mesh if it's TUBE style and we want accurate preview
+        currentStroke.transform = glm::translate(glm::mat4(1.0f), translation) * currentStroke.transform;
+        currentStroke.inverseTransform = glm::inverse(currentStroke.transform);
     }
 }
 
-void Painter::translateCurrentStroke(const glm::vec3& translation) {
+void Painter::rotateCurrentStroke(float angleRadians, const glm::vec3& axis) {
+    applyCurrentStrokeEdit(glm::rotate(glm::mat4(1.0f), angleRadians, glm::normalize(axis)));
+}
+
+void Painter::applyCurrentStrokeEdit(const glm::mat4& edit) {
     if (drawing && !currentStroke.points.empty()) {
-        for (auto& p : currentStroke.points)
-            p += translation;
-        // Need to regenerate mesh if it's TUBE style and we want accurate preview
+        glm::vec3 localCenter = glm::vec3(currentStroke.pointSum / static_cast<double>(currentStroke.points.size()));
+        glm::vec3 center = glm::vec3(currentStroke.transform * glm::vec4(localCenter, 1.0f));
+        currentStroke.transform = glm::translate(glm::mat4(1.0f), center) * edit *
+            glm::translate(glm::mat4(1.0f), -center) * currentStroke.transform;
+        currentStroke.inverseTransform = glm::inverse(currentStroke.transform);
+    }
+}
+
+void Painter::bakeCurrentStrokeTransform() {
+    if (drawing && !currentStroke.points.empty()) {
+        currentStroke.pointSum = glm::dvec3(0.0);
+        for (auto& p : currentStroke.points) {
+            p = glm::vec3(currentStroke.transform * glm::vec4(p, 1.0f));
+            currentStroke.pointSum += glm::dvec3(p);
+        }
+        currentStroke.transform = glm::mat4(1.0f);
+        currentStroke.inverseTransform = glm::mat4(1.0f);
     }
 }
 
 void Painter::duplicateLastStroke() {
+    duplicateLastStroke(glm::mat4(1.0f));
+}
+
+void Painter::duplicateLastStroke(const glm::mat4& offset) {
     if (!strokes.empty()) {
-        strokes.push_back(strokes.back());
-        // Ensure deep copy if necessary (vectors are copied by value here)
+        // The copy shares the original's payload (and its GPU mesh): no geometry is copied,
+        // and all copies are drawn with one instanced call
+        strokes.duplicate(static_cast<uint32_t>(strokes.size() - 1), offset);
+        history.recordAdd();
+        journalAppend(StrokeJournal::Duplicate, &offset[0][0], sizeof(glm::mat4));
+        gpuCacheDirty = true;
     }
 }
 
 void Painter::mergeAllStrokes() {
-    if (strokes.size() < 2) return; // Need at least two strokes to merge
-
-    Stroke merged;
     // Use properties of the first stroke as base? Or current brush? Let's use current brush.
-    merged.ambientColor = brushAmbientColor;
-    merged.diffuseColor = brushDiffuseColor;
-    merged.specularColor = brushSpecularColor;
-    merged.shininess = brushShininess;
-    merged.size = brushSize;
-    merged.style = currentDrawStyle; // Merged stroke gets the current style? Or maybe FREEHAND?
+    StrokeMaterial material;
+    material.ambientColor = brushAmbientColor;
+    material.diffuseColor = brushDiffuseColor;
+    material.specularColor = brushSpecularColor;
+    material.shininess = brushShininess;
+    if (!mergeStrokes(material, brushSize, currentDrawStyle)) return;
+
+    // The brush may have changed by the time this is replayed, so record what was used
+    std::vector<uint8_t> record(sizeof(StrokeMaterial) + sizeof(float) + 1);
+    std::memcpy(record.data(), &material, sizeof(StrokeMaterial));
+    std::memcpy(record.data() + sizeof(StrokeMaterial), &brushSize, sizeof(float));
+    record.back() = static_cast<uint8_t>(currentDrawStyle);
+    journalAppend(StrokeJournal::Merge, record.data(), record.size());
+}
+
+bool Painter::mergeStrokes(const StrokeMaterial& material, float size, DrawStyle style) {
+    if (strokes.size() < 2) return false; // Need at least two strokes to merge
 
-    // Collect all control points
-    for (const auto& stroke : strokes) {
-        merged.points.insert(merged.points.end(), stroke.points.begin(), stroke.points.end());
+    Stroke merged;
+    merged.ambientColor = material.ambientColor;
+    merged.diffuseColor = material.diffuseColor;
+    merged.specularColor = material.specularColor;
+    merged.shininess = material.shininess;
+    merged.size = size;
+    merged.style = style; // Merged stroke gets the current style? Or maybe FREEHAND?
+
+    // Collect all control points (in world space, copies may be transformed)
+    for (uint32_t i = 0; i < strokes.size(); ++i) {
+        const glm::mat4& transform = strokes.transform(i);
+        for (uint32_t p = 0; p < strokes.pointCount(i); ++p) {
+            merged.points.push_back(glm::vec3(transform * glm::vec4(strokes.points(i)[p], 1.0f)));
+        }
     }
 
-    // Regenerate geometry if needed for the merged stroke's style
-    if (merged.style == TUBE) {
-        generateTubeMesh(merged);
+    // Move the originals into the history so the merge can be undone
+    std::vector<StrokeRecord> removed(strokes.size());
+    for (size_t i = removed.size(); i-- > 0;) {
+        removed[i] = strokes.takeBack();
     }
+    storeStroke(merged); // Regenerates geometry if needed for the merged stroke's style
+    history.recordReplace(std::move(removed), 1);
+    gpuCacheDirty = true;
+    return true;
+}
 
-    strokes.clear();
-    strokes.push_back(merged);
-    undoneStrokes.clear(); // Cannot undo a merge easily
+
+// Static batching: the scene looks the same afterwards but draws in one call per primitive
+// range instead of one per stroke. Undo brings the individual strokes back.
+void Painter::bakeAllStrokes() {
+    if (strokes.size() < 2) return; // Nothing to gain from baking a single stroke
+
+    std::vector<uint32_t> members(strokes.size());
+    for (uint32_t i = 0; i < members.size(); ++i) members[i] = i;
+    StrokeRef batch = buildBatchPayload(members.data(), members.size());
+    if (!batch) return;
+
+    std::vector<StrokeRecord> removed(strokes.size());
+    for (size_t i = removed.size(); i-- > 0;) {
+        removed[i] = strokes.takeBack();
+    }
+    StrokeMaterial material = batch->materials[0]; // Unused when drawing; keeps the store's table tidy
+    strokes.add(std::move(batch), material, 0.0f, static_cast<uint8_t>(BATCH));
+    history.recordReplace(std::move(removed), 1);
+    journalAppend(StrokeJournal::Bake);
+    gpuCacheDirty = true;
 }
 
 
 void Painter::clearUndoneStrokes() {
-    undoneStrokes.clear();
+    history.clearRedo();
+    journalAppend(StrokeJournal::ClearUndone);
+    gpuCacheDirty = true;
 }
 
 void Painter::reverseCurrentStroke() {
@@ -764,4 +1456,776 @@ void Painter::setDrawStyle(DrawStyle style) {
 
 Painter::DrawStyle Painter::getDrawStyle() const {
     return currentDrawStyle;
+}
+
+bool Painter::getSceneBounds(glm::vec3& outMin, glm::vec3& outMax) const {
+    if (strokes.empty()) return false;
+    const std::vector<glm::vec3>& boundsMin = strokes.getBoundsMin();
+    const std::vector<glm::vec3>& boundsMax = strokes.getBoundsMax();
+    outMin = boundsMin[0];
+    outMax = boundsMax[0];
+    for (size_t i = 1; i < strokes.size(); ++i) {
+        outMin = glm::min(outMin, boundsMin[i]);
+        outMax = glm::max(outMax, boundsMax[i]);
+    }
+    return true;
+}
+
+StrokeArena::Stats Painter::getMemoryStats() const {
+    return strokeArena.getStats();
+}
+
+void Painter::setHistoryMemoryBudget(size_t bytes) {
+    history.setMemoryBudget(bytes);
+    gpuCacheDirty = true; // Evicted commands may have held the last references
+}
+
+void Painter::setChunkedRendering(bool enabled) {
+    chunkedRendering = enabled;
+    unbakedStrokes.clear();
+    if (!enabled) {
+        // Drop the chunk batches; they are rebuilt from scratch when re-enabled
+        chunkGrid.clear();
+    }
+    gpuCacheDirty = true; // Per-stroke meshes go once batches cover their strokes
+}
+
+bool Painter::getChunkedRendering() const {
+    return chunkedRendering;
+}
+
+void Painter::setChunkSize(float size) {
+    chunkGrid.setCellSize(size);
+    gpuCacheDirty = true;
+}
+
+float Painter::getChunkSize() const {
+    return chunkGrid.getCellSize();
+}
+
+Painter::RenderStats Painter::getRenderStats() const {
+    RenderStats stats = renderStats;
+    stats.chunkCount = 0;
+    for (const StrokeChunkGrid::Chunk& chunk : chunkGrid.getChunks()) {
+        if (chunk.batch && !chunk.stale) stats.chunkCount++;
+    }
+    return stats;
+}
+
+bool Painter::saveScene(const std::string& path, bool includeMeshes, bool packPoints) {
+    SceneFile::SaveOptions options;
+    options.includeMeshes = includeMeshes;
+    options.pointStep = packPoints ? PointGridStep : 0.0f;
+    SceneFile::SaveStats saveStats;
+    std::string error;
+    if (!SceneFile::save(path, strokes, options, &saveStats, &error)) {
+        logger.addLog("[ERROR] Scene save failed: " + error);
+        return false;
+    }
+    logger.addLog("Saved scene: " + path + " (" + std::to_string(strokes.size()) + " strokes)");
+    // The file now holds everything journaled so far, so replaying it is enough (while a stream
+    // runs, the journal keeps starting from the streamed file instead). A replay starts with
+    // an empty history, so the live one goes too: an undo past the save couldn't be replayed.
+    if (journal.isOpen() && !sceneStream.isActive()) {
+        history.clear();
+        gpuCacheDirty = true;
+        journal.reset();
+        uint64_t digest[2] = { saveStats.bytes, saveStats.contentHash }; // Hashed while writing
+        journalFile(StrokeJournal::LoadScene, {}, path, digest);
+    }
+    return true;
+}
+
+Painter::CodecBenchmark Painter::benchmarkPointCodec() {
+    // Each shared payload once; batch points are scattered across strokes and don't delta well
+    std::vector<PointCodec::Stream> streams;
+    std::unordered_map<const StrokePayload*, bool> seen;
+    for (uint32_t i = 0; i < strokes.size(); ++i) {
+        const StrokePayload* payload = strokes.payload(i).get();
+        if (payload->isBatch() || !seen.emplace(payload, true).second) continue;
+        streams.push_back({ payload->points, payload->pointCount });
+    }
+
+    CodecBenchmark result;
+    result.varint = PointCodec::benchmark(streams.data(), streams.size(), PointGridStep, PointCodec::Varint);
+    result.bitPacked = PointCodec::benchmark(streams.data(), streams.size(), PointGridStep, PointCodec::BitPacked);
+    for (const PointCodec::Stats* stats : { &result.varint, &result.bitPacked }) {
+        char message[256];
+        snprintf(message, sizeof(message), "Point codec (%s): %zu points, %.2fx, encode %.0f MB/s, decode %.0f MB/s, max error %.5f",
+            stats == &result.varint ? "varint" : "bit-packed", stats->points, stats->ratio(),
+            stats->encodeMBps(), stats->decodeMBps(), stats->maxError);
+        logger.addLog(message);
+    }
+    return result;
+}
+
+// --- Mesh Export ---
+
+bool Painter::exportMesh(const std::string& path, MeshExport::Format format, const glm::vec3& viewDirection, MeshExport::Stats* stats) {
+    // Material table: the scene's, then each batch's own table
+    MeshExport::Source source;
+    source.strokeCount = strokes.size();
+    source.materials = strokes.getMaterials();
+    std::unordered_map<const StrokePayload*, uint32_t> batchTables;
+    for (uint32_t i = 0; i < strokes.size(); ++i) {
+        const StrokePayload& payload = *strokes.payload(i);
+        if (payload.isBatch() && batchTables.emplace(&payload, static_cast<uint32_t>(source.materials.size())).second) {
+            source.materials.insert(source.materials.end(), payload.materials, payload.materials + payload.materialCount);
+        }
+    }
+    source.measure = [this](size_t stroke, size_t& vertexCount, size_t& triangleCount) {
+        measureExportStroke(static_cast<uint32_t>(stroke), vertexCount, triangleCount);
+    };
+    source.build = [this, &batchTables, viewDirection](size_t stroke, MeshExport::StrokeMesh& out) {
+        const StrokePayload* payload = strokes.payload(static_cast<uint32_t>(stroke)).get();
+        auto table = batchTables.find(payload);
+        buildExportStroke(static_cast<uint32_t>(stroke), viewDirection, table == batchTables.end() ? 0 : table->second, out);
+    };
+
+    MeshExport::Stats exportStats;
+    std::string error;
+    if (!MeshExport::write(path, format, source, &exportStats, &error)) {
+        logger.addLog("[ERROR] Export failed: " + error);
+        return false;
+    }
+    if (stats) *stats = exportStats;
+    char message[256];
+    snprintf(message, sizeof(message), "Exported %s: %zu triangles, %.1f MB in %.2f s (%.1f MB/s)",
+        path.c_str(), exportStats.triangles, exportStats.bytes / (1024.0 * 1024.0), exportStats.seconds,
+        exportStats.megabytesPerSecond());
+    logger.addLog(message);
+    return true;
+}
+
+bool Painter::exportGlb(const std::string& path, GltfExport::Stats* stats) {
+    GltfExport::Scene scene;
+    scene.materials = strokes.getMaterials();
+    scene.cube.vertices = cubeMesh.data();
+    scene.cube.vertexCount = cubeMesh.size();
+    scene.sphere.vertices = sphereMesh.data();
+    scene.sphere.vertexCount = sphereMesh.size();
+    scene.sphere.indices = sphereMeshIndices.data();
+    scene.sphere.indexCount = sphereMeshIndices.size();
+
+    // Strokes sharing a payload (duplicates) share one mesh; dabs share the base meshes
+    std::map<std::pair<int, uint32_t>, size_t> dabGroups;
+    std::map<std::pair<const StrokePayload*, uint32_t>, size_t> payloadGroups;
+    std::unordered_map<const StrokePayload*, uint32_t> batchTables;
+    for (uint32_t i = 0; i < strokes.size(); ++i) {
+        const StrokePayload& payload = *strokes.payload(i);
+        const glm::mat4& transform = strokes.transform(i);
+        DrawStyle style = static_cast<DrawStyle>(strokes.style(i));
+        uint32_t material = strokes.materialIndex(i);
+
+        if (style == CUBE || style == SPHERE) {
+            GltfExport::Scene::Base base = style == CUBE ? GltfExport::Scene::Cube : GltfExport::Scene::Sphere;
+            auto found = dabGroups.emplace(std::make_pair(int(base), material), scene.dabs.size());
+            if (found.second) scene.dabs.push_back({ base, material, {} });
+            std::vector<glm::mat4>& transforms = scene.dabs[found.first->second].transforms;
+            float scale = strokes.size(i) * 0.1f;
+            for (uint32_t p = 0; p < payload.pointCount; ++p) {
+                transforms.push_back(glm::scale(glm::translate(transform, payload.points[p]), glm::vec3(scale)));
+            }
+            continue;
+        }
+
+        GltfExport::Scene::Kind kind = style == TUBE ? GltfExport::Scene::Triangles :
+            style == BATCH ? GltfExport::Scene::Batch :
+            style == POINTS ? GltfExport::Scene::Points : GltfExport::Scene::LineStrip;
+        if (kind == GltfExport::Scene::Batch) {
+            auto table = batchTables.emplace(&payload, static_cast<uint32_t>(scene.materials.size()));
+            if (table.second) scene.materials.insert(scene.materials.end(), payload.materials, payload.materials + payload.materialCount);
+            material = table.first->second;
+        }
+        auto found = payloadGroups.emplace(std::make_pair(&payload, material), scene.payloads.size());
+        if (found.second) scene.payloads.push_back({ &payload, kind, material, {} });
+        scene.payloads[found.first->second].transforms.push_back(transform);
+    }
+
+    GltfExport::Stats exportStats;
+    std::string error;
+    if (!GltfExport::write(path, scene, &exportStats, &error)) {
+        logger.addLog("[ERROR] Export failed: " + error);
+        return false;
+    }
+    if (stats) *stats = exportStats;
+    char message[256];
+    snprintf(message, sizeof(message), "Exported %s: %zu meshes, %zu nodes, %zu instances, %.1f MB in %.2f s",
+        path.c_str(), exportStats.meshes, exportStats.nodes, exportStats.instances,
+        exportStats.bytes / (1024.0 * 1024.0), exportStats.seconds);
+    logger.addLog(message);
+    return true;
+}
+
+void Painter::measureExportStroke(uint32_t index, size_t& vertexCount, size_t& triangleCount) const {
+    const StrokePayload& payload = *strokes.payload(index);
+    size_t points = payload.pointCount;
+    vertexCount = 0;
+    triangleCount = 0;
+    switch (static_cast<DrawStyle>(strokes.style(index))) {
+    case FREEHAND:
+        if (points >= 2) {
+            vertexCount = points * 2;
+            triangleCount = (points - 1) * 2;
+        }
+        break;
+    case POINTS:
+        vertexCount = points * 4;
+        triangleCount = points * 2;
+        break;
+    case CUBE:
+        vertexCount = points * cubeMesh.size();
+        triangleCount = points * (cubeMesh.size() / 3);
+        break;
+    case SPHERE:
+        vertexCount = points * sphereMesh.size();
+        triangleCount = points * (sphereMeshIndices.size() / 3);
+        break;
+    case TUBE:
+        vertexCount = payload.vertexCount;
+        triangleCount = payload.indexCount / 3;
+        break;
+    case BATCH:
+        vertexCount = payload.vertexCount;
+        for (uint32_t r = 0; r < payload.rangeCount; ++r) {
+            const StrokeBatchRange& range = payload.ranges[r];
+            size_t quads = range.primitive == StrokeBatchRange::Lines ? range.indexCount / 2 :
+                range.primitive == StrokeBatchRange::Points ? range.indexCount : 0;
+            vertexCount += quads * 4;
+            triangleCount += range.primitive == StrokeBatchRange::Triangles ? range.indexCount / 3 : quads * 2;
+        }
+        break;
+    }
+}
+
+void Painter::buildExportStroke(uint32_t index, const glm::vec3& viewDirection, uint32_t tableOffset, MeshExport::StrokeMesh& out) const {
+    const StrokePayload& payload = *strokes.payload(index);
+    const glm::mat4& transform = strokes.transform(index);
+    float size = strokes.size(index);
+    DrawStyle style = static_cast<DrawStyle>(strokes.style(index));
+
+    // Camera-facing basis for ribbons and quads
+    glm::vec3 forward = glm::normalize(viewDirection);
+    glm::vec3 right = glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f));
+    right = glm::length(right) > 1e-4f ? glm::normalize(right) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 up = glm::cross(right, forward);
+    glm::vec3 facing = -forward;
+
+    auto pushVertex = [&out](const glm::mat4& model, const StrokeVertex& v) {
+        out.positions.push_back(glm::vec3(model * glm::vec4(v.position, 1.0f)));
+        glm::vec3 normal = glm::mat3(model) * v.normal; // Uniform scale only, like the shader
+        float length = glm::length(normal);
+        out.normals.push_back(length > 0.0f ? normal / length : normal);
+    };
+    auto pushQuad = [&out, &facing](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+        uint32_t base = static_cast<uint32_t>(out.positions.size());
+        for (const glm::vec3* corner : { &a, &b, &c, &d }) {
+            out.positions.push_back(*corner);
+            out.normals.push_back(facing);
+        }
+        const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for (uint32_t i : quad) out.indices.push_back(base + i);
+    };
+    auto pushBillboard = [&](const glm::vec3& center, float width) {
+        glm::vec3 x = right * (width * 0.5f);
+        glm::vec3 y = up * (width * 0.5f);
+        pushQuad(center - x - y, center + x - y, center + x + y, center - x + y);
+    };
+    auto pushSegment = [&](const glm::vec3& a, const glm::vec3& b, float width) {
+        glm::vec3 side = glm::cross(b - a, forward);
+        float length = glm::length(side);
+        side = length > 0.0f ? side * (width * 0.5f / length) : right * (width * 0.5f);
+        pushQuad(a - side, b - side, b + side, a + side);
+    };
+
+    if (style == BATCH) {
+        // Triangles and expanded lines/points, then one part per material
+        std::map<uint32_t, std::vector<uint32_t>> byMaterial;
+        for (uint32_t v = 0; v < payload.vertexCount; ++v) {
+            pushVertex(transform, payload.vertices[v]);
+        }
+        for (uint32_t r = 0; r < payload.rangeCount; ++r) {
+            const StrokeBatchRange& range = payload.ranges[r];
+            const unsigned int* indices = payload.indices + range.firstIndex;
+            uint32_t step = range.primitive == StrokeBatchRange::Triangles ? 3 : range.primitive == StrokeBatchRange::Lines ? 2 : 1;
+            for (uint32_t i = 0; i + step <= range.indexCount; i += step) {
+                size_t first = out.indices.size();
+                if (range.primitive == StrokeBatchRange::Triangles) {
+                    out.indices.insert(out.indices.end(), indices + i, indices + i + 3);
+                }
+                else if (range.primitive == StrokeBatchRange::Lines) {
+                    pushSegment(out.positions[indices[i]], out.positions[indices[i + 1]], range.size * ExportPixelSize);
+                }
+                else {
+                    pushBillboard(out.positions[indices[i]], range.size * ExportPixelSize);
+                }
+                std::vector<uint32_t>& target = byMaterial[tableOffset + payload.materialIds[indices[i]]];
+                target.insert(target.end(), out.indices.begin() + first, out.indices.end());
+                out.indices.resize(first);
+            }
+        }
+        for (const auto& group : byMaterial) {
+            MeshExport::StrokeMesh::Part part = { group.first, static_cast<uint32_t>(out.indices.size()), static_cast<uint32_t>(group.second.size()) };
+            out.parts.push_back(part);
+            out.indices.insert(out.indices.end(), group.second.begin(), group.second.end());
+        }
+        return;
+    }
+
+    switch (style) {
+    case FREEHAND: {
+        // Ribbon along the polyline, mitred by using the neighbours' direction at each point
+        if (payload.pointCount < 2) break;
+        float halfWidth = size * ExportPixelSize * 0.5f;
+        std::vector<glm::vec3> world(payload.pointCount);
+        for (uint32_t p = 0; p < payload.pointCount; ++p) {
+            world[p] = glm::vec3(transform * glm::vec4(payload.points[p], 1.0f));
+        }
+        for (uint32_t p = 0; p < payload.pointCount; ++p) {
+            glm::vec3 tangent = world[std::min(p + 1, payload.pointCount - 1)] - world[p > 0 ? p - 1 : 0];
+            glm::vec3 side = glm::cross(tangent, forward);
+            float length = glm::length(side);
+            side = length > 0.0f ? side * (halfWidth / length) : right * halfWidth;
+            out.positions.push_back(world[p] - side);
+            out.positions.push_back(world[p] + side);
+            out.normals.push_back(facing);
+            out.normals.push_back(facing);
+            if (p > 0) {
+                uint32_t base = (p - 1) * 2;
+                const uint32_t quad[6] = { base, base + 2, base + 3, base, base + 3, base + 1 };
+                out.indices.insert(out.indices.end(), quad, quad + 6);
+            }
+        }
+        break;
+    }
+    case POINTS:
+        for (uint32_t p = 0; p < payload.pointCount; ++p) {
+            pushBillboard(glm::vec3(transform * glm::vec4(payload.points[p], 1.0f)), size * ExportPixelSize);
+        }
+        break;
+    case CUBE:
+    case SPHERE: {
+        // Same placement as the instanced dabs
+        const std::vector<Vertex>& mesh = style == CUBE ? cubeMesh : sphereMesh;
+        for (uint32_t p = 0; p < payload.pointCount; ++p) {
+            glm::mat4 model = glm::translate(transform, payload.points[p]);
+            model = glm::scale(model, glm::vec3(size * 0.1f));
+            uint32_t base = static_cast<uint32_t>(out.positions.size());
+            for (const Vertex& v : mesh) {
+                pushVertex(model, v);
+            }
+            if (style == CUBE) {
+                for (uint32_t i = 0; i + 2 < mesh.size(); i += 3) {
+                    out.indices.push_back(base + i);
+                    out.indices.push_back(base + i + 1);
+                    out.indices.push_back(base + i + 2);
+                }
+            }
+            else {
+                for (unsigned int i : sphereMeshIndices) out.indices.push_back(base + i);
+            }
+        }
+        break;
+    }
+    case TUBE:
+        for (uint32_t v = 0; v < payload.vertexCount; ++v) {
+            pushVertex(transform, payload.vertices[v]);
+        }
+        out.indices.insert(out.indices.end(), payload.indices, payload.indices + payload.indexCount);
+        break;
+    case BATCH:
+        break;
+    }
+    MeshExport::StrokeMesh::Part part = { strokes.materialIndex(index), 0, static_cast<uint32_t>(out.indices.size()) };
+    out.parts.push_back(part);
+}
+
+bool Painter::loadScene(const std::string& path) {
+    // Load into a fresh store so a bad file leaves the current scene untouched
+    StrokeStore loaded;
+    SceneFile::LoadStats stats;
+    std::string error;
+    bool ok = SceneFile::load(path, strokeArena, loaded,
+        [this](const glm::vec3* points, size_t count, uint8_t style, float size) {
+            return buildPayload(points, count, static_cast<DrawStyle>(style), size);
+        }, &stats, &error);
+    if (!ok) {
+        logger.addLog("[ERROR] Scene load failed: " + error);
+        return false;
+    }
+
+    sceneStream.cancel();
+    drawing = false;
+    currentStroke.points.clear();
+    strokes = std::move(loaded);
+    history.clear();
+    chunkGrid.clear();
+    gpuCacheDirty = true;
+    // The file holds the scene; the journal only needs to say which one
+    journal.reset();
+    heldJournalRecords.clear();
+    journalFile(StrokeJournal::LoadScene, {}, path);
+
+    char message[256];
+    snprintf(message, sizeof(message), "Loaded scene: %s (%zu strokes, %.1f MB in %.1f ms, %zu meshes rebuilt)",
+        path.c_str(), stats.strokes, stats.bytes / (1024.0 * 1024.0), stats.seconds * 1000.0, stats.rebuiltMeshes);
+    logger.addLog(message);
+    return true;
+}
+
+bool Painter::streamScene(const std::string& path) {
+    std::string error;
+    bool ok = sceneStream.start(path,
+        [](const glm::vec3* points, size_t count, uint8_t style, float size,
+           std::vector<StrokeVertex>& vertices, std::vector<unsigned int>& indices) {
+            // Same mesh buildPayload makes, minus the arena allocation (workers can't touch it)
+            if (style != TUBE || count < 2) return;
+            vertices.resize(count * TubeSegments);
+            indices.resize((count - 1) * TubeSegments * 6);
+            generateTubeMesh(points, count, size, vertices.data(), indices.data());
+        }, &error);
+    if (!ok) {
+        logger.addLog("[ERROR] Scene stream failed: " + error);
+        return false;
+    }
+
+    drawing = false;
+    currentStroke.points.clear();
+    strokes.clear();
+    history.clear();
+    chunkGrid.clear();
+    gpuCacheDirty = true;
+    // Journaled when the stream is over (the worker hashes the file last)
+    journal.reset();
+    heldJournalRecords.clear();
+    streamPath = path;
+    logger.addLog("Streaming scene: " + path);
+    return true;
+}
+
+void Painter::cancelSceneStream() {
+    if (!sceneStream.isActive()) return;
+    sceneStream.cancel();
+    history.clear();
+    journalStreamEnd();
+    logger.addLog("Scene stream cancelled (" + std::to_string(strokes.size()) + " strokes loaded)");
+}
+
+SceneStreamLoader::Progress Painter::getSceneStreamProgress() const {
+    return sceneStream.getProgress();
+}
+
+void Painter::pumpSceneStream() {
+    PROFILE_SCOPE("Painter::pumpSceneStream");
+    // A few ms per frame keeps the UI responsive however big the file is
+    sceneStream.deliver(strokeArena, strokes, 4.0);
+    if (sceneStream.isActive()) return;
+
+    // Strokes added while streaming never went through the history
+    history.clear();
+    journalStreamEnd();
+    SceneStreamLoader::Progress progress = sceneStream.getProgress();
+    if (progress.failed) {
+        logger.addLog("[ERROR] Scene stream failed: " + progress.error);
+        return;
+    }
+    char message[256];
+    snprintf(message, sizeof(message), "Streamed scene: %zu strokes in %.2f s (%.1f MB/s, %.0f strokes/s)",
+        progress.strokesDelivered, progress.seconds, progress.bytesPerSecond / (1024.0 * 1024.0), progress.strokesPerSecond);
+    logger.addLog(message);
+}
+
+// --- Point Import ---
+
+bool Painter::importPoints(const std::string& path, DrawStyle style, PointImport::Stats* stats) {
+    if (style != POINTS && style != TUBE) {
+        logger.addLog("[ERROR] Point import needs the Points or Tube style");
+        return false;
+    }
+    StrokeMaterial material;
+    material.ambientColor = brushAmbientColor;
+    material.diffuseColor = brushDiffuseColor;
+    material.specularColor = brushSpecularColor;
+    material.shininess = brushShininess;
+    if (!importPointStrokes(path, material, brushSize, style, stats)) return false;
+
+    // Journal the file, not its points: like LoadScene, recovery reads it again
+    if (journal.isOpen()) {
+        std::vector<uint8_t> record(sizeof(StrokeMaterial) + sizeof(float) + 1);
+        std::memcpy(record.data(), &material, sizeof(StrokeMaterial));
+        std::memcpy(record.data() + sizeof(StrokeMaterial), &brushSize, sizeof(float));
+        record.back() = static_cast<uint8_t>(style);
+        journalFile(StrokeJournal::ImportPoints, std::move(record), path);
+    }
+    return true;
+}
+
+bool Painter::importPointStrokes(const std::string& path, const StrokeMaterial& material, float size, DrawStyle style, PointImport::Stats* stats) {
+    PointImport::Cloud cloud;
+    PointImport::Stats importStats;
+    std::string error;
+    if (!PointImport::load(path, cloud, &importStats, &error)) {
+        logger.addLog("[ERROR] Point import failed: " + error);
+        return false;
+    }
+    auto buildStart = std::chrono::steady_clock::now();
+
+    // Cut the polylines into strokes. Tube pieces overlap by a point so the tube stays closed.
+    struct Piece {
+        size_t first;
+        size_t count;
+    };
+    std::vector<Piece> pieces;
+    for (size_t line = 0; line < cloud.polylineCount(); ++line) {
+        size_t end = cloud.polylineEnd(line);
+        size_t first = cloud.polylineStarts[line];
+        if (style == TUBE && end - first < 2) continue;
+        while (first < end) {
+            size_t count = std::min(ImportStrokePoints, end - first);
+            pieces.push_back({ first, count });
+            if (first + count >= end) break;
+            first += style == TUBE ? count - 1 : count;
+        }
+    }
+
+    // Payloads are allocated here (the arena is main-thread only), then filled in parallel:
+    // tube meshes are most of the work
+    std::vector<std::unique_ptr<StrokePayloadBuilder>> builders(pieces.size());
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        size_t count = pieces[i].count;
+        bool tube = style == TUBE && count >= 2;
+        builders[i].reset(new StrokePayloadBuilder(strokeArena, count,
+            tube ? count * TubeSegments : 0, tube ? (count - 1) * TubeSegments * 6 : 0));
+    }
+    parallelFor(pieces.size(), [&](size_t i) {
+        const glm::vec3* points = cloud.points.data() + pieces[i].first;
+        size_t count = pieces[i].count;
+        std::copy_n(points, count, builders[i]->points());
+        if (style == TUBE && count >= 2) {
+            generateTubeMesh(points, count, size, builders[i]->vertices(), builders[i]->indices());
+        }
+    });
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        strokes.add(builders[i]->finish(), material, size, static_cast<uint8_t>(style), glm::mat4(1.0f));
+    }
+    builders.clear();
+    if (!pieces.empty()) history.recordAdd(static_cast<uint32_t>(pieces.size()));
+    double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+
+    if (stats) *stats = importStats;
+    char message[320];
+    snprintf(message, sizeof(message), "Imported %s: %zu points, %zu polylines as %zu strokes (%zu lines skipped); parsed %.1f MB in %.1f ms (%.2f M points/s), strokes built in %.1f ms",
+        path.c_str(), importStats.points, importStats.polylines, pieces.size(), importStats.skippedLines,
+        importStats.bytes / (1024.0 * 1024.0), importStats.parseSeconds * 1000.0, importStats.pointsPerSecond() / 1e6,
+        buildSeconds * 1000.0);
+    logger.addLog(message);
+    return true;
+}
+
+// --- Crash Recovery Journal ---
+
+namespace {
+    // Bounds-checked reads from a journal record
+    struct RecordReader {
+        const uint8_t* cursor;
+        const uint8_t* end;
+        template <typename T> bool read(T& value) {
+            if (static_cast<size_t>(end - cursor) < sizeof(T)) return false;
+            std::memcpy(&value, cursor, sizeof(T));
+            cursor += sizeof(T);
+            return true;
+        }
+    };
+}
+
+// The size, hash and path at the end of a LoadScene or ImportPoints record, if the file still matches
+static bool readJournaledFile(RecordReader& reader, std::string& path) {
+    uint64_t size, hash, currentSize, currentHash;
+    if (!reader.read(size) || !reader.read(hash)) {
+        logger.addLog("[ERROR] Journal replay stopped: file record without a digest");
+        return false;
+    }
+    path.assign(reinterpret_cast<const char*>(reader.cursor), reader.end - reader.cursor);
+    if (!fileDigest(path, currentSize, currentHash) || currentSize != size || currentHash != hash) {
+        logger.addLog("[ERROR] Journal replay stopped: " + path + " is missing or changed since it was journaled");
+        return false;
+    }
+    return true;
+}
+
+void Painter::journalAppend(StrokeJournal::RecordType type, const void* data, size_t size) {
+    if (!journal.isOpen()) return;
+    if (sceneStream.isActive()) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        heldJournalRecords.push_back({ type, std::vector<uint8_t>(bytes, bytes + size), std::string() });
+        return;
+    }
+    journal.append(type, data, size);
+}
+
+void Painter::journalFile(StrokeJournal::RecordType type, std::vector<uint8_t> record, const std::string& path, const uint64_t* digest) {
+    if (!journal.isOpen()) return;
+    if (!digest) {
+        if (sceneStream.isActive()) heldJournalRecords.push_back({ type, std::move(record), path });
+        else journal.appendFile(type, record.data(), record.size(), path);
+        return;
+    }
+    size_t offset = record.size();
+    record.resize(offset + 2 * sizeof(uint64_t));
+    std::memcpy(record.data() + offset, digest, 2 * sizeof(uint64_t));
+    record.insert(record.end(), path.begin(), path.end());
+    journalAppend(type, record.data(), record.size());
+}
+
+// Replay loads the whole file, cuts it back to what was delivered, then applies the edits made
+// while streaming (on top of the loaded strokes rather than between them). A stream that ran to
+// the end has hashed the file on its worker; otherwise the journal writer does.
+void Painter::journalStreamEnd() {
+    SceneStreamLoader::Progress progress = sceneStream.getProgress();
+    uint64_t digest[2] = { progress.bytesTotal, progress.contentHash };
+    journalFile(StrokeJournal::LoadScene, {}, streamPath, progress.hashed ? digest : nullptr);
+    if (progress.strokesDelivered < progress.strokesTotal) {
+        uint64_t delivered = progress.strokesDelivered;
+        journalAppend(StrokeJournal::StreamCancelled, &delivered, sizeof(delivered));
+    }
+    for (HeldRecord& record : heldJournalRecords) {
+        if (record.filePath.empty()) journalAppend(record.type, record.data.data(), record.data.size());
+        else journal.appendFile(record.type, record.data.data(), record.data.size(), record.filePath);
+    }
+    heldJournalRecords.clear();
+}
+
+void Painter::journalStroke(const Stroke& stroke) {
+    PROFILE_SCOPE("Painter::journalStroke");
+    if (!journal.isOpen()) return;
+    // Material, size, style, transform, point count, then the points packed with PointCodec
+    StrokeMaterial material;
+    material.ambientColor = stroke.ambientColor;
+    material.diffuseColor = stroke.diffuseColor;
+    material.specularColor = stroke.specularColor;
+    material.shininess = stroke.shininess;
+    uint8_t style = static_cast<uint8_t>(stroke.style);
+    uint32_t pointCount = static_cast<uint32_t>(stroke.points.size());
+
+    std::vector<uint8_t>& record = journalScratch;
+    record.resize(sizeof(StrokeMaterial) + sizeof(float) + 1 + sizeof(glm::mat4) + sizeof(uint32_t));
+    uint8_t* out = record.data();
+    std::memcpy(out, &material, sizeof(StrokeMaterial)); out += sizeof(StrokeMaterial);
+    std::memcpy(out, &stroke.size, sizeof(float)); out += sizeof(float);
+    *out++ = style;
+    std::memcpy(out, &stroke.transform[0][0], sizeof(glm::mat4)); out += sizeof(glm::mat4);
+    std::memcpy(out, &pointCount, sizeof(uint32_t));
+    PointCodec::encode(stroke.points.data(), stroke.points.size(), PointGridStep, record);
+    journalAppend(StrokeJournal::AddStroke, record.data(), record.size());
+}
+
+bool Painter::replayJournalRecord(StrokeJournal::RecordType type, const uint8_t* data, size_t size) {
+    RecordReader reader = { data, data + size };
+    switch (type) {
+    case StrokeJournal::AddStroke: {
+        StrokeMaterial material;
+        Stroke stroke;
+        uint8_t style;
+        uint32_t pointCount;
+        if (!reader.read(material) || !reader.read(stroke.size) || !reader.read(style) ||
+            !reader.read(stroke.transform) || !reader.read(pointCount) || style >= BATCH) {
+            return true;
+        }
+        stroke.points.resize(pointCount);
+        if (!PointCodec::decode(reader.cursor, reader.end - reader.cursor, pointCount, PointGridStep, stroke.points.data())) return true;
+        stroke.inverseTransform = glm::inverse(stroke.transform);
+        stroke.ambientColor = material.ambientColor;
+        stroke.diffuseColor = material.diffuseColor;
+        stroke.specularColor = material.specularColor;
+        stroke.shininess = material.shininess;
+        stroke.style = static_cast<DrawStyle>(style);
+        storeStroke(stroke);
+        history.recordAdd();
+        break;
+    }
+    case StrokeJournal::Undo:
+        history.undo(strokes);
+        break;
+    case StrokeJournal::Redo:
+        history.redo(strokes);
+        break;
+    case StrokeJournal::ClearUndone:
+        history.clearRedo();
+        break;
+    case StrokeJournal::Duplicate: {
+        glm::mat4 offset;
+        if (reader.read(offset)) duplicateLastStroke(offset);
+        break;
+    }
+    case StrokeJournal::Merge: {
+        StrokeMaterial material;
+        float mergedSize;
+        uint8_t style;
+        if (reader.read(material) && reader.read(mergedSize) && reader.read(style) && style < BATCH) {
+            mergeStrokes(material, mergedSize, static_cast<DrawStyle>(style));
+        }
+        break;
+    }
+    case StrokeJournal::Bake:
+        bakeAllStrokes();
+        break;
+    case StrokeJournal::LoadScene: {
+        std::string path;
+        return readJournaledFile(reader, path) && loadScene(path);
+    }
+    case StrokeJournal::ImportPoints: {
+        StrokeMaterial material;
+        float importSize;
+        uint8_t style;
+        std::string path;
+        if (!reader.read(material) || !reader.read(importSize) || !reader.read(style) || (style != POINTS && style != TUBE)) return true;
+        return readJournaledFile(reader, path) && importPointStrokes(path, material, importSize, static_cast<DrawStyle>(style), nullptr);
+    }
+    case StrokeJournal::StreamCancelled: {
+        uint64_t delivered;
+        if (!reader.read(delivered)) return true;
+        while (strokes.size() > delivered) strokes.popBack();
+        history.clear();
+        break;
+    }
+    }
+    return true;
+}
+
+bool Painter::openJournal(const std::string& path) {
+    // The journal isn't open while replaying, so replayed edits aren't journaled twice
+    auto start = std::chrono::steady_clock::now();
+    size_t replayed = 0;
+    std::string error, keptAside;
+    bool ok = journal.open(path, [this](StrokeJournal::RecordType type, const uint8_t* data, size_t size) {
+        return replayJournalRecord(type, data, size);
+    }, &replayed, &error, &keptAside);
+    gpuCacheDirty = true;
+    if (!keptAside.empty()) {
+        logger.addLog("[WARNING] The whole journal was kept as " + keptAside +
+            ": put the missing file back and rename it to " + path + " to recover the rest");
+    }
+    if (!ok) {
+        logger.addLog("[ERROR] " + error);
+        return false;
+    }
+    if (replayed > 0) {
+        char message[256];
+        snprintf(message, sizeof(message), "Recovered %zu strokes from %zu journal records in %.1f ms",
+            strokes.size(), replayed, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        logger.addLog(message);
+    }
+    return true;
+}
+
+void Painter::closeJournal() {
+    journal.discard();
+}
+
+StrokeJournal::Stats Painter::getJournalStats() const {
+    return journal.getStats();
+}
+
+StrokeHistory::Stats Painter::getHistoryStats() const {
+    return history.getStats();
 }
\ No newline at end of file
@@ -6,6 +6,19 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <string>
 #include <vector> 
+#include <unordered_map>
+#include <unordered_set>
+#include "StrokeStore.h"
+#include "StrokeHistory.h"
+#include "StrokeChunkGrid.h"
+#include "SceneStreamLoader.h"
+#include "StrokeJournal.h"
+#include "MeshExport.h"
+#include "GltfExport.h"
+#include "PointImport.h"
+#include "RenderDevice.h"
+#include <memory>
+#include <chrono>
 
 // Forward declaration
 class Camera;
@@ -13,9 +26,15 @@ class Camera;
 class Painter {
 public:
     // Added SPHERE and TUBE styles
-    enum DrawStyle { FREEHAND, CUBE, POINTS, SPHERE, TUBE };
+    // BATCH is not a brush style: it marks baked static batches (see bakeAllStrokes)
+    enum DrawStyle { FREEHAND, CUBE, POINTS, SPHERE, TUBE, BATCH };
 
-    Painter();
+    // gpu = false makes a headless painter (benchmarks, tools): no GL calls at all, draw() does
+    // nothing, everything else (including prepareFrame) works as usual
+    explicit Painter(bool gpu = true);
+    // Issues every GPU command through 'device' (e.g. a RecordingRenderDevice to count them),
+    // which must outlive the painter
+    explicit Painter(RenderDevice& device);
     ~Painter(); // Add destructor to clean up resources
 
     void addPoint(const glm::vec3& point);
@@ -23,6 +42,12 @@ public:
     void clear();
     // Pass camera position for specular lighting
     void draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos);
+    // CPU half of draw(): streams in strokes, updates the chunks, culls and sorts the strokes to
+    // draw one by one (with chunks, only those no chunk batch covers yet). Returns true if the
+    // frame is drawn from chunks.
+    bool prepareFrame(const glm::mat4& viewProjection);
+    bool hasShaders() const { return litShaderProgram != 0; } // False if the lit shader failed to load
+    bool getSceneBounds(glm::vec3& outMin, glm::vec3& outMax) const; // World bounds; false if empty
     void undoStroke();
     void redoStroke();
     void smoothCurrentStroke();
@@ -34,12 +59,74 @@ public:
     void removeLastPoint();
     void scaleCurrentStroke(float scaleFactor);
     void translateCurrentStroke(const glm::vec3& translation);
+    void rotateCurrentStroke(float angleRadians, const glm::vec3& axis); // About the stroke's centroid
+    void bakeCurrentStrokeTransform(); // Apply the stroke transform to its points and reset it
     void duplicateLastStroke();
+    void duplicateLastStroke(const glm::mat4& offset); // Copy placed at offset * original transform
     void mergeAllStrokes();
+    void bakeAllStrokes(); // Flatten every stroke into one static mesh that keeps each stroke's material
     void clearUndoneStrokes();
     void reverseCurrentStroke();
     void setDrawStyle(DrawStyle style);
     DrawStyle getDrawStyle() const;
+    StrokeArena::Stats getMemoryStats() const; // Stroke data allocator statistics
+    void setHistoryMemoryBudget(size_t bytes);
+    StrokeHistory::Stats getHistoryStats() const;
+
+    // --- Chunked static batching ---
+    struct RenderStats {
+        size_t drawCalls = 0;       // Completed strokes, last frame
+        size_t chunkCount = 0;      // Non-empty chunks
+        size_t visibleChunks = 0;
+        size_t chunksRebuilt = 0;   // In the last update that rebuilt anything
+        float lastRebuildMs = 0.0f; // Total for that update
+        float maxRebuildMs = 0.0f;  // Slowest single chunk so far
+        size_t unbakedStrokes = 0;  // Drawn outside the chunk batches: waiting for a rebake, or instanced copies
+    };
+    void setChunkedRendering(bool enabled);
+    bool getChunkedRendering() const;
+    void setChunkSize(float size); // World units per chunk edge
+    float getChunkSize() const;
+    // Rebakes every chunk that is behind right away, instead of a few per frame once the scene is idle
+    void flushChunks();
+    RenderStats getRenderStats() const;
+
+    // --- Scene files (.p3d) ---
+    // packPoints: store control points with PointCodec (lossy, ~1 mm grid) instead of raw floats.
+    // With a journal open, the journal restarts from the saved file and the undo history is cleared.
+    bool saveScene(const std::string& path, bool includeMeshes = true, bool packPoints = false);
+    bool loadScene(const std::string& path); // Replaces the scene and clears history
+    // Progressive load: clears the scene, then strokes stream in over the next frames
+    bool streamScene(const std::string& path);
+    void cancelSceneStream();
+    SceneStreamLoader::Progress getSceneStreamProgress() const;
+
+    // --- Mesh export (OBJ/PLY/STL) ---
+    // Every stroke as triangles. Freehand lines become ribbons and points become quads, both
+    // facing 'viewDirection' (the camera's, so the export looks like the screen).
+    bool exportMesh(const std::string& path, MeshExport::Format format, const glm::vec3& viewDirection,
+        MeshExport::Stats* stats = nullptr);
+    // Binary glTF: shared meshes placed by nodes, dabs as GPU instances (see GltfExport.h)
+    bool exportGlb(const std::string& path, GltfExport::Stats* stats = nullptr);
+
+    // --- Point cloud / polyline import (CSV, XYZ, PLY) ---
+    // Adds the file's points as POINTS or TUBE strokes with the current brush, undone as one step.
+    // Each polyline (each PLY) is cut into strokes of up to 4096 points.
+    bool importPoints(const std::string& path, DrawStyle style, PointImport::Stats* stats = nullptr);
+
+    // --- Crash recovery journal ---
+    // Replays the edits journaled by a session that crashed, then journals every new one
+    bool openJournal(const std::string& path);
+    void closeJournal(); // Clean exit: deletes the journal, there is nothing to recover
+    StrokeJournal::Stats getJournalStats() const;
+
+    // --- Point Codec ---
+    struct CodecBenchmark {
+        PointCodec::Stats varint;
+        PointCodec::Stats bitPacked;
+    };
+    // Round-trips the control points of every stroke in the scene through both formats
+    CodecBenchmark benchmarkPointCodec();
 
     // --- Material Properties ---
     glm::vec4 brushAmbientColor;
@@ -54,17 +141,16 @@ public:
 
 
 private:
-    struct Vertex {
-        glm::vec3 position;
-        glm::vec3 normal;
-        // Add texCoords here later for texturing
-        // glm::vec2 texCoords;
-    };
+    typedef StrokeVertex Vertex;
 
+    // Stroke being built by addPoint (finished strokes live in the StrokeStore)
     struct Stroke {
-        std::vector<glm::vec3> points; // Original control points
-        std::vector<Vertex> generatedVertices; // Vertices for rendering (e.g., tube mesh)
-        std::vector<unsigned int> generatedIndices; // Indices for rendering
+        std::vector<glm::vec3> points; // Original control points, in stroke-local space
+
+        // Move/scale/rotate edits only touch these; the shaders apply the transform
+        glm::mat4 transform = glm::mat4(1.0f);
+        glm::mat4 inverseTransform = glm::mat4(1.0f); // Maps new input points into local space
+        glm::dvec3 pointSum = glm::dvec3(0.0); // Running sum of local points, for the centroid
 
         // Material applied to this stroke
         glm::vec4 ambientColor;
@@ -76,10 +162,51 @@ private:
         DrawStyle style; // Store style used for this stroke
     };
 
-    std::vector<Stroke> strokes;
-    std::vector<Stroke> undoneStrokes;
+    StrokeArena strokeArena; // Backs stroke payloads; declared first so it outlives them
+    StrokeStore strokes;
+    StrokeHistory history;
     bool drawing;
     Stroke currentStroke;
+    std::vector<uint32_t> visibleStrokes; // Reused every frame by draw()
+    // Visible strokes sharing payload, material and size, drawn with one instanced call
+    struct StrokeGroup {
+        size_t start, count; // Range of visibleStrokes
+        size_t firstInstance; // In strokeInstanceVBO, or instanceDataVBO for dab styles
+    };
+    std::vector<StrokeGroup> visibleGroups; // Reused every frame by draw()
+    std::vector<uint64_t> instanceSerials; // Serials of the visible strokes the instance buffers were built for
+    std::vector<glm::mat4> instanceScratch; // Instance matrices of mesh and line styles (one per copy)
+    std::vector<glm::mat4> dabInstanceScratch; // Instance matrices of dab styles (one per point per copy)
+
+    // GPU copy of a payload's geometry, shared by every stroke that references the payload
+    struct GpuMesh {
+        unsigned int vao = 0, vbo = 0, ebo = 0;
+        unsigned int materialBuffer = 0, materialTexture = 0; // Batches: material table texture buffer
+        StrokeRef payload; // Keeps the key alive so its address can't be reused
+    };
+    std::unordered_map<const StrokePayload*, GpuMesh> gpuMeshes;
+    bool gpuCacheDirty; // Strokes left the scene; prune meshes it no longer draws
+    std::unordered_set<const StrokePayload*> livePayloads; // Reused by pruneGpuMeshes
+
+    StrokeChunkGrid chunkGrid; // Scene split into chunks, each drawn as one baked batch
+    bool chunkedRendering;
+    std::vector<uint32_t> unbakedStrokes; // Reused every frame: strokes no chunk batch draws yet
+    std::chrono::steady_clock::time_point lastChunkEdit; // Last sync that added or removed strokes
+    std::unique_ptr<RenderDevice> ownedDevice;
+    RenderDevice* device; // Every GPU command goes through here; null for headless painters
+    RenderStats renderStats;
+
+    SceneStreamLoader sceneStream; // After the arena: holds payloads until they are delivered
+    StrokeJournal journal;
+    std::vector<uint8_t> journalScratch; // Reused to build stroke records
+    // Edits made while a scene streams in, journaled after the stream itself once it is over
+    struct HeldRecord {
+        StrokeJournal::RecordType type;
+        std::vector<uint8_t> data;
+        std::string filePath; // File records whose digest the journal writer still has to add
+    };
+    std::vector<HeldRecord> heldJournalRecords;
+    std::string streamPath;
 
     // --- OpenGL Resources ---
     // Generic VBO/VAO for simple styles (lines, points)
@@ -90,8 +217,23 @@ private:
     int cubeIndexCount;
     unsigned int sphereVAO, sphereVBO, sphereEBO; // For drawing a single detailed sphere if needed
     int sphereIndexCount;
+    // CPU copies of the dab meshes, used when baking CUBE/SPHERE strokes into batches
+    std::vector<Vertex> cubeMesh;
+    std::vector<Vertex> sphereMesh;
+    std::vector<unsigned int> sphereMeshIndices;
     // Resources for tube rendering
     unsigned int tubeVAO, tubeVBO, tubeEBO;
+    // Per-stroke transforms for instanced payload meshes (bound in every GpuMesh VAO)
+    unsigned int strokeInstanceVBO;
+    unsigned int identityInstanceVBO; // One identity matrix for world-space batches, uploaded once
+
+    // Lit shader uniform locations, looked up once in initShaders
+    struct LitUniforms {
+        GLint view = -1, projection = -1, model = -1, viewPos = -1;
+        GLint lightPosition = -1, lightColor = -1, lightAmbient = -1, lightDiffuse = -1, lightSpecular = -1;
+        GLint materialAmbient = -1, materialDiffuse = -1, materialSpecular = -1, materialShininess = -1;
+        GLint useInstancing = -1, materialTable = -1, useMaterialTable = -1;
+    } litUniforms;
 
     // --- Shaders ---
     unsigned int simpleShaderProgram; // Original shader (renamed)
@@ -100,6 +242,8 @@ private:
 
     DrawStyle currentDrawStyle; // Renamed from drawStyle
 
+    Painter(RenderDevice* renderDevice, bool ownsDevice);
+
     // --- Initialization Helpers ---
     void initShaders();
     void initCube();
@@ -108,18 +252,49 @@ private:
 
 
     // --- Geometry Generation ---
-    void generateTubeMesh(Stroke& stroke, int segments = 8); // Generate vertices/indices for a tube stroke
+    static const int TubeSegments = 8;
+    // Generate vertices/indices for a tube stroke into caller-provided arrays
+    // (count * segments vertices, (count - 1) * segments * 6 indices)
+    static void generateTubeMesh(const glm::vec3* points, size_t count, float size, Vertex* outVertices, unsigned int* outIndices, int segments = TubeSegments);
+    StrokeRef buildPayload(const glm::vec3* points, size_t count, DrawStyle style, float size); // Points + generated mesh
+    StrokeRef buildBatchPayload(const uint32_t* strokeIndices, size_t count); // World-space mesh of several strokes
 
     // --- Buffer Updates ---
-    void updateSimpleBuffer(const std::vector<glm::vec3>& points);
-    void updateTubeBuffers(const Stroke& stroke);
-    void setupInstancedVertexAttributes(unsigned int VAO, unsigned int& instanceVBO);
+    void updateSimpleBuffer(const glm::vec3* points, size_t count);
+    void updateTubeBuffers(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+    void bindInstanceAttributes(); // mat4 at locations 2-5 from the bound GL_ARRAY_BUFFER, into the bound VAO
+    void pointInstanceAttributes(size_t firstInstance); // Moves those attributes to another instance
 
     // --- Drawing Helpers ---
     void drawStrokeFreehand(const Stroke& stroke, const glm::mat4& model, int colorLoc);
     void drawStrokePoints(const Stroke& stroke, const glm::mat4& model, int colorLoc);
-    void drawStrokeInstanced(const Stroke& stroke, unsigned int baseVAO, int indexCount, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos);
+    void updateInstanceBuffers(); // Groups visibleStrokes; uploads their matrices if they changed
+    void drawStrokeGroup(const StrokeGroup& group);
+    void drawBatch(const StrokeRef& payload, GLsizei instanceCount);
+    void updateChunks(bool flush = false);
+    void drawChunks(const glm::mat4& viewProjection);
+    void pumpSceneStream(); // Moves this frame's share of streamed strokes into the scene
+    const GpuMesh& getGpuMesh(const StrokeRef& payload, DrawStyle style);
+    void pruneGpuMeshes();
+    void deleteGpuMesh(GpuMesh& mesh);
 
     void smoothStroke(Stroke& stroke);
+    void applyCurrentStrokeEdit(const glm::mat4& edit); // Pre-multiply about the centroid, O(1)
+    void storeStroke(const Stroke& stroke); // Build the payload and append a finished stroke to 'strokes'
+    bool mergeStrokes(const StrokeMaterial& material, float size, DrawStyle style);
+    bool importPointStrokes(const std::string& path, const StrokeMaterial& material, float size, DrawStyle style, PointImport::Stats* stats);
+    void journalStroke(const Stroke& stroke);
+    // Export helpers: thread-safe, they only read the scene
+    void measureExportStroke(uint32_t index, size_t& vertexCount, size_t& triangleCount) const;
+    void buildExportStroke(uint32_t index, const glm::vec3& viewDirection, uint32_t tableOffset, MeshExport::StrokeMesh& out) const;
+    bool replayJournalRecord(StrokeJournal::RecordType type, const uint8_t* data, size_t size); // False stops the replay
+    void journalAppend(StrokeJournal::RecordType type, const void* data = nullptr, size_t size = 0); // Held back while streaming
+    // Appends 'record' (the type's own fields) followed by the file's size, content hash and path.
+    // Without a known digest ({size, hash}) the journal writer reads the file for it.
+    void journalFile(StrokeJournal::RecordType type, std::vector<uint8_t> record, const std::string& path,
+        const uint64_t* digest = nullptr);
+    void journalStreamEnd(); // Journals a finished or stopped stream as a load, then the edits made meanwhile
+    // Frustum cull using stroke bounds, of 'candidates' or else every stroke
+    void collectVisibleStrokes(const glm::mat4& viewProjection, const std::vector<uint32_t>* candidates = nullptr);
 
 };
\ No newline at end of file
@@ -0,0 +1,38 @@
+// ParallelFor.h
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// Runs body(i) for every i in [0, count) across the available cores, the calling thread
+// included. Items are handed out 'grain' at a time from a shared counter, so items of very
+// different cost (short and long strokes) still balance. Returns when all items are done.
+template <typename Body>
+void parallelFor(size_t count, const Body& body, size_t grain = 1) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), (count + grain - 1) / grain);
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; ++i) body(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t first = next.fetch_add(grain); first < count; first = next.fetch_add(grain)) {
+            size_t last = std::min(first + grain, count);
+            for (size_t i = first; i < last; ++i) body(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (size_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
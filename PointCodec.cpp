@@ -0,0 +1,242 @@
+// PointCodec.cpp
+#include "PointCodec.h"
+#include "ParallelFor.h"
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "vec3 must be 3 packed floats");
+
+static const size_t BlockPoints = 32;
+static const size_t StreamGrain = 16; // Streams per work item when running on several cores
+
+static inline uint32_t zigzag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+    return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+// Snaps coordinates to the grid. Kept branch-free (and clamped so the conversion is always
+// defined) so the compiler can vectorize it.
+static inline void quantize(const float* values, size_t count, float invStep, int32_t* out) {
+    const float limit = 1073741824.0f; // 2^30
+    for (size_t i = 0; i < count; ++i) {
+        float value = std::floor(values[i] * invStep + 0.5f);
+        value = std::min(std::max(value, -limit), limit);
+        out[i] = static_cast<int32_t>(value);
+    }
+}
+
+// --- Varint ---
+
+static inline uint8_t* writeVarint(uint32_t value, uint8_t* out) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+static inline bool readVarint(const uint8_t*& cursor, const uint8_t* end, uint32_t& value) {
+    // Smooth strokes mostly produce single-byte deltas
+    if (cursor != end && *cursor < 0x80) {
+        value = *cursor++;
+        return true;
+    }
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (cursor == end) return false;
+        uint8_t byte = *cursor++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// --- Bit packing ---
+
+static inline int bitWidth(const uint32_t* values, size_t count) {
+    uint32_t combined = 0;
+    for (size_t i = 0; i < count; ++i) combined |= values[i];
+    int width = 0;
+    while (width < 32 && (combined >> width) != 0) width++;
+    return width;
+}
+
+static void pack(const uint32_t* values, size_t count, int width, std::vector<uint8_t>& out) {
+    size_t position = out.size();
+    out.resize(position + (count * width + 7) / 8);
+    uint8_t* cursor = out.data() + position;
+    uint64_t bits = 0;
+    int bitCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bits |= static_cast<uint64_t>(values[i]) << bitCount;
+        bitCount += width;
+        while (bitCount >= 8) {
+            *cursor++ = static_cast<uint8_t>(bits);
+            bits >>= 8;
+            bitCount -= 8;
+        }
+    }
+    if (bitCount > 0) *cursor = static_cast<uint8_t>(bits);
+}
+
+static bool unpack(const uint8_t*& cursor, const uint8_t* end, size_t count, int width, uint32_t* values) {
+    size_t bytes = (count * width + 7) / 8;
+    if (static_cast<size_t>(end - cursor) < bytes) return false;
+    if (width == 0) {
+        std::fill(values, values + count, 0u);
+        return true;
+    }
+    uint64_t mask = (uint64_t(1) << width) - 1;
+    uint64_t bits = 0;
+    int bitCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        while (bitCount < width) {
+            bits |= static_cast<uint64_t>(*cursor++) << bitCount;
+            bitCount += 8;
+        }
+        values[i] = static_cast<uint32_t>(bits & mask);
+        bits >>= width;
+        bitCount -= width;
+    }
+    return true;
+}
+
+// --- Streams ---
+
+size_t PointCodec::encode(const glm::vec3* points, size_t count, float step, std::vector<uint8_t>& out, Format format) {
+    size_t start = out.size();
+    out.push_back(format);
+    const float* values = reinterpret_cast<const float*>(points);
+    float invStep = 1.0f / step;
+    int32_t previous[3] = { 0, 0, 0 };
+    int32_t quantized[BlockPoints * 3];
+    uint32_t deltas[3][BlockPoints];
+
+    for (size_t first = 0; first < count; first += BlockPoints) {
+        size_t blockCount = std::min(BlockPoints, count - first);
+        quantize(values + first * 3, blockCount * 3, invStep, quantized);
+        for (size_t i = 0; i < blockCount; ++i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                int32_t value = quantized[i * 3 + axis];
+                // Wrapping subtraction keeps extreme jumps well defined
+                deltas[axis][i] = zigzag(static_cast<int32_t>(static_cast<uint32_t>(value) - static_cast<uint32_t>(previous[axis])));
+                previous[axis] = value;
+            }
+        }
+
+        if (format == BitPacked) {
+            int widths[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                widths[axis] = bitWidth(deltas[axis], blockCount);
+                out.push_back(static_cast<uint8_t>(widths[axis]));
+            }
+            for (int axis = 0; axis < 3; ++axis) {
+                pack(deltas[axis], blockCount, widths[axis], out);
+            }
+        }
+        else {
+            // Worst case 5 bytes per delta; write through a pointer and trim afterwards
+            size_t position = out.size();
+            out.resize(position + blockCount * 3 * 5);
+            uint8_t* cursor = out.data() + position;
+            for (size_t i = 0; i < blockCount; ++i) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    cursor = writeVarint(deltas[axis][i], cursor);
+                }
+            }
+            out.resize(cursor - out.data());
+        }
+    }
+    return out.size() - start;
+}
+
+bool PointCodec::decode(const uint8_t* data, size_t size, size_t count, float step, glm::vec3* outPoints) {
+    if (size == 0) return false;
+    const uint8_t* cursor = data + 1;
+    const uint8_t* end = data + size;
+    Format format = static_cast<Format>(data[0]);
+    if (format != Varint && format != BitPacked) return false;
+
+    float* values = reinterpret_cast<float*>(outPoints);
+    int32_t current[3] = { 0, 0, 0 };
+    uint32_t deltas[3][BlockPoints];
+
+    for (size_t first = 0; first < count; first += BlockPoints) {
+        size_t blockCount = std::min(BlockPoints, count - first);
+        if (format == BitPacked) {
+            if (end - cursor < 3) return false;
+            int widths[3] = { cursor[0], cursor[1], cursor[2] };
+            cursor += 3;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (widths[axis] > 32 || !unpack(cursor, end, blockCount, widths[axis], deltas[axis])) return false;
+            }
+        }
+        else {
+            for (size_t i = 0; i < blockCount; ++i) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (!readVarint(cursor, end, deltas[axis][i])) return false;
+                }
+            }
+        }
+
+        for (int axis = 0; axis < 3; ++axis) {
+            uint32_t value = static_cast<uint32_t>(current[axis]);
+            for (size_t i = 0; i < blockCount; ++i) {
+                value += static_cast<uint32_t>(unzigzag(deltas[axis][i]));
+                values[(first + i) * 3 + axis] = static_cast<int32_t>(value) * step;
+            }
+            current[axis] = static_cast<int32_t>(value);
+        }
+    }
+    return true;
+}
+
+void PointCodec::encodeMany(const Stream* streams, size_t streamCount, float step, Format format, std::vector<std::vector<uint8_t>>& out) {
+    out.resize(streamCount);
+    parallelFor(streamCount, [&](size_t i) {
+        out[i].clear();
+        encode(streams[i].points, streams[i].count, step, out[i], format);
+    }, StreamGrain);
+}
+
+PointCodec::Stats PointCodec::benchmark(const Stream* streams, size_t streamCount, float step, Format format) {
+    Stats stats;
+    stats.streams = streamCount;
+    std::vector<size_t> offsets(streamCount + 1, 0);
+    for (size_t i = 0; i < streamCount; ++i) {
+        offsets[i + 1] = offsets[i] + streams[i].count;
+    }
+    stats.points = offsets[streamCount];
+    stats.rawBytes = stats.points * sizeof(glm::vec3);
+
+    std::vector<std::vector<uint8_t>> encoded;
+    auto start = std::chrono::steady_clock::now();
+    encodeMany(streams, streamCount, step, format, encoded);
+    stats.encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const std::vector<uint8_t>& bytes : encoded) {
+        stats.encodedBytes += bytes.size();
+    }
+
+    std::vector<glm::vec3> decoded(stats.points);
+    std::atomic<bool> corrupt(false);
+    start = std::chrono::steady_clock::now();
+    parallelFor(streamCount, [&](size_t i) {
+        if (!decode(encoded[i].data(), encoded[i].size(), streams[i].count, step, decoded.data() + offsets[i])) corrupt = true;
+    }, StreamGrain);
+    stats.decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    float maxError = corrupt ? INFINITY : 0.0f;
+    for (size_t i = 0; i < streamCount && !corrupt; ++i) {
+        for (size_t p = 0; p < streams[i].count; ++p) {
+            glm::vec3 error = glm::abs(decoded[offsets[i] + p] - streams[i].points[p]);
+            maxError = std::max(maxError, std::max(error.x, std::max(error.y, error.z)));
+        }
+    }
+    stats.maxError = maxError;
+    return stats;
+}
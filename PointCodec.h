@@ -0,0 +1,49 @@
+// PointCodec.h
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Compact lossy encoding for stroke control points.
+// Points are snapped to a grid of 'step' world units and each point is stored as the difference
+// to the previous one, which for smooth strokes is a few grid cells. The zigzag-mapped deltas
+// are then either written as LEB128 varints or bit-packed per block of 32 points, at the
+// narrowest width that fits the block. Either way a point mostly needs 3-4 bytes instead of 12.
+// The first byte of a stream records its format, so decode() reads both.
+namespace PointCodec {
+    enum Format : uint8_t {
+        Varint = 1,   // Byte-aligned, no block overhead: best for short strokes
+        BitPacked = 2 // 3 width bytes per block, then no wasted bits: best for long smooth strokes
+    };
+
+    struct Stream {
+        const glm::vec3* points;
+        size_t count;
+    };
+
+    struct Stats {
+        size_t streams = 0;
+        size_t points = 0;
+        size_t rawBytes = 0;      // 12 bytes per point
+        size_t encodedBytes = 0;
+        double encodeSeconds = 0.0;
+        double decodeSeconds = 0.0;
+        float maxError = 0.0f;    // Largest coordinate error after a round trip
+
+        double ratio() const { return encodedBytes ? double(rawBytes) / encodedBytes : 0.0; }
+        // Throughput in MB of raw points per second
+        double encodeMBps() const { return encodeSeconds > 0.0 ? rawBytes / (1024.0 * 1024.0) / encodeSeconds : 0.0; }
+        double decodeMBps() const { return decodeSeconds > 0.0 ? rawBytes / (1024.0 * 1024.0) / decodeSeconds : 0.0; }
+    };
+
+    // Appends the encoded stream to 'out' and returns the number of bytes written
+    size_t encode(const glm::vec3* points, size_t count, float step, std::vector<uint8_t>& out, Format format = Varint);
+    // Decodes 'count' points. Returns false if the stream is truncated or corrupt.
+    bool decode(const uint8_t* data, size_t size, size_t count, float step, glm::vec3* outPoints);
+
+    // Encodes each stream into out[i], spread over the available cores
+    void encodeMany(const Stream* streams, size_t streamCount, float step, Format format, std::vector<std::vector<uint8_t>>& out);
+    // Round-trips the streams (multithreaded) and reports size, speed and error
+    Stats benchmark(const Stream* streams, size_t streamCount, float step, Format format);
+}
@@ -0,0 +1,368 @@
+// PointImport.cpp
+#include "PointImport.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+using namespace PointImport;
+
+static const size_t ChunkBytes = 4u * 1024u * 1024u; // Text parsed per task
+static const size_t BinaryGrain = 64u * 1024u;       // PLY vertices per task
+
+// --- Float parsing ---
+
+static inline bool isDigit(char c) { return static_cast<unsigned>(c - '0') < 10u; }
+
+// Parses [+-]digits[.digits][(e|E)[+-]digits] without strtod's locale lookups and allocations.
+// Up to 19 significant digits go into an integer mantissa, then one multiply or divide by an
+// exact power of ten: correctly rounded for the coordinates scanners write, and always well
+// within float precision. Returns the end of the number, or null if there isn't one.
+static const char* parseFloat(const char* p, const char* end, float& out) {
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for (; p != end && isDigit(*p); ++p, any = true) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        }
+        else {
+            exponent++;
+        }
+    }
+    if (p != end && *p == '.') {
+        for (++p; p != end && isDigit(*p); ++p, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+        }
+    }
+    if (!any) return nullptr;
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q != end && (*q == '-' || *q == '+')) negativeExponent = *q++ == '-';
+        if (q != end && isDigit(*q)) {
+            int value = 0;
+            for (; q != end && isDigit(*q); ++q) {
+                if (value < 10000) value = value * 10 + (*q - '0');
+            }
+            exponent += negativeExponent ? -value : value;
+            p = q;
+        }
+    }
+
+    double value = static_cast<double>(mantissa);
+    if (mantissa != 0 && exponent != 0) {
+        if (exponent > 0 && exponent <= 22) value *= powers[exponent];
+        else if (exponent < 0 && exponent >= -22) value /= powers[-exponent];
+        else value *= std::pow(10.0, exponent);
+    }
+    out = static_cast<float>(negative ? -value : value);
+    return p;
+}
+
+static inline bool isSeparator(char c) { return c == ' ' || c == '\t' || c == ',' || c == ';'; }
+
+// --- Text ---
+
+namespace {
+    struct TextChunk {
+        const char* begin;
+        const char* end;
+        std::vector<glm::vec3> points;
+        std::vector<size_t> breaks; // Local point index after each blank line
+        size_t skipped = 0;
+    };
+
+    // Parses whole lines in [begin, end). 'columns' are the x, y and z column indices.
+    void parseLines(TextChunk& chunk, const int columns[3]) {
+        int lastColumn = std::max(columns[0], std::max(columns[1], columns[2]));
+        const char* p = chunk.begin;
+        chunk.points.reserve((chunk.end - chunk.begin) / 24); // Typical "x y z\n" line length
+        while (p < chunk.end) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+            if (!lineEnd) lineEnd = chunk.end;
+
+            float values[3];
+            int found = 0, column = 0;
+            const char* q = p;
+            while (q < lineEnd && (*q == ' ' || *q == '\t')) q++;
+            bool blank = q == lineEnd || *q == '\r';
+            while (!blank && column <= lastColumn && q < lineEnd) {
+                float value;
+                const char* next = parseFloat(q, lineEnd, value);
+                if (!next) break;
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (columns[axis] == column) {
+                        values[axis] = value;
+                        found++;
+                    }
+                }
+                column++;
+                q = next;
+                while (q < lineEnd && isSeparator(*q)) q++;
+            }
+
+            if (found == 3) chunk.points.push_back(glm::vec3(values[0], values[1], values[2]));
+            else if (blank) chunk.breaks.push_back(chunk.points.size());
+            else chunk.skipped++;
+            p = lineEnd + 1;
+        }
+    }
+
+    // Splits [begin, end) into line-aligned chunks, parses them in parallel and appends to 'out'
+    void parseText(const char* begin, const char* end, const int columns[3], Cloud& out, size_t& skipped) {
+        std::vector<TextChunk> chunks;
+        for (const char* p = begin; p < end;) {
+            const char* split = end;
+            if (static_cast<size_t>(end - p) > ChunkBytes) {
+                const char* newline = static_cast<const char*>(std::memchr(p + ChunkBytes, '\n', end - (p + ChunkBytes)));
+                if (newline) split = newline + 1;
+            }
+            TextChunk chunk;
+            chunk.begin = p;
+            chunk.end = split;
+            chunks.push_back(std::move(chunk));
+            p = split;
+        }
+        parallelFor(chunks.size(), [&](size_t i) { parseLines(chunks[i], columns); });
+
+        size_t total = out.points.size();
+        for (const TextChunk& chunk : chunks) total += chunk.points.size();
+        out.points.reserve(total);
+        for (const TextChunk& chunk : chunks) {
+            size_t offset = out.points.size();
+            for (size_t local : chunk.breaks) {
+                // Consecutive blank lines and blank lines before any point don't make empty polylines
+                size_t start = offset + local;
+                if (start > out.polylineStarts.back()) out.polylineStarts.push_back(start);
+            }
+            out.points.insert(out.points.end(), chunk.points.begin(), chunk.points.end());
+            skipped += chunk.skipped;
+        }
+        // A trailing blank line shouldn't leave an empty polyline either
+        if (out.polylineStarts.size() > 1 && out.polylineStarts.back() >= out.points.size()) out.polylineStarts.pop_back();
+    }
+}
+
+// --- PLY ---
+
+namespace {
+    enum PlyType { PlyInvalid, PlyInt8, PlyUInt8, PlyInt16, PlyUInt16, PlyInt32, PlyUInt32, PlyFloat32, PlyFloat64 };
+
+    PlyType plyType(const std::string& name) {
+        if (name == "char" || name == "int8") return PlyInt8;
+        if (name == "uchar" || name == "uint8") return PlyUInt8;
+        if (name == "short" || name == "int16") return PlyInt16;
+        if (name == "ushort" || name == "uint16") return PlyUInt16;
+        if (name == "int" || name == "int32") return PlyInt32;
+        if (name == "uint" || name == "uint32") return PlyUInt32;
+        if (name == "float" || name == "float32") return PlyFloat32;
+        if (name == "double" || name == "float64") return PlyFloat64;
+        return PlyInvalid;
+    }
+
+    size_t plySize(PlyType type) {
+        static const size_t sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+        return sizes[type];
+    }
+
+    float readPly(const uint8_t* data, PlyType type, bool swap) {
+        uint8_t bytes[8];
+        size_t size = plySize(type);
+        for (size_t i = 0; i < size; ++i) bytes[i] = data[swap ? size - 1 - i : i];
+        switch (type) {
+        case PlyInt8: { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+        case PlyUInt8: return bytes[0];
+        case PlyInt16: { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case PlyUInt16: { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case PlyInt32: { int32_t v; std::memcpy(&v, bytes, 4); return static_cast<float>(v); }
+        case PlyUInt32: { uint32_t v; std::memcpy(&v, bytes, 4); return static_cast<float>(v); }
+        case PlyFloat32: { float v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyFloat64: { double v; std::memcpy(&v, bytes, 8); return static_cast<float>(v); }
+        default: return 0.0f;
+        }
+    }
+
+    struct PlyElement {
+        std::string name;
+        size_t count = 0;
+        size_t stride = 0;     // Binary row size, unless the element has list properties
+        bool hasList = false;
+        int xyz[3] = { -1, -1, -1 };       // Property index of x, y, z (vertex element)
+        size_t offsets[3] = { 0, 0, 0 };   // Their byte offsets in a binary row
+        PlyType types[3] = { PlyInvalid, PlyInvalid, PlyInvalid };
+        int propertyCount = 0;
+    };
+
+    bool isLittleEndian() {
+        const uint16_t probe = 1;
+        uint8_t first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+
+    bool loadPly(const char* data, size_t size, Cloud& out, size_t& skipped, std::string* error) {
+        const char* end = data + size;
+        const char* p = data;
+        auto nextLine = [&p, end]() {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            std::string line(p, lineEnd ? lineEnd : end);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            p = lineEnd ? lineEnd + 1 : end;
+            return line;
+        };
+
+        // --- Header ---
+        std::string format;
+        std::vector<PlyElement> elements;
+        bool ended = false;
+        while (p < end && !ended) {
+            std::string line = nextLine();
+            char word[32] = {}, a[32] = {}, b[32] = {}, c[32] = {};
+            std::sscanf(line.c_str(), "%31s %31s %31s %31s", word, a, b, c);
+            if (std::strcmp(word, "format") == 0) format = a;
+            else if (std::strcmp(word, "element") == 0) {
+                PlyElement element;
+                element.name = a;
+                element.count = std::strtoull(b, nullptr, 10);
+                elements.push_back(element);
+            }
+            else if (std::strcmp(word, "property") == 0 && !elements.empty()) {
+                PlyElement& element = elements.back();
+                int index = element.propertyCount++;
+                if (std::strcmp(a, "list") == 0) {
+                    element.hasList = true;
+                    continue;
+                }
+                PlyType type = plyType(a);
+                if (type == PlyInvalid) {
+                    if (error) *error = "Unknown PLY property type: " + std::string(a);
+                    return false;
+                }
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (b[0] == "xyz"[axis] && b[1] == 0) {
+                        element.xyz[axis] = index;
+                        element.offsets[axis] = element.stride;
+                        element.types[axis] = type;
+                    }
+                }
+                element.stride += plySize(type);
+            }
+            else if (std::strcmp(word, "end_header") == 0) ended = true;
+        }
+        if (!ended) {
+            if (error) *error = "PLY header has no end_header";
+            return false;
+        }
+
+        bool ascii = format == "ascii";
+        bool binary = format == "binary_little_endian" || format == "binary_big_endian";
+        if (!ascii && !binary) {
+            if (error) *error = "Unknown PLY format: " + format;
+            return false;
+        }
+        bool swap = binary && (format == "binary_little_endian") != isLittleEndian();
+
+        // Skip what comes before the vertices; the rest of the file isn't needed
+        const PlyElement* vertices = nullptr;
+        for (const PlyElement& element : elements) {
+            if (element.name == "vertex") {
+                vertices = &element;
+                break;
+            }
+            if (ascii) {
+                for (size_t row = 0; row < element.count && p < end; ++row) nextLine();
+            }
+            else if (element.hasList) {
+                if (error) *error = "Binary PLY with list properties before the vertices isn't supported";
+                return false;
+            }
+            else {
+                p += std::min<size_t>(element.count * element.stride, end - p);
+            }
+        }
+        if (!vertices || vertices->xyz[0] < 0 || vertices->xyz[1] < 0 || vertices->xyz[2] < 0 || (binary && vertices->hasList)) {
+            if (error) *error = "PLY has no vertex x/y/z";
+            return false;
+        }
+
+        if (ascii) {
+            // Vertex rows only: the face rows after them would parse as numbers too
+            const char* first = p;
+            for (size_t row = 0; row < vertices->count && p < end; ++row) {
+                const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                p = lineEnd ? lineEnd + 1 : end;
+            }
+            parseText(first, p, vertices->xyz, out, skipped);
+            return true;
+        }
+
+        size_t available = static_cast<size_t>(end - p) / vertices->stride;
+        if (available < vertices->count) {
+            if (error) *error = "PLY vertex data is truncated";
+            return false;
+        }
+        const uint8_t* rows = reinterpret_cast<const uint8_t*>(p);
+        size_t offset = out.points.size();
+        out.points.resize(offset + vertices->count);
+        size_t blocks = (vertices->count + BinaryGrain - 1) / BinaryGrain;
+        parallelFor(blocks, [&](size_t block) {
+            size_t last = std::min(vertices->count, (block + 1) * BinaryGrain);
+            for (size_t v = block * BinaryGrain; v < last; ++v) {
+                const uint8_t* row = rows + v * vertices->stride;
+                glm::vec3& point = out.points[offset + v];
+                for (int axis = 0; axis < 3; ++axis) {
+                    point[axis] = readPly(row + vertices->offsets[axis], vertices->types[axis], swap);
+                }
+            }
+        });
+        return true;
+    }
+}
+
+bool PointImport::load(const std::string& path, Cloud& out, Stats* stats, std::string* error) {
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.open(path, error)) return false;
+    const char* data = reinterpret_cast<const char*>(file.getData());
+    size_t size = file.getSize();
+
+    out.points.clear();
+    out.polylineStarts.assign(1, 0);
+    size_t skipped = 0;
+    if (size >= 4 && std::memcmp(data, "ply", 3) == 0 && (data[3] == '\n' || data[3] == '\r')) {
+        if (!loadPly(data, size, out, skipped, error)) return false;
+    }
+    else {
+        const int columns[3] = { 0, 1, 2 };
+        parseText(data, data + size, columns, out, skipped);
+    }
+    if (out.points.empty()) {
+        out.polylineStarts.clear();
+        if (error) *error = "No points in " + path;
+        return false;
+    }
+
+    if (stats) {
+        stats->points = out.points.size();
+        stats->polylines = out.polylineCount();
+        stats->skippedLines = skipped;
+        stats->bytes = size;
+        stats->parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+// PointImport.h
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Loads point clouds and polylines from text (CSV / XYZ / ASCII: one point per line, x y z in
+// the first three columns, separated by spaces, tabs, commas or semicolons) and from PLY
+// (ascii or binary, vertex x/y/z of any numeric type).
+//
+// The file is memory mapped and split into chunks at line boundaries; every chunk is parsed on
+// its own core with a locale-free float parser, then the chunks are stitched back in order.
+// In text files a blank line ends a polyline (the gnuplot convention); lines that don't start
+// with three numbers (headers, comments) are skipped. A PLY is one polyline.
+namespace PointImport {
+    struct Cloud {
+        std::vector<glm::vec3> points;
+        std::vector<size_t> polylineStarts; // First point of each polyline, ascending, starts with 0
+
+        size_t polylineCount() const { return polylineStarts.size(); }
+        size_t polylineEnd(size_t i) const { return i + 1 < polylineStarts.size() ? polylineStarts[i + 1] : points.size(); }
+    };
+
+    struct Stats {
+        size_t points = 0;
+        size_t polylines = 0;
+        size_t skippedLines = 0; // Text lines that weren't points
+        uint64_t bytes = 0;
+        double parseSeconds = 0.0;
+
+        double pointsPerSecond() const { return parseSeconds > 0.0 ? points / parseSeconds : 0.0; }
+    };
+
+    bool load(const std::string& path, Cloud& out, Stats* stats = nullptr, std::string* error = nullptr);
+}
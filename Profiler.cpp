@@ -0,0 +1,241 @@
+// Profiler.cpp
+#include "Profiler.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <cstdio>
+#include <cstring>
+
+namespace Profiler {
+
+std::atomic<bool> enabledFlag(false);
+
+namespace {
+
+const uint64_t RingSize = 16384; // Zones per thread, power of two
+const size_t FrameMarkCount = 512;
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+// Fields are atomics so a reader racing the owner reads stale or new values, never torn ones;
+// relaxed stores compile to plain moves
+struct Slot {
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> startNs;
+    std::atomic<uint64_t> endNs;
+    std::atomic<uint32_t> depth;
+};
+
+struct ThreadRing {
+    uint32_t index = 0;
+    std::string name;               // Guarded by the registry mutex
+    bool inUse = false;             // Guarded by the registry mutex
+    uint32_t depth = 0;             // Owner thread only
+    std::atomic<uint64_t> written{0}; // Zones ever written; the newest is at written - 1
+    Slot slots[RingSize];
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings; // Never shrinks: indices are thread rows
+    uint64_t frameMarks[FrameMarkCount] = {};
+    uint64_t frameCount = 0;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+std::string defaultThreadName(uint32_t index) {
+    return "Worker " + std::to_string(index);
+}
+
+// Owns the calling thread's ring; gives it back when the thread exits so the next one reuses it
+struct ThreadHandle {
+    ThreadRing* ring = nullptr;
+
+    ThreadRing* get() {
+        if (ring) return ring;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (std::unique_ptr<ThreadRing>& candidate : r.rings) {
+            if (!candidate->inUse) {
+                ring = candidate.get();
+                break;
+            }
+        }
+        if (!ring) {
+            r.rings.emplace_back(new ThreadRing());
+            ring = r.rings.back().get();
+            ring->index = static_cast<uint32_t>(r.rings.size() - 1);
+        }
+        ring->inUse = true;
+        ring->name = defaultThreadName(ring->index);
+        return ring;
+    }
+
+    ~ThreadHandle() {
+        if (!ring) return;
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        ring->inUse = false;
+    }
+};
+
+thread_local ThreadHandle threadHandle;
+
+void appendEscaped(std::string& out, const char* text) {
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') out += '\\';
+        if (static_cast<unsigned char>(*c) < 0x20) continue;
+        out += *c;
+    }
+}
+
+} // namespace
+
+
+// --- Recording ---
+
+void setEnabled(bool enabled) {
+    enabledFlag.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void Scope::begin(const char* zoneName) {
+    threadHandle.get()->depth++;
+    name = zoneName;
+    startNs = now();
+}
+
+void Scope::finish() {
+    uint64_t endNs = now();
+    ThreadRing* ring = threadHandle.ring;
+    uint32_t depth = --ring->depth; // Scopes close in reverse order, so this is the depth begin() saw
+    uint64_t index = ring->written.load(std::memory_order_relaxed);
+    // Keeps the previous publish ahead of these stores, which collect() relies on to spot overwrites
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot& slot = ring->slots[index & (RingSize - 1)];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    slot.depth.store(depth, std::memory_order_relaxed);
+    ring->written.store(index + 1, std::memory_order_release);
+    name = nullptr;
+}
+
+void setThreadName(const char* name) {
+    ThreadRing* ring = threadHandle.get();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ring->name = name;
+}
+
+std::vector<std::string> getThreadNames() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<std::string> names;
+    for (const std::unique_ptr<ThreadRing>& ring : r.rings) names.push_back(ring->name);
+    return names;
+}
+
+void frameMark() {
+    if (!isEnabled()) return;
+    uint64_t time = now();
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.frameMarks[r.frameCount % FrameMarkCount] = time;
+    r.frameCount++;
+}
+
+std::vector<uint64_t> getFrameMarks() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    uint64_t first = r.frameCount > FrameMarkCount ? r.frameCount - FrameMarkCount : 0;
+    std::vector<uint64_t> marks;
+    for (uint64_t i = first; i < r.frameCount; ++i) marks.push_back(r.frameMarks[i % FrameMarkCount]);
+    return marks;
+}
+
+
+// --- Reading ---
+
+void collect(uint64_t fromNs, std::vector<Zone>& out) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex); // Only keeps the ring list still; owners never take it
+    std::vector<std::pair<uint64_t, Zone>> found;
+    for (const std::unique_ptr<ThreadRing>& ring : r.rings) {
+        // Zones land in the order they end, so walk back from the newest until they end too early
+        uint64_t written = ring->written.load(std::memory_order_acquire);
+        uint64_t first = written > RingSize ? written - RingSize : 0;
+        found.clear();
+        for (uint64_t i = written; i > first; --i) {
+            const Slot& slot = ring->slots[(i - 1) & (RingSize - 1)];
+            Zone zone;
+            zone.name = slot.name.load(std::memory_order_relaxed);
+            zone.startNs = slot.startNs.load(std::memory_order_relaxed);
+            zone.endNs = slot.endNs.load(std::memory_order_relaxed);
+            zone.depth = slot.depth.load(std::memory_order_relaxed);
+            zone.thread = ring->index;
+            if (zone.endNs < fromNs) break;
+            if (zone.startNs >= fromNs) found.emplace_back(i - 1, zone);
+        }
+        // The owner kept writing meanwhile: slots it may have lapped are unreliable, drop them
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = ring->written.load(std::memory_order_relaxed);
+        uint64_t valid = after >= RingSize ? after - RingSize + 1 : 0; // First index still intact
+        for (size_t k = found.size(); k-- > 0;) {
+            if (found[k].first >= valid) out.push_back(found[k].second);
+        }
+    }
+}
+
+bool exportChromeTrace(const std::string& path, size_t* zoneCount, std::string* error) {
+    std::vector<Zone> zones;
+    collect(0, zones);
+    std::vector<std::string> threadNames = getThreadNames();
+    std::vector<uint64_t> frames = getFrameMarks();
+
+    // Trace-event format: "X" complete events in microseconds, "M" metadata names the rows
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char line[160];
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"3D Paint\"}}";
+    for (size_t t = 0; t < threadNames.size(); ++t) {
+        std::snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"", t);
+        json += line;
+        appendEscaped(json, threadNames[t].c_str());
+        json += "\"}}";
+        std::snprintf(line, sizeof(line), ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"sort_index\":%zu}}", t, t);
+        json += line;
+    }
+    for (uint64_t frame : frames) {
+        std::snprintf(line, sizeof(line), ",\n{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}", frame / 1000.0);
+        json += line;
+    }
+    for (const Zone& zone : zones) {
+        json += ",\n{\"name\":\"";
+        appendEscaped(json, zone.name ? zone.name : "?");
+        std::snprintf(line, sizeof(line), "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            zone.thread, zone.startNs / 1000.0, (zone.endNs - zone.startNs) / 1000.0);
+        json += line;
+    }
+    json += "\n]}\n";
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        if (error) *error = "Cannot open " + path + " for writing";
+        return false;
+    }
+    bool ok = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        if (error) *error = "Failed writing " + path;
+        return false;
+    }
+    if (zoneCount) *zoneCount = zones.size();
+    return true;
+}
+
+} // namespace Profiler
@@ -0,0 +1,85 @@
+// Profiler.h
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Hierarchical CPU timing of named scopes, for finding where a frame goes.
+//
+//     void Painter::updateChunks() {
+//         PROFILE_SCOPE("Painter::updateChunks");
+//         ...
+//
+// Every thread records finished zones into its own fixed-size ring buffer: no locks and no
+// allocation on the hot path, only two clock reads and a few stores. Readers (the profiler
+// panel, the trace export) copy the rings out and drop whatever was overwritten meanwhile.
+// Old zones fall off the end; at 16K zones per thread that's plenty of recent frames.
+//
+// Recording is off until setEnabled(true); a disabled scope costs one relaxed atomic load.
+// Defining P3D_NO_PROFILER compiles the macros away entirely.
+namespace Profiler {
+    struct Zone {
+        const char* name = nullptr; // The literal passed to PROFILE_SCOPE
+        uint64_t startNs = 0;       // Since the profiler's epoch (see now())
+        uint64_t endNs = 0;
+        uint32_t thread = 0;        // Index into getThreadNames()
+        uint32_t depth = 0;         // Nesting on its thread, 0 = outermost
+
+        double milliseconds() const { return (endNs - startNs) / 1e6; }
+    };
+
+    extern std::atomic<bool> enabledFlag;
+    inline bool isEnabled() { return enabledFlag.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    uint64_t now(); // Nanoseconds on a monotonic clock, 0 = first use of the profiler
+
+    // Label for the calling thread's row; threads without one show up as "Worker N".
+    // Thread pools that come and go reuse the rows of threads that have exited.
+    void setThreadName(const char* name);
+    std::vector<std::string> getThreadNames();
+
+    // Frame boundaries: call once per frame from the main loop, before anything else
+    void frameMark();
+    std::vector<uint64_t> getFrameMarks(); // Start times of recent frames, oldest first
+
+    // Appends every zone still held by the rings that started at or after 'fromNs'
+    void collect(uint64_t fromNs, std::vector<Zone>& out);
+
+    // Writes everything still recorded as Chrome trace-event JSON (chrome://tracing, Perfetto)
+    bool exportChromeTrace(const std::string& path, size_t* zoneCount = nullptr, std::string* error = nullptr);
+
+    // Times its own lifetime; use through PROFILE_SCOPE, or by name when a zone has to end early
+    class Scope {
+    public:
+        explicit Scope(const char* name) : name(nullptr), startNs(0) {
+            if (isEnabled()) begin(name);
+        }
+        ~Scope() { end(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        // Closes the zone before the end of the C++ scope; the destructor then does nothing
+        void end() {
+            if (name) finish();
+        }
+
+    private:
+        void begin(const char* zoneName);
+        void finish();
+
+        const char* name; // Null when the profiler was off at construction
+        uint64_t startNs;
+    };
+}
+
+#ifndef P3D_NO_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::frameMark()
+#else
+#define PROFILE_SCOPE(name) (void)0
+#define PROFILE_FRAME() (void)0
+#endif
@@ -0,0 +1,294 @@
+// ProfilerPanel.cpp
+#include "ProfilerPanel.h"
+#include "Globals.h"
+#include "RecordingRenderDevice.h"
+#include "imgui.h"
+#include <algorithm>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Stable color per zone name, so a zone keeps its color from frame to frame
+static ImU32 zoneColor(const char* name) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (const char* c = name; *c; ++c) hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+    return ImColor::HSV((hash % 360) / 360.0f, 0.45f, 0.8f);
+}
+
+ProfilerPanel::ProfilerPanel() :
+    paused(false),
+    framesShown(3),
+    rangeStart(0),
+    rangeEnd(0),
+    viewStart(0.0),
+    viewEnd(1.0)
+{
+    std::strcpy(exportPath, "profile.json");
+}
+
+// Takes the last 'framesShown' finished frames out of the profiler and totals them per zone name
+void ProfilerPanel::refresh(const GpuPassTimer* gpuTimer) {
+    std::vector<uint64_t> marks = Profiler::getFrameMarks();
+    zones.clear();
+    frameMarks.clear();
+    summary.clear();
+    if (marks.size() < 2) return;
+    // The newest mark opened the frame still being recorded
+    size_t last = marks.size() - 1;
+    size_t first = last > static_cast<size_t>(framesShown) ? last - framesShown : 0;
+    rangeStart = marks[first];
+    rangeEnd = marks[last];
+    frameMarks.assign(marks.begin() + first, marks.end());
+    Profiler::collect(rangeStart, zones);
+    threadNames = Profiler::getThreadNames(); // After collecting: every zone's thread has a name
+    zones.erase(std::remove_if(zones.begin(), zones.end(), [this](const Profiler::Zone& zone) {
+        return zone.endNs > rangeEnd;
+    }), zones.end());
+    std::sort(zones.begin(), zones.end(), [](const Profiler::Zone& a, const Profiler::Zone& b) {
+        if (a.thread != b.thread) return a.thread < b.thread;
+        if (a.startNs != b.startNs) return a.startNs < b.startNs;
+        return a.depth < b.depth;
+    });
+
+    // Self time = own time minus direct children; parents are found with a stack per thread
+    std::vector<double> childMs(zones.size(), 0.0);
+    std::vector<size_t> open;
+    for (size_t i = 0; i < zones.size(); ++i) {
+        if (i > 0 && zones[i].thread != zones[i - 1].thread) open.clear();
+        while (!open.empty() && zones[open.back()].depth >= zones[i].depth) open.pop_back();
+        if (!open.empty()) childMs[open.back()] += zones[i].milliseconds();
+        open.push_back(i);
+    }
+    std::map<std::string, Summary> byName;
+    for (size_t i = 0; i < zones.size(); ++i) {
+        Summary& entry = byName[zones[i].name];
+        entry.calls++;
+        entry.totalMs += zones[i].milliseconds();
+        entry.selfMs += zones[i].milliseconds() - childMs[i];
+    }
+    for (auto& entry : byName) {
+        entry.second.name = entry.first;
+        summary.push_back(entry.second);
+    }
+    std::sort(summary.begin(), summary.end(), [](const Summary& a, const Summary& b) { return a.selfMs > b.selfMs; });
+
+    // GPU passes go in a lane of their own after the threads, without entering the summary
+    if (!gpuTimer || zones.empty()) return;
+    uint32_t gpuLane = static_cast<uint32_t>(threadNames.size());
+    size_t cpuZones = zones.size();
+    for (const GpuPassTimer::Result& result : gpuTimer->getHistory()) {
+        for (const GpuPassTimer::Interval& interval : result.intervals) {
+            if (interval.startNs < rangeStart || interval.startNs >= rangeEnd || interval.endNs <= interval.startNs) continue;
+            Profiler::Zone zone;
+            zone.name = RecordingRenderDevice::passName(interval.pass);
+            zone.startNs = interval.startNs;
+            zone.endNs = interval.endNs;
+            zone.thread = gpuLane;
+            zones.push_back(zone);
+        }
+    }
+    if (zones.size() > cpuZones) threadNames.push_back("GPU");
+}
+
+void ProfilerPanel::draw(const std::string& title, const GpuPassTimer* gpuTimer) {
+    ImGui::Begin(title.c_str());
+
+    bool capture = Profiler::isEnabled();
+    if (ImGui::Checkbox("Capture", &capture)) Profiler::setEnabled(capture);
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &paused);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(120.0f);
+    ImGui::SliderInt("Frames", &framesShown, 1, 16);
+
+    ImGui::InputText("##TracePath", exportPath, sizeof(exportPath));
+    ImGui::SameLine();
+    if (ImGui::Button("Export Chrome Trace")) {
+        size_t zoneCount = 0;
+        std::string error;
+        if (Profiler::exportChromeTrace(exportPath, &zoneCount, &error)) {
+            char message[320];
+            std::snprintf(message, sizeof(message), "Wrote %zu zones to %s", zoneCount, exportPath);
+            exportStatus = message;
+            logger.addLog("Profiler: " + exportStatus);
+        }
+        else {
+            exportStatus = error;
+            logger.addLog("[ERROR] Profiler trace export failed: " + error);
+        }
+    }
+    if (!exportStatus.empty()) ImGui::TextUnformatted(exportStatus.c_str());
+
+    if (gpuTimer && gpuTimer->isAvailable()) drawGpuPasses(*gpuTimer); // Timed even while capture is off
+    if (!paused && capture) refresh(gpuTimer);
+    if (zones.empty()) {
+        ImGui::TextDisabled(capture ? "Waiting for frames..." : "Capture is off.");
+        ImGui::End();
+        return;
+    }
+    double frameMs = (rangeEnd - rangeStart) / 1e6 / std::max<size_t>(frameMarks.size() - 1, 1);
+    ImGui::Text("%zu zones over %zu frames, %.2f ms/frame", zones.size(), frameMarks.size() - 1, frameMs);
+
+    drawTimeline();
+    drawSummary();
+    ImGui::End();
+}
+
+void ProfilerPanel::drawTimeline() {
+    const float labelWidth = 110.0f;
+    float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+
+    // One lane per thread with zones, tall enough for its deepest nesting
+    std::vector<uint32_t> laneRows(threadNames.size(), 0);
+    for (const Profiler::Zone& zone : zones) {
+        if (zone.thread < laneRows.size()) laneRows[zone.thread] = std::max(laneRows[zone.thread], zone.depth + 1);
+    }
+    std::vector<float> laneY(laneRows.size(), 0.0f);
+    float height = rowHeight; // Time ruler
+    for (size_t t = 0; t < laneRows.size(); ++t) {
+        laneY[t] = height;
+        if (laneRows[t]) height += laneRows[t] * rowHeight + 4.0f;
+    }
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(ImGui::GetContentRegionAvail().x, labelWidth + 50.0f);
+    ImGui::InvisibleButton("##Timeline", ImVec2(width, height));
+    ImGui::SetItemKeyOwner(ImGuiKey_MouseWheelY); // Wheel zooms instead of scrolling the window
+    float trackX = origin.x + labelWidth;
+    float trackWidth = width - labelWidth;
+
+    // --- Zoom and pan ---
+    ImGuiIO& io = ImGui::GetIO();
+    double span = viewEnd - viewStart;
+    if (ImGui::IsItemHovered()) {
+        if (io.MouseWheel != 0.0f) {
+            double anchor = viewStart + span * std::min(std::max((io.MousePos.x - trackX) / trackWidth, 0.0f), 1.0f);
+            double newSpan = std::min(std::max(span * std::pow(0.8, io.MouseWheel), 1e-4), 1.0);
+            viewStart = anchor - (anchor - viewStart) * newSpan / span;
+            span = newSpan;
+        }
+        if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+            viewStart = 0.0;
+            span = 1.0;
+        }
+    }
+    if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
+        viewStart -= io.MouseDelta.x / trackWidth * span;
+    }
+    viewStart = std::min(std::max(viewStart, 0.0), 1.0 - span);
+    viewEnd = viewStart + span;
+
+    double rangeNs = static_cast<double>(rangeEnd - rangeStart);
+    auto toX = [&](uint64_t time) {
+        return trackX + static_cast<float>(((time - rangeStart) / rangeNs - viewStart) / span * trackWidth);
+    };
+
+    // --- Lanes and frame boundaries ---
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImU32 textColor = ImGui::GetColorU32(ImGuiCol_Text);
+    for (size_t t = 0; t < laneRows.size(); ++t) {
+        if (!laneRows[t]) continue;
+        float y = origin.y + laneY[t];
+        drawList->AddRectFilled(ImVec2(origin.x, y), ImVec2(origin.x + width, y + laneRows[t] * rowHeight),
+            ImGui::GetColorU32(ImGuiCol_FrameBg));
+        drawList->AddText(ImVec2(origin.x + 4.0f, y + 2.0f), textColor, threadNames[t].c_str());
+    }
+    drawList->PushClipRect(ImVec2(trackX, origin.y), ImVec2(trackX + trackWidth, origin.y + height), true);
+    for (size_t f = 0; f < frameMarks.size(); ++f) {
+        float x = toX(frameMarks[f]);
+        drawList->AddLine(ImVec2(x, origin.y), ImVec2(x, origin.y + height), ImGui::GetColorU32(ImGuiCol_Separator));
+        if (f + 1 < frameMarks.size()) {
+            char label[32];
+            std::snprintf(label, sizeof(label), "%.2f ms", (frameMarks[f + 1] - frameMarks[f]) / 1e6);
+            drawList->AddText(ImVec2(x + 4.0f, origin.y + 1.0f), textColor, label);
+        }
+    }
+
+    // --- Zones ---
+    const Profiler::Zone* hovered = nullptr;
+    ImFont* font = ImGui::GetFont();
+    float fontSize = ImGui::GetFontSize();
+    for (const Profiler::Zone& zone : zones) {
+        float x0 = toX(zone.startNs);
+        float x1 = std::max(toX(zone.endNs), x0 + 1.0f);
+        if (x1 < trackX || x0 > trackX + trackWidth) continue;
+        float y0 = origin.y + laneY[zone.thread] + zone.depth * rowHeight;
+        ImVec2 min(x0, y0 + 1.0f), max(x1, y0 + rowHeight - 1.0f);
+        drawList->AddRectFilled(min, max, zoneColor(zone.name));
+        if (x1 - x0 > 24.0f) {
+            ImVec4 clip(std::max(x0, trackX), min.y, std::min(x1, trackX + trackWidth) - 2.0f, max.y);
+            drawList->AddText(font, fontSize, ImVec2(std::max(x0, trackX) + 3.0f, y0 + 2.0f), IM_COL32(0, 0, 0, 255), zone.name, nullptr, 0.0f, &clip);
+        }
+        if (ImGui::IsItemHovered() && ImGui::IsMouseHoveringRect(min, max)) hovered = &zone;
+    }
+    drawList->PopClipRect();
+
+    if (hovered) {
+        ImGui::BeginTooltip();
+        ImGui::TextUnformatted(hovered->name);
+        ImGui::Text("%.3f ms on %s, depth %u", hovered->milliseconds(), threadNames[hovered->thread].c_str(), hovered->depth);
+        ImGui::EndTooltip();
+    }
+}
+
+void ProfilerPanel::drawSummary() {
+    double frames = static_cast<double>(std::max<size_t>(frameMarks.size() - 1, 1));
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY;
+    if (!ImGui::BeginTable("##ProfilerSummary", 4, flags, ImVec2(0.0f, 0.0f))) return;
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Zone", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("Calls/frame");
+    ImGui::TableSetupColumn("Total ms/frame");
+    ImGui::TableSetupColumn("Self ms/frame");
+    ImGui::TableHeadersRow();
+    for (const Summary& entry : summary) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(entry.name.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", entry.calls / frames);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", entry.totalMs / frames);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", entry.selfMs / frames);
+    }
+    ImGui::EndTable();
+}
+
+// Last, average and worst GPU time per pass over the timer's history
+void ProfilerPanel::drawGpuPasses(const GpuPassTimer& gpuTimer) {
+    const std::deque<GpuPassTimer::Result>& history = gpuTimer.getHistory();
+    if (history.empty()) return;
+    double sum[GpuPassTimer::PassCount] = {}, worst[GpuPassTimer::PassCount] = {};
+    double frameSum = 0.0;
+    for (const GpuPassTimer::Result& result : history) {
+        for (int pass = 0; pass < GpuPassTimer::PassCount; ++pass) {
+            sum[pass] += result.passMs[pass];
+            worst[pass] = std::max(worst[pass], result.passMs[pass]);
+        }
+        frameSum += result.frameMs;
+    }
+    const GpuPassTimer::Result& last = history.back();
+    ImGui::Text("GPU: %.3f ms/frame over %zu frames (%llu untimed while the GPU was behind)",
+        frameSum / history.size(), history.size(), static_cast<unsigned long long>(gpuTimer.getSkippedFrames()));
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+    if (!ImGui::BeginTable("##GpuPasses", 4, flags)) return;
+    ImGui::TableSetupColumn("GPU pass");
+    ImGui::TableSetupColumn("Last ms");
+    ImGui::TableSetupColumn("Avg ms");
+    ImGui::TableSetupColumn("Max ms");
+    ImGui::TableHeadersRow();
+    for (int pass = 0; pass < GpuPassTimer::PassCount; ++pass) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(RecordingRenderDevice::passName(static_cast<RenderPass>(pass)));
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", last.passMs[pass]);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", sum[pass] / history.size());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", worst[pass]);
+    }
+    ImGui::EndTable();
+}
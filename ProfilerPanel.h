@@ -0,0 +1,48 @@
+// ProfilerPanel.h
+#pragma once
+#include "Profiler.h"
+#include "GpuPassTimer.h"
+#include <string>
+#include <vector>
+
+// "Profiler" window: a timeline of the last few frames, one lane per thread with nested zones
+// stacked below their parents, and a table of where the time went (total and self time per
+// zone name). Mouse wheel zooms the timeline, dragging pans it, double-click resets.
+// With a GpuPassTimer it adds a GPU lane (passes on the same clock, as far as their results
+// are back) and a table of GPU time per pass.
+class ProfilerPanel {
+public:
+    ProfilerPanel();
+
+    void draw(const std::string& title, const GpuPassTimer* gpuTimer = nullptr); // Own window, like Logger::draw
+
+private:
+    struct Summary {
+        std::string name;
+        size_t calls = 0;
+        double totalMs = 0.0;
+        double selfMs = 0.0;
+    };
+
+    void refresh(const GpuPassTimer* gpuTimer);
+    void drawTimeline();
+    void drawSummary();
+    void drawGpuPasses(const GpuPassTimer& gpuTimer);
+
+    bool paused;
+    int framesShown;
+    char exportPath[256];
+    std::string exportStatus;
+
+    // Snapshot being shown
+    std::vector<Profiler::Zone> zones;
+    std::vector<uint64_t> frameMarks; // Inside [rangeStart, rangeEnd]
+    std::vector<std::string> threadNames;
+    std::vector<Summary> summary;
+    uint64_t rangeStart;
+    uint64_t rangeEnd;
+
+    // Visible part of the snapshot, 0..1
+    double viewStart;
+    double viewEnd;
+};
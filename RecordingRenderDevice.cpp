@@ -0,0 +1,379 @@
+// RecordingRenderDevice.cpp
+#include "RecordingRenderDevice.h"
+
+RecordingRenderDevice::RecordingRenderDevice(bool logCommands) :
+    forward(nullptr),
+    pass(RenderPass::Other),
+    logging(logCommands),
+    nextName(1),
+    bufferBytes(0),
+    boundVertexArray(0),
+    boundProgram(0),
+    textureUnit(GL_TEXTURE0)
+{
+    elementBuffers[0] = 0; // The default vertex array
+}
+
+RecordingRenderDevice::RecordingRenderDevice(RenderDevice& forwardTo, bool logCommands) :
+    RecordingRenderDevice(logCommands)
+{
+    forward = &forwardTo;
+}
+
+void RecordingRenderDevice::Stats::add(const Stats& other) {
+    commands += other.commands;
+    for (int op = 0; op < OpCount; ++op) perOp[op] += other.perOp[op];
+    uploads += other.uploads;
+    uploadBytes += other.uploadBytes;
+    allocatedBytes += other.allocatedBytes;
+    binds += other.binds;
+    redundantBinds += other.redundantBinds;
+    programBinds += other.programBinds;
+    vertexArrayBinds += other.vertexArrayBinds;
+    bufferBinds += other.bufferBinds;
+    textureBinds += other.textureBinds;
+    uniformSets += other.uniformSets;
+    uniformLookups += other.uniformLookups;
+    stateChanges += other.stateChanges;
+    drawCalls += other.drawCalls;
+    instancedDraws += other.instancedDraws;
+    instances += other.instances;
+    elements += other.elements;
+    triangles += other.triangles;
+}
+
+void RecordingRenderDevice::resetStats() {
+    stats = Stats();
+    for (Stats& passTotal : passStats) passTotal = Stats();
+}
+
+void RecordingRenderDevice::addExternal(RenderPass externalPass, const Stats& counts) {
+    stats.add(counts);
+    passStats[static_cast<int>(externalPass)].add(counts);
+}
+
+const char* RecordingRenderDevice::opName(Op op) {
+    static const char* const names[OpCount] = {
+        "genBuffers", "deleteBuffers", "bindBuffer", "bufferData", "bufferSubData",
+        "genVertexArrays", "deleteVertexArrays", "bindVertexArray", "enableVertexAttribArray",
+        "vertexAttribPointer", "vertexAttribIPointer", "vertexAttribDivisor",
+        "genTextures", "deleteTextures", "activeTexture", "bindTexture", "texBuffer",
+        "loadProgram", "deleteProgram", "useProgram", "getUniformLocation", "uniform",
+        "lineWidth", "pointSize",
+        "drawArrays", "drawElements", "drawArraysInstanced", "drawElementsInstanced"
+    };
+    return op < OpCount ? names[op] : "unknown";
+}
+
+const char* RecordingRenderDevice::passName(RenderPass pass) {
+    static const char* const names[] = { "Other", "Sky", "Strokes", "Preview", "ImGui" };
+    return pass < RenderPass::Count ? names[static_cast<int>(pass)] : "unknown";
+}
+
+// --- Bookkeeping ---
+
+void RecordingRenderDevice::record(Op op, GLenum target, GLuint object, size_t bytes, GLsizei count, GLsizei instances) {
+    add(&Stats::commands);
+    stats.perOp[op]++;
+    passStats[static_cast<int>(pass)].perOp[op]++;
+    if (logging) {
+        Command command = { op, target, object, bytes, count, instances };
+        log.push_back(command);
+    }
+}
+
+void RecordingRenderDevice::add(size_t Stats::*counter, size_t amount) {
+    stats.*counter += amount;
+    passStats[static_cast<int>(pass)].*counter += amount;
+}
+
+void RecordingRenderDevice::bind(GLuint& slot, GLuint object, size_t Stats::*kind) {
+    add(&Stats::binds);
+    add(kind);
+    if (slot == object) add(&Stats::redundantBinds);
+    slot = object;
+}
+
+GLuint RecordingRenderDevice::newName() {
+    return nextName++;
+}
+
+GLuint& RecordingRenderDevice::boundBuffer(GLenum target) {
+    if (target == GL_ELEMENT_ARRAY_BUFFER) return elementBuffers[boundVertexArray];
+    return boundBuffers[target];
+}
+
+void RecordingRenderDevice::upload(size_t bytes, bool hasData) {
+    if (hasData) {
+        add(&Stats::uploads);
+        add(&Stats::uploadBytes, bytes);
+    }
+    else {
+        add(&Stats::allocatedBytes, bytes);
+    }
+}
+
+void RecordingRenderDevice::draw(Op op, GLenum mode, GLsizei count, GLsizei instances) {
+    record(op, mode, boundVertexArray, 0, count, instances);
+    size_t triangles = 0;
+    if (mode == GL_TRIANGLES) triangles = count / 3;
+    else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count > 2) triangles = count - 2;
+    add(&Stats::drawCalls);
+    if (op == DrawArraysInstanced || op == DrawElementsInstanced) add(&Stats::instancedDraws);
+    add(&Stats::instances, instances);
+    add(&Stats::elements, static_cast<size_t>(count) * instances);
+    add(&Stats::triangles, triangles * instances);
+}
+
+void RecordingRenderDevice::beginPass(RenderPass newPass) {
+    pass = newPass;
+    if (forward) forward->beginPass(newPass);
+}
+
+// --- Buffers ---
+
+void RecordingRenderDevice::genBuffers(GLsizei n, GLuint* buffers) {
+    if (forward) forward->genBuffers(n, buffers);
+    for (GLsizei i = 0; i < n; ++i) {
+        if (!forward) buffers[i] = newName();
+        bufferSizes[buffers[i]] = 0;
+    }
+    record(GenBuffers, 0, n > 0 ? buffers[0] : 0);
+}
+
+void RecordingRenderDevice::deleteBuffers(GLsizei n, const GLuint* buffers) {
+    for (GLsizei i = 0; i < n; ++i) {
+        auto found = bufferSizes.find(buffers[i]);
+        if (found == bufferSizes.end()) continue; // 0 and unknown names are ignored, as in GL
+        bufferBytes -= found->second;
+        bufferSizes.erase(found);
+        // Deleting a bound buffer unbinds it
+        for (auto& entry : boundBuffers) if (entry.second == buffers[i]) entry.second = 0;
+        for (auto& entry : elementBuffers) if (entry.second == buffers[i]) entry.second = 0;
+    }
+    record(DeleteBuffers, 0, n > 0 ? buffers[0] : 0);
+    if (forward) forward->deleteBuffers(n, buffers);
+}
+
+void RecordingRenderDevice::bindBuffer(GLenum target, GLuint buffer) {
+    bind(boundBuffer(target), buffer, &Stats::bufferBinds);
+    record(BindBuffer, target, buffer);
+    if (forward) forward->bindBuffer(target, buffer);
+}
+
+void RecordingRenderDevice::bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    GLuint buffer = boundBuffer(target);
+    auto found = bufferSizes.find(buffer);
+    if (found != bufferSizes.end()) {
+        bufferBytes += static_cast<size_t>(size) - found->second;
+        found->second = static_cast<size_t>(size);
+    }
+    upload(static_cast<size_t>(size), data != nullptr);
+    record(BufferData, target, buffer, static_cast<size_t>(size));
+    if (forward) forward->bufferData(target, size, data, usage);
+}
+
+void RecordingRenderDevice::bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    GLuint buffer = boundBuffer(target);
+    upload(static_cast<size_t>(size), data != nullptr);
+    record(BufferSubData, target, buffer, static_cast<size_t>(size));
+    if (forward) forward->bufferSubData(target, offset, size, data);
+}
+
+// --- Vertex arrays ---
+
+void RecordingRenderDevice::genVertexArrays(GLsizei n, GLuint* arrays) {
+    if (forward) forward->genVertexArrays(n, arrays);
+    for (GLsizei i = 0; i < n; ++i) {
+        if (!forward) arrays[i] = newName();
+        elementBuffers[arrays[i]] = 0;
+    }
+    record(GenVertexArrays, 0, n > 0 ? arrays[0] : 0);
+}
+
+void RecordingRenderDevice::deleteVertexArrays(GLsizei n, const GLuint* arrays) {
+    for (GLsizei i = 0; i < n; ++i) {
+        if (arrays[i] == 0) continue;
+        elementBuffers.erase(arrays[i]);
+        if (boundVertexArray == arrays[i]) boundVertexArray = 0;
+    }
+    record(DeleteVertexArrays, 0, n > 0 ? arrays[0] : 0);
+    if (forward) forward->deleteVertexArrays(n, arrays);
+}
+
+void RecordingRenderDevice::bindVertexArray(GLuint array) {
+    bind(boundVertexArray, array, &Stats::vertexArrayBinds);
+    record(BindVertexArray, 0, array);
+    if (forward) forward->bindVertexArray(array);
+}
+
+void RecordingRenderDevice::enableVertexAttribArray(GLuint index) {
+    add(&Stats::stateChanges);
+    record(EnableVertexAttribArray, 0, index);
+    if (forward) forward->enableVertexAttribArray(index);
+}
+
+void RecordingRenderDevice::vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) {
+    add(&Stats::stateChanges);
+    record(VertexAttribPointer, type, index);
+    if (forward) forward->vertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void RecordingRenderDevice::vertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer) {
+    add(&Stats::stateChanges);
+    record(VertexAttribIPointer, type, index);
+    if (forward) forward->vertexAttribIPointer(index, size, type, stride, pointer);
+}
+
+void RecordingRenderDevice::vertexAttribDivisor(GLuint index, GLuint divisor) {
+    add(&Stats::stateChanges);
+    record(VertexAttribDivisor, 0, index);
+    if (forward) forward->vertexAttribDivisor(index, divisor);
+}
+
+// --- Textures ---
+
+void RecordingRenderDevice::genTextures(GLsizei n, GLuint* names) {
+    if (forward) forward->genTextures(n, names);
+    for (GLsizei i = 0; i < n; ++i) {
+        if (!forward) names[i] = newName();
+        textures.insert(names[i]);
+    }
+    record(GenTextures, 0, n > 0 ? names[0] : 0);
+}
+
+void RecordingRenderDevice::deleteTextures(GLsizei n, const GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) {
+        if (!textures.erase(names[i])) continue;
+        for (auto& entry : boundTextures) if (entry.second == names[i]) entry.second = 0;
+    }
+    record(DeleteTextures, 0, n > 0 ? names[0] : 0);
+    if (forward) forward->deleteTextures(n, names);
+}
+
+void RecordingRenderDevice::activeTexture(GLenum unit) {
+    add(&Stats::stateChanges);
+    textureUnit = unit;
+    record(ActiveTexture, unit);
+    if (forward) forward->activeTexture(unit);
+}
+
+void RecordingRenderDevice::bindTexture(GLenum target, GLuint texture) {
+    bind(boundTextures[(static_cast<uint64_t>(textureUnit) << 32) | target], texture, &Stats::textureBinds);
+    record(BindTexture, target, texture);
+    if (forward) forward->bindTexture(target, texture);
+}
+
+void RecordingRenderDevice::texBuffer(GLenum target, GLenum internalFormat, GLuint buffer) {
+    add(&Stats::stateChanges);
+    record(TexBuffer, target, buffer);
+    if (forward) forward->texBuffer(target, internalFormat, buffer);
+}
+
+// --- Programs and uniforms ---
+
+GLuint RecordingRenderDevice::loadProgram(const char* vertexPath, const char* fragmentPath) {
+    // Without a real device there is nothing to compile: every program "links"
+    GLuint program = forward ? forward->loadProgram(vertexPath, fragmentPath) : newName();
+    record(LoadProgram, 0, program);
+    return program;
+}
+
+void RecordingRenderDevice::deleteProgram(GLuint program) {
+    if (boundProgram == program) boundProgram = 0;
+    record(DeleteProgram, 0, program);
+    if (forward) forward->deleteProgram(program);
+}
+
+void RecordingRenderDevice::useProgram(GLuint program) {
+    bind(boundProgram, program, &Stats::programBinds);
+    record(UseProgram, 0, program);
+    if (forward) forward->useProgram(program);
+}
+
+GLint RecordingRenderDevice::getUniformLocation(GLuint program, const GLchar* name) {
+    add(&Stats::uniformLookups);
+    GLint location;
+    if (forward) {
+        location = forward->getUniformLocation(program, name);
+    }
+    else {
+        // One location per name, whatever the program: enough to tell the uniforms apart in the log
+        auto inserted = uniformLocations.insert(std::make_pair(std::string(name), static_cast<GLint>(uniformLocations.size())));
+        location = inserted.first->second;
+    }
+    record(GetUniformLocation, 0, static_cast<GLuint>(location));
+    return location;
+}
+
+void RecordingRenderDevice::uniform1i(GLint location, GLint value) {
+    add(&Stats::uniformSets);
+    record(Uniform, 0, static_cast<GLuint>(location), sizeof(GLint));
+    if (forward) forward->uniform1i(location, value);
+}
+
+void RecordingRenderDevice::uniform1f(GLint location, GLfloat value) {
+    add(&Stats::uniformSets);
+    record(Uniform, 0, static_cast<GLuint>(location), sizeof(GLfloat));
+    if (forward) forward->uniform1f(location, value);
+}
+
+void RecordingRenderDevice::uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) {
+    add(&Stats::uniformSets);
+    record(Uniform, 0, static_cast<GLuint>(location), 3 * sizeof(GLfloat));
+    if (forward) forward->uniform3f(location, x, y, z);
+}
+
+void RecordingRenderDevice::uniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+    add(&Stats::uniformSets);
+    record(Uniform, 0, static_cast<GLuint>(location), count * 3 * sizeof(GLfloat));
+    if (forward) forward->uniform3fv(location, count, value);
+}
+
+void RecordingRenderDevice::uniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+    add(&Stats::uniformSets);
+    record(Uniform, 0, static_cast<GLuint>(location), count * 4 * sizeof(GLfloat));
+    if (forward) forward->uniform4fv(location, count, value);
+}
+
+void RecordingRenderDevice::uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    add(&Stats::uniformSets);
+    record(Uniform, 0, static_cast<GLuint>(location), count * 16 * sizeof(GLfloat));
+    if (forward) forward->uniformMatrix4fv(location, count, transpose, value);
+}
+
+// --- Fixed-function state ---
+
+void RecordingRenderDevice::lineWidth(GLfloat width) {
+    add(&Stats::stateChanges);
+    record(LineWidth);
+    if (forward) forward->lineWidth(width);
+}
+
+void RecordingRenderDevice::pointSize(GLfloat size) {
+    add(&Stats::stateChanges);
+    record(PointSize);
+    if (forward) forward->pointSize(size);
+}
+
+// --- Draws ---
+
+void RecordingRenderDevice::drawArrays(GLenum mode, GLint first, GLsizei count) {
+    draw(DrawArrays, mode, count, 1);
+    if (forward) forward->drawArrays(mode, first, count);
+}
+
+void RecordingRenderDevice::drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    draw(DrawElements, mode, count, 1);
+    if (forward) forward->drawElements(mode, count, type, indices);
+}
+
+void RecordingRenderDevice::drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) {
+    draw(DrawArraysInstanced, mode, count, instanceCount);
+    if (forward) forward->drawArraysInstanced(mode, first, count, instanceCount);
+}
+
+void RecordingRenderDevice::drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount) {
+    draw(DrawElementsInstanced, mode, count, instanceCount);
+    if (forward) forward->drawElementsInstanced(mode, count, type, indices, instanceCount);
+}
@@ -0,0 +1,153 @@
+// RecordingRenderDevice.h
+#pragma once
+#include "RenderDevice.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstddef>
+#include <cstdint>
+
+// Null render device: executes nothing, counts everything. Hands out fake object names, tracks
+// what is bound and how big every buffer is, and can keep a log of each command. Lets the
+// Painter's submission be checked ("unchanged strokes upload nothing", "N strokes take fewer
+// than M draw calls") and its CPU cost profiled on machines without a GPU or a GL context.
+// Wrapped around a real device it forwards every command after counting it, which is how the
+// app gets its live per-pass counters.
+class RecordingRenderDevice : public RenderDevice {
+public:
+    enum Op : uint8_t {
+        GenBuffers, DeleteBuffers, BindBuffer, BufferData, BufferSubData,
+        GenVertexArrays, DeleteVertexArrays, BindVertexArray, EnableVertexAttribArray,
+        VertexAttribPointer, VertexAttribIPointer, VertexAttribDivisor,
+        GenTextures, DeleteTextures, ActiveTexture, BindTexture, TexBuffer,
+        LoadProgram, DeleteProgram, UseProgram, GetUniformLocation, Uniform,
+        LineWidth, PointSize,
+        DrawArrays, DrawElements, DrawArraysInstanced, DrawElementsInstanced,
+        OpCount
+    };
+
+    struct Command {
+        Op op;
+        GLenum target;     // Buffer/texture target, or the primitive mode of a draw
+        GLuint object;     // Buffer, array, texture or program name; location for Uniform
+        size_t bytes;      // Uploaded (or allocated) bytes
+        GLsizei count;     // Vertices or indices per instance
+        GLsizei instances;
+    };
+
+    struct Stats {
+        size_t commands = 0;
+        size_t perOp[OpCount] = {};
+        size_t uploads = 0;         // bufferData/bufferSubData calls that carried data
+        size_t uploadBytes = 0;
+        size_t allocatedBytes = 0;  // bufferData without data: storage only
+        size_t binds = 0;           // Buffer, vertex array, texture and program binds
+        size_t redundantBinds = 0;  // Binds of what was already bound
+        size_t programBinds = 0;
+        size_t vertexArrayBinds = 0;
+        size_t bufferBinds = 0;
+        size_t textureBinds = 0;
+        size_t uniformSets = 0;
+        size_t uniformLookups = 0;  // getUniformLocation calls
+        size_t stateChanges = 0;    // Line width, point size, texture unit, attribute setup
+        size_t drawCalls = 0;
+        size_t instancedDraws = 0;
+        size_t instances = 0;
+        size_t elements = 0;        // Vertices or indices submitted, over all instances
+        size_t triangles = 0;       // Over all instances
+
+        void add(const Stats& other);
+    };
+
+    explicit RecordingRenderDevice(bool logCommands = false);
+    // Counts, then forwards every command to 'forwardTo' (whose object names are used)
+    explicit RecordingRenderDevice(RenderDevice& forwardTo, bool logCommands = false);
+
+    const Stats& getStats() const { return stats; }
+    const Stats& getPassStats(RenderPass pass) const { return passStats[static_cast<int>(pass)]; }
+    void resetStats(); // Zeroes the counters (every pass); objects and bindings are kept
+    // Adds work done behind the device's back (e.g. by the ImGui backend) to a pass and the total
+    void addExternal(RenderPass pass, const Stats& counts);
+    static const char* passName(RenderPass pass);
+
+    // Objects alive right now
+    size_t getBufferCount() const { return bufferSizes.size(); }
+    size_t getBufferBytes() const { return bufferBytes; }
+    size_t getVertexArrayCount() const { return elementBuffers.size() - 1; } // Minus the default array
+    size_t getTextureCount() const { return textures.size(); }
+
+    void setLogging(bool enabled) { logging = enabled; }
+    const std::vector<Command>& getLog() const { return log; }
+    void clearLog() { log.clear(); }
+    static const char* opName(Op op);
+
+    void beginPass(RenderPass pass) override;
+
+    void genBuffers(GLsizei n, GLuint* buffers) override;
+    void deleteBuffers(GLsizei n, const GLuint* buffers) override;
+    void bindBuffer(GLenum target, GLuint buffer) override;
+    void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+    void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) override;
+
+    void genVertexArrays(GLsizei n, GLuint* arrays) override;
+    void deleteVertexArrays(GLsizei n, const GLuint* arrays) override;
+    void bindVertexArray(GLuint array) override;
+    void enableVertexAttribArray(GLuint index) override;
+    void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) override;
+    void vertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer) override;
+    void vertexAttribDivisor(GLuint index, GLuint divisor) override;
+
+    void genTextures(GLsizei n, GLuint* textures) override;
+    void deleteTextures(GLsizei n, const GLuint* textures) override;
+    void activeTexture(GLenum unit) override;
+    void bindTexture(GLenum target, GLuint texture) override;
+    void texBuffer(GLenum target, GLenum internalFormat, GLuint buffer) override;
+
+    GLuint loadProgram(const char* vertexPath, const char* fragmentPath) override;
+    void deleteProgram(GLuint program) override;
+    void useProgram(GLuint program) override;
+    GLint getUniformLocation(GLuint program, const GLchar* name) override;
+    void uniform1i(GLint location, GLint value) override;
+    void uniform1f(GLint location, GLfloat value) override;
+    void uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) override;
+    void uniform3fv(GLint location, GLsizei count, const GLfloat* value) override;
+    void uniform4fv(GLint location, GLsizei count, const GLfloat* value) override;
+    void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) override;
+
+    void lineWidth(GLfloat width) override;
+    void pointSize(GLfloat size) override;
+
+    void drawArrays(GLenum mode, GLint first, GLsizei count) override;
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) override;
+    void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) override;
+    void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount) override;
+
+private:
+    void record(Op op, GLenum target = 0, GLuint object = 0, size_t bytes = 0, GLsizei count = 0, GLsizei instances = 0);
+    void add(size_t Stats::*counter, size_t amount = 1); // To the total and the current pass
+    void bind(GLuint& slot, GLuint object, size_t Stats::*kind);
+    GLuint newName(); // Fake names when nothing is forwarded
+    GLuint& boundBuffer(GLenum target); // Element buffers are vertex array state, like in GL
+    void upload(size_t bytes, bool hasData);
+    void draw(Op op, GLenum mode, GLsizei count, GLsizei instances);
+
+    RenderDevice* forward; // Null for a pure recorder
+    Stats stats;
+    Stats passStats[static_cast<int>(RenderPass::Count)];
+    RenderPass pass;
+    bool logging;
+    std::vector<Command> log;
+    GLuint nextName; // Never reused, so a stale handle can't alias a new object
+
+    std::unordered_map<GLuint, size_t> bufferSizes;      // Live buffers
+    size_t bufferBytes;
+    std::unordered_map<GLuint, GLuint> elementBuffers;   // Live vertex arrays (and 0) -> element buffer
+    std::unordered_set<GLuint> textures;
+    std::unordered_map<GLenum, GLuint> boundBuffers;     // Every target but GL_ELEMENT_ARRAY_BUFFER
+    std::unordered_map<uint64_t, GLuint> boundTextures;  // (unit, target) -> texture
+    std::unordered_map<std::string, GLint> uniformLocations;
+    GLuint boundVertexArray;
+    GLuint boundProgram;
+    GLenum textureUnit;
+};
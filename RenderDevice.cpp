@@ -0,0 +1,75 @@
+// RenderDevice.cpp
+#include "RenderDevice.h"
+#include "Shader.h"
+#include "GpuPassTimer.h"
+
+void GLRenderDevice::beginPass(RenderPass pass) {
+    if (passTimer) passTimer->markPass(pass);
+}
+
+// --- Buffers ---
+
+void GLRenderDevice::genBuffers(GLsizei n, GLuint* buffers) { glGenBuffers(n, buffers); }
+void GLRenderDevice::deleteBuffers(GLsizei n, const GLuint* buffers) { glDeleteBuffers(n, buffers); }
+void GLRenderDevice::bindBuffer(GLenum target, GLuint buffer) { glBindBuffer(target, buffer); }
+void GLRenderDevice::bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) { glBufferData(target, size, data, usage); }
+void GLRenderDevice::bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) { glBufferSubData(target, offset, size, data); }
+
+// --- Vertex arrays ---
+
+void GLRenderDevice::genVertexArrays(GLsizei n, GLuint* arrays) { glGenVertexArrays(n, arrays); }
+void GLRenderDevice::deleteVertexArrays(GLsizei n, const GLuint* arrays) { glDeleteVertexArrays(n, arrays); }
+void GLRenderDevice::bindVertexArray(GLuint array) { glBindVertexArray(array); }
+void GLRenderDevice::enableVertexAttribArray(GLuint index) { glEnableVertexAttribArray(index); }
+
+void GLRenderDevice::vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) {
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void GLRenderDevice::vertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer) {
+    glVertexAttribIPointer(index, size, type, stride, pointer);
+}
+
+void GLRenderDevice::vertexAttribDivisor(GLuint index, GLuint divisor) { glVertexAttribDivisor(index, divisor); }
+
+// --- Textures ---
+
+void GLRenderDevice::genTextures(GLsizei n, GLuint* textures) { glGenTextures(n, textures); }
+void GLRenderDevice::deleteTextures(GLsizei n, const GLuint* textures) { glDeleteTextures(n, textures); }
+void GLRenderDevice::activeTexture(GLenum unit) { glActiveTexture(unit); }
+void GLRenderDevice::bindTexture(GLenum target, GLuint texture) { glBindTexture(target, texture); }
+void GLRenderDevice::texBuffer(GLenum target, GLenum internalFormat, GLuint buffer) { glTexBuffer(target, internalFormat, buffer); }
+
+// --- Programs and uniforms ---
+
+GLuint GLRenderDevice::loadProgram(const char* vertexPath, const char* fragmentPath) { return loadShader(vertexPath, fragmentPath); }
+void GLRenderDevice::deleteProgram(GLuint program) { glDeleteProgram(program); }
+void GLRenderDevice::useProgram(GLuint program) { glUseProgram(program); }
+GLint GLRenderDevice::getUniformLocation(GLuint program, const GLchar* name) { return glGetUniformLocation(program, name); }
+void GLRenderDevice::uniform1i(GLint location, GLint value) { glUniform1i(location, value); }
+void GLRenderDevice::uniform1f(GLint location, GLfloat value) { glUniform1f(location, value); }
+void GLRenderDevice::uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) { glUniform3f(location, x, y, z); }
+void GLRenderDevice::uniform3fv(GLint location, GLsizei count, const GLfloat* value) { glUniform3fv(location, count, value); }
+void GLRenderDevice::uniform4fv(GLint location, GLsizei count, const GLfloat* value) { glUniform4fv(location, count, value); }
+
+void GLRenderDevice::uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    glUniformMatrix4fv(location, count, transpose, value);
+}
+
+// --- Fixed-function state ---
+
+void GLRenderDevice::lineWidth(GLfloat width) { glLineWidth(width); }
+void GLRenderDevice::pointSize(GLfloat size) { glPointSize(size); }
+
+// --- Draws ---
+
+void GLRenderDevice::drawArrays(GLenum mode, GLint first, GLsizei count) { glDrawArrays(mode, first, count); }
+void GLRenderDevice::drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) { glDrawElements(mode, count, type, indices); }
+
+void GLRenderDevice::drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) {
+    glDrawArraysInstanced(mode, first, count, instanceCount);
+}
+
+void GLRenderDevice::drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount) {
+    glDrawElementsInstanced(mode, count, type, indices, instanceCount);
+}
@@ -0,0 +1,118 @@
+// RenderDevice.h
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+
+class GpuPassTimer;
+
+// Parts of a frame, for per-pass statistics; Other covers setup work outside any pass
+enum class RenderPass : uint8_t { Other, Sky, Strokes, Preview, ImGui, Count };
+
+// Every GPU command the Painter issues goes through this interface. The calls mirror the GL
+// functions of the same name (minus the gl prefix) so Painter code reads like plain GL.
+// GLRenderDevice forwards to the driver; RecordingRenderDevice (RecordingRenderDevice.h) only
+// counts and logs, so submission can be checked and timed without a GPU or a context.
+class RenderDevice {
+public:
+    virtual ~RenderDevice() {}
+
+    // Marks the start of a pass; the commands that follow belong to it. Not a GL command: the
+    // recorder counts per pass, the GL device writes a timestamp when it has a GpuPassTimer.
+    virtual void beginPass(RenderPass) {}
+
+    // --- Buffers ---
+    virtual void genBuffers(GLsizei n, GLuint* buffers) = 0;
+    virtual void deleteBuffers(GLsizei n, const GLuint* buffers) = 0;
+    virtual void bindBuffer(GLenum target, GLuint buffer) = 0;
+    virtual void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) = 0;
+    virtual void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) = 0;
+
+    // --- Vertex arrays ---
+    virtual void genVertexArrays(GLsizei n, GLuint* arrays) = 0;
+    virtual void deleteVertexArrays(GLsizei n, const GLuint* arrays) = 0;
+    virtual void bindVertexArray(GLuint array) = 0;
+    virtual void enableVertexAttribArray(GLuint index) = 0;
+    virtual void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) = 0;
+    virtual void vertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer) = 0;
+    virtual void vertexAttribDivisor(GLuint index, GLuint divisor) = 0;
+
+    // --- Textures ---
+    virtual void genTextures(GLsizei n, GLuint* textures) = 0;
+    virtual void deleteTextures(GLsizei n, const GLuint* textures) = 0;
+    virtual void activeTexture(GLenum unit) = 0;
+    virtual void bindTexture(GLenum target, GLuint texture) = 0;
+    virtual void texBuffer(GLenum target, GLenum internalFormat, GLuint buffer) = 0;
+
+    // --- Programs and uniforms ---
+    // Compiles and links a vertex + fragment shader pair from files; 0 on failure
+    virtual GLuint loadProgram(const char* vertexPath, const char* fragmentPath) = 0;
+    virtual void deleteProgram(GLuint program) = 0;
+    virtual void useProgram(GLuint program) = 0;
+    virtual GLint getUniformLocation(GLuint program, const GLchar* name) = 0;
+    virtual void uniform1i(GLint location, GLint value) = 0;
+    virtual void uniform1f(GLint location, GLfloat value) = 0;
+    virtual void uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) = 0;
+    virtual void uniform3fv(GLint location, GLsizei count, const GLfloat* value) = 0;
+    virtual void uniform4fv(GLint location, GLsizei count, const GLfloat* value) = 0;
+    virtual void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) = 0;
+
+    // --- Fixed-function state ---
+    virtual void lineWidth(GLfloat width) = 0;
+    virtual void pointSize(GLfloat size) = 0;
+
+    // --- Draws ---
+    virtual void drawArrays(GLenum mode, GLint first, GLsizei count) = 0;
+    virtual void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) = 0;
+    virtual void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) = 0;
+    virtual void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount) = 0;
+};
+
+// The real thing: straight calls into the current GL context
+class GLRenderDevice : public RenderDevice {
+public:
+    // Pass changes become GPU timestamps in 'timer' (null: none)
+    void setPassTimer(GpuPassTimer* timer) { passTimer = timer; }
+    void beginPass(RenderPass pass) override;
+
+    void genBuffers(GLsizei n, GLuint* buffers) override;
+    void deleteBuffers(GLsizei n, const GLuint* buffers) override;
+    void bindBuffer(GLenum target, GLuint buffer) override;
+    void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+    void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) override;
+
+    void genVertexArrays(GLsizei n, GLuint* arrays) override;
+    void deleteVertexArrays(GLsizei n, const GLuint* arrays) override;
+    void bindVertexArray(GLuint array) override;
+    void enableVertexAttribArray(GLuint index) override;
+    void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) override;
+    void vertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer) override;
+    void vertexAttribDivisor(GLuint index, GLuint divisor) override;
+
+    void genTextures(GLsizei n, GLuint* textures) override;
+    void deleteTextures(GLsizei n, const GLuint* textures) override;
+    void activeTexture(GLenum unit) override;
+    void bindTexture(GLenum target, GLuint texture) override;
+    void texBuffer(GLenum target, GLenum internalFormat, GLuint buffer) override;
+
+    GLuint loadProgram(const char* vertexPath, const char* fragmentPath) override;
+    void deleteProgram(GLuint program) override;
+    void useProgram(GLuint program) override;
+    GLint getUniformLocation(GLuint program, const GLchar* name) override;
+    void uniform1i(GLint location, GLint value) override;
+    void uniform1f(GLint location, GLfloat value) override;
+    void uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) override;
+    void uniform3fv(GLint location, GLsizei count, const GLfloat* value) override;
+    void uniform4fv(GLint location, GLsizei count, const GLfloat* value) override;
+    void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) override;
+
+    void lineWidth(GLfloat width) override;
+    void pointSize(GLfloat size) override;
+
+    void drawArrays(GLenum mode, GLint first, GLsizei count) override;
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) override;
+    void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) override;
+    void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount) override;
+
+private:
+    GpuPassTimer* passTimer = nullptr;
+};
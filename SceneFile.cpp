@@ -0,0 +1,532 @@
+// SceneFile.cpp
+#include "SceneFile.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+
+using namespace SceneFile;
+
+static_assert(sizeof(FileHeader) == 64, "FileHeader layout");
+static_assert(sizeof(SectionEntry) == 32, "SectionEntry layout");
+static_assert(sizeof(StrokeEntry) == 168, "StrokeEntry layout");
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "mat4 must be 16 packed floats");
+
+static const char Magic[8] = { 'P', '3', 'D', 'S', 'C', 'E', 'N', 'E' };
+static const uint32_t ByteOrderMark = 0x01020304;
+
+static uint64_t alignSection(uint64_t offset) {
+    return (offset + SectionAlignment - 1) & ~uint64_t(SectionAlignment - 1);
+}
+
+// [offset, offset + length) lies within [0, count), without the sum being able to wrap
+static bool inRange(uint64_t offset, uint64_t length, uint64_t count) {
+    return offset <= count && length <= count - offset;
+}
+
+// --- Saving ---
+
+namespace {
+    // Writes the file and hashes it on the way, so the journal needn't read it back
+    class FileWriter {
+    public:
+        FileWriter(std::ofstream& out, uint64_t fileSize) : out(out), hasher(fileSize), position(0) {}
+        void write(const void* data, size_t bytes) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            hasher.update(data, bytes);
+            position += bytes;
+        }
+        uint64_t tell() const { return position; }
+        uint64_t finish() { return hasher.finish(); }
+    private:
+        std::ofstream& out;
+        ContentHasher hasher;
+        uint64_t position;
+    };
+
+    struct PendingSection {
+        SectionEntry entry;
+        std::function<void(FileWriter&)> write;
+    };
+}
+
+bool SceneFile::save(const std::string& path, const StrokeStore& store, const SaveOptions& options, SaveStats* stats, std::string* error) {
+    // Distinct payloads, in first-use order
+    std::unordered_map<const StrokePayload*, uint32_t> payloadIds;
+    std::vector<const StrokePayload*> payloads;
+    for (uint32_t i = 0; i < store.size(); ++i) {
+        const StrokePayload* payload = store.payload(i).get();
+        if (payloadIds.emplace(payload, static_cast<uint32_t>(payloads.size())).second) {
+            payloads.push_back(payload);
+        }
+    }
+
+    // Pack control points up front, spread over all cores. Batches stay raw: their points are
+    // only used for bounds, and their views must stay zero-copy.
+    std::vector<std::vector<uint8_t>> packed;
+    std::vector<uint32_t> packedPayloads;
+    if (options.pointStep > 0.0f) {
+        std::vector<PointCodec::Stream> streams;
+        for (size_t p = 0; p < payloads.size(); ++p) {
+            if (payloads[p]->isBatch()) continue;
+            packedPayloads.push_back(static_cast<uint32_t>(p));
+            streams.push_back({ payloads[p]->points, payloads[p]->pointCount });
+        }
+        PointCodec::encodeMany(streams.data(), streams.size(), options.pointStep, options.pointFormat, packed);
+    }
+
+    // Assign each payload its slice of every section
+    struct Slices { uint64_t points, vertices, indices, materialIds; uint32_t table, ranges; bool meshStored; int32_t packed; };
+    std::vector<Slices> slices(payloads.size());
+    for (Slices& slice : slices) {
+        slice.packed = -1;
+    }
+    for (size_t k = 0; k < packedPayloads.size(); ++k) {
+        slices[packedPayloads[k]].packed = static_cast<int32_t>(k);
+    }
+    uint64_t pointCount = 0, vertexCount = 0, indexCount = 0, materialIdCount = 0, rangeCount = 0, packedBytes = 0;
+    uint64_t materialCount = store.getMaterials().size();
+    for (size_t p = 0; p < payloads.size(); ++p) {
+        const StrokePayload& payload = *payloads[p];
+        Slices& slice = slices[p];
+        // Batches can't be rebuilt from their points, so their mesh is always kept
+        slice.meshStored = options.includeMeshes || payload.isBatch();
+        slice.points = slice.packed >= 0 ? packedBytes : pointCount;
+        slice.vertices = vertexCount;
+        slice.indices = indexCount;
+        slice.materialIds = materialIdCount;
+        slice.table = static_cast<uint32_t>(materialCount);
+        slice.ranges = static_cast<uint32_t>(rangeCount);
+        if (slice.packed >= 0) {
+            packedBytes += packed[slice.packed].size();
+        }
+        else {
+            pointCount += payload.pointCount;
+        }
+        if (slice.meshStored) {
+            vertexCount += payload.vertexCount;
+            indexCount += payload.indexCount;
+        }
+        if (payload.isBatch()) {
+            materialIdCount += payload.vertexCount;
+            materialCount += payload.materialCount;
+            rangeCount += payload.rangeCount;
+        }
+    }
+
+    std::vector<StrokeEntry> entries(store.size());
+    for (uint32_t i = 0; i < store.size(); ++i) {
+        const StrokePayload& payload = *store.payload(i);
+        uint32_t id = payloadIds[&payload];
+        const Slices& slice = slices[id];
+        StrokeEntry& entry = entries[i];
+        std::memset(&entry, 0, sizeof(entry));
+        std::memcpy(entry.transform, &store.transform(i)[0][0], sizeof(entry.transform));
+        for (int axis = 0; axis < 3; ++axis) {
+            entry.boundsMin[axis] = payload.boundsMin[axis];
+            entry.boundsMax[axis] = payload.boundsMax[axis];
+        }
+        entry.pointOffset = slice.points;
+        entry.pointCount = payload.pointCount;
+        if (slice.packed >= 0) {
+            entry.flags |= PointsPacked;
+            entry.packedBytes = static_cast<uint32_t>(packed[slice.packed].size());
+        }
+        if (slice.meshStored) {
+            entry.vertexOffset = slice.vertices;
+            entry.vertexCount = payload.vertexCount;
+            entry.indexOffset = slice.indices;
+            entry.indexCount = payload.indexCount;
+        }
+        else if (payload.vertexCount > 0) {
+            entry.flags |= MeshOmitted;
+        }
+        if (payload.isBatch()) {
+            entry.materialIdOffset = slice.materialIds;
+            entry.tableOffset = slice.table;
+            entry.tableCount = payload.materialCount;
+            entry.rangeOffset = slice.ranges;
+            entry.rangeCount = payload.rangeCount;
+        }
+        entry.materialIndex = store.materialIndex(i);
+        entry.size = store.size(i);
+        entry.style = store.style(i);
+        entry.payloadId = id;
+    }
+
+    // Section writers stream straight from the payloads
+    std::vector<PendingSection> sections;
+    auto addSection = [&sections](SectionType type, uint32_t elementSize, uint64_t count, std::function<void(FileWriter&)> write) {
+        PendingSection section;
+        std::memset(&section.entry, 0, sizeof(section.entry));
+        section.entry.type = type;
+        section.entry.elementSize = elementSize;
+        section.entry.count = count;
+        section.write = std::move(write);
+        sections.push_back(std::move(section));
+    };
+    addSection(StrokesSection, sizeof(StrokeEntry), entries.size(), [&](FileWriter& out) {
+        out.write(entries.data(), entries.size() * sizeof(StrokeEntry));
+    });
+    addSection(MaterialsSection, sizeof(StrokeMaterial), materialCount, [&](FileWriter& out) {
+        const std::vector<StrokeMaterial>& materials = store.getMaterials();
+        out.write(materials.data(), materials.size() * sizeof(StrokeMaterial));
+        for (const StrokePayload* payload : payloads) {
+            if (payload->isBatch()) out.write(payload->materials, payload->materialCount * sizeof(StrokeMaterial));
+        }
+    });
+    addSection(PointsSection, sizeof(glm::vec3), pointCount, [&](FileWriter& out) {
+        for (size_t p = 0; p < payloads.size(); ++p) {
+            if (slices[p].packed < 0) out.write(payloads[p]->points, payloads[p]->pointCount * sizeof(glm::vec3));
+        }
+    });
+    if (packedBytes > 0) {
+        addSection(PackedPointsSection, 1, packedBytes, [&](FileWriter& out) {
+            for (const std::vector<uint8_t>& bytes : packed) {
+                out.write(bytes.data(), bytes.size());
+            }
+        });
+    }
+    addSection(VerticesSection, sizeof(StrokeVertex), vertexCount, [&](FileWriter& out) {
+        for (size_t p = 0; p < payloads.size(); ++p) {
+            if (slices[p].meshStored) out.write(payloads[p]->vertices, payloads[p]->vertexCount * sizeof(StrokeVertex));
+        }
+    });
+    addSection(IndicesSection, sizeof(unsigned int), indexCount, [&](FileWriter& out) {
+        for (size_t p = 0; p < payloads.size(); ++p) {
+            if (slices[p].meshStored) out.write(payloads[p]->indices, payloads[p]->indexCount * sizeof(unsigned int));
+        }
+    });
+    addSection(MaterialIdsSection, sizeof(uint32_t), materialIdCount, [&](FileWriter& out) {
+        for (const StrokePayload* payload : payloads) {
+            if (payload->isBatch()) out.write(payload->materialIds, payload->vertexCount * sizeof(uint32_t));
+        }
+    });
+    addSection(RangesSection, sizeof(StrokeBatchRange), rangeCount, [&](FileWriter& out) {
+        for (const StrokePayload* payload : payloads) {
+            if (payload->isBatch()) out.write(payload->ranges, payload->rangeCount * sizeof(StrokeBatchRange));
+        }
+    });
+
+    // Lay the sections out after the header and section table
+    uint64_t offset = sizeof(FileHeader) + sections.size() * sizeof(SectionEntry);
+    for (PendingSection& section : sections) {
+        offset = alignSection(offset);
+        section.entry.offset = offset;
+        offset += section.entry.count * section.entry.elementSize;
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = packedBytes > 0 ? Version : 1;
+    header.headerSize = sizeof(FileHeader);
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+    header.byteOrder = ByteOrderMark;
+    header.fileSize = offset;
+    header.payloadCount = payloads.size();
+    header.pointStep = packedBytes > 0 ? options.pointStep : 0.0f;
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            if (error) *error = "Cannot write " + tempPath;
+            return false;
+        }
+        FileWriter writer(out, header.fileSize);
+        writer.write(&header, sizeof(header));
+        for (const PendingSection& section : sections) {
+            writer.write(&section.entry, sizeof(SectionEntry));
+        }
+        static const char padding[SectionAlignment] = {};
+        for (const PendingSection& section : sections) {
+            writer.write(padding, static_cast<size_t>(section.entry.offset - writer.tell()));
+            section.write(writer);
+        }
+        if (stats) {
+            stats->bytes = writer.tell();
+            stats->contentHash = writer.finish();
+        }
+        out.flush();
+        if (!out.good()) {
+            out.close();
+            std::remove(tempPath.c_str());
+            if (error) *error = "Write failed: " + tempPath;
+            return false;
+        }
+    }
+    // Replace the old file only once the new one is complete (it may still be mapped by the loaded scene)
+    if (!MappedFile::replace(tempPath, path)) {
+        std::remove(tempPath.c_str());
+        if (error) *error = "Cannot rename " + tempPath + " to " + path;
+        return false;
+    }
+    return true;
+}
+
+// --- Loading ---
+
+SceneFile::Reader::Reader() {
+    std::memset(&header, 0, sizeof(header));
+}
+
+SceneFile::Reader::~Reader() {
+}
+
+void SceneFile::Reader::close() {
+    file.reset();
+    payloadChecked.reset();
+    std::memset(&header, 0, sizeof(header));
+    for (SectionView& section : sections) {
+        section = SectionView();
+    }
+}
+
+uint64_t SceneFile::Reader::contentHash() const {
+    return file ? file->contentHash() : 0;
+}
+
+uint64_t SceneFile::Reader::getFileSize() const {
+    return file ? file->getSize() : 0;
+}
+
+bool SceneFile::Reader::open(const std::string& path, std::string* error) {
+    close();
+    auto fail = [this, error](const std::string& message) {
+        close();
+        if (error) *error = message;
+        return false;
+    };
+
+    file = std::make_shared<MappedFile>();
+    if (!file->open(path, error)) {
+        file.reset();
+        return false;
+    }
+    const uint8_t* base = file->getData();
+    uint64_t fileSize = file->getSize();
+
+    if (fileSize < sizeof(FileHeader)) return fail("Not a scene file: " + path);
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0) return fail("Not a scene file: " + path);
+    if (header.byteOrder != ByteOrderMark) return fail("Scene was written with a different byte order");
+    if (header.version > Version) return fail("Scene file version " + std::to_string(header.version) + " is newer than supported");
+    if (header.headerSize < sizeof(FileHeader) || header.fileSize > fileSize ||
+        header.headerSize + uint64_t(header.sectionCount) * sizeof(SectionEntry) > fileSize) {
+        return fail("Truncated scene file: " + path);
+    }
+
+    // Known sections; element sizes must match our in-memory layouts for zero-copy views
+    const uint32_t elementSizes[SectionTypeCount] = { 0, sizeof(StrokeEntry), sizeof(StrokeMaterial), sizeof(glm::vec3),
+        sizeof(StrokeVertex), sizeof(unsigned int), sizeof(uint32_t), sizeof(StrokeBatchRange), 1 };
+    for (uint32_t s = 0; s < header.sectionCount; ++s) {
+        SectionEntry entry;
+        std::memcpy(&entry, base + header.headerSize + s * sizeof(SectionEntry), sizeof(entry));
+        if (entry.type == 0 || entry.type >= SectionTypeCount) continue; // Unknown section: skip
+        if (entry.elementSize != elementSizes[entry.type]) return fail("Scene file layout does not match this build");
+        if (entry.offset % std::min<uint32_t>(entry.elementSize, 4) != 0 || entry.offset > fileSize || entry.count > (fileSize - entry.offset) / entry.elementSize) {
+            return fail("Corrupt section table: " + path);
+        }
+        sections[entry.type].data = base + entry.offset;
+        sections[entry.type].count = entry.count;
+    }
+    if (header.payloadCount > sections[StrokesSection].count) return fail("Corrupt payload count: " + path);
+    if (sections[PackedPointsSection].count > 0 && !(header.pointStep > 0.0f)) return fail("Corrupt point grid: " + path);
+    payloadChecked.reset(new std::atomic<uint8_t>[static_cast<size_t>(header.payloadCount)]());
+    return true;
+}
+
+const StrokeEntry* SceneFile::Reader::entry(size_t index, std::string* error) const {
+    if (index >= getStrokeCount()) return nullptr;
+    const StrokeEntry& e = reinterpret_cast<const StrokeEntry*>(sections[StrokesSection].data)[index];
+    bool batch = e.rangeCount > 0;
+    bool packed = (e.flags & PointsPacked) != 0;
+    bool ok = e.payloadId < header.payloadCount && e.materialIndex < sections[MaterialsSection].count &&
+        e.style <= BatchStyle && (e.style == BatchStyle) == batch &&
+        (packed ? !batch && inRange(e.pointOffset, e.packedBytes, sections[PackedPointsSection].count) :
+            inRange(e.pointOffset, e.pointCount, sections[PointsSection].count)) &&
+        inRange(e.vertexOffset, e.vertexCount, sections[VerticesSection].count) &&
+        inRange(e.indexOffset, e.indexCount, sections[IndicesSection].count) &&
+        (!batch || (inRange(e.materialIdOffset, e.vertexCount, sections[MaterialIdsSection].count) &&
+            e.tableCount > 0 && inRange(e.tableOffset, e.tableCount, sections[MaterialsSection].count) &&
+            inRange(e.rangeOffset, e.rangeCount, sections[RangesSection].count)));
+    if (ok) {
+        // Entries sharing a payload get it built from whichever comes first, so they must agree on batch-ness
+        uint8_t kind = batch ? 2 : 1;
+        uint8_t checked = payloadChecked[e.payloadId].load(std::memory_order_relaxed);
+        if (checked == 0) {
+            ok = checkContents(e);
+            if (ok) payloadChecked[e.payloadId].store(kind, std::memory_order_relaxed);
+        }
+        else {
+            ok = checked == kind;
+        }
+    }
+    if (!ok) {
+        if (error) *error = "Corrupt stroke entry " + std::to_string(index);
+        return nullptr;
+    }
+    return &e;
+}
+
+// What the payload arrays hold, once the arrays themselves are known to be in range
+bool SceneFile::Reader::checkContents(const StrokeEntry& entry) const {
+    const unsigned int* entryIndices = indices(entry);
+    for (uint32_t i = 0; i < entry.indexCount; ++i) {
+        if (entryIndices[i] >= entry.vertexCount) return false;
+    }
+    if (entry.rangeCount == 0) return true;
+    const uint32_t* materialIds = reinterpret_cast<const uint32_t*>(sections[MaterialIdsSection].data) + entry.materialIdOffset;
+    for (uint32_t i = 0; i < entry.vertexCount; ++i) {
+        if (materialIds[i] >= entry.tableCount) return false;
+    }
+    const StrokeBatchRange* ranges = reinterpret_cast<const StrokeBatchRange*>(sections[RangesSection].data) + entry.rangeOffset;
+    for (uint32_t r = 0; r < entry.rangeCount; ++r) {
+        if (ranges[r].primitive > StrokeBatchRange::Points || !inRange(ranges[r].firstIndex, ranges[r].indexCount, entry.indexCount)) return false;
+    }
+    return true;
+}
+
+const glm::vec3* SceneFile::Reader::points(const StrokeEntry& entry, std::vector<glm::vec3>& scratch) const {
+    if (!(entry.flags & PointsPacked)) {
+        return reinterpret_cast<const glm::vec3*>(sections[PointsSection].data) + entry.pointOffset;
+    }
+    scratch.resize(entry.pointCount);
+    if (!PointCodec::decode(sections[PackedPointsSection].data + entry.pointOffset, entry.packedBytes,
+            entry.pointCount, header.pointStep, scratch.data())) {
+        return nullptr;
+    }
+    return scratch.data();
+}
+
+const StrokeVertex* SceneFile::Reader::vertices(const StrokeEntry& entry) const {
+    return reinterpret_cast<const StrokeVertex*>(sections[VerticesSection].data) + entry.vertexOffset;
+}
+
+const unsigned int* SceneFile::Reader::indices(const StrokeEntry& entry) const {
+    return reinterpret_cast<const unsigned int*>(sections[IndicesSection].data) + entry.indexOffset;
+}
+
+const StrokeMaterial& SceneFile::Reader::material(const StrokeEntry& entry) const {
+    return reinterpret_cast<const StrokeMaterial*>(sections[MaterialsSection].data)[entry.materialIndex];
+}
+
+uint64_t SceneFile::Reader::payloadBytes(const StrokeEntry& entry) const {
+    uint64_t pointBytes = (entry.flags & PointsPacked) ? entry.packedBytes : uint64_t(entry.pointCount) * sizeof(glm::vec3);
+    uint64_t bytes = pointBytes +
+        uint64_t(entry.vertexCount) * sizeof(StrokeVertex) + uint64_t(entry.indexCount) * sizeof(unsigned int);
+    if (entry.rangeCount > 0) {
+        bytes += uint64_t(entry.vertexCount) * sizeof(uint32_t) + uint64_t(entry.tableCount) * sizeof(StrokeMaterial) +
+            uint64_t(entry.rangeCount) * sizeof(StrokeBatchRange);
+    }
+    return bytes;
+}
+
+static void touchPages(const void* data, size_t bytes) {
+    const volatile uint8_t* cursor = static_cast<const uint8_t*>(data);
+    for (size_t offset = 0; offset < bytes; offset += 4096) {
+        (void)cursor[offset];
+    }
+}
+
+void SceneFile::Reader::touchPayload(const StrokeEntry& entry) const {
+    if (!(entry.flags & PointsPacked)) {
+        touchPages(reinterpret_cast<const glm::vec3*>(sections[PointsSection].data) + entry.pointOffset, size_t(entry.pointCount) * sizeof(glm::vec3));
+    }
+    touchPages(vertices(entry), size_t(entry.vertexCount) * sizeof(StrokeVertex));
+    touchPages(indices(entry), size_t(entry.indexCount) * sizeof(unsigned int));
+    if (entry.rangeCount > 0) {
+        touchPages(reinterpret_cast<const uint32_t*>(sections[MaterialIdsSection].data) + entry.materialIdOffset, size_t(entry.vertexCount) * sizeof(uint32_t));
+        touchPages(reinterpret_cast<const StrokeMaterial*>(sections[MaterialsSection].data) + entry.tableOffset, size_t(entry.tableCount) * sizeof(StrokeMaterial));
+        touchPages(reinterpret_cast<const StrokeBatchRange*>(sections[RangesSection].data) + entry.rangeOffset, size_t(entry.rangeCount) * sizeof(StrokeBatchRange));
+    }
+}
+
+StrokeRef SceneFile::Reader::makePayload(StrokeArena& arena, const StrokeEntry& entry) const {
+    if (entry.flags & PointsPacked) {
+        // Decode straight into the arena; the stored mesh (if any) is copied alongside
+        StrokePayloadBuilder builder(arena, entry.pointCount, entry.vertexCount, entry.indexCount);
+        if (!PointCodec::decode(sections[PackedPointsSection].data + entry.pointOffset, entry.packedBytes,
+                entry.pointCount, header.pointStep, builder.points())) {
+            return StrokeRef();
+        }
+        std::copy_n(vertices(entry), entry.vertexCount, builder.vertices());
+        std::copy_n(indices(entry), entry.indexCount, builder.indices());
+        return builder.finish();
+    }
+
+    bool batch = entry.rangeCount > 0;
+    StrokePayload layout;
+    layout.points = reinterpret_cast<const glm::vec3*>(sections[PointsSection].data) + entry.pointOffset;
+    layout.pointCount = entry.pointCount;
+    layout.vertices = vertices(entry);
+    layout.vertexCount = entry.vertexCount;
+    layout.indices = indices(entry);
+    layout.indexCount = entry.indexCount;
+    layout.boundsMin = glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]);
+    layout.boundsMax = glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]);
+    layout.materialIds = batch ? reinterpret_cast<const uint32_t*>(sections[MaterialIdsSection].data) + entry.materialIdOffset : nullptr;
+    layout.materials = batch ? reinterpret_cast<const StrokeMaterial*>(sections[MaterialsSection].data) + entry.tableOffset : nullptr;
+    layout.materialCount = batch ? entry.tableCount : 0;
+    layout.ranges = batch ? reinterpret_cast<const StrokeBatchRange*>(sections[RangesSection].data) + entry.rangeOffset : nullptr;
+    layout.rangeCount = batch ? entry.rangeCount : 0;
+    return StrokePayloadBuilder::view(arena, layout, file);
+}
+
+glm::mat4 SceneFile::entryTransform(const StrokeEntry& entry) {
+    glm::mat4 transform;
+    std::memcpy(&transform[0][0], entry.transform, sizeof(entry.transform));
+    return transform;
+}
+
+bool SceneFile::load(const std::string& path, StrokeArena& arena, StrokeStore& store, const RebuildFunction& rebuild,
+    LoadStats* stats, std::string* error) {
+    auto start = std::chrono::steady_clock::now();
+
+    Reader reader;
+    if (!reader.open(path, error)) return false;
+
+    std::vector<StrokeRef> payloads(reader.getPayloadCount());
+    std::vector<glm::vec3> scratch;
+    size_t rebuiltMeshes = 0, unpackedPayloads = 0;
+    store.reserve(store.size() + reader.getStrokeCount());
+    for (size_t i = 0; i < reader.getStrokeCount(); ++i) {
+        const StrokeEntry* entry = reader.entry(i, error);
+        if (!entry) return false;
+
+        StrokeRef& payload = payloads[entry->payloadId];
+        if (!payload) {
+            if ((entry->flags & MeshOmitted) && rebuild) {
+                const glm::vec3* points = reader.points(*entry, scratch);
+                if (points) {
+                    payload = rebuild(points, entry->pointCount, entry->style, entry->size);
+                    rebuiltMeshes++;
+                }
+            }
+            else {
+                payload = reader.makePayload(arena, *entry);
+            }
+            if (!payload) {
+                if (error) *error = "Corrupt packed points in stroke " + std::to_string(i);
+                return false;
+            }
+            if (entry->flags & PointsPacked) unpackedPayloads++;
+        }
+        store.add(payload, reader.material(*entry), entry->size, entry->style, entryTransform(*entry));
+    }
+
+    if (stats) {
+        stats->strokes = reader.getStrokeCount();
+        stats->payloads = payloads.size();
+        stats->rebuiltMeshes = rebuiltMeshes;
+        stats->unpackedPayloads = unpackedPayloads;
+        stats->bytes = static_cast<size_t>(reader.getFileSize());
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return true;
+}
@@ -0,0 +1,174 @@
+// SceneFile.h
+#pragma once
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include "StrokeStore.h"
+#include "PointCodec.h"
+
+class MappedFile;
+
+// Binary scene files (.p3d).
+//
+// Layout: [FileHeader][SectionEntry x sectionCount][sections...]. Each section starts on a
+// 64-byte boundary and holds a flat array in the same layout the program uses in memory
+// (element sizes are recorded and checked on load), so a loader can map the file and point
+// stroke payloads straight at the mapped bytes instead of parsing them. Readers skip section
+// types they don't know; Version only changes for incompatible layouts.
+//
+// Control points can optionally be saved packed with PointCodec (lossy, snapped to a grid).
+// Packed strokes are decoded into the arena on load instead of being mapped.
+namespace SceneFile {
+    const uint32_t Version = 2; // 2: packed points (files without them are still written as 1)
+    const size_t SectionAlignment = 64;
+
+    enum SectionType : uint32_t {
+        StrokesSection = 1,     // StrokeEntry
+        MaterialsSection = 2,   // StrokeMaterial: scene materials, then batch material tables
+        PointsSection = 3,      // glm::vec3
+        VerticesSection = 4,    // StrokeVertex
+        IndicesSection = 5,     // unsigned int, local to each payload's vertices
+        MaterialIdsSection = 6, // uint32_t per batch vertex
+        RangesSection = 7,      // StrokeBatchRange
+        PackedPointsSection = 8 // PointCodec streams, one byte per element
+    };
+    const uint32_t SectionTypeCount = 9;
+
+    // Painter::BATCH: baked batches, the only style with material tables and ranges
+    const uint8_t BatchStyle = 5;
+
+    struct FileHeader {
+        char magic[8];          // "P3DSCENE"
+        uint32_t version;
+        uint32_t headerSize;    // sizeof(FileHeader)
+        uint32_t sectionCount;  // SectionEntry table follows the header
+        uint32_t byteOrder;     // 0x01020304 as written
+        uint64_t fileSize;
+        uint64_t payloadCount;  // Distinct payloads (StrokeEntry::payloadId range)
+        float pointStep;        // Grid of PackedPointsSection; 0 if nothing is packed
+        uint8_t reserved[20];
+    };
+
+    struct SectionEntry {
+        uint32_t type;
+        uint32_t elementSize;
+        uint64_t offset;        // From the start of the file
+        uint64_t count;         // Elements
+        uint64_t reserved;
+    };
+
+    enum StrokeFlags : uint8_t {
+        MeshOmitted = 1,        // Payload had a mesh that was not saved; rebuild it from the points
+        PointsPacked = 2        // pointOffset is a byte offset into PackedPointsSection
+    };
+
+    // One per stroke. Strokes with the same payloadId share their payload (duplicates).
+    struct StrokeEntry {
+        float transform[16];
+        float boundsMin[3];     // Payload (local) bounds
+        float boundsMax[3];
+        uint64_t pointOffset;   // Element offsets into the matching sections
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t materialIdOffset;
+        uint32_t pointCount;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t materialIndex; // Into MaterialsSection
+        uint32_t tableOffset;   // Batches: material table, also in MaterialsSection
+        uint32_t tableCount;
+        uint32_t rangeOffset;
+        uint32_t rangeCount;
+        float size;
+        uint8_t style;
+        uint8_t flags;          // StrokeFlags
+        uint16_t reserved;
+        uint32_t payloadId;
+        uint32_t packedBytes;   // PointsPacked: length of the stream
+    };
+
+    // Rebuilds a payload whose mesh was not stored
+    typedef std::function<StrokeRef(const glm::vec3* points, size_t count, uint8_t style, float size)> RebuildFunction;
+
+    struct SaveOptions {
+        bool includeMeshes = true;
+        float pointStep = 0.0f; // > 0 packs control points onto this grid (batches always stay raw)
+        PointCodec::Format pointFormat = PointCodec::BitPacked;
+    };
+
+    struct SaveStats {
+        uint64_t bytes = 0;
+        uint64_t contentHash = 0; // MappedFile::contentHash() of the file written
+    };
+
+    struct LoadStats {
+        size_t strokes = 0;
+        size_t payloads = 0;
+        size_t rebuiltMeshes = 0;
+        size_t unpackedPayloads = 0;
+        size_t bytes = 0;
+        double seconds = 0.0;
+    };
+
+    // Maps a scene file and hands out validated stroke entries and zero-copy payload views.
+    // Thread-safe for reading once open; payloads must be created on the thread owning the arena.
+    // Nothing in the file is trusted: every offset and count is range-checked on its own, and
+    // the first entry of each payload also has its indices, material ids and ranges checked
+    // (which touches those pages, so it happens wherever entry() is first called for it).
+    class Reader {
+    public:
+        Reader();
+        ~Reader();
+        bool open(const std::string& path, std::string* error = nullptr);
+        void close();
+
+        size_t getStrokeCount() const { return static_cast<size_t>(sections[StrokesSection].count); }
+        size_t getPayloadCount() const { return static_cast<size_t>(header.payloadCount); }
+        uint64_t getFileSize() const;
+        uint64_t contentHash() const; // See MappedFile::contentHash
+
+        // Entry 'index', checked against the sections. Null (and 'error' set) if corrupt.
+        const StrokeEntry* entry(size_t index, std::string* error = nullptr) const;
+        // Control points: straight from the mapping, or decoded into 'scratch' if packed.
+        // Null if a packed stream is corrupt.
+        const glm::vec3* points(const StrokeEntry& entry, std::vector<glm::vec3>& scratch) const;
+        const StrokeVertex* vertices(const StrokeEntry& entry) const;
+        const unsigned int* indices(const StrokeEntry& entry) const;
+        const StrokeMaterial& material(const StrokeEntry& entry) const;
+        // Bytes an entry's payload occupies in the file (points + stored mesh)
+        uint64_t payloadBytes(const StrokeEntry& entry) const;
+        // Reads one byte per page of everything the payload maps (raw points, mesh, batch arrays),
+        // so a background thread takes the page faults instead of whoever uses the payload next
+        void touchPayload(const StrokeEntry& entry) const;
+        // Payload whose arrays point into the mapping (keeping it alive), or an arena copy with
+        // decoded points for packed entries. Null if a packed stream is corrupt.
+        StrokeRef makePayload(StrokeArena& arena, const StrokeEntry& entry) const;
+
+    private:
+        struct SectionView {
+            const uint8_t* data = nullptr;
+            uint64_t count = 0;
+        };
+
+        bool checkContents(const StrokeEntry& entry) const;
+
+        std::shared_ptr<MappedFile> file;
+        FileHeader header;
+        SectionView sections[SectionTypeCount];
+        // Per payload: 0 not checked yet, else checked and 1 plain / 2 batch (any thread may set it)
+        std::unique_ptr<std::atomic<uint8_t>[]> payloadChecked;
+    };
+
+    // Writes to a temporary file next to 'path' and renames it over 'path' when complete
+    bool save(const std::string& path, const StrokeStore& store, const SaveOptions& options, SaveStats* stats = nullptr,
+        std::string* error = nullptr);
+
+    glm::mat4 entryTransform(const StrokeEntry& entry);
+
+    // Maps 'path' and appends its strokes to 'store'. Payloads are views into the mapping (which
+    // stays alive as long as any of them does); only the stroke entries (and packed points) are read.
+    bool load(const std::string& path, StrokeArena& arena, StrokeStore& store, const RebuildFunction& rebuild,
+        LoadStats* stats = nullptr, std::string* error = nullptr);
+}
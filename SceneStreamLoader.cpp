@@ -0,0 +1,220 @@
+// SceneStreamLoader.cpp
+#include "SceneStreamLoader.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <algorithm>
+
+SceneStreamLoader::SceneStreamLoader() :
+    cancelRequested(false),
+    active(false),
+    workerDone(true),
+    currentOffset(0),
+    currentDecoded(0)
+{
+}
+
+SceneStreamLoader::~SceneStreamLoader() {
+    cancel();
+}
+
+bool SceneStreamLoader::start(const std::string& path, MeshFunction function, std::string* error) {
+    cancel();
+    if (!reader.open(path, error)) return false;
+
+    meshFunction = function;
+    payloads.assign(reader.getPayloadCount(), StrokeRef());
+    current = Batch();
+    currentOffset = 0;
+    currentDecoded = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.clear();
+        progress = Progress();
+        progress.strokesTotal = reader.getStrokeCount();
+        progress.bytesTotal = reader.getFileSize();
+        progress.active = true;
+        workerDone = false;
+    }
+    startTime = std::chrono::steady_clock::now();
+    cancelRequested = false;
+    active = true;
+    worker = std::thread(&SceneStreamLoader::run, this);
+    return true;
+}
+
+void SceneStreamLoader::cancel() {
+    if (!active) return;
+    cancelRequested = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        progress.cancelled = true;
+    }
+    readyTaken.notify_all(); // The worker may be waiting for room in 'ready'
+    finish();
+}
+
+void SceneStreamLoader::run() {
+    Profiler::setThreadName("Scene stream");
+    size_t total = reader.getStrokeCount();
+    std::vector<uint8_t> seen(reader.getPayloadCount(), 0);
+    size_t index = 0;
+
+    while (index < total && !cancelRequested) {
+        {
+            // Wait for deliver() to catch up before decoding more
+            std::unique_lock<std::mutex> lock(mutex);
+            readyTaken.wait(lock, [this] { return ready.size() < MaxReadyBatches || cancelRequested; });
+        }
+        if (cancelRequested) break;
+        PROFILE_SCOPE("Stream batch");
+        Batch batch;
+        batch.firstEntry = index;
+        std::string error;
+        while (index < total && batch.count < BatchStrokes && batch.bytes < BatchBytes) {
+            const SceneFile::StrokeEntry* entry = reader.entry(index, &error);
+            if (!entry) {
+                std::lock_guard<std::mutex> lock(mutex);
+                progress.failed = true;
+                progress.error = error;
+                workerDone = true;
+                return;
+            }
+            batch.bytes += sizeof(SceneFile::StrokeEntry);
+            if (!seen[entry->payloadId]) {
+                // First use of this payload: fault in everything deliver() reads or the views map
+                // (entry() has just checked its indices, so most of it is in already), and note if it needs work
+                seen[entry->payloadId] = 1;
+                bool packed = (entry->flags & SceneFile::PointsPacked) != 0;
+                reader.touchPayload(*entry);
+                batch.bytes += reader.payloadBytes(*entry);
+                if (packed || ((entry->flags & SceneFile::MeshOmitted) && meshFunction)) {
+                    batch.decodedEntries.push_back(static_cast<uint32_t>(batch.count));
+                }
+            }
+            ++index;
+            ++batch.count;
+        }
+
+        batch.decoded.resize(batch.decodedEntries.size());
+        std::atomic<bool> corrupt(false);
+        parallelFor(batch.decodedEntries.size(), [&](size_t k) {
+            const SceneFile::StrokeEntry* entry = reader.entry(batch.firstEntry + batch.decodedEntries[k]);
+            Decoded& decoded = batch.decoded[k];
+            std::vector<glm::vec3> none;
+            const glm::vec3* points = reader.points(*entry, (entry->flags & SceneFile::PointsPacked) ? decoded.points : none);
+            if (!points) {
+                corrupt = true;
+                return;
+            }
+            if ((entry->flags & SceneFile::MeshOmitted) && meshFunction) {
+                meshFunction(points, entry->pointCount, entry->style, entry->size, decoded.vertices, decoded.indices);
+                decoded.meshGenerated = true;
+            }
+        });
+        if (corrupt) {
+            std::lock_guard<std::mutex> lock(mutex);
+            progress.failed = true;
+            progress.error = "Corrupt packed points near stroke " + std::to_string(batch.firstEntry);
+            workerDone = true;
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        progress.strokesDecoded += batch.count;
+        progress.bytesRead += batch.bytes;
+        ready.push_back(std::move(batch));
+    }
+
+    uint64_t hash = 0;
+    bool hashed = !cancelRequested;
+    if (hashed) {
+        PROFILE_SCOPE("Stream hash");
+        hash = reader.contentHash();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    progress.contentHash = hash;
+    progress.hashed = hashed;
+    workerDone = true;
+}
+
+size_t SceneStreamLoader::deliver(StrokeArena& arena, StrokeStore& store, double budgetMs) {
+    if (!active) return 0;
+    auto start = std::chrono::steady_clock::now();
+    auto budget = std::chrono::duration<double, std::milli>(budgetMs);
+    size_t added = 0;
+
+    while (true) {
+        if (currentOffset == current.count) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ready.empty()) break;
+                current = std::move(ready.front());
+                ready.pop_front();
+            }
+            readyTaken.notify_one();
+            currentOffset = 0;
+            currentDecoded = 0;
+        }
+
+        const SceneFile::StrokeEntry* entry = reader.entry(current.firstEntry + currentOffset);
+        StrokeRef& payload = payloads[entry->payloadId];
+        if (currentDecoded < current.decodedEntries.size() && current.decodedEntries[currentDecoded] == currentOffset) {
+            // Points and/or mesh prepared by the workers: copy them into one arena payload
+            const Decoded& decoded = current.decoded[currentDecoded++];
+            const glm::vec3* points = decoded.points.empty() ? reader.points(*entry, scratch) : decoded.points.data();
+            size_t vertexCount = decoded.meshGenerated ? decoded.vertices.size() : entry->vertexCount;
+            size_t indexCount = decoded.meshGenerated ? decoded.indices.size() : entry->indexCount;
+            const StrokeVertex* vertices = decoded.meshGenerated ? decoded.vertices.data() : reader.vertices(*entry);
+            const unsigned int* indices = decoded.meshGenerated ? decoded.indices.data() : reader.indices(*entry);
+            StrokePayloadBuilder builder(arena, entry->pointCount, vertexCount, indexCount);
+            std::copy_n(points, entry->pointCount, builder.points());
+            std::copy_n(vertices, vertexCount, builder.vertices());
+            std::copy_n(indices, indexCount, builder.indices());
+            payload = builder.finish();
+        }
+        else if (!payload) {
+            payload = reader.makePayload(arena, *entry);
+        }
+        store.add(payload, reader.material(*entry), entry->size, entry->style, SceneFile::entryTransform(*entry));
+        ++currentOffset;
+        ++added;
+
+        // Checking the clock every stroke would cost more than adding one
+        if ((added & 63) == 0 && std::chrono::steady_clock::now() - start >= budget) break;
+    }
+
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        progress.strokesDelivered += added;
+        progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if (progress.seconds > 0.0) {
+            progress.bytesPerSecond = progress.bytesRead / progress.seconds;
+            progress.strokesPerSecond = progress.strokesDelivered / progress.seconds;
+        }
+        done = workerDone && ready.empty() && currentOffset == current.count;
+    }
+    if (done) finish();
+    return added;
+}
+
+SceneStreamLoader::Progress SceneStreamLoader::getProgress() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return progress;
+}
+
+void SceneStreamLoader::finish() {
+    if (worker.joinable()) worker.join();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.clear();
+        progress.active = false;
+        workerDone = true;
+    }
+    current = Batch();
+    currentOffset = 0;
+    currentDecoded = 0;
+    payloads.clear();
+    reader.close(); // Delivered views keep the mapping alive on their own
+    active = false;
+}
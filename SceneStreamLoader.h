@@ -0,0 +1,102 @@
+// SceneStreamLoader.h
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include "SceneFile.h"
+
+// Loads a scene file progressively.
+// A background thread walks the stroke entries in batches, faults in the bytes each batch
+// references (so the main thread never waits on the disk), decodes packed points and
+// regenerates meshes that were not saved, spread over all cores. Every frame the main thread calls deliver() to move a
+// time-boxed amount of finished work into the scene, so strokes show up as they arrive.
+// The worker stays at most MaxReadyBatches ahead of deliver(), so a slow main thread doesn't
+// pile the whole decoded scene up in memory.
+// The worker finishes by hashing the file (its pages are cached by then) for the crash journal.
+class SceneStreamLoader {
+public:
+    // Fills the mesh of a stroke saved without one. Runs on worker threads: must be thread-safe.
+    typedef std::function<void(const glm::vec3* points, size_t count, uint8_t style, float size,
+        std::vector<StrokeVertex>& vertices, std::vector<unsigned int>& indices)> MeshFunction;
+
+    struct Progress {
+        size_t strokesTotal = 0;
+        size_t strokesDecoded = 0;   // Read (and meshed) by the background thread
+        size_t strokesDelivered = 0; // Added to the scene
+        uint64_t bytesTotal = 0;
+        uint64_t bytesRead = 0;
+        double seconds = 0.0;
+        double bytesPerSecond = 0.0;
+        double strokesPerSecond = 0.0;
+        uint64_t contentHash = 0;    // Of the whole file, once every stroke is decoded
+        bool hashed = false;
+        bool active = false;
+        bool cancelled = false;
+        bool failed = false;
+        std::string error;
+    };
+
+    static const size_t MaxReadyBatches = 4; // Decoded batches the worker may keep waiting for deliver()
+
+    SceneStreamLoader();
+    ~SceneStreamLoader();
+    SceneStreamLoader(const SceneStreamLoader&) = delete;
+    SceneStreamLoader& operator=(const SceneStreamLoader&) = delete;
+
+    bool start(const std::string& path, MeshFunction meshFunction, std::string* error = nullptr);
+    // Stops the background thread; strokes delivered so far stay in the scene
+    void cancel();
+    // Main thread: adds decoded strokes to 'store' until 'budgetMs' is used up. Returns strokes added.
+    size_t deliver(StrokeArena& arena, StrokeStore& store, double budgetMs);
+
+    bool isActive() const { return active; }
+    Progress getProgress() const;
+
+private:
+    // Worker output for a payload that can't simply be a view into the file
+    struct Decoded {
+        std::vector<glm::vec3> points;      // Packed entries only
+        std::vector<StrokeVertex> vertices; // Generated meshes only
+        std::vector<unsigned int> indices;
+        bool meshGenerated = false;
+    };
+    struct Batch {
+        size_t firstEntry = 0;
+        size_t count = 0;
+        uint64_t bytes = 0;
+        std::vector<uint32_t> decodedEntries; // Batch-relative, ascending
+        std::vector<Decoded> decoded;
+    };
+
+    static const size_t BatchStrokes = 1024;
+    static const uint64_t BatchBytes = 8u * 1024u * 1024u;
+
+    void run();
+    void finish(); // Joins the worker and releases the file
+
+    SceneFile::Reader reader;
+    MeshFunction meshFunction;
+    std::thread worker;
+    std::atomic<bool> cancelRequested;
+    bool active;
+
+    mutable std::mutex mutex;  // Guards 'ready', 'progress' and 'workerDone'
+    std::condition_variable readyTaken; // deliver() took a batch, or cancel() was called
+    std::deque<Batch> ready;
+    Progress progress;
+    bool workerDone;
+    std::chrono::steady_clock::time_point startTime;
+
+    // Main thread only
+    std::vector<StrokeRef> payloads; // By payload id, so duplicates stay shared
+    Batch current;
+    size_t currentOffset;
+    size_t currentDecoded;
+    std::vector<glm::vec3> scratch;
+};
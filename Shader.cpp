@@ -3,7 +3,16 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include "Globals.h"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 
 std::string readFile(const char* path) {
@@ -31,19 +40,18 @@ unsigned int compileShader(GLenum type, const std::string& source) {
         glGetShaderInfoLog(shader, 512, NULL, infoLog);
         std::cerr << "SHADER COMPILE ERROR (" << (type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT")
             << "):\n" << infoLog << "\n";
-        logger.addLog(std::string("Shader compile error: ") + infoLog);
+        logger.addLog(LogLevel::Error, std::string("Shader compile error: ") + infoLog);
         return 0;
     }
     return shader;
 }
-unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
-    std::string vertexCode = readFile(vertexPath);
-    std::string fragmentCode = readFile(fragmentPath);
-    if (vertexCode.empty() || fragmentCode.empty()) return 0;
+// Compiles and links; 'retrievable' asks the driver to keep the binary for the cache
+static unsigned int buildProgram(const std::string& vertexCode, const std::string& fragmentCode, bool retrievable) {
     unsigned int vertex = compileShader(GL_VERTEX_SHADER, vertexCode);
     unsigned int fragment = compileShader(GL_FRAGMENT_SHADER, fragmentCode);
     if (!vertex || !fragment) return 0;
     unsigned int program = glCreateProgram();
+    if (retrievable) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(program, vertex);
     glAttachShader(program, fragment);
     glLinkProgram(program);
@@ -53,7 +61,7 @@ unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
         char infoLog[512];
         glGetProgramInfoLog(program, 512, NULL, infoLog);
         std::cerr << "SHADER LINK ERROR:\n" << infoLog << "\n";
-        logger.addLog(std::string("Shader link error: ") + infoLog);
+        logger.addLog(LogLevel::Error, std::string("Shader link error: ") + infoLog);
         glDeleteProgram(program);
         return 0;
     }
@@ -63,7 +71,7 @@ unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
         char infoLog[512];
         glGetProgramInfoLog(program, 512, NULL, infoLog);
         std::cerr << "SHADER VALIDATION ERROR:\n" << infoLog << "\n";
-        logger.addLog(std::string("Shader validation error: ") + infoLog);
+        logger.addLog(LogLevel::Error, std::string("Shader validation error: ") + infoLog);
         glDeleteProgram(program);
         return 0;
     }
@@ -72,5 +80,159 @@ unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
     return program;
 }
 
+
+// --- Program binary cache ---
+
+namespace {
+    const char CacheMagic[8] = { 'P', '3', 'D', 'S', 'H', 'B', 'N', '1' };
+
+    struct CacheHeader {
+        char magic[8];
+        uint64_t key;
+        uint32_t format;
+        uint32_t size;
+    };
+
+    std::string cacheDirectory;
+    int binariesSupported = -1; // Unknown until the first load, when a context is current
+    ShaderLoadStats loadStats;
+
+    uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull; // FNV-1a
+        }
+        return hash;
+    }
+
+    uint64_t programKey(const std::string& vertexCode, const std::string& fragmentCode) {
+        uint64_t key = 14695981039346656037ull;
+        key = hashBytes(key, vertexCode.c_str(), vertexCode.size() + 1);
+        key = hashBytes(key, fragmentCode.c_str(), fragmentCode.size() + 1);
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION }) {
+            const char* value = reinterpret_cast<const char*>(glGetString(name));
+            if (value) key = hashBytes(key, value, std::strlen(value) + 1);
+        }
+        return key;
+    }
+
+    std::string cachePath(uint64_t key) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return cacheDirectory + "/" + name;
+    }
+
+    bool cacheEnabled() {
+        if (cacheDirectory.empty()) return false;
+        if (binariesSupported < 0) {
+            GLint formats = 0;
+            if (glad_glProgramBinary && glad_glGetProgramBinary && glad_glProgramParameteri) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            binariesSupported = formats > 0 ? 1 : 0;
+            if (!binariesSupported) logger.addLog(LogLevel::Warning, "Shader cache off: the driver offers no program binary formats");
+        }
+        return binariesSupported == 1;
+    }
+
+    unsigned int loadCachedProgram(uint64_t key) {
+        FILE* file = std::fopen(cachePath(key).c_str(), "rb");
+        if (!file) return 0;
+        // The size in the header is only trusted once it matches the file
+        long fileSize = -1;
+        if (std::fseek(file, 0, SEEK_END) == 0) fileSize = std::ftell(file);
+        std::rewind(file);
+        CacheHeader header;
+        std::vector<char> binary;
+        bool ok = fileSize >= static_cast<long>(sizeof(header)) &&
+            std::fread(&header, sizeof(header), 1, file) == 1 &&
+            std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) == 0 && header.key == key &&
+            header.size > 0 && static_cast<unsigned long>(fileSize) - sizeof(header) == header.size;
+        if (ok) {
+            binary.resize(header.size);
+            ok = std::fread(binary.data(), 1, binary.size(), file) == binary.size();
+        }
+        std::fclose(file);
+        if (!ok) return 0;
+
+        unsigned int program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+        int success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            // Driver update with the same version strings, or a corrupt file: compile instead
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    // Written under a temporary name first, so a crash never leaves half a binary behind
+    bool storeProgram(uint64_t key, unsigned int program) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return false;
+        std::vector<char> binary(length);
+        GLsizei written = 0;
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0) return false;
+
+#ifdef _WIN32
+        _mkdir(cacheDirectory.c_str());
+#else
+        mkdir(cacheDirectory.c_str(), 0755);
+#endif
+        std::string path = cachePath(key);
+        std::string tempPath = path + ".tmp";
+        FILE* file = std::fopen(tempPath.c_str(), "wb");
+        if (!file) return false;
+        CacheHeader header;
+        std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+        header.key = key;
+        header.format = format;
+        header.size = static_cast<uint32_t>(written);
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+            std::fwrite(binary.data(), 1, written, file) == static_cast<size_t>(written);
+        ok = std::fclose(file) == 0 && ok;
+        std::remove(path.c_str()); // rename() won't replace on Windows
+        if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+void setShaderCacheDirectory(const std::string& directory) {
+    cacheDirectory = directory;
+}
+
+ShaderLoadStats getShaderLoadStats() {
+    return loadStats;
+}
+
+unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
+    auto start = std::chrono::steady_clock::now();
+    std::string vertexCode = readFile(vertexPath);
+    std::string fragmentCode = readFile(fragmentPath);
+    if (vertexCode.empty() || fragmentCode.empty()) return 0;
+
+    bool cached = cacheEnabled();
+    uint64_t key = cached ? programKey(vertexCode, fragmentCode) : 0;
+    unsigned int program = cached ? loadCachedProgram(key) : 0;
+    if (program) {
+        loadStats.fromCache++;
+    }
+    else {
+        program = buildProgram(vertexCode, fragmentCode, cached);
+        if (program && cached) {
+            if (storeProgram(key, program)) loadStats.cacheWrites++;
+            else logger.addLog(LogLevel::Warning, "Shader cache: could not write the binary for " + std::string(vertexPath));
+        }
+    }
+    if (program) loadStats.programs++;
+    loadStats.totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return program;
+}
+
 // made by Piotrixek / Veni
 // https://github.com/Piotrixek
\ No newline at end of file
@@ -5,3 +5,18 @@
 std::string readFile(const char* path);
 unsigned int compileShader(GLenum type, const std::string& source);
 unsigned int loadShader(const char* vertexPath, const char* fragmentPath);
+
+// On-disk program binary cache for loadShader(). Each program is keyed by a hash of both
+// sources and the driver (GL vendor, renderer and version strings) and loaded with
+// glProgramBinary from <directory>/<key>.bin when there is one. A missing file, or one the
+// driver rejects, falls back to compiling and linking, and the new binary replaces the file.
+// Off until a directory is set, and when the context offers no binary formats (core in GL 4.1).
+void setShaderCacheDirectory(const std::string& directory); // Empty turns the cache off
+
+struct ShaderLoadStats {
+    int programs = 0;     // loadShader() calls that produced a program
+    int fromCache = 0;
+    int cacheWrites = 0;
+    double totalMs = 0.0; // In loadShader(), file reads included
+};
+ShaderLoadStats getShaderLoadStats();
@@ -0,0 +1,152 @@
+// StrokeArena.cpp
+#include "StrokeArena.h"
+#include <cassert>
+
+static const uint32_t NoChunk = 0xFFFFFFFFu;
+
+StrokeArena::StrokeArena(size_t chunkSize, size_t maxRetainedChunks) :
+    chunkSize(chunkSize),
+    maxRetainedChunks(maxRetainedChunks),
+    currentChunk(NoChunk),
+    totalAllocations(0)
+{
+}
+
+StrokeArena::~StrokeArena() {
+    for (Chunk& chunk : chunks) {
+        delete[] chunk.memory;
+    }
+}
+
+void* StrokeArena::allocate(size_t bytes) {
+    if (bytes == 0) return nullptr;
+    size_t needed = sizeof(AllocationHeader) + ((bytes + Alignment - 1) & ~(Alignment - 1));
+
+    // Oversized allocations get a dedicated chunk so they don't waste the current one
+    if (needed > chunkSize) {
+        uint32_t index = acquireChunk(needed);
+        Chunk& dedicated = chunks[index];
+        AllocationHeader* header = reinterpret_cast<AllocationHeader*>(dedicated.memory);
+        header->chunkIndex = index;
+        header->reserved = 0;
+        header->bytes = bytes;
+        dedicated.offset = needed;
+        dedicated.liveAllocations = 1;
+        dedicated.liveBytes = bytes;
+        ++totalAllocations;
+        return header + 1;
+    }
+
+    if (currentChunk == NoChunk || chunks[currentChunk].offset + needed > chunks[currentChunk].capacity) {
+        // The full chunk stays alive until its last allocation is released
+        currentChunk = acquireChunk(needed);
+    }
+
+    Chunk& chunk = chunks[currentChunk];
+    AllocationHeader* header = reinterpret_cast<AllocationHeader*>(chunk.memory + chunk.offset);
+    header->chunkIndex = currentChunk;
+    header->reserved = 0;
+    header->bytes = bytes;
+    chunk.offset += needed;
+    chunk.liveAllocations++;
+    chunk.liveBytes += bytes;
+    ++totalAllocations;
+    return header + 1;
+}
+
+void StrokeArena::release(void* ptr) {
+    if (!ptr) return;
+    AllocationHeader* header = static_cast<AllocationHeader*>(ptr) - 1;
+    uint32_t index = header->chunkIndex;
+    assert(index < chunks.size() && chunks[index].liveAllocations > 0);
+
+    Chunk& chunk = chunks[index];
+    chunk.liveAllocations--;
+    chunk.liveBytes -= header->bytes;
+    if (chunk.liveAllocations == 0) {
+        if (index == currentChunk) {
+            chunk.offset = 0; // Keep bump-allocating from the start of the same chunk
+        }
+        else {
+            recycleChunk(index);
+        }
+    }
+}
+
+void StrokeArena::reset() {
+    for (uint32_t i = 0; i < chunks.size(); ++i) {
+        Chunk& chunk = chunks[i];
+        if (!chunk.memory) continue;
+        // Non-current chunks without allocations are already on the free list
+        if (i != currentChunk && chunk.liveAllocations == 0) continue;
+        chunk.liveAllocations = 0;
+        chunk.liveBytes = 0;
+        recycleChunk(i);
+    }
+    currentChunk = NoChunk;
+}
+
+void StrokeArena::trim() {
+    if (currentChunk != NoChunk && chunks[currentChunk].liveAllocations == 0) {
+        uint32_t index = currentChunk;
+        currentChunk = NoChunk;
+        delete[] chunks[index].memory;
+        chunks[index] = Chunk();
+        emptySlots.push_back(index);
+    }
+    for (uint32_t index : freeChunks) {
+        delete[] chunks[index].memory;
+        chunks[index] = Chunk();
+        emptySlots.push_back(index);
+    }
+    freeChunks.clear();
+}
+
+StrokeArena::Stats StrokeArena::getStats() const {
+    Stats stats;
+    for (const Chunk& chunk : chunks) {
+        if (!chunk.memory) continue;
+        stats.bytesReserved += chunk.capacity;
+        stats.bytesUsed += chunk.liveBytes;
+        stats.liveAllocations += chunk.liveAllocations;
+        stats.chunkCount++;
+    }
+    stats.freeChunkCount = freeChunks.size();
+    stats.totalAllocations = totalAllocations;
+    return stats;
+}
+
+uint32_t StrokeArena::acquireChunk(size_t minCapacity) {
+    if (minCapacity <= chunkSize && !freeChunks.empty()) {
+        uint32_t index = freeChunks.back();
+        freeChunks.pop_back();
+        return index;
+    }
+
+    Chunk chunk;
+    chunk.capacity = (minCapacity > chunkSize) ? minCapacity : chunkSize;
+    chunk.memory = new unsigned char[chunk.capacity];
+    if (!emptySlots.empty()) {
+        uint32_t index = emptySlots.back();
+        emptySlots.pop_back();
+        chunks[index] = chunk;
+        return index;
+    }
+    chunks.push_back(chunk);
+    return static_cast<uint32_t>(chunks.size() - 1);
+}
+
+void StrokeArena::recycleChunk(uint32_t index) {
+    Chunk& chunk = chunks[index];
+    chunk.offset = 0;
+    if (index == currentChunk) currentChunk = NoChunk;
+    // Oversized chunks and anything beyond the retention limit go back to the heap
+    if (chunk.capacity != chunkSize || freeChunks.size() >= maxRetainedChunks) {
+        delete[] chunk.memory;
+        chunk = Chunk();
+        emptySlots.push_back(index);
+    }
+    else {
+        freeChunks.push_back(index);
+    }
+}
@@ -0,0 +1,71 @@
+// StrokeArena.h
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Chunked allocator for stroke points and generated geometry.
+// Allocations are bump-allocated out of large chunks. Each chunk counts its live allocations
+// and is recycled as a whole once the count drops to zero, so freeing a stroke never touches
+// the heap and clearing a scene costs one operation per chunk rather than per stroke.
+// Not thread-safe: only the thread that owns the Painter allocates from it.
+class StrokeArena {
+public:
+    struct Stats {
+        size_t bytesReserved = 0;   // Memory held in chunks (including retained free chunks)
+        size_t bytesUsed = 0;       // Bytes in live allocations
+        size_t chunkCount = 0;      // Chunks currently allocated from the heap
+        size_t freeChunkCount = 0;  // Empty chunks kept around for reuse
+        size_t liveAllocations = 0;
+        size_t totalAllocations = 0; // Allocations served since construction
+    };
+
+    explicit StrokeArena(size_t chunkSize = 1 << 20, size_t maxRetainedChunks = 8);
+    ~StrokeArena();
+    StrokeArena(const StrokeArena&) = delete;
+    StrokeArena& operator=(const StrokeArena&) = delete;
+
+    void* allocate(size_t bytes);
+    void release(void* ptr);
+    // Releases every allocation at once. Pointers handed out before are invalid afterwards.
+    void reset();
+    // Returns retained empty chunks (and the current one, if nothing lives in it) to the heap
+    void trim();
+
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return count ? static_cast<T*>(allocate(count * sizeof(T))) : nullptr;
+    }
+
+    Stats getStats() const;
+    size_t getChunkSize() const { return chunkSize; }
+
+private:
+    struct Chunk {
+        unsigned char* memory = nullptr;
+        size_t capacity = 0;
+        size_t offset = 0;
+        size_t liveAllocations = 0;
+        size_t liveBytes = 0;
+    };
+
+    // Stored in front of every allocation so release() can find its chunk
+    struct alignas(16) AllocationHeader {
+        uint32_t chunkIndex;
+        uint32_t reserved;
+        uint64_t bytes;
+    };
+
+    static const size_t Alignment = 16;
+
+    uint32_t acquireChunk(size_t minCapacity);
+    void recycleChunk(uint32_t index);
+
+    size_t chunkSize;
+    size_t maxRetainedChunks;
+    std::vector<Chunk> chunks;
+    std::vector<uint32_t> freeChunks;   // Empty chunks with memory ready for reuse
+    std::vector<uint32_t> emptySlots;   // Chunk slots whose memory was returned to the heap
+    uint32_t currentChunk;
+    size_t totalAllocations;
+};
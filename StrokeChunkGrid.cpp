@@ -0,0 +1,103 @@
+// StrokeChunkGrid.cpp
+#include "StrokeChunkGrid.h"
+#include <algorithm>
+#include <utility>
+
+StrokeChunkGrid::StrokeChunkGrid(float cellSize) :
+    cellSize(cellSize)
+{
+}
+
+void StrokeChunkGrid::setCellSize(float size) {
+    if (size <= 0.0f || size == cellSize) return;
+    cellSize = size;
+    clear();
+}
+
+size_t StrokeChunkGrid::sync(const StrokeStore& store) {
+    const std::vector<uint64_t>& serials = store.getSerials();
+
+    // Find the unchanged prefix; everything after it was removed or replaced
+    size_t keep = std::min(serials.size(), syncedSerials.size());
+    while (keep > 0 && serials[keep - 1] != syncedSerials[keep - 1]) {
+        --keep;
+    }
+    size_t changes = (syncedSerials.size() - keep) + (serials.size() - keep);
+
+    // Strokes that left the store are the highest indices of their chunks
+    for (size_t i = syncedSerials.size(); i-- > keep;) {
+        auto uses = payloadUses.find(strokePayloads[i]);
+        if (--uses->second == 0) payloadUses.erase(uses);
+        if (strokeChunks[i] == NoChunk) {
+            instanced.pop_back();
+            continue;
+        }
+        Chunk& chunk = chunks[strokeChunks[i]];
+        chunk.members.pop_back();
+        if (chunk.members.size() < chunk.bakedCount) chunk.stale = true;
+    }
+    syncedSerials.resize(keep);
+    strokeChunks.resize(keep);
+    strokePayloads.resize(keep);
+
+    const std::vector<glm::vec3>& boundsMin = store.getBoundsMin();
+    const std::vector<glm::vec3>& boundsMax = store.getBoundsMax();
+    for (size_t i = keep; i < serials.size(); ++i) {
+        const StrokePayload* payload = store.payload(static_cast<uint32_t>(i)).get();
+        uint32_t chunkIndex = NoChunk;
+        if (payloadUses[payload]++ > 0) {
+            instanced.push_back(static_cast<uint32_t>(i));
+        }
+        else {
+            glm::vec3 center = (boundsMin[i] + boundsMax[i]) * 0.5f;
+            chunkIndex = chunkFor(glm::ivec3(glm::floor(center / cellSize)));
+            chunks[chunkIndex].members.push_back(static_cast<uint32_t>(i));
+        }
+        syncedSerials.push_back(serials[i]);
+        strokeChunks.push_back(chunkIndex);
+        strokePayloads.push_back(payload);
+    }
+    return changes;
+}
+
+void StrokeChunkGrid::clear() {
+    chunks.clear();
+    chunkLookup.clear();
+    syncedSerials.clear();
+    strokeChunks.clear();
+    strokePayloads.clear();
+    payloadUses.clear();
+    instanced.clear();
+}
+
+void StrokeChunkGrid::markBaked(Chunk& chunk, StrokeRef batch) {
+    chunk.batch = std::move(batch);
+    chunk.bakedCount = static_cast<uint32_t>(chunk.members.size());
+    chunk.stale = false;
+}
+
+void StrokeChunkGrid::collectUnbaked(std::vector<uint32_t>& out) const {
+    for (const Chunk& chunk : chunks) {
+        out.insert(out.end(), chunk.members.end() - chunk.pendingCount(), chunk.members.end());
+    }
+    out.insert(out.end(), instanced.begin(), instanced.end());
+}
+
+uint64_t StrokeChunkGrid::cellKey(const glm::ivec3& cell) {
+    // 21 bits per axis, offset so negative cells pack cleanly
+    const uint64_t mask = (1u << 21) - 1;
+    return ((static_cast<uint64_t>(cell.x + (1 << 20)) & mask) << 42) |
+        ((static_cast<uint64_t>(cell.y + (1 << 20)) & mask) << 21) |
+        (static_cast<uint64_t>(cell.z + (1 << 20)) & mask);
+}
+
+uint32_t StrokeChunkGrid::chunkFor(const glm::ivec3& cell) {
+    auto found = chunkLookup.find(cellKey(cell));
+    if (found != chunkLookup.end()) return found->second;
+    Chunk chunk;
+    chunk.cell = cell;
+    chunks.push_back(std::move(chunk));
+    uint32_t index = static_cast<uint32_t>(chunks.size() - 1);
+    chunkLookup.emplace(cellKey(cell), index);
+    return index;
+}
@@ -0,0 +1,63 @@
+// StrokeChunkGrid.h
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "StrokeStore.h"
+
+// Uniform grid over the scene used for static batching.
+// Every finished stroke belongs to the chunk holding the centre of its bounds. sync() diffs the
+// store against what it saw last time (strokes only ever change at the end of the store) and
+// only updates the chunks that gained or lost strokes. A chunk's batch stays usable while it
+// only gains strokes: the new ones are "pending" and drawn one by one on top of it until the
+// owner rebakes the chunk, which it can put off until the scene is idle. Losing a baked stroke
+// makes the batch stale, and all members are drawn one by one until the rebake.
+// Further copies of a payload (duplicates) never join a chunk: they stay on the instanced path.
+class StrokeChunkGrid {
+public:
+    struct Chunk {
+        glm::ivec3 cell;
+        std::vector<uint32_t> members; // Stroke indices, ascending
+        StrokeRef batch;               // Baked geometry of the first 'bakedCount' members (null while none)
+        uint32_t bakedCount = 0;
+        bool stale = false;            // Batch holds strokes that are gone: don't draw it
+        float lastRebuildMs = 0.0f;
+
+        bool needsRebake() const { return stale || bakedCount != members.size(); }
+        size_t pendingCount() const { return stale ? members.size() : members.size() - bakedCount; }
+    };
+
+    explicit StrokeChunkGrid(float cellSize = 2.0f);
+
+    void setCellSize(float size); // Re-buckets every stroke on the next sync
+    float getCellSize() const { return cellSize; }
+
+    // Brings chunk membership in line with the store. Returns the number of strokes added or removed.
+    size_t sync(const StrokeStore& store);
+    void clear();
+    // After rebaking 'chunk' from all its current members
+    static void markBaked(Chunk& chunk, StrokeRef batch);
+
+    // Appends every stroke not drawn by a chunk batch: pending members and instanced copies
+    void collectUnbaked(std::vector<uint32_t>& out) const;
+    size_t getInstancedCount() const { return instanced.size(); }
+
+    std::vector<Chunk>& getChunks() { return chunks; }
+    const std::vector<Chunk>& getChunks() const { return chunks; }
+
+private:
+    static const uint32_t NoChunk = ~0u; // strokeChunks value of instanced copies
+
+    static uint64_t cellKey(const glm::ivec3& cell);
+    uint32_t chunkFor(const glm::ivec3& cell);
+
+    float cellSize;
+    std::vector<Chunk> chunks;
+    std::unordered_map<uint64_t, uint32_t> chunkLookup;
+    std::vector<uint64_t> syncedSerials; // Store serials as of the last sync
+    std::vector<uint32_t> strokeChunks;  // Chunk of each synced stroke
+    std::vector<const StrokePayload*> strokePayloads; // Payload of each synced stroke
+    std::unordered_map<const StrokePayload*, uint32_t> payloadUses; // Synced strokes per payload
+    std::vector<uint32_t> instanced;     // Synced copies kept out of the chunks, ascending
+};
@@ -0,0 +1,255 @@
+// StrokeHistory.cpp
+#include "StrokeHistory.h"
+#include "PointCodec.h"
+#include "Globals.h"
+#include <algorithm>
+#include <utility>
+
+StrokeHistory::StrokeHistory() :
+    budgetBytes(256u * 1024u * 1024u),
+    bytesUsed(0),
+    compressionStep(1.0f / 1024.0f),
+    nextSerial(0),
+    evictedCommands(0)
+{
+}
+
+void StrokeHistory::recordAdd(uint32_t count) {
+    Command command;
+    command.addedCount = count;
+    command.removedCount = 0;
+    command.serial = nextSerial++;
+    clearRedo();
+    pushCommand(undoStack, std::move(command));
+    enforceBudget();
+}
+
+void StrokeHistory::recordReplace(std::vector<StrokeRecord>&& removed, uint32_t addedCount) {
+    Command command;
+    command.removedCount = static_cast<uint32_t>(removed.size());
+    command.removed.resize(removed.size());
+    for (size_t i = 0; i < removed.size(); ++i) {
+        command.removed[i].record = std::move(removed[i]);
+    }
+    removed.clear();
+    command.addedCount = addedCount;
+    command.serial = nextSerial++;
+    clearRedo();
+    pushCommand(undoStack, std::move(command));
+    enforceBudget();
+}
+
+bool StrokeHistory::undo(StrokeStore& scene) {
+    if (undoStack.empty()) {
+        // Strokes that never went through the history (nothing recorded yet): drop the last one
+        if (scene.empty()) return false;
+        Command command;
+        command.addedCount = 1;
+        command.serial = nextSerial++;
+        pushCommand(undoStack, std::move(command));
+    }
+    Command command = popCommand(undoStack);
+    if (!restore(command.removed)) {
+        returnCommand(undoStack, std::move(command));
+        return false;
+    }
+
+    takeFromScene(scene, command.addedCount, command.added);
+    giveToScene(scene, command.removed);
+    pushCommand(redoStack, std::move(command));
+    enforceBudget();
+    return true;
+}
+
+bool StrokeHistory::redo(StrokeStore& scene) {
+    if (redoStack.empty()) return false;
+    Command command = popCommand(redoStack);
+    if (!restore(command.added)) {
+        returnCommand(redoStack, std::move(command));
+        return false;
+    }
+
+    takeFromScene(scene, command.removedCount, command.removed);
+    giveToScene(scene, command.added);
+    pushCommand(undoStack, std::move(command));
+    enforceBudget();
+    return true;
+}
+
+void StrokeHistory::clearRedo() {
+    for (Command& command : redoStack) {
+        dropCommand(command);
+    }
+    redoStack.clear();
+}
+
+void StrokeHistory::clear() {
+    undoStack.clear();
+    redoStack.clear();
+    payloads.clear();
+    bytesUsed = 0;
+}
+
+void StrokeHistory::setMemoryBudget(size_t bytes) {
+    budgetBytes = bytes;
+    enforceBudget();
+}
+
+StrokeHistory::Stats StrokeHistory::getStats() const {
+    Stats stats;
+    stats.bytesUsed = bytesUsed;
+    stats.budgetBytes = budgetBytes;
+    stats.undoCount = undoStack.size();
+    stats.redoCount = redoStack.size();
+    stats.evictedCommands = evictedCommands;
+    for (const std::deque<Command>* stack : { &undoStack, &redoStack }) {
+        for (const Command& command : *stack) {
+            for (const std::vector<Entry>* entries : { &command.added, &command.removed }) {
+                for (const Entry& entry : *entries) {
+                    if (!entry.record.payload) stats.compressedStrokes++;
+                }
+            }
+        }
+    }
+    return stats;
+}
+
+void StrokeHistory::takeFromScene(StrokeStore& scene, uint32_t count, std::vector<Entry>& out) {
+    count = std::min<uint32_t>(count, static_cast<uint32_t>(scene.size()));
+    out.resize(count);
+    for (uint32_t i = count; i-- > 0;) {
+        out[i].record = scene.takeBack();
+    }
+}
+
+bool StrokeHistory::restore(std::vector<Entry>& entries) {
+    std::vector<glm::vec3> decoded;
+    for (Entry& entry : entries) {
+        if (entry.record.payload) continue;
+        // Cold entry: decode the control points and regenerate the mesh
+        decoded.resize(entry.packedPointCount);
+        bool decodedOk = PointCodec::decode(entry.packedPoints.data(), entry.packedPoints.size(),
+            entry.packedPointCount, compressionStep, decoded.data());
+        StrokeRef payload;
+        if (decodedOk && rebuild) payload = rebuild(decoded.data(), decoded.size(), entry.record.style, entry.record.size);
+        if (!payload) {
+            logger.addLog(std::string("[ERROR] History: cannot rebuild a stroke (") +
+                (!decodedOk ? "corrupt control points" : !rebuild ? "no rebuild function" : "rebuild failed") + "), undo/redo skipped");
+            return false;
+        }
+        entry.record.payload = std::move(payload);
+        entry.packedPoints.clear();
+        entry.packedPoints.shrink_to_fit();
+        entry.packedPointCount = 0;
+    }
+    return true;
+}
+
+void StrokeHistory::giveToScene(StrokeStore& scene, std::vector<Entry>& entries) {
+    for (Entry& entry : entries) {
+        scene.add(std::move(entry.record));
+    }
+    entries.clear();
+    entries.shrink_to_fit();
+}
+
+void StrokeHistory::pushCommand(std::deque<Command>& stack, Command&& command) {
+    returnCommand(stack, std::move(command));
+
+    // The command that just left the hot window gets compressed
+    if (stack.size() > HotCommands) {
+        Command& cooled = stack[stack.size() - 1 - HotCommands];
+        dropCommand(cooled);
+        compress(cooled);
+        cooled.bytes = measure(cooled);
+        bytesUsed += cooled.bytes;
+        hold(cooled);
+    }
+}
+
+void StrokeHistory::returnCommand(std::deque<Command>& stack, Command&& command) {
+    command.bytes = measure(command);
+    bytesUsed += command.bytes;
+    hold(command);
+    stack.push_back(std::move(command));
+}
+
+StrokeHistory::Command StrokeHistory::popCommand(std::deque<Command>& stack) {
+    Command command = std::move(stack.back());
+    stack.pop_back();
+    dropCommand(command);
+    return command;
+}
+
+void StrokeHistory::dropCommand(Command& command) {
+    bytesUsed -= command.bytes;
+    command.bytes = 0;
+    release(command);
+}
+
+void StrokeHistory::compress(Command& command) {
+    for (std::vector<Entry>* entries : { &command.added, &command.removed }) {
+        for (Entry& entry : *entries) {
+            StrokeRef& payload = entry.record.payload;
+            // Payloads still shared with the scene (or a duplicate) would not free anything,
+            // and baked batches can't be rebuilt from their control points
+            if (!payload || payload->isBatch()) continue;
+            uint32_t cached = cacheReferences ? cacheReferences(payload.get()) : 0;
+            if (payload.useCount() > 1 + cached) continue;
+            entry.packedPoints.clear();
+            PointCodec::encode(payload->points, payload->pointCount, compressionStep, entry.packedPoints);
+            entry.packedPoints.shrink_to_fit();
+            entry.packedPointCount = payload->pointCount;
+            payload.reset();
+        }
+    }
+}
+
+void StrokeHistory::enforceBudget() {
+    // Evict from the bottom of whichever stack holds the oldest command
+    while (bytesUsed > budgetBytes && (!undoStack.empty() || !redoStack.empty())) {
+        bool fromUndo = !undoStack.empty() &&
+            (redoStack.empty() || undoStack.front().serial < redoStack.front().serial);
+        std::deque<Command>& stack = fromUndo ? undoStack : redoStack;
+        dropCommand(stack.front());
+        stack.pop_front();
+        evictedCommands++;
+    }
+}
+
+size_t StrokeHistory::measure(const Command& command) {
+    size_t bytes = sizeof(Command);
+    for (const std::vector<Entry>* entries : { &command.added, &command.removed }) {
+        for (const Entry& entry : *entries) {
+            bytes += sizeof(Entry) + entry.packedPoints.capacity();
+        }
+    }
+    return bytes;
+}
+
+void StrokeHistory::hold(const Command& command) {
+    for (const std::vector<Entry>* entries : { &command.added, &command.removed }) {
+        for (const Entry& entry : *entries) {
+            const StrokePayload* payload = entry.record.payload.get();
+            if (!payload) continue;
+            Charge& charge = payloads[payload];
+            if (charge.holders++ == 0) {
+                charge.bytes = payload->byteSize();
+                bytesUsed += charge.bytes;
+            }
+        }
+    }
+}
+
+void StrokeHistory::release(const Command& command) {
+    for (const std::vector<Entry>* entries : { &command.added, &command.removed }) {
+        for (const Entry& entry : *entries) {
+            auto found = payloads.find(entry.record.payload.get());
+            if (found == payloads.end()) continue;
+            if (--found->second.holders == 0) {
+                bytesUsed -= found->second.bytes;
+                payloads.erase(found);
+            }
+        }
+    }
+}
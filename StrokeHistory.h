@@ -0,0 +1,117 @@
+// StrokeHistory.h
+#pragma once
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include "StrokeStore.h"
+
+// Undo/redo history for a StrokeStore.
+// Every operation is recorded as a command that replaces the last N strokes of the scene with
+// M other strokes. Commands only ever move StrokeRefs between the scene and themselves, so
+// undo and redo cost O(strokes touched) regardless of how much geometry those strokes hold.
+//
+// History memory is budgeted. Strokes held by commands that are more than a few steps away
+// from the top of either stack drop their payload (and with it any generated mesh) and keep
+// only their control points, quantized and delta-encoded with PointCodec. They are rebuilt
+// through the rebuild function when they return to the scene. If the history still exceeds
+// its budget, the oldest commands are evicted. A payload counts against the budget once for
+// as long as any command holds it, whoever else (scene, GPU mesh cache) shares it.
+//
+// If a cold stroke can't be rebuilt, undo()/redo() log an error and change nothing, so the
+// scene never ends up with fewer strokes than the command recorded.
+class StrokeHistory {
+public:
+    // Rebuilds a payload (points + generated mesh) for a stroke coming back from cold storage
+    typedef std::function<StrokeRef(const glm::vec3* points, size_t count, uint8_t style, float size)> RebuildFunction;
+    // References to a payload held by caches that let go of it once nobody else holds it (GPU meshes)
+    typedef std::function<uint32_t(const StrokePayload* payload)> CacheReferenceFunction;
+
+    struct Stats {
+        size_t bytesUsed = 0;        // Payloads the history holds (each once) + compressed points
+        size_t budgetBytes = 0;
+        size_t undoCount = 0;
+        size_t redoCount = 0;
+        size_t compressedStrokes = 0;
+        size_t evictedCommands = 0;  // Since construction
+    };
+
+    StrokeHistory();
+
+    // 'count' strokes were appended to the scene (endStroke, duplicate)
+    void recordAdd(uint32_t count = 1);
+    // The last removed.size() strokes of the scene were replaced by 'addedCount' new ones (merge)
+    void recordReplace(std::vector<StrokeRecord>&& removed, uint32_t addedCount);
+
+    bool undo(StrokeStore& scene);
+    bool redo(StrokeStore& scene);
+    void clearRedo();
+    void clear();
+
+    void setRebuildFunction(RebuildFunction function) { rebuild = function; }
+    // Compression skips payloads that someone else still uses; cache references don't count
+    void setCacheReferenceFunction(CacheReferenceFunction function) { cacheReferences = function; }
+    void setMemoryBudget(size_t bytes);
+    // Grid step (world units) used when compressing control points
+    void setCompressionStep(float step) { compressionStep = step; }
+
+    size_t getUndoCount() const { return undoStack.size(); }
+    size_t getRedoCount() const { return redoStack.size(); }
+    Stats getStats() const;
+
+private:
+    // A stroke held by a command: either hot (payload set) or cold (payload dropped,
+    // control points in 'packedPoints')
+    struct Entry {
+        StrokeRecord record;
+        std::vector<uint8_t> packedPoints;
+        uint32_t packedPointCount = 0;
+    };
+
+    struct Command {
+        // Strokes this command put into the scene / took out of it. Whichever side is
+        // currently in the scene is held there, and only its count is kept here.
+        std::vector<Entry> added;
+        std::vector<Entry> removed;
+        uint32_t addedCount = 0;
+        uint32_t removedCount = 0;
+        uint64_t serial = 0;   // Creation order, used to find the oldest command to evict
+        size_t bytes = 0;      // Entries and packed points, while it sits on a stack (payloads are in 'payloads')
+    };
+
+    static const size_t HotCommands = 4; // Commands nearest the top of each stack stay uncompressed
+
+    // Pops 'count' strokes off the scene into 'out', preserving their order
+    static void takeFromScene(StrokeStore& scene, uint32_t count, std::vector<Entry>& out);
+    // Rebuilds the payloads of cold entries; false (and nothing lost) if one can't be
+    bool restore(std::vector<Entry>& entries);
+    static void giveToScene(StrokeStore& scene, std::vector<Entry>& entries);
+
+    void pushCommand(std::deque<Command>& stack, Command&& command);
+    void returnCommand(std::deque<Command>& stack, Command&& command); // Undoes popCommand
+    Command popCommand(std::deque<Command>& stack);
+    void dropCommand(Command& command); // Releases what it was charged for
+    void compress(Command& command);
+    void enforceBudget();
+    static size_t measure(const Command& command);
+    void hold(const Command& command);
+    void release(const Command& command);
+
+    std::deque<Command> undoStack;
+    std::deque<Command> redoStack;
+    RebuildFunction rebuild;
+    CacheReferenceFunction cacheReferences;
+    size_t budgetBytes;
+    size_t bytesUsed; // Command bytes + payloadBytes
+
+    // Payloads held by any command: references from commands, and bytes charged once
+    struct Charge {
+        uint32_t holders = 0;
+        size_t bytes = 0;
+    };
+    std::unordered_map<const StrokePayload*, Charge> payloads;
+    float compressionStep;
+    uint64_t nextSerial;
+    size_t evictedCommands;
+};
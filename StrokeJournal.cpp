@@ -0,0 +1,350 @@
+// StrokeJournal.cpp
+#include "StrokeJournal.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char Magic[8] = { 'P', '3', 'D', 'J', 'R', 'N', 'L', '1' };
+static const size_t RecordHeaderSize = 9;            // size, crc, type
+static const uint32_t MaxRecordSize = 256u << 20;    // Anything larger is a torn length field
+static const size_t BatchBytes = 256 * 1024;         // Wake the writer early once this much is pending
+static const int BatchIntervalMs = 50;
+
+namespace {
+    struct CrcTable {
+        uint32_t entries[256];
+        CrcTable() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                }
+                entries[i] = value;
+            }
+        }
+    };
+}
+
+// CRC-32 of the record type and payload
+static uint32_t crc32(uint8_t type, const uint8_t* data, size_t size) {
+    static const CrcTable table;
+    uint32_t crc = ~0u;
+    crc = table.entries[(crc ^ type) & 0xFF] ^ (crc >> 8);
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+StrokeJournal::StrokeJournal() :
+    file(nullptr),
+    resetRequested(false),
+    flushRequested(false),
+    stopping(false),
+    syncInterval(1.0)
+{
+}
+
+StrokeJournal::~StrokeJournal() {
+    close();
+}
+
+bool StrokeJournal::open(const std::string& newPath, const ReplayFunction& replay, size_t* replayed, std::string* error,
+    std::string* keptAside) {
+    close();
+    path = newPath;
+    if (keptAside) keptAside->clear();
+
+    // Replay whatever is intact; 'validSize' ends up at the end of the last good record
+    uint64_t validSize = 0;
+    size_t count = 0;
+    bool refused = false;
+    std::string prefixPath = path + ".tmp";
+    {
+        MappedFile mapped;
+        if (mapped.open(path) && mapped.getSize() >= sizeof(Magic) && std::memcmp(mapped.getData(), Magic, sizeof(Magic)) == 0) {
+            const uint8_t* data = mapped.getData();
+            size_t size = mapped.getSize();
+            size_t offset = sizeof(Magic);
+            while (size - offset >= RecordHeaderSize) {
+                uint32_t recordSize, crc;
+                std::memcpy(&recordSize, data + offset, 4);
+                std::memcpy(&crc, data + offset + 4, 4);
+                uint8_t type = data[offset + 8];
+                if (recordSize > MaxRecordSize || size - offset - RecordHeaderSize < recordSize) break;
+                const uint8_t* payload = data + offset + RecordHeaderSize;
+                if (crc32(type, payload, recordSize) != crc) break;
+                if (replay && !replay(static_cast<RecordType>(type), payload, recordSize)) {
+                    refused = true;
+                    break;
+                }
+                offset += RecordHeaderSize + recordSize;
+                count++;
+            }
+            validSize = offset;
+            // The records after a refused one are still good: copy out what was replayed, so
+            // the journal can be set aside whole and 'path' go on from the replayed part
+            if (refused) {
+                FILE* prefix = std::fopen(prefixPath.c_str(), "wb");
+                bool written = prefix && std::fwrite(data, 1, offset, prefix) == offset;
+                if (prefix && std::fclose(prefix) != 0) written = false;
+                if (!written) {
+                    std::remove(prefixPath.c_str());
+                    if (error) *error = "Cannot write " + prefixPath;
+                    return false;
+                }
+            }
+        }
+    }
+    if (replayed) *replayed = count;
+    if (refused) {
+        std::string aside = path + ".unreplayed";
+        for (int n = 2; std::FILE* existing = std::fopen(aside.c_str(), "rb"); ++n) {
+            std::fclose(existing);
+            aside = path + ".unreplayed." + std::to_string(n);
+        }
+        if (std::rename(path.c_str(), aside.c_str()) != 0) {
+            std::remove(prefixPath.c_str());
+            if (error) *error = "Cannot set journal " + path + " aside";
+            return false;
+        }
+        if (keptAside) *keptAside = aside;
+        if (std::rename(prefixPath.c_str(), path.c_str()) != 0) {
+            std::remove(prefixPath.c_str());
+            validSize = 0; // Start over: everything is in the one set aside
+        }
+    }
+
+    // Append after the last good record, or start a fresh file
+    file = validSize > 0 ? std::fopen(path.c_str(), "r+b") : std::fopen(path.c_str(), "w+b");
+    if (!file) {
+        if (error) *error = "Cannot open journal " + path;
+        return false;
+    }
+    if (validSize == 0) {
+        std::fwrite(Magic, 1, sizeof(Magic), file);
+        validSize = sizeof(Magic);
+    }
+    if (!truncate(validSize) || std::fseek(file, static_cast<long>(validSize), SEEK_SET) != 0) {
+        std::fclose(file);
+        file = nullptr;
+        if (error) *error = "Cannot prepare journal " + path;
+        return false;
+    }
+    sync();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.clear();
+        pendingFiles.clear();
+        resetRequested = false;
+        flushRequested = false;
+        stopping = false;
+        stats = Stats();
+        stats.open = true;
+        stats.fileBytes = validSize;
+    }
+    writer = std::thread(&StrokeJournal::run, this);
+    return true;
+}
+
+void StrokeJournal::close() {
+    if (!file) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    std::fclose(file);
+    file = nullptr;
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.open = false;
+}
+
+void StrokeJournal::discard() {
+    if (!file) return;
+    close();
+    std::remove(path.c_str());
+}
+
+void StrokeJournal::encode(RecordType type, const void* data, size_t size, std::vector<uint8_t>& out) {
+    uint32_t recordSize = static_cast<uint32_t>(size);
+    uint32_t crc = crc32(type, static_cast<const uint8_t*>(data), size);
+    size_t offset = out.size();
+    out.resize(offset + RecordHeaderSize + size);
+    uint8_t* record = out.data() + offset;
+    std::memcpy(record, &recordSize, 4);
+    std::memcpy(record + 4, &crc, 4);
+    record[8] = type;
+    if (size > 0) std::memcpy(record + RecordHeaderSize, data, size);
+}
+
+void StrokeJournal::append(RecordType type, const void* data, size_t size) {
+    if (!file) return;
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        encode(type, data, size, pending);
+        stats.records++;
+        stats.pendingBytes = pending.size();
+        full = pending.size() >= BatchBytes;
+    }
+    if (full) wake.notify_one();
+}
+
+void StrokeJournal::appendFile(RecordType type, const void* data, size_t size, const std::string& filePath) {
+    if (!file) return;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        PendingFile record = { pending.size(), type, std::vector<uint8_t>(bytes, bytes + size), filePath };
+        pendingFiles.push_back(std::move(record));
+        stats.records++;
+    }
+    wake.notify_one(); // Hashing may take a while, start now
+}
+
+void StrokeJournal::reset() {
+    if (!file) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.clear(); // Would be cut off by the reset anyway
+        pendingFiles.clear();
+        stats.pendingBytes = 0;
+        resetRequested = true;
+    }
+    wake.notify_one();
+}
+
+void StrokeJournal::flush() {
+    if (!file) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushRequested = true;
+    }
+    wake.notify_one();
+}
+
+StrokeJournal::Stats StrokeJournal::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void StrokeJournal::run() {
+    Profiler::setThreadName("Journal writer");
+    std::vector<uint8_t> writing;
+    std::vector<PendingFile> files;
+    std::vector<uint8_t> fileRecord;
+    auto lastSync = std::chrono::steady_clock::now();
+    bool unsynced = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        // Batch up records: wake every BatchIntervalMs, or early when a lot piles up
+        wake.wait_for(lock, std::chrono::milliseconds(BatchIntervalMs), [this]() {
+            return stopping || flushRequested || resetRequested || !pendingFiles.empty() || pending.size() >= BatchBytes;
+        });
+        bool doReset = resetRequested;
+        bool forceSync = flushRequested || stopping;
+        bool stop = stopping;
+        resetRequested = false;
+        flushRequested = false;
+        writing.swap(pending);
+        pending.clear();
+        files.swap(pendingFiles);
+        pendingFiles.clear();
+        stats.pendingBytes = 0;
+        lock.unlock();
+
+        // Disk work happens without the lock, so append() never waits on it
+        Profiler::Scope writeZone("Journal write");
+        auto writeStart = std::chrono::steady_clock::now();
+        if (doReset) {
+            truncate(sizeof(Magic));
+            std::fseek(file, static_cast<long>(sizeof(Magic)), SEEK_SET);
+            unsynced = true;
+        }
+        // File records are completed here, off the main thread, and spliced in where they were appended
+        size_t written = 0, copied = 0;
+        for (const PendingFile& pendingFile : files) {
+            uint64_t digest[2] = { 0, 0 };
+            {
+                PROFILE_SCOPE("Journal file hash");
+                MappedFile mapped;
+                if (mapped.open(pendingFile.path)) {
+                    digest[0] = mapped.getSize();
+                    digest[1] = mapped.contentHash();
+                }
+            }
+            std::vector<uint8_t> payload(pendingFile.prefix);
+            const uint8_t* digestBytes = reinterpret_cast<const uint8_t*>(digest);
+            payload.insert(payload.end(), digestBytes, digestBytes + sizeof(digest));
+            payload.insert(payload.end(), pendingFile.path.begin(), pendingFile.path.end());
+            fileRecord.clear();
+            encode(pendingFile.type, payload.data(), payload.size(), fileRecord);
+            std::fwrite(writing.data() + copied, 1, pendingFile.position - copied, file);
+            std::fwrite(fileRecord.data(), 1, fileRecord.size(), file);
+            written += pendingFile.position - copied + fileRecord.size();
+            copied = pendingFile.position;
+        }
+        if (copied < writing.size()) {
+            std::fwrite(writing.data() + copied, 1, writing.size() - copied, file);
+            written += writing.size() - copied;
+        }
+        if (written > 0) {
+            std::fflush(file);
+            unsynced = true;
+        }
+        double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - writeStart).count();
+        writeZone.end();
+
+        double syncMs = -1.0;
+        auto now = std::chrono::steady_clock::now();
+        if (unsynced && (forceSync || now - lastSync >= syncInterval)) {
+            PROFILE_SCOPE("Journal fsync");
+            sync();
+            lastSync = std::chrono::steady_clock::now();
+            syncMs = std::chrono::duration<double, std::milli>(lastSync - now).count();
+            unsynced = false;
+        }
+
+        lock.lock();
+        if (doReset) stats.fileBytes = sizeof(Magic);
+        if (written > 0) {
+            stats.fileBytes += written;
+            stats.writes++;
+            stats.lastWriteMs = writeMs;
+        }
+        if (syncMs >= 0.0) {
+            stats.syncs++;
+            stats.lastSyncMs = syncMs;
+        }
+        writing.clear();
+        files.clear();
+        if (stop) break;
+    }
+}
+
+bool StrokeJournal::truncate(uint64_t size) {
+    std::fflush(file);
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), static_cast<long long>(size)) == 0;
+#else
+    return ftruncate(fileno(file), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+void StrokeJournal::sync() {
+    std::fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
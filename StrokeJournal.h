@@ -0,0 +1,111 @@
+// StrokeJournal.h
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Append-only log of scene edits, so a crashed session can be replayed on the next start.
+//
+// The main thread only copies each record into a memory buffer; a background thread writes
+// the buffer out in batches (every 50 ms, or sooner once 256 KB pile up) and syncs it to disk every
+// syncInterval. A crash loses at most the records of the last sync window. Every record
+// carries its length and a CRC, and replay stops at the first torn or corrupt one, which is
+// then cut off before appending resumes. A record the replay function refuses (e.g. a scene
+// file that went missing) also stops the replay, but nothing is lost: the whole journal is
+// kept aside and only the replayed records carry on.
+//
+// File layout: "P3DJRNL1", then records of [uint32 size][uint32 crc][uint8 type][size bytes].
+// What the payloads mean is up to the caller (see Painter::replayJournalRecord).
+class StrokeJournal {
+public:
+    enum RecordType : uint8_t {
+        AddStroke = 1,   // Finished stroke: material, size, style, transform, packed points
+        Undo = 2,
+        Redo = 3,
+        ClearUndone = 4,
+        Duplicate = 5,   // mat4 offset
+        Merge = 6,       // Material, size and style of the merged stroke
+        Bake = 7,
+        LoadScene = 8,   // File size, content hash, then the scene file's path
+        ImportPoints = 9, // Material, size, style, file size, content hash, then the imported file's path
+        StreamCancelled = 10 // Strokes a cancelled (or failed) stream had delivered, after its LoadScene
+    };
+
+    struct Stats {
+        bool open = false;
+        uint64_t records = 0;      // Appended since open
+        uint64_t fileBytes = 0;    // Written to the file so far
+        size_t pendingBytes = 0;   // Appended but not written yet
+        size_t writes = 0;
+        size_t syncs = 0;
+        double lastWriteMs = 0.0;
+        double lastSyncMs = 0.0;
+    };
+
+    // Returns false to stop the replay there (see open())
+    typedef std::function<bool(RecordType type, const uint8_t* data, size_t size)> ReplayFunction;
+
+    StrokeJournal();
+    ~StrokeJournal();
+    StrokeJournal(const StrokeJournal&) = delete;
+    StrokeJournal& operator=(const StrokeJournal&) = delete;
+
+    // Feeds every intact record of 'path' to 'replay', then opens it for appending (creating it
+    // if needed). 'replayed' receives the number of records replayed. If 'replay' stopped early,
+    // the journal as it was is renamed to 'keptAside' (path.unreplayed, .unreplayed.2, ...) and
+    // 'path' starts over with the records before the one refused.
+    bool open(const std::string& path, const ReplayFunction& replay, size_t* replayed = nullptr, std::string* error = nullptr,
+        std::string* keptAside = nullptr);
+    // Writes and syncs everything pending, then stops the writer
+    void close();
+    // Clean shutdown: closes the journal and deletes the file, so the next start replays nothing
+    void discard();
+
+    // Main thread. Never waits on the disk.
+    void append(RecordType type, const void* data = nullptr, size_t size = 0);
+    // Appends 'data' followed by the size and content hash of 'filePath' and the path itself
+    // (LoadScene, ImportPoints). The writer reads the file for the hash, in order with the other
+    // records; one it can't read gets size and hash 0, which no replay will accept.
+    void appendFile(RecordType type, const void* data, size_t size, const std::string& filePath);
+    // Drops every record: the scene was cleared or replaced. Applied by the writer.
+    void reset();
+    // Asks the writer to write and sync now instead of at the next interval
+    void flush();
+
+    void setSyncInterval(double seconds) { syncInterval = std::chrono::duration<double>(seconds); }
+    bool isOpen() const { return file != nullptr; }
+    Stats getStats() const;
+
+private:
+    // A file record waiting for its digest; goes in at 'position' of 'pending'
+    struct PendingFile {
+        size_t position;
+        RecordType type;
+        std::vector<uint8_t> prefix;
+        std::string path;
+    };
+
+    static void encode(RecordType type, const void* data, size_t size, std::vector<uint8_t>& out);
+    void run();
+    bool truncate(uint64_t size);
+    void sync();
+
+    FILE* file;
+    std::string path;
+    std::thread writer;
+    mutable std::mutex mutex;         // Guards everything below 'file' that both threads touch
+    std::condition_variable wake;
+    std::vector<uint8_t> pending;     // Records the writer hasn't taken yet
+    std::vector<PendingFile> pendingFiles;
+    bool resetRequested;
+    bool flushRequested;
+    bool stopping;
+    Stats stats;
+    std::chrono::duration<double> syncInterval;
+};
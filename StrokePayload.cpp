@@ -0,0 +1,134 @@
+// StrokePayload.cpp
+#include "StrokePayload.h"
+#include <new>
+#include <limits>
+
+static size_t alignUp(size_t value) {
+    return (value + 15) & ~size_t(15);
+}
+
+size_t StrokePayload::byteSize() const {
+    if (backing) return alignUp(sizeof(StrokePayload)); // Arrays are not ours
+    size_t bytes = alignUp(sizeof(StrokePayload)) + alignUp(pointCount * sizeof(glm::vec3)) +
+        alignUp(vertexCount * sizeof(StrokeVertex)) + alignUp(indexCount * sizeof(unsigned int));
+    if (isBatch()) {
+        bytes += alignUp(vertexCount * sizeof(uint32_t)) + alignUp(materialCount * sizeof(StrokeMaterial)) +
+            alignUp(rangeCount * sizeof(StrokeBatchRange));
+    }
+    return bytes;
+}
+
+StrokeRef& StrokeRef::operator=(const StrokeRef& other) {
+    if (other.payload) other.payload->refCount++;
+    reset();
+    payload = other.payload;
+    return *this;
+}
+
+StrokeRef& StrokeRef::operator=(StrokeRef&& other) noexcept {
+    if (this != &other) {
+        reset();
+        payload = other.payload;
+        other.payload = nullptr;
+    }
+    return *this;
+}
+
+void StrokeRef::reset() {
+    if (payload && --payload->refCount == 0) {
+        StrokeArena* arena = payload->arena;
+        payload->~StrokePayload();
+        arena->release(payload);
+    }
+    payload = nullptr;
+}
+
+StrokePayloadBuilder::StrokePayloadBuilder(StrokeArena& arena, size_t pointCount, size_t vertexCount, size_t indexCount,
+    size_t materialCount, size_t rangeCount) {
+    // One allocation: [header][points][vertices][indices]([materialIds][materials][ranges]), each 16-byte aligned
+    bool batch = materialCount > 0;
+    size_t headerBytes = alignUp(sizeof(StrokePayload));
+    size_t pointBytes = alignUp(pointCount * sizeof(glm::vec3));
+    size_t vertexBytes = alignUp(vertexCount * sizeof(StrokeVertex));
+    size_t indexBytes = alignUp(indexCount * sizeof(unsigned int));
+    size_t idBytes = batch ? alignUp(vertexCount * sizeof(uint32_t)) : 0;
+    size_t materialBytes = batch ? alignUp(materialCount * sizeof(StrokeMaterial)) : 0;
+    size_t rangeBytes = batch ? alignUp(rangeCount * sizeof(StrokeBatchRange)) : 0;
+    unsigned char* memory = static_cast<unsigned char*>(arena.allocate(
+        headerBytes + pointBytes + vertexBytes + indexBytes + idBytes + materialBytes + rangeBytes));
+
+    payload = new (memory) StrokePayload();
+    payload->arena = &arena;
+    payload->refCount = 1;
+    unsigned char* cursor = memory + headerBytes;
+    payload->points = reinterpret_cast<glm::vec3*>(cursor);
+    payload->pointCount = static_cast<uint32_t>(pointCount);
+    cursor += pointBytes;
+    payload->vertices = reinterpret_cast<StrokeVertex*>(cursor);
+    payload->vertexCount = static_cast<uint32_t>(vertexCount);
+    cursor += vertexBytes;
+    payload->indices = reinterpret_cast<unsigned int*>(cursor);
+    payload->indexCount = static_cast<uint32_t>(indexCount);
+    cursor += indexBytes;
+
+    payload->materialIds = nullptr;
+    payload->materials = nullptr;
+    payload->materialCount = 0;
+    payload->ranges = nullptr;
+    payload->rangeCount = 0;
+    if (batch) {
+        payload->materialIds = reinterpret_cast<uint32_t*>(cursor);
+        cursor += idBytes;
+        payload->materials = new (cursor) StrokeMaterial[materialCount]();
+        payload->materialCount = static_cast<uint32_t>(materialCount);
+        cursor += materialBytes;
+        payload->ranges = new (cursor) StrokeBatchRange[rangeCount]();
+        payload->rangeCount = static_cast<uint32_t>(rangeCount);
+    }
+}
+
+StrokeRef StrokePayloadBuilder::view(StrokeArena& arena, const StrokePayload& layout, StrokeBacking backing) {
+    StrokePayload* payload = new (arena.allocate(sizeof(StrokePayload))) StrokePayload();
+    payload->points = layout.points;
+    payload->pointCount = layout.pointCount;
+    payload->vertices = layout.vertices;
+    payload->vertexCount = layout.vertexCount;
+    payload->indices = layout.indices;
+    payload->indexCount = layout.indexCount;
+    payload->boundsMin = layout.boundsMin;
+    payload->boundsMax = layout.boundsMax;
+    payload->materialIds = layout.materialIds;
+    payload->materials = layout.materials;
+    payload->materialCount = layout.materialCount;
+    payload->ranges = layout.ranges;
+    payload->rangeCount = layout.rangeCount;
+    payload->arena = &arena;
+    payload->refCount = 1;
+    payload->backing = std::move(backing);
+    return StrokeRef(payload);
+}
+
+StrokePayloadBuilder::~StrokePayloadBuilder() {
+    // Abandoned before finish(): drop the allocation
+    StrokeRef discard(payload);
+}
+
+StrokeRef StrokePayloadBuilder::finish() {
+    glm::vec3 bMin(std::numeric_limits<float>::max());
+    glm::vec3 bMax(-std::numeric_limits<float>::max());
+    for (uint32_t i = 0; i < payload->pointCount; ++i) {
+        bMin = glm::min(bMin, payload->points[i]);
+        bMax = glm::max(bMax, payload->points[i]);
+    }
+    // Generated meshes can reach past the control points (tube radius, batched dabs)
+    for (uint32_t i = 0; i < payload->vertexCount; ++i) {
+        bMin = glm::min(bMin, payload->vertices[i].position);
+        bMax = glm::max(bMax, payload->vertices[i].position);
+    }
+    payload->boundsMin = bMin;
+    payload->boundsMax = bMax;
+
+    StrokeRef ref(payload);
+    payload = nullptr;
+    return ref;
+}
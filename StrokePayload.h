@@ -0,0 +1,127 @@
+// StrokePayload.h
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <glm/glm.hpp>
+#include "StrokeArena.h"
+
+// Vertex layout shared by tube meshes and the base instanced meshes
+struct StrokeVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    // Add texCoords here later for texturing
+    // glm::vec2 texCoords;
+};
+
+// Material applied to a stroke. Strokes reference these by index into the material table.
+struct StrokeMaterial {
+    glm::vec4 ambientColor;
+    glm::vec4 diffuseColor;
+    glm::vec4 specularColor;
+    float shininess;
+
+    bool operator==(const StrokeMaterial& other) const {
+        return ambientColor == other.ambientColor && diffuseColor == other.diffuseColor &&
+            specularColor == other.specularColor && shininess == other.shininess;
+    }
+};
+
+// Index range of a baked batch drawn with one primitive type
+struct StrokeBatchRange {
+    enum Primitive : uint8_t { Triangles, Lines, Points };
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    Primitive primitive;
+    float size; // Line width / point size (unused for triangles)
+};
+
+// Keeps external memory alive (e.g. a mapped scene file) for payloads whose arrays point into it
+typedef std::shared_ptr<const void> StrokeBacking;
+
+// Immutable geometry of a stroke: control points plus any generated mesh.
+// Header and arrays live in a single StrokeArena allocation (views only put the header there and
+// point at external memory, see StrokePayloadBuilder::view). Payloads are reference counted
+// through StrokeRef so the scene, the undo history and duplicated strokes can all share one
+// copy; the allocation goes back to the arena when the last reference drops.
+// Reference counting is not atomic: payloads belong to the thread that owns the Painter.
+class StrokePayload {
+public:
+    const glm::vec3* points;
+    uint32_t pointCount;
+    const StrokeVertex* vertices;
+    uint32_t vertexCount;
+    const unsigned int* indices; // Local to 'vertices'
+    uint32_t indexCount;
+    glm::vec3 boundsMin; // Covers points and vertices
+    glm::vec3 boundsMax;
+
+    // Baked batches only (null/0 otherwise): several strokes flattened into one mesh whose
+    // vertices pick their material from a table, drawn range by range
+    const uint32_t* materialIds; // One per vertex, indexes 'materials'
+    const StrokeMaterial* materials;
+    uint32_t materialCount;
+    const StrokeBatchRange* ranges;
+    uint32_t rangeCount;
+
+    bool isBatch() const { return materialIds != nullptr; }
+    size_t byteSize() const;
+
+private:
+    friend class StrokeRef;
+    friend class StrokePayloadBuilder;
+    StrokeArena* arena;
+    mutable uint32_t refCount;
+    StrokeBacking backing; // Set for views: arrays live in external memory, not the arena
+};
+
+// Intrusive reference to a StrokePayload
+class StrokeRef {
+public:
+    StrokeRef() : payload(nullptr) {}
+    StrokeRef(const StrokeRef& other) : payload(other.payload) { if (payload) payload->refCount++; }
+    StrokeRef(StrokeRef&& other) noexcept : payload(other.payload) { other.payload = nullptr; }
+    ~StrokeRef() { reset(); }
+    StrokeRef& operator=(const StrokeRef& other);
+    StrokeRef& operator=(StrokeRef&& other) noexcept;
+
+    void reset();
+    const StrokePayload* get() const { return payload; }
+    const StrokePayload* operator->() const { return payload; }
+    const StrokePayload& operator*() const { return *payload; }
+    explicit operator bool() const { return payload != nullptr; }
+    uint32_t useCount() const { return payload ? payload->refCount : 0; }
+
+private:
+    friend class StrokePayloadBuilder;
+    explicit StrokeRef(StrokePayload* adopt) : payload(adopt) {}
+    StrokePayload* payload;
+};
+
+// Allocates a payload and exposes its arrays for filling in before it is frozen
+class StrokePayloadBuilder {
+public:
+    // A non-zero materialCount makes a baked batch (adds material ids, table and ranges)
+    StrokePayloadBuilder(StrokeArena& arena, size_t pointCount, size_t vertexCount, size_t indexCount,
+        size_t materialCount = 0, size_t rangeCount = 0);
+    ~StrokePayloadBuilder();
+    StrokePayloadBuilder(const StrokePayloadBuilder&) = delete;
+    StrokePayloadBuilder& operator=(const StrokePayloadBuilder&) = delete;
+
+    glm::vec3* points() { return const_cast<glm::vec3*>(payload->points); }
+    StrokeVertex* vertices() { return const_cast<StrokeVertex*>(payload->vertices); }
+    unsigned int* indices() { return const_cast<unsigned int*>(payload->indices); }
+    uint32_t* materialIds() { return const_cast<uint32_t*>(payload->materialIds); }
+    StrokeMaterial* materials() { return const_cast<StrokeMaterial*>(payload->materials); }
+    StrokeBatchRange* ranges() { return const_cast<StrokeBatchRange*>(payload->ranges); }
+
+    // Computes bounds from the points and vertices and hands out the first reference
+    StrokeRef finish();
+
+    // Payload whose arrays point into memory owned by 'backing' (zero-copy loading).
+    // Copies the public fields of 'layout', bounds included; only the header uses the arena.
+    static StrokeRef view(StrokeArena& arena, const StrokePayload& layout, StrokeBacking backing);
+
+private:
+    StrokePayload* payload;
+};
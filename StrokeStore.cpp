@@ -0,0 +1,108 @@
+// StrokeStore.cpp
+#include "StrokeStore.h"
+#include <utility>
+
+// World-space AABB of a transformed box (Arvo's method)
+static void transformBounds(const glm::vec3& bMin, const glm::vec3& bMax, const glm::mat4& m, glm::vec3& outMin, glm::vec3& outMax) {
+    outMin = outMax = glm::vec3(m[3]);
+    for (int col = 0; col < 3; ++col) {
+        for (int row = 0; row < 3; ++row) {
+            float a = m[col][row] * bMin[col];
+            float b = m[col][row] * bMax[col];
+            outMin[row] += (a < b) ? a : b;
+            outMax[row] += (a < b) ? b : a;
+        }
+    }
+}
+
+uint32_t StrokeStore::add(StrokeRef payload, const StrokeMaterial& material, float size, uint8_t style, const glm::mat4& transform) {
+    uint32_t index = static_cast<uint32_t>(styles.size());
+    pushHeader(*payload, style, size, findOrAddMaterial(material), transform);
+    payloads.push_back(std::move(payload));
+    return index;
+}
+
+uint32_t StrokeStore::add(StrokeRecord&& record) {
+    return add(std::move(record.payload), record.material, record.size, record.style, record.transform);
+}
+
+uint32_t StrokeStore::duplicate(uint32_t index, const glm::mat4& offset) {
+    uint32_t newIndex = static_cast<uint32_t>(styles.size());
+    StrokeRef shared = payloads[index]; // Take the reference before push_back can reallocate
+    glm::mat4 transform = offset * transforms[index];
+    pushHeader(*shared, styles[index], sizes[index], materialIndices[index], transform);
+    payloads.push_back(std::move(shared));
+    return newIndex;
+}
+
+StrokeRecord StrokeStore::takeBack() {
+    uint32_t last = static_cast<uint32_t>(size() - 1);
+    StrokeRecord record;
+    record.payload = std::move(payloads[last]);
+    record.material = material(last);
+    record.size = sizes[last];
+    record.style = styles[last];
+    record.transform = transforms[last];
+    popHeader();
+    return record;
+}
+
+void StrokeStore::popBack() {
+    if (empty()) return;
+    popHeader();
+}
+
+void StrokeStore::clear() {
+    boundsMin.clear();
+    boundsMax.clear();
+    styles.clear();
+    sizes.clear();
+    materialIndices.clear();
+    transforms.clear();
+    serials.clear();
+    payloads.clear();
+    materials.clear();
+}
+
+void StrokeStore::reserve(size_t strokeCount) {
+    boundsMin.reserve(strokeCount);
+    boundsMax.reserve(strokeCount);
+    styles.reserve(strokeCount);
+    sizes.reserve(strokeCount);
+    materialIndices.reserve(strokeCount);
+    transforms.reserve(strokeCount);
+    serials.reserve(strokeCount);
+    payloads.reserve(strokeCount);
+}
+
+uint32_t StrokeStore::findOrAddMaterial(const StrokeMaterial& material) {
+    // Most strokes reuse the last brush material, so search backwards
+    for (size_t i = materials.size(); i-- > 0;) {
+        if (materials[i] == material) return static_cast<uint32_t>(i);
+    }
+    materials.push_back(material);
+    return static_cast<uint32_t>(materials.size() - 1);
+}
+
+void StrokeStore::pushHeader(const StrokePayload& payload, uint8_t style, float size, uint32_t materialIndex, const glm::mat4& transform) {
+    glm::vec3 bMin, bMax;
+    transformBounds(payload.boundsMin, payload.boundsMax, transform, bMin, bMax);
+    boundsMin.push_back(bMin);
+    boundsMax.push_back(bMax);
+    styles.push_back(style);
+    sizes.push_back(size);
+    materialIndices.push_back(materialIndex);
+    transforms.push_back(transform);
+    serials.push_back(nextSerial++);
+}
+
+void StrokeStore::popHeader() {
+    boundsMin.pop_back();
+    boundsMax.pop_back();
+    styles.pop_back();
+    sizes.pop_back();
+    materialIndices.pop_back();
+    transforms.pop_back();
+    serials.pop_back();
+    payloads.pop_back();
+}
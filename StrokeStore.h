@@ -0,0 +1,88 @@
+// StrokeStore.h
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "StrokePayload.h"
+
+// A stroke taken out of a store (e.g. held by the undo history)
+struct StrokeRecord {
+    StrokeRef payload;
+    StrokeMaterial material;
+    float size;
+    uint8_t style;
+    glm::mat4 transform = glm::mat4(1.0f);
+};
+
+// Structure-of-arrays storage for finished strokes.
+// Hot per-stroke header data (bounds, style, size, material index) lives in tightly packed
+// parallel arrays so culling/sorting loops only touch what they need. Control points and
+// generated geometry are shared, immutable StrokePayloads referenced from a cold array;
+// strokes sharing a payload are instances that differ only by their transform.
+// (Payloads took over from pooled point/vertex/index arrays addressed by offset and count:
+// a pool range can't be shared by copies and the undo history without copying it, and
+// removing strokes from the middle of a pool means compacting it. The payloads' memory comes
+// from a StrokeArena, which keeps the pools' few-large-allocations behaviour.)
+class StrokeStore {
+public:
+    // Appends a stroke and returns its index
+    uint32_t add(StrokeRef payload, const StrokeMaterial& material, float size, uint8_t style,
+        const glm::mat4& transform = glm::mat4(1.0f));
+    uint32_t add(StrokeRecord&& record);
+    // Appends another instance of stroke 'index', placed at 'offset' * its transform
+    uint32_t duplicate(uint32_t index, const glm::mat4& offset = glm::mat4(1.0f));
+    // Removes the last stroke and hands back its reference and header
+    StrokeRecord takeBack();
+    void popBack();
+    void clear();
+    void reserve(size_t strokeCount);
+
+    size_t size() const { return styles.size(); }
+    bool empty() const { return styles.empty(); }
+
+    // --- Hot header arrays ---
+    const std::vector<glm::vec3>& getBoundsMin() const { return boundsMin; }
+    const std::vector<glm::vec3>& getBoundsMax() const { return boundsMax; }
+    const std::vector<uint8_t>& getStyles() const { return styles; }
+    const std::vector<float>& getSizes() const { return sizes; }
+    const std::vector<uint32_t>& getMaterialIndices() const { return materialIndices; }
+    const std::vector<glm::mat4>& getTransforms() const { return transforms; }
+    // Unique per added stroke (never reused), so observers can tell which slots changed
+    const std::vector<uint64_t>& getSerials() const { return serials; }
+
+    // --- Per-stroke accessors ---
+    uint8_t style(uint32_t i) const { return styles[i]; }
+    float size(uint32_t i) const { return sizes[i]; }
+    const StrokeMaterial& material(uint32_t i) const { return materials[materialIndices[i]]; }
+    uint32_t materialIndex(uint32_t i) const { return materialIndices[i]; }
+    const glm::mat4& transform(uint32_t i) const { return transforms[i]; }
+    const StrokeRef& payload(uint32_t i) const { return payloads[i]; }
+
+    const glm::vec3* points(uint32_t i) const { return payloads[i]->points; }
+    uint32_t pointCount(uint32_t i) const { return payloads[i]->pointCount; }
+    const StrokeVertex* vertices(uint32_t i) const { return payloads[i]->vertices; }
+    uint32_t vertexCount(uint32_t i) const { return payloads[i]->vertexCount; }
+    const unsigned int* indices(uint32_t i) const { return payloads[i]->indices; }
+    uint32_t indexCount(uint32_t i) const { return payloads[i]->indexCount; }
+
+    const std::vector<StrokeMaterial>& getMaterials() const { return materials; }
+
+private:
+    uint32_t findOrAddMaterial(const StrokeMaterial& material);
+    void pushHeader(const StrokePayload& payload, uint8_t style, float size, uint32_t materialIndex, const glm::mat4& transform);
+    void popHeader();
+
+    // Hot data (bounds are in world space, i.e. with the transform applied)
+    std::vector<glm::vec3> boundsMin;
+    std::vector<glm::vec3> boundsMax;
+    std::vector<uint8_t> styles;
+    std::vector<float> sizes;
+    std::vector<uint32_t> materialIndices;
+    std::vector<glm::mat4> transforms;
+
+    // Cold data
+    std::vector<uint64_t> serials;
+    uint64_t nextSerial = 1;
+    std::vector<StrokeRef> payloads;
+    std::vector<StrokeMaterial> materials;
+};
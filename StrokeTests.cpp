@@ -0,0 +1,692 @@
+// StrokeTests.cpp
+#include "StrokeTests.h"
+#include "Painter.h"
+#include "StrokeStore.h"
+#include "StrokeHistory.h"
+#include "RecordingRenderDevice.h"
+#include "SceneStreamLoader.h"
+#include "SceneFile.h"
+#include "PointCodec.h"
+#include "LogQueue.h"
+#include "Globals.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <random>
+
+// --- Heap counter (standalone build only: the app keeps the default operator new) ---
+#ifdef P3D_TESTS_MAIN
+// GCC inlines these next to its builtin operator new and reports malloc/free as a mismatch.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+namespace {
+    std::atomic<size_t> heapBytes(0);
+    std::atomic<size_t> heapLargest(0); // Largest single allocation since the last reset
+}
+
+void* operator new(size_t bytes) {
+    heapBytes.fetch_add(bytes, std::memory_order_relaxed);
+    size_t largest = heapLargest.load(std::memory_order_relaxed);
+    while (bytes > largest && !heapLargest.compare_exchange_weak(largest, bytes, std::memory_order_relaxed)) {}
+    if (void* ptr = std::malloc(bytes ? bytes : 1)) return ptr;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t bytes) { return operator new(bytes); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+#endif
+
+namespace {
+    const uint8_t TubeStyle = 4; // Painter::TUBE
+
+    class Checker {
+    public:
+        void check(bool passed, const std::string& name) {
+            checks++;
+            if (!passed) failures++;
+            std::printf("%s %s\n", passed ? "PASS" : "FAIL", name.c_str());
+        }
+        int finish() const {
+            std::printf("%d checks, %d failed\n", checks, failures);
+            return failures ? 1 : 0;
+        }
+    private:
+        int checks = 0;
+        int failures = 0;
+    };
+
+    struct HeapSample {
+        size_t bytes = 0;
+        size_t largest = 0;
+        bool counted = false;
+    };
+
+    HeapSample heapSample() {
+        HeapSample sample;
+#ifdef P3D_TESTS_MAIN
+        sample.bytes = heapBytes.load(std::memory_order_relaxed);
+        sample.largest = heapLargest.exchange(0, std::memory_order_relaxed);
+        sample.counted = true;
+#endif
+        return sample;
+    }
+
+    StrokeRef makePayload(StrokeArena& arena, size_t count) {
+        StrokePayloadBuilder builder(arena, count, count, 0);
+        for (size_t i = 0; i < count; ++i) {
+            builder.points()[i] = glm::vec3(static_cast<float>(i), 0.0f, 0.0f);
+            builder.vertices()[i].position = builder.points()[i];
+            builder.vertices()[i].normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+        return builder.finish();
+    }
+
+    // Spirals stacked along y, 200 points each, in the painter's current style
+    void drawStrokes(Painter& painter, int count) {
+        for (int s = 0; s < count; ++s) {
+            for (int p = 0; p < 200; ++p) {
+                float t = p * 0.05f;
+                painter.addPoint(glm::vec3(std::cos(t) * 4.0f, s * 1.0f, std::sin(t) * 4.0f + t));
+            }
+            painter.endStroke();
+        }
+    }
+
+    // --- StrokeRef identity and use counts through StrokeStore and StrokeHistory ---
+    void testSharing(Checker& checker) {
+        StrokeArena arena;
+        StrokeStore store;
+        StrokeHistory history;
+        StrokeMaterial material = { glm::vec4(0.1f), glm::vec4(1.0f), glm::vec4(0.5f), 32.0f };
+
+        StrokeRef original = makePayload(arena, 64);
+        const StrokePayload* payload = original.get();
+        checker.check(original.useCount() == 1, "new payload has one reference");
+        store.add(original, material, 1.0f, TubeStyle);
+        history.recordAdd();
+        checker.check(store.payload(0).get() == payload && original.useCount() == 2, "store shares the added payload");
+        original.reset();
+        checker.check(store.payload(0).useCount() == 1, "store holds the last reference");
+
+        StrokeArena::Stats before = arena.getStats();
+        store.duplicate(0, glm::translate(glm::mat4(1.0f), glm::vec3(5.0f, 0.0f, 0.0f)));
+        history.recordAdd();
+        checker.check(store.size() == 2 && store.payload(1).get() == payload && store.payload(0).useCount() == 2,
+            "duplicate shares the payload");
+        checker.check(store.getBoundsMin()[1].x == store.getBoundsMin()[0].x + 5.0f, "duplicate has its own transform");
+
+        StrokeRef observer = store.payload(0); // Keeps the count readable while the history holds the strokes
+        checker.check(history.undo(store) && history.undo(store) && store.empty(), "undo removes both strokes");
+        checker.check(observer.useCount() == 3, "history keeps both references on undo");
+        checker.check(history.redo(store) && history.redo(store) && store.size() == 2, "redo restores both strokes");
+        checker.check(store.payload(0).get() == payload && store.payload(1).get() == payload && observer.useCount() == 3,
+            "redo hands back the same payload");
+
+        StrokeRecord taken = store.takeBack();
+        checker.check(taken.payload.get() == payload && observer.useCount() == 3, "takeBack moves the reference out");
+        taken.payload.reset();
+
+        StrokeArena::Stats after = arena.getStats();
+        checker.check(after.totalAllocations == before.totalAllocations && after.bytesUsed == before.bytesUsed,
+            "duplicate, undo and redo allocate nothing in the arena");
+
+        store.clear();
+        history.clear();
+        checker.check(observer.useCount() == 1, "clearing the store and history drops their references");
+        observer.reset();
+        checker.check(arena.getStats().liveAllocations == 0, "last reference frees the payload");
+    }
+
+    // --- Allocation counters around undo/redo/duplicate on a headless Painter ---
+    void testPainterCopies(Checker& checker) {
+        const int Strokes = 8;
+        const int Steps = 4; // Within the history's hot window, so nothing is compressed and rebuilt
+        Painter painter(false);
+        painter.setHistoryMemoryBudget(size_t(1) << 30);
+        painter.setDrawStyle(Painter::TUBE);
+        drawStrokes(painter, Strokes);
+        StrokeArena::Stats before = painter.getMemoryStats();
+        checker.check(painter.getStrokeCount() == Strokes && before.liveAllocations == Strokes, "painter built one payload per stroke");
+        size_t strokeBytes = before.bytesUsed / Strokes; // Geometry of one stroke
+
+        enum Action { Undo, Redo, Duplicate };
+        struct Step {
+            const char* name;
+            Action action;
+        };
+        const Step steps[] = { { "undo", Undo }, { "redo", Redo }, { "duplicate", Duplicate }, { "undo duplicate", Undo }, { "redo duplicate", Redo } };
+        int expected = Strokes;
+        for (const Step& step : steps) {
+            StrokeArena::Stats arenaBefore = painter.getMemoryStats();
+            HeapSample heapBefore = heapSample();
+            for (int i = 0; i < Steps; ++i) {
+                if (step.action == Undo) painter.undoStroke();
+                else if (step.action == Redo) painter.redoStroke();
+                else painter.duplicateLastStroke();
+            }
+            HeapSample heapAfter = heapSample();
+            StrokeArena::Stats arenaAfter = painter.getMemoryStats();
+            expected += step.action == Undo ? -Steps : Steps;
+            std::string name = step.name;
+            checker.check(painter.getStrokeCount() == expected, name + ": stroke count");
+            checker.check(arenaAfter.totalAllocations == arenaBefore.totalAllocations && arenaAfter.bytesUsed == arenaBefore.bytesUsed,
+                name + ": no arena allocations (" + std::to_string(arenaAfter.totalAllocations - arenaBefore.totalAllocations) + ")");
+            if (heapAfter.counted) {
+                // Bookkeeping (history commands, store slots) is fine; anything the size of a
+                // stroke's geometry is a copy
+                checker.check(heapAfter.largest < strokeBytes / 4,
+                    name + ": no geometry-sized heap allocation (" + std::to_string(heapAfter.bytes - heapBefore.bytes) +
+                    " bytes in total, largest " + std::to_string(heapAfter.largest) + ", stroke " + std::to_string(strokeBytes) + ")");
+            }
+        }
+        checker.check(painter.getMemoryStats().liveAllocations == Strokes, "duplicates share their payloads");
+    }
+
+    void drawFrame(Painter& painter) {
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 5.0f, 30.0f), glm::vec3(0.0f, 5.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+        painter.draw(view, projection, glm::vec3(0.0f, 5.0f, 30.0f));
+    }
+
+    // --- History budget with strokes that have been drawn (the GPU mesh cache holds them too) ---
+    void testHistoryDrawnStrokes(Checker& checker) {
+        const int Strokes = 12;
+        StrokeHistory::Stats undrawn, drawn;
+        size_t buffersDrawn = 0, buffersBaseline = 0;
+        for (int pass = 0; pass < 2; ++pass) {
+            RecordingRenderDevice device;
+            Painter painter(device);
+            painter.setDrawStyle(Painter::TUBE);
+            drawStrokes(painter, Strokes);
+            if (pass == 1) drawFrame(painter);
+            for (int i = 0; i < Strokes - 1; ++i) painter.undoStroke();
+            drawFrame(painter);
+            (pass == 1 ? drawn : undrawn) = painter.getHistoryStats();
+            if (pass == 1) buffersDrawn = device.getBufferCount();
+        }
+        {
+            RecordingRenderDevice device;
+            Painter painter(device);
+            painter.setDrawStyle(Painter::TUBE);
+            drawStrokes(painter, 1);
+            drawFrame(painter);
+            buffersBaseline = device.getBufferCount();
+        }
+        checker.check(drawn.compressedStrokes > 0 && drawn.compressedStrokes == undrawn.compressedStrokes,
+            "drawn strokes compress like undrawn ones (" + std::to_string(drawn.compressedStrokes) + " vs " +
+            std::to_string(undrawn.compressedStrokes) + ")");
+        checker.check(drawn.bytesUsed == undrawn.bytesUsed,
+            "history bytes with drawn strokes: " + std::to_string(drawn.bytesUsed) + " vs " + std::to_string(undrawn.bytesUsed));
+        checker.check(buffersDrawn == buffersBaseline,
+            "undone strokes free their GPU buffers (" + std::to_string(buffersDrawn) + " buffers, " + std::to_string(buffersBaseline) + " for one stroke)");
+    }
+
+    // --- Chunk batches: strokes drawn before their chunk baked keep no meshes of their own ---
+    void testChunkMeshes(Checker& checker) {
+        size_t buffers[2], bytes[2];
+        for (int pass = 0; pass < 2; ++pass) {
+            RecordingRenderDevice device;
+            Painter painter(device);
+            painter.setChunkedRendering(true);
+            painter.setDrawStyle(Painter::TUBE);
+            drawStrokes(painter, 20);
+            if (pass == 1) drawFrame(painter); // Drawn one by one first: no chunk has baked yet
+            painter.flushChunks();
+            drawFrame(painter);
+            buffers[pass] = device.getBufferCount();
+            bytes[pass] = device.getBufferBytes();
+        }
+        checker.check(buffers[1] == buffers[0] && bytes[1] == bytes[0],
+            "baked strokes free their own meshes (" + std::to_string(buffers[1]) + " buffers, " + std::to_string(bytes[1]) +
+            " bytes; baked directly " + std::to_string(buffers[0]) + ", " + std::to_string(bytes[0]) + ")");
+    }
+
+    // Helix points; with 'mesh', a strip of triangles over them (stands in for a generated mesh)
+    StrokeRef makeHelixPayload(StrokeArena& arena, const glm::vec3* points, size_t count, bool mesh) {
+        size_t triangles = mesh && count > 2 ? count - 2 : 0;
+        StrokePayloadBuilder builder(arena, count, mesh ? count : 0, triangles * 3);
+        for (size_t i = 0; i < count; ++i) {
+            builder.points()[i] = points[i];
+            if (!mesh) continue;
+            builder.vertices()[i].position = points[i] + glm::vec3(0.0f, 0.1f, 0.0f);
+            builder.vertices()[i].normal = glm::normalize(glm::vec3(points[i].x, 0.0f, points[i].z) + glm::vec3(0.001f));
+        }
+        for (size_t t = 0; t < triangles; ++t) {
+            for (int k = 0; k < 3; ++k) builder.indices()[t * 3 + k] = static_cast<unsigned int>(t + k);
+        }
+        return builder.finish();
+    }
+
+    std::vector<glm::vec3> helix(size_t count, float phase) {
+        std::vector<glm::vec3> points(count);
+        for (size_t i = 0; i < count; ++i) {
+            float a = phase + i * 0.1f;
+            points[i] = glm::vec3(std::cos(a) * 3.0f, i * 0.05f, std::sin(a) * 3.0f);
+        }
+        return points;
+    }
+
+    // --- Scene files: save and load keep every stroke, raw, packed or without meshes ---
+    void testSceneRoundTrip(Checker& checker) {
+        const char* path = "selftest_roundtrip.p3d";
+        const float Step = 0.001f;
+        StrokeArena arena;
+        StrokeStore store;
+        StrokeMaterial red = { glm::vec4(0.2f, 0.0f, 0.0f, 1.0f), glm::vec4(1.0f, 0.0f, 0.0f, 1.0f), glm::vec4(1.0f), 32.0f };
+        StrokeMaterial blue = { glm::vec4(0.0f, 0.0f, 0.2f, 1.0f), glm::vec4(0.0f, 0.0f, 1.0f, 0.5f), glm::vec4(0.5f), 8.0f };
+        std::vector<glm::vec3> tube = helix(200, 0.0f), line = helix(37, 1.0f), dot = helix(1, 2.0f);
+        store.add(makeHelixPayload(arena, tube.data(), tube.size(), true), red, 2.0f, TubeStyle);
+        store.duplicate(0, glm::translate(glm::mat4(1.0f), glm::vec3(5.0f, 0.0f, 0.0f)));
+        store.add(makeHelixPayload(arena, line.data(), line.size(), false), blue, 1.0f, 0, // FREEHAND
+            glm::rotate(glm::mat4(1.0f), 0.5f, glm::vec3(0.0f, 1.0f, 0.0f)));
+        store.add(makeHelixPayload(arena, dot.data(), dot.size(), false), blue, 3.0f, 2); // POINTS
+
+        const char* modes[] = { "raw", "packed", "without meshes" };
+        for (int mode = 0; mode < 3; ++mode) {
+            SceneFile::SaveOptions options;
+            options.pointStep = mode == 1 ? Step : 0.0f;
+            options.includeMeshes = mode != 2;
+            std::string name = std::string(", ") + modes[mode];
+            checker.check(SceneFile::save(path, store, options), "scene saves" + name);
+
+            size_t rebuilt = 0;
+            StrokeArena loadArena;
+            StrokeStore loaded;
+            SceneFile::RebuildFunction rebuild = [&](const glm::vec3* points, size_t count, uint8_t, float) {
+                ++rebuilt;
+                return makeHelixPayload(loadArena, points, count, true);
+            };
+            std::string error;
+            checker.check(SceneFile::load(path, loadArena, loaded, rebuild, nullptr, &error), "scene loads" + name + (error.empty() ? "" : ": " + error));
+            if (loaded.size() != store.size()) {
+                checker.check(false, "scene keeps its strokes" + name + " (" + std::to_string(loaded.size()) + ")");
+                continue;
+            }
+
+            bool headers = true, meshes = true;
+            float pointError = 0.0f;
+            for (uint32_t i = 0; i < store.size(); ++i) {
+                headers = headers && loaded.style(i) == store.style(i) && loaded.size(i) == store.size(i) &&
+                    loaded.material(i) == store.material(i) && loaded.transform(i) == store.transform(i) &&
+                    loaded.pointCount(i) == store.pointCount(i);
+                if (loaded.pointCount(i) != store.pointCount(i)) continue;
+                for (uint32_t p = 0; p < store.pointCount(i); ++p) {
+                    glm::vec3 d = glm::abs(loaded.points(i)[p] - store.points(i)[p]);
+                    pointError = std::max(pointError, std::max(d.x, std::max(d.y, d.z)));
+                }
+                // Saved meshes come back as they were, and the rebuild makes the same mesh from the same points
+                meshes = meshes && loaded.vertexCount(i) == store.vertexCount(i) && loaded.indexCount(i) == store.indexCount(i) &&
+                    std::memcmp(loaded.vertices(i), store.vertices(i), store.vertexCount(i) * sizeof(StrokeVertex)) == 0 &&
+                    std::memcmp(loaded.indices(i), store.indices(i), store.indexCount(i) * sizeof(unsigned int)) == 0;
+            }
+            checker.check(headers, "scene keeps stroke headers" + name);
+            checker.check(mode == 1 ? pointError <= Step * 0.5f + 1e-5f : pointError == 0.0f,
+                "scene keeps control points" + name + " (max error " + std::to_string(pointError) + ")");
+            checker.check(meshes, "scene keeps meshes" + name);
+            checker.check(loaded.payload(0).get() == loaded.payload(1).get(), "duplicates still share a payload" + name);
+            checker.check(rebuilt == (mode == 2 ? 1u : 0u), "meshes rebuilt" + name + ": " + std::to_string(rebuilt));
+        }
+        std::remove(path);
+    }
+
+    // --- Point codec: error bounds, extreme jumps, and streams cut short or corrupt ---
+    void testPointCodec(Checker& checker) {
+        const PointCodec::Format formats[] = { PointCodec::Varint, PointCodec::BitPacked };
+        const char* formatNames[] = { "varint", "bit-packed" };
+        const float Step = 0.001f;
+        for (int f = 0; f < 2; ++f) {
+            std::string name = std::string(", ") + formatNames[f];
+            // Counts around the 32-point blocks
+            bool roundTrips = true, truncationCaught = true;
+            float maxError = 0.0f;
+            const size_t counts[] = { 0, 1, 31, 32, 33, 100 };
+            for (size_t count : counts) {
+                std::vector<glm::vec3> points = helix(count, 0.3f);
+                std::vector<uint8_t> encoded;
+                PointCodec::encode(points.data(), points.size(), Step, encoded, formats[f]);
+                std::vector<glm::vec3> decoded(count);
+                if (!PointCodec::decode(encoded.data(), encoded.size(), count, Step, decoded.data())) {
+                    roundTrips = false;
+                    continue;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    glm::vec3 d = glm::abs(decoded[i] - points[i]);
+                    maxError = std::max(maxError, std::max(d.x, std::max(d.y, d.z)));
+                }
+                // Every shorter prefix is missing deltas, so it has to be refused (exact-size copies
+                // so a read past the end would land outside the allocation)
+                for (size_t cut = 0; count > 0 && cut < encoded.size(); ++cut) {
+                    std::vector<uint8_t> prefix(encoded.begin(), encoded.begin() + cut);
+                    if (PointCodec::decode(prefix.data(), prefix.size(), count, Step, decoded.data())) truncationCaught = false;
+                }
+            }
+            checker.check(roundTrips && maxError <= Step * 0.5f + 1e-5f,
+                "codec round trip within half a step" + name + " (max error " + std::to_string(maxError) + ")");
+            checker.check(truncationCaught, "codec refuses truncated streams" + name);
+
+            // Jumps across the whole grid wrap in the deltas and still come back exactly (step 1:
+            // these integers are exact floats); anything past 2^30 cells clamps instead of wrapping
+            std::vector<glm::vec3> extreme = {
+                glm::vec3(1e9f, -1e9f, 0.0f), glm::vec3(-1e9f, 1e9f, 1.0f), glm::vec3(1e9f, 0.0f, -1e9f), glm::vec3(5e9f, -5e9f, 0.0f)
+            };
+            std::vector<uint8_t> encoded;
+            PointCodec::encode(extreme.data(), extreme.size(), 1.0f, encoded, formats[f]);
+            std::vector<glm::vec3> decoded(extreme.size());
+            bool ok = PointCodec::decode(encoded.data(), encoded.size(), extreme.size(), 1.0f, decoded.data());
+            const float Limit = 1073741824.0f; // 2^30
+            checker.check(ok && decoded[0] == extreme[0] && decoded[1] == extreme[1] && decoded[2] == extreme[2],
+                "codec keeps full-range jumps exact" + name);
+            checker.check(ok && decoded[3] == glm::vec3(Limit, -Limit, 0.0f), "codec clamps points beyond the grid" + name);
+        }
+
+        // Unknown format byte, impossible bit width, random garbage: refused or decoded, never a crash
+        std::vector<glm::vec3> points = helix(40, 0.0f), decoded(40);
+        std::vector<uint8_t> encoded;
+        PointCodec::encode(points.data(), points.size(), Step, encoded, PointCodec::BitPacked);
+        std::vector<uint8_t> corrupt = encoded;
+        corrupt[0] = 7;
+        bool badFormat = !PointCodec::decode(corrupt.data(), corrupt.size(), 40, Step, decoded.data());
+        corrupt = encoded;
+        corrupt[1] = 33;
+        bool badWidth = !PointCodec::decode(corrupt.data(), corrupt.size(), 40, Step, decoded.data());
+        checker.check(badFormat && badWidth, "codec refuses unknown formats and widths over 32 bits");
+        std::mt19937 random(7);
+        for (int i = 0; i < 2000; ++i) {
+            std::vector<uint8_t> garbage(1 + random() % 64);
+            for (uint8_t& byte : garbage) byte = static_cast<uint8_t>(random());
+            garbage[0] = static_cast<uint8_t>(1 + i % 2);
+            PointCodec::decode(garbage.data(), garbage.size(), 40, Step, decoded.data());
+        }
+        checker.check(true, "codec survives random streams");
+    }
+
+    // --- Steady frames: an unchanged scene uploads nothing and looks up no uniforms ---
+    void testSteadyFrame(Checker& checker) {
+        for (int chunked = 0; chunked < 2; ++chunked) {
+            RecordingRenderDevice device;
+            Painter painter(device);
+            painter.setChunkedRendering(chunked != 0);
+            painter.setDrawStyle(Painter::TUBE);
+            drawStrokes(painter, 6);
+            painter.duplicateLastStroke(glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 0.0f)));
+            painter.setDrawStyle(Painter::CUBE);
+            drawStrokes(painter, 2);
+            painter.flushChunks();
+            drawFrame(painter);
+            device.resetStats();
+            drawFrame(painter);
+            const RecordingRenderDevice::Stats& stats = device.getStats();
+            std::string mode = chunked ? "chunked" : "per stroke";
+            checker.check(stats.drawCalls > 0 && stats.uploadBytes == 0,
+                "second frame of an unchanged scene uploads nothing, " + mode + " (" + std::to_string(stats.uploadBytes) + " bytes)");
+            checker.check(stats.uniformLookups == 0,
+                "uniform locations are looked up once, " + mode + " (" + std::to_string(stats.uniformLookups) + " lookups)");
+        }
+    }
+
+    // --- Clearing the scene hands the arena's memory back ---
+    void testClearArena(Checker& checker) {
+        Painter painter(false);
+        painter.setDrawStyle(Painter::TUBE);
+        drawStrokes(painter, 50);
+        for (int i = 0; i < 20; ++i) painter.undoStroke();
+        drawStrokes(painter, 10);
+        painter.clear();
+        StrokeArena::Stats stats = painter.getMemoryStats();
+        checker.check(stats.bytesReserved == 0 && stats.chunkCount == 0,
+            "clear releases the arena (" + std::to_string(stats.bytesReserved) + " bytes in " + std::to_string(stats.chunkCount) + " chunks)");
+    }
+
+    // --- Scene streaming: the worker waits for deliver() instead of decoding the whole file ahead ---
+    void testStreamBacklog(Checker& checker) {
+        const char* scenePath = "selftest_stream.p3d";
+        const size_t Strokes = 10000; // About ten batches
+        {
+            Painter painter(false);
+            painter.setDrawStyle(Painter::FREEHAND);
+            drawStrokes(painter, 1);
+            for (size_t i = 1; i < Strokes; ++i) painter.duplicateLastStroke(glm::translate(glm::mat4(1.0f), glm::vec3(0.01f, 0.0f, 0.0f)));
+            checker.check(painter.saveScene(scenePath), "stream scene saves");
+        }
+        SceneStreamLoader loader;
+        checker.check(loader.start(scenePath, SceneStreamLoader::MeshFunction()), "stream starts");
+        // Nobody delivers: let the worker run until it stops making progress
+        size_t decoded = 0;
+        for (int i = 0; i < 100; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            size_t now = loader.getProgress().strokesDecoded;
+            if (i > 2 && now == decoded) break;
+            decoded = now;
+        }
+        checker.check(decoded > 0 && decoded < Strokes,
+            "stream worker waits for deliver (" + std::to_string(decoded) + " of " + std::to_string(Strokes) + " decoded)");
+        StrokeArena arena;
+        StrokeStore store;
+        while (loader.isActive()) loader.deliver(arena, store, 5.0);
+        checker.check(store.size() == Strokes && !loader.getProgress().failed,
+            "stream delivers every stroke (" + std::to_string(store.size()) + ")");
+        std::remove(scenePath);
+    }
+
+    // --- Crash recovery: a painter destroyed without closeJournal() leaves its journal behind ---
+    void testJournalSaveUndo(Checker& checker) {
+        const char* scenePath = "selftest_scene.p3d";
+        const char* journalPath = "selftest_journal.p3dj";
+        std::remove(journalPath);
+        int liveCount;
+        {
+            Painter painter(false);
+            checker.check(painter.openJournal(journalPath), "journal opens");
+            painter.setDrawStyle(Painter::TUBE);
+            drawStrokes(painter, 10);
+            painter.mergeAllStrokes();
+            checker.check(painter.saveScene(scenePath), "scene saves");
+            painter.undoStroke(); // Nothing left to undo: the save cleared the history
+            drawStrokes(painter, 2);
+            painter.undoStroke();
+            liveCount = painter.getStrokeCount();
+        }
+        Painter recovered(false);
+        checker.check(recovered.openJournal(journalPath), "journal reopens");
+        checker.check(recovered.getStrokeCount() == liveCount,
+            "save, undo, replay: " + std::to_string(recovered.getStrokeCount()) + " strokes recovered, " + std::to_string(liveCount) + " live");
+        recovered.closeJournal();
+        std::remove(scenePath);
+    }
+
+    bool writeText(const char* path, const std::string& text) {
+        FILE* file = std::fopen(path, "wb");
+        if (!file) return false;
+        bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        return std::fclose(file) == 0 && ok;
+    }
+
+    // A file the journal refers to goes missing: the replay stops there but keeps the journal
+    void testJournalMissingFile(Checker& checker) {
+        const char* pointsPath = "selftest_points.xyz";
+        const char* journalPath = "selftest_journal.p3dj";
+        std::string aside = std::string(journalPath) + ".unreplayed";
+        std::remove(journalPath);
+        std::remove(aside.c_str());
+        std::string points;
+        for (int i = 0; i < 100; ++i) points += std::to_string(i * 0.1f) + " 1 2\n";
+        checker.check(writeText(pointsPath, points), "points file written");
+        int liveCount;
+        {
+            Painter painter(false);
+            painter.openJournal(journalPath);
+            drawStrokes(painter, 3);
+            checker.check(painter.importPoints(pointsPath, Painter::POINTS), "points import");
+            drawStrokes(painter, 2);
+            liveCount = painter.getStrokeCount();
+        }
+        std::remove(pointsPath);
+        {
+            Painter recovered(false);
+            recovered.openJournal(journalPath);
+            checker.check(recovered.getStrokeCount() == 3, "replay stops at the missing file (" + std::to_string(recovered.getStrokeCount()) + " strokes)");
+        }
+        FILE* kept = std::fopen(aside.c_str(), "rb");
+        checker.check(kept != nullptr, "whole journal kept aside");
+        if (kept) std::fclose(kept);
+
+        // Putting the file back and the journal in place recovers everything
+        writeText(pointsPath, points);
+        std::remove(journalPath);
+        std::rename(aside.c_str(), journalPath);
+        Painter restored(false);
+        restored.openJournal(journalPath);
+        checker.check(restored.getStrokeCount() == liveCount,
+            "kept journal replays in full (" + std::to_string(restored.getStrokeCount()) + " of " + std::to_string(liveCount) + " strokes)");
+        restored.closeJournal();
+        std::remove(pointsPath);
+    }
+
+    long fileSize(const char* path) {
+        FILE* file = std::fopen(path, "rb");
+        if (!file) return -1;
+        long size = std::fseek(file, 0, SEEK_END) == 0 ? std::ftell(file) : -1;
+        std::fclose(file);
+        return size;
+    }
+
+    // A crash mid-write leaves a torn record at the end: replay keeps the intact prefix, cuts the
+    // tail off and appends after it
+    void testJournalTornTail(Checker& checker) {
+        const char* journalPath = "selftest_journal.p3dj";
+        std::remove(journalPath);
+        {
+            Painter painter(false);
+            painter.openJournal(journalPath);
+            drawStrokes(painter, 5);
+        }
+        long intactSize = fileSize(journalPath);
+
+        // Half a record header plus junk after the last record
+        FILE* file = std::fopen(journalPath, "ab");
+        const uint8_t junk[] = { 0xff, 0xff, 0x00, 0x00, 0x12, 0x34, 0x56 };
+        bool appended = file && std::fwrite(junk, 1, sizeof(junk), file) == sizeof(junk);
+        if (file) appended = std::fclose(file) == 0 && appended;
+        checker.check(appended, "junk appended to the journal");
+        {
+            Painter recovered(false);
+            recovered.openJournal(journalPath);
+            checker.check(recovered.getStrokeCount() == 5,
+                "junk tail: " + std::to_string(recovered.getStrokeCount()) + " of 5 strokes recovered");
+            checker.check(fileSize(journalPath) == intactSize, "junk tail cut off the journal");
+        }
+
+        // Cut inside the last stroke record: only the strokes before it come back
+        long tornSize = intactSize - 100;
+        file = std::fopen(journalPath, "rb");
+        std::vector<uint8_t> bytes(static_cast<size_t>(tornSize));
+        bool read = file && std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        if (file) std::fclose(file);
+        checker.check(read && writeText(journalPath, std::string(bytes.begin(), bytes.end())), "journal torn mid-record");
+        {
+            Painter recovered(false);
+            recovered.openJournal(journalPath);
+            checker.check(recovered.getStrokeCount() == 4,
+                "torn record: " + std::to_string(recovered.getStrokeCount()) + " of 4 intact strokes recovered");
+            long cutSize = fileSize(journalPath);
+            checker.check(cutSize > 0 && cutSize < tornSize, "torn record cut off the journal");
+            drawStrokes(recovered, 1); // Journaled right after the intact prefix
+        }
+        Painter resumed(false);
+        resumed.openJournal(journalPath);
+        checker.check(resumed.getStrokeCount() == 5,
+            "appends after the cut replay (" + std::to_string(resumed.getStrokeCount()) + " of 5 strokes)");
+        resumed.closeJournal();
+    }
+
+    // --- LogQueue: several pushers, one popper ---
+    // Each line carries its producer and number in timeNs and again in the text. Whatever the
+    // interleaving, every producer's lines must come out in order and intact, and popped plus
+    // dropped must add up to pushed.
+    void runLogQueue(Checker& checker, size_t capacity, const std::string& name) {
+        const int Producers = 4;
+        const uint64_t Lines = 20000;
+        LogQueue queue(capacity);
+        std::atomic<int> running(Producers);
+        std::atomic<uint64_t> refused(0);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < Producers; ++p) {
+            producers.emplace_back([&, p] {
+                for (uint64_t i = 0; i < Lines; ++i) {
+                    uint64_t tag = (static_cast<uint64_t>(p) << 32) | i;
+                    if (!queue.push(LogLevel::Info, tag, std::to_string(p) + ":" + std::to_string(i)))
+                        refused.fetch_add(1, std::memory_order_relaxed);
+                }
+                running.fetch_sub(1);
+            });
+        }
+        std::vector<int64_t> last(Producers, -1);
+        uint64_t popped = 0;
+        bool ordered = true, intact = true;
+        LogQueue::Entry entry;
+        for (;;) {
+            bool done = running.load() == 0; // Read before popping, so nothing pushed before it is missed
+            bool any = false;
+            while (queue.pop(entry)) {
+                any = true;
+                ++popped;
+                int p = static_cast<int>(entry.timeNs >> 32);
+                int64_t i = static_cast<int64_t>(entry.timeNs & 0xffffffffu);
+                if (p < 0 || p >= Producers) { intact = false; continue; }
+                if (i <= last[p]) ordered = false;
+                last[p] = i;
+                if (entry.text != std::to_string(p) + ":" + std::to_string(i)) intact = false;
+            }
+            if (done && !any) break;
+            if (!any) std::this_thread::yield();
+        }
+        for (std::thread& producer : producers) producer.join();
+        uint64_t dropped = queue.getDroppedCount();
+        checker.check(ordered, name + ": lines of each producer pop in order");
+        checker.check(intact, name + ": popped lines intact");
+        checker.check(popped + dropped == Producers * Lines && dropped == refused.load(),
+            name + ": " + std::to_string(popped) + " popped + " + std::to_string(dropped) + " dropped of " + std::to_string(Producers * Lines));
+    }
+
+    void testLogQueue(Checker& checker) {
+        runLogQueue(checker, 1 << 17, "log queue with room");
+        runLogQueue(checker, 64, "log queue overflowing"); // Drops, then carries on in order
+    }
+}
+
+int runStrokeTests(int, char**) {
+    LogSinkScope logToStderr(logger, stderr); // Warnings the checks provoke show up next to them
+    Checker checker;
+    testSharing(checker);
+    testPainterCopies(checker);
+    testHistoryDrawnStrokes(checker);
+    testChunkMeshes(checker);
+    testSteadyFrame(checker);
+    testClearArena(checker);
+    testStreamBacklog(checker);
+    testSceneRoundTrip(checker);
+    testPointCodec(checker);
+    testJournalSaveUndo(checker);
+    testJournalMissingFile(checker);
+    testJournalTornTail(checker);
+    testLogQueue(checker);
+    return checker.finish();
+}
+
+#ifdef P3D_TESTS_MAIN
+// Standalone build (see README.md)
+int main(int argc, char** argv) {
+    return runStrokeTests(argc, argv);
+}
+#endif
@@ -0,0 +1,11 @@
+// StrokeTests.h
+#pragma once
+
+// Self-test for stroke sharing: StrokeRef identity and use counts through the store, the undo
+// history and duplication, and allocation counters around undo/redo/duplicate on a headless
+// Painter, checking that none of them copies stroke geometry. Also covers the GPU mesh cache,
+// scene streaming, .p3d round trips and journal recovery. Prints one line per check.
+//   3D Paint.exe --self-test
+// or, on Linux, the standalone build described in README.md (which also counts heap bytes).
+// Returns the process exit code: 0 if every check passed.
+int runStrokeTests(int argc, char** argv);
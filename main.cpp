@@ -22,6 +22,16 @@
 #include "Painter.h"          
 #include "Util.h"            
 #include "ImGuiCustomStyle.h"
+#include "Benchmark.h"
+#include "OffscreenRender.h"
+#include "StrokeTests.h"
+#include "GpuCounterPanel.h"
+#include "ProfilerPanel.h"
+#include "GpuPassTimer.h"
+#include "FrameTimeStats.h"
+#include <cstdlib> // __argc, __argv
+#include <cstring>
+#include <chrono>
 
 /*
 Camera camera(glm::vec3(0.0f, 1.0f, 3.0f));
@@ -36,6 +46,32 @@ const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
+    auto launchTime = std::chrono::steady_clock::now(); // For the time to first frame
+    // --- Headless benchmark: no window, JSON on stdout ---
+    if (__argc > 1 && std::strcmp(__argv[1], "--benchmark") == 0) {
+        return runBenchmark(__argc - 1, __argv + 1);
+    }
+    // --- Offscreen render: hidden window, scene + camera path in, timings and frame hashes out ---
+    if (__argc > 1 && std::strcmp(__argv[1], "--render") == 0) {
+        return runOffscreenRender(__argc - 1, __argv + 1);
+    }
+    // --- Stroke sharing self-test: PASS/FAIL lines on stdout, exit code 1 on a failure ---
+    if (__argc > 1 && std::strcmp(__argv[1], "--self-test") == 0) {
+        return runStrokeTests(__argc - 1, __argv + 1);
+    }
+
+    // --- Log file: the previous session's log is kept as session.log.1 ---
+    std::string logError;
+    if (!logger.openFile("session.log", 4 << 20, 3, &logError)) logger.addLog("[ERROR] " + logError);
+    LogSinkScope closeLogOnExit(logger);
+
+    // --- Shader cache: linked programs from the last run, unless --no-shader-cache ---
+    bool shaderCache = true;
+    for (int i = 1; i < __argc; ++i) {
+        if (std::strcmp(__argv[i], "--no-shader-cache") == 0) shaderCache = false;
+    }
+    if (shaderCache) setShaderCacheDirectory("shader_cache");
+
     // --- GLFW Initialization ---
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -126,18 +162,40 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
 
     // --- Create Painter ---
-    Painter painter;
+    // Its GL commands (and the sky's) go through a counting wrapper for the GPU Counters panel
+    GLRenderDevice glDevice;
+    GpuPassTimer gpuTimer; // GPU time per pass, for the Profiler window
+    if (gpuTimer.init()) glDevice.setPassTimer(&gpuTimer);
+    else logger.addLog(LogLevel::Warning, "GPU pass timing unavailable: this context has no timer queries");
+    RecordingRenderDevice gpuCounters(glDevice);
+    GpuCounterPanel gpuCounterPanel;
+    Painter painter(gpuCounters);
+    painter.openJournal("session.p3dj"); // Brings back the last session if it crashed
+
+    // --- CPU Profiler ---
+    Profiler::setThreadName("Main");
+    ProfilerPanel profilerPanel;
+    FrameTimeStats frameTimes; // Every frame's time, for percentiles and hitches
+    double lastFrameClock = 0.0;
 
 
     // --- Main Render Loop ---
     while (!glfwWindowShouldClose(window)) {
+        PROFILE_FRAME();
+        gpuTimer.beginFrame(); // Also picks up GPU times of earlier frames that have finished
+
         // --- Per-frame Time Logic ---
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        double frameClock = glfwGetTime(); // In double: the float above is down to ~0.1 ms steps after an hour
+        if (lastFrameClock > 0.0) frameTimes.addFrame(frameClock - lastFrameClock);
+        lastFrameClock = frameClock;
 
         // --- Input Processing ---
+        Profiler::Scope inputZone("Input");
         processInput(window); // Handle keyboard input (camera movement, exit, mouse capture toggle)
+        inputZone.end();
 
         // --- Rendering ---
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f); // Set background color
@@ -154,22 +212,27 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         glm::vec3 viewPos = camera.position; // Get camera position for lighting
 
         // --- Draw Skybox (First, behind everything else) ---
+        Profiler::Scope skyZone("Sky");
+        gpuCounters.beginPass(RenderPass::Sky);
         if (skyShader) { // Check if shader loaded successfully
             glDepthMask(GL_FALSE); // Disable depth writing for skybox
-            glUseProgram(skyShader);
+            gpuCounters.useProgram(skyShader);
             // Pass uniforms if your sky shader needs them (e.g., view/projection without translation)
             // glm::mat4 skyView = glm::mat4(glm::mat3(view)); // Remove translation
             // glUniformMatrix4fv(glGetUniformLocation(skyShader, "view"), 1, GL_FALSE, &skyView[0][0]);
             // glUniformMatrix4fv(glGetUniformLocation(skyShader, "projection"), 1, GL_FALSE, &projection[0][0]);
-            glBindVertexArray(skyVAO);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            gpuCounters.bindVertexArray(skyVAO);
+            gpuCounters.drawArrays(GL_TRIANGLE_STRIP, 0, 4);
             glDepthMask(GL_TRUE); // Re-enable depth writing
-            glBindVertexArray(0);
+            gpuCounters.bindVertexArray(0);
         }
+        gpuCounters.beginPass(RenderPass::Other);
+        skyZone.end();
 
 
         // --- Handle Painting Input (Screen to World) ---
         // Only process painting if ImGui doesn't want the mouse AND mouse is captured for camera control
+        Profiler::Scope paintZone("Paint input");
         if (!io.WantCaptureMouse && mouseCaptured) {
             double mouseX, mouseY;
             glfwGetCursorPos(window, &mouseX, &mouseY); // Get current mouse position
@@ -190,7 +253,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             // If ImGui wants the mouse OR the mouse isn't captured for camera control, ensure stroke ends
             painter.endStroke();
         }
+        paintZone.end();
 
+        Profiler::Scope imguiBuildZone("ImGui build"); // Ends with the Controls window, before the Painter draws
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -237,9 +302,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         ImGui::SameLine();
         if (ImGui::Button("Trans Curr (+X)")) painter.translateCurrentStroke(glm::vec3(0.1f, 0.0f, 0.0f));
 
+        if (ImGui::Button("Rotate Curr (15 deg Y)")) painter.rotateCurrentStroke(glm::radians(15.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        ImGui::SameLine();
+        if (ImGui::Button("Bake Curr Transform")) painter.bakeCurrentStrokeTransform();
+
         if (ImGui::Button("Duplicate Last")) painter.duplicateLastStroke();
         ImGui::SameLine();
         if (ImGui::Button("Merge All")) painter.mergeAllStrokes();
+        ImGui::SameLine();
+        if (ImGui::Button("Bake All")) painter.bakeAllStrokes();
 
         if (ImGui::Button("Clear Undone")) painter.clearUndoneStrokes();
         ImGui::SameLine();
@@ -253,12 +324,121 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         ImGui::ColorEdit3("Color##Light", glm::value_ptr(painter.lightColor));
         ImGui::Separator();
 
+        // --- Scene File ---
+        ImGui::Text("Scene File");
+        static char scenePath[256] = "scene.p3d";
+        static bool saveMeshes = true;
+        static bool packPoints = false;
+        ImGui::InputText("Path##Scene", scenePath, sizeof(scenePath));
+        if (ImGui::Button("Save Scene")) painter.saveScene(scenePath, saveMeshes, packPoints);
+        ImGui::SameLine();
+        if (ImGui::Button("Load Scene")) painter.loadScene(scenePath);
+        ImGui::SameLine();
+        ImGui::Checkbox("Save Meshes", &saveMeshes);
+        ImGui::SameLine();
+        ImGui::Checkbox("Pack Points", &packPoints);
+        SceneStreamLoader::Progress stream = painter.getSceneStreamProgress();
+        if (stream.active) {
+            float fraction = stream.strokesTotal ? (float)stream.strokesDelivered / stream.strokesTotal : 0.0f;
+            ImGui::ProgressBar(fraction, ImVec2(-80.0f, 0.0f));
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel##Stream")) painter.cancelSceneStream();
+        }
+        else if (ImGui::Button("Stream Load")) {
+            painter.streamScene(scenePath);
+        }
+        if (stream.strokesTotal > 0) {
+            ImGui::Text("Stream: %zu / %zu strokes, %.1f MB/s, %.0f strokes/s%s",
+                stream.strokesDelivered, stream.strokesTotal, stream.bytesPerSecond / (1024.0 * 1024.0),
+                stream.strokesPerSecond, stream.cancelled ? " (cancelled)" : "");
+        }
+        static char exportPath[256] = "scene";
+        static int exportFormat = 0;
+        static bool exportRan = false;
+        static MeshExport::Stats exportStats;
+        ImGui::InputText("Export Name", exportPath, sizeof(exportPath));
+        ImGui::Combo("Export Format", &exportFormat, "OBJ\0PLY\0STL\0GLB\0");
+        static bool glbRan = false;
+        static GltfExport::Stats glbStats;
+        if (ImGui::Button("Export Mesh")) {
+            if (exportFormat == 3) {
+                glbRan = painter.exportGlb(std::string(exportPath) + ".glb", &glbStats);
+                exportRan = false;
+            }
+            else {
+                MeshExport::Format format = static_cast<MeshExport::Format>(exportFormat);
+                exportRan = painter.exportMesh(std::string(exportPath) + MeshExport::extension(format), format, camera.front, &exportStats);
+                glbRan = false;
+            }
+        }
+        if (glbRan) {
+            ImGui::Text("Export: %zu meshes, %zu nodes, %zu instances, %.1f MB in %.2f s", glbStats.meshes, glbStats.nodes,
+                glbStats.instances, glbStats.bytes / (1024.0 * 1024.0), glbStats.seconds);
+        }
+        if (exportRan) {
+            ImGui::Text("Export: %zu triangles, %.1f MB in %.2f s (%.1f MB/s)", exportStats.triangles,
+                exportStats.bytes / (1024.0 * 1024.0), exportStats.seconds, exportStats.megabytesPerSecond());
+        }
+        static char importPath[256] = "points.xyz";
+        static int importStyle = 0;
+        static bool importRan = false;
+        static PointImport::Stats importStats;
+        ImGui::InputText("Import File", importPath, sizeof(importPath));
+        ImGui::Combo("Import As", &importStyle, "Points\0Tubes\0");
+        if (ImGui::Button("Import Points")) {
+            importRan = painter.importPoints(importPath, importStyle == 0 ? Painter::POINTS : Painter::TUBE, &importStats);
+        }
+        if (importRan) {
+            ImGui::Text("Import: %zu points, %zu polylines, %.1f ms (%.2f M points/s)", importStats.points,
+                importStats.polylines, importStats.parseSeconds * 1000.0, importStats.pointsPerSecond() / 1e6);
+        }
+        static bool codecRan = false;
+        static Painter::CodecBenchmark codec;
+        if (ImGui::Button("Benchmark Point Codec")) {
+            codec = painter.benchmarkPointCodec();
+            codecRan = true;
+        }
+        if (codecRan) {
+            ImGui::Text("Varint:     %.2fx, enc %.0f MB/s, dec %.0f MB/s", codec.varint.ratio(), codec.varint.encodeMBps(), codec.varint.decodeMBps());
+            ImGui::Text("Bit-packed: %.2fx, enc %.0f MB/s, dec %.0f MB/s", codec.bitPacked.ratio(), codec.bitPacked.encodeMBps(), codec.bitPacked.decodeMBps());
+        }
+        ImGui::Separator();
+
 
         // --- Info ---
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
         ImGui::Text("Total Strokes: %d", painter.getStrokeCount());
+        StrokeArena::Stats memStats = painter.getMemoryStats();
+        ImGui::Text("Stroke Memory: %.2f / %.2f MB (%zu chunks, %zu free)",
+            memStats.bytesUsed / (1024.0 * 1024.0), memStats.bytesReserved / (1024.0 * 1024.0),
+            memStats.chunkCount, memStats.freeChunkCount);
+        StrokeHistory::Stats historyStats = painter.getHistoryStats();
+        ImGui::Text("History: %.2f MB (%zu undo / %zu redo, %zu compressed, %zu evicted)",
+            historyStats.bytesUsed / (1024.0 * 1024.0), historyStats.undoCount, historyStats.redoCount,
+            historyStats.compressedStrokes, historyStats.evictedCommands);
+        static int historyBudgetMB = static_cast<int>(historyStats.budgetBytes / (1024 * 1024));
+        if (ImGui::SliderInt("History Budget (MB)", &historyBudgetMB, 16, 4096)) {
+            painter.setHistoryMemoryBudget(static_cast<size_t>(historyBudgetMB) * 1024 * 1024);
+        }
+
+        StrokeJournal::Stats journalStats = painter.getJournalStats();
+        ImGui::Text("Journal: %llu records, %.1f KB on disk, %zu B pending, last fsync %.2f ms",
+            (unsigned long long)journalStats.records, journalStats.fileBytes / 1024.0,
+            journalStats.pendingBytes, journalStats.lastSyncMs);
+
+        bool chunked = painter.getChunkedRendering();
+        if (ImGui::Checkbox("Chunked Static Batches", &chunked)) painter.setChunkedRendering(chunked);
+        float chunkSize = painter.getChunkSize();
+        if (ImGui::SliderFloat("Chunk Size", &chunkSize, 0.5f, 32.0f)) painter.setChunkSize(chunkSize);
+        Painter::RenderStats renderStats = painter.getRenderStats();
+        ImGui::Text("Draw calls: %zu | Chunks: %zu (%zu visible)", renderStats.drawCalls, renderStats.chunkCount, renderStats.visibleChunks);
+        ImGui::Text("Chunk rebuild: %zu in %.2f ms (slowest %.2f ms)", renderStats.chunksRebuilt, renderStats.lastRebuildMs, renderStats.maxRebuildMs);
+        ImGui::Text("Outside chunk batches: %zu strokes", renderStats.unbakedStrokes);
+        frameTimes.draw();
+        gpuCounterPanel.draw();
 
         ImGui::End(); // End Controls Window
+        imguiBuildZone.end();
 
 
         // --- Draw Painter Content ---
@@ -266,13 +446,25 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         painter.draw(view, projection, viewPos);
 
 
-        // --- Draw Logger Window ---
+        // --- Draw Logger and Profiler Windows ---
+        Profiler::Scope windowsZone("ImGui windows");
         logger.draw("Application Log"); // Draw your log window
+        profilerPanel.draw("Profiler", &gpuTimer);
+        windowsZone.end();
 
 
         // --- Render ImGui ---
+        Profiler::Scope imguiRenderZone("ImGui render");
         ImGui::Render(); // Assemble draw data
+        gpuCounters.beginPass(RenderPass::ImGui);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData()); // Render draw data
+        gpuCounters.beginPass(RenderPass::Other);
+        gpuTimer.endFrame();
+        imguiRenderZone.end();
+        // The backend calls GL itself: count its work from the draw data, then close the frame
+        gpuCounters.addExternal(RenderPass::ImGui, GpuCounterPanel::countImGuiDrawData(ImGui::GetDrawData()));
+        gpuCounterPanel.addFrame(gpuCounters);
+        gpuCounters.resetStats();
 
         // --- Handle ImGui Viewports (Optional) ---
         // if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
@@ -284,16 +476,31 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
 
         // --- GLFW Swap Buffers and Poll Events ---
+        Profiler::Scope swapZone("SwapBuffers");
         glfwSwapBuffers(window); // Swap the front and back buffers
+        swapZone.end();
+        static bool firstFrameShown = false;
+        if (!firstFrameShown) {
+            firstFrameShown = true;
+            ShaderLoadStats shaderStats = getShaderLoadStats();
+            char message[256];
+            snprintf(message, sizeof(message), "First frame after %.0f ms (shaders: %d programs in %.1f ms, %d from cache%s)",
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launchTime).count(),
+                shaderStats.programs, shaderStats.totalMs, shaderStats.fromCache, shaderCache ? "" : ", cache off");
+            logger.addLog(message);
+        }
+        PROFILE_SCOPE("PollEvents"); // Runs to the end of the frame
         glfwPollEvents();      // Check for and process events
     }
 
     // --- Cleanup ---
+    painter.closeJournal(); // Clean exit: the next start has nothing to recover
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
     // Painter destructor cleans up its own OpenGL objects when 'painter' goes out of scope
+    gpuTimer.shutdown();
     // Cleanup skybox resources
     glDeleteVertexArrays(1, &skyVAO);
     glDeleteBuffers(1, &skyVBO);
@@ -3,6 +3,7 @@ out vec4 FragColor;
 
 in vec3 FragPos; // Position from vertex shader (world space)
 in vec3 Normal;  // Normal from vertex shader (world space)
+flat in uint MaterialId; // Only meaningful for baked batches
 
 struct Material {
     vec4 ambient;   // Use vec4 for color, potentially alpha later
@@ -25,29 +26,43 @@ uniform Material material;
 uniform Light light;
 uniform vec3 viewPos; // Camera position in world space
 
+// Baked batches read the material per vertex from a table instead of the 'material' uniform.
+// 4 texels per material: ambient, diffuse, specular, (shininess, 0, 0, 0)
+uniform bool useMaterialTable;
+uniform samplerBuffer materialTable;
+
 void main()
 {
+    Material mat = material;
+    if (useMaterialTable) {
+        int base = int(MaterialId) * 4;
+        mat.ambient = texelFetch(materialTable, base);
+        mat.diffuse = texelFetch(materialTable, base + 1);
+        mat.specular = texelFetch(materialTable, base + 2);
+        mat.shininess = texelFetch(materialTable, base + 3).r;
+    }
+
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(light.position - FragPos);
 
     // Ambient
-    vec3 ambient = light.ambient * material.ambient.rgb * light.color; // Modulate by light color
+    vec3 ambient = light.ambient * mat.ambient.rgb * light.color; // Modulate by light color
 
     // Diffuse
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * (diff * material.diffuse.rgb) * light.color; // Modulate by light color
+    vec3 diffuse = light.diffuse * (diff * mat.diffuse.rgb) * light.color; // Modulate by light color
 
     // Specular
     vec3 viewDir = normalize(viewPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     // Alternative: Blinn-Phong
     // vec3 halfwayDir = normalize(lightDir + viewDir);
-    // float spec = pow(max(dot(norm, halfwayDir), 0.0), material.shininess);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * (spec * material.specular.rgb) * light.color; // Modulate by light color
+    // float spec = pow(max(dot(norm, halfwayDir), 0.0), mat.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), mat.shininess);
+    vec3 specular = light.specular * (spec * mat.specular.rgb) * light.color; // Modulate by light color
 
     vec3 result = ambient + diffuse + specular;
 
     // Use material diffuse alpha for overall transparency
-    FragColor = vec4(result, material.diffuse.a);
+    FragColor = vec4(result, mat.diffuse.a);
 }
\ No newline at end of file
@@ -3,6 +3,8 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 // Instanced rendering uses mat4 for model matrix
 layout (location = 2) in mat4 instanceModel; // VEC4 VEC4 VEC4 VEC4
+// Baked batches: index into the batch material table (locations 2-5 are taken by the matrix)
+layout (location = 6) in uint aMaterialId;
 
 // OR standard model matrix if not instancing
 uniform mat4 model; // Use this for non-instanced geometry (lines, tubes)
@@ -12,6 +14,7 @@ uniform mat4 projection;
 
 out vec3 FragPos;  // Vertex position in world space (or view space if preferred)
 out vec3 Normal;   // Normal in world space (or view space)
+flat out uint MaterialId;
 
 // Flag to determine if we are using instancing
 // You might set this based on draw style, or just always pass instanceModel
@@ -29,5 +32,7 @@ void main()
     // Normal = mat3(transpose(inverse(currentModel))) * aNormal; // More robust
     Normal = mat3(currentModel) * aNormal; // Simpler if scaling is uniform or non-existent
 
+    MaterialId = aMaterialId;
+
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file